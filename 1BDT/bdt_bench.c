@@ -0,0 +1,108 @@
+/*--------------------------------------------------------------------*/
+/* bdt_bench.c                                                        */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#include "bdt.h"
+#include "gen.h"
+#include "bench.h"
+
+
+/* The number of times the whole tree is turned into a string. */
+enum { BENCH_TO_STRINGS = 10 };
+
+
+/*
+    Inserts the paths of g into the BDT, which must hold none of
+    them, in order.
+*/
+static void insertAll(Gen_T g) {
+   size_t i;
+   int status;
+
+   for (i = 0; i < Gen_getCount(g); i++) {
+      status = BDT_insertPath(Gen_getPath(g, i));
+      assert(status == SUCCESS);
+   }
+   (void) status;
+}
+
+
+/*
+    Times each operation of the BDT on a tree of the shape given by
+    the options in argv, which are described in gen.h, and writes
+    the results to stdout as described in bench.h. The BDT holds no
+    files and has no stat, so the tree may not have files either.
+    Returns 0, or EXIT_FAILURE if the options are not valid or the
+    tree cannot be generated.
+*/
+int main(int argc, char* argv[]) {
+   struct Gen_shape shape = { 10, 2, 0, 8, 1 };
+   Gen_T g;
+   size_t count;
+   size_t i;
+   boolean found;
+   char* string;
+   int status;
+
+   if (!Gen_parseShape(argc, argv, &shape) || shape.fileRatio != 0 ||
+       shape.fanout > 2) {
+      fprintf(stderr, "usage: %s [-d depth] [-w fanout <= 2] "
+              "[-l nameLength] [-s seed]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   g = Gen_new(&shape);
+   if (g == NULL) {
+      fprintf(stderr, "%s: cannot generate the tree\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   count = Gen_getCount(g);
+   Gen_printShape(g, stdout);
+   Bench_printHeader();
+
+   status = BDT_init();
+   assert(status == SUCCESS);
+   Bench_start();
+   insertAll(g);
+   Bench_stop("bdt", "insert", count);
+
+   Bench_start();
+   for (i = 0; i < count; i++) {
+      found = BDT_containsPath(Gen_getPath(g, i));
+      assert(found);
+   }
+   Bench_stop("bdt", "contains", count);
+
+   Bench_start();
+   for (i = 0; i < BENCH_TO_STRINGS; i++) {
+      string = BDT_toString();
+      assert(string != NULL);
+      free(string);
+   }
+   Bench_stop("bdt", "toString", BENCH_TO_STRINGS);
+
+   /* children come after their parents, so go from the end */
+   Bench_start();
+   for (i = count; i-- > 0; ) {
+      status = BDT_rmPath(Gen_getPath(g, i));
+      assert(status == SUCCESS);
+   }
+   Bench_stop("bdt", "rm", count);
+
+   insertAll(g);
+   Bench_start();
+   status = BDT_destroy();
+   assert(status == SUCCESS);
+   Bench_stop("bdt", "destroy", 1);
+
+   (void) found;
+   (void) status;
+   Gen_free(g);
+   return 0;
+}
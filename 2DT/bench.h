@@ -0,0 +1,45 @@
+/*--------------------------------------------------------------------*/
+/* bench.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef BENCH_INCLUDED
+#define BENCH_INCLUDED
+
+
+#include <stddef.h>
+
+
+/*
+    Timing for the benchmark drivers. Each result is printed to stdout
+    as one line of space-separated fields,
+
+       tree op ops ns_per_op allocs_per_op peak_rss_kb
+
+    after a header line starting with '#', so that results may be
+    compared across releases by a script. Allocations are the calls
+    to malloc, calloc and realloc, which are only counted in programs
+    linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc.
+*/
+
+
+/*
+    Writes the header line naming the fields of the results.
+*/
+void Bench_printHeader(void);
+
+
+/*
+    Starts timing a run of operations.
+*/
+void Bench_start(void);
+
+
+/*
+    Stops timing the run of ops operations started by the last call
+    to Bench_start, and writes its result as op on tree.
+*/
+void Bench_stop(const char* tree, const char* op, size_t ops);
+
+#endif
@@ -74,38 +74,61 @@ boolean Checker_Node_isValid(Node n) {
 /*
    Performs a pre-order traversal of the tree rooted at n.
    Tracks the number of nodes visited with counter pointer.
-   Returns FALSE if a broken invariant is found and
-   returns TRUE otherwise.
+   The nodes still to visit are kept on an explicit stack rather
+   than by recurring, so trees of any depth can be checked.
+   Returns FALSE if a broken invariant is found or the stack
+   cannot grow, and returns TRUE otherwise.
 */
 static boolean Checker_treeCheck(Node n, size_t* counter) {
+   DynArray_T stack;
+   Node child;
    size_t c;
+   boolean isValid = TRUE;
    assert(counter != NULL);
 
-   if(n != NULL) {
+   if(n == NULL)
+      return TRUE;
+
+   stack = DynArray_new(0);
+   if(stack == NULL || !DynArray_add(stack, n)) {
+      fprintf(stderr, "Checker ran out of memory\n");
+      if(stack != NULL)
+         DynArray_free(stack);
+      return FALSE;
+   }
+
+   while(isValid && DynArray_getLength(stack) > 0) {
+      n = DynArray_removeAt(stack, DynArray_getLength(stack) - 1);
       (*counter)++;
 
       /* Sample check on each non-root Node: Node must be valid */
       /* If not, pass that failure back up immediately */
-      if(!Checker_Node_isValid(n))
-         return FALSE;
-
+      if(!Checker_Node_isValid(n)) {
+         isValid = FALSE;
+         break;
+      }
 
-      for(c = 0; c < Node_getNumChildren(n); c++)
+      /* children are pushed last to first, so that they are
+         popped, and visited, first to last */
+      for(c = Node_getNumChildren(n); c-- > 0; )
       {
-         Node child = Node_getChild(n, c);
+         child = Node_getChild(n, c);
          if(Node_compare(Node_getParent(child),n) != 0) {
-            fprintf(stderr, 
+            fprintf(stderr,
             "Node is not linked to its proper parent\n");
-            return FALSE;
+            isValid = FALSE;
+            break;
+         }
+         if(!DynArray_add(stack, child)) {
+            fprintf(stderr, "Checker ran out of memory\n");
+            isValid = FALSE;
+            break;
          }
-
-         /* if recurring down one subtree results in a failed check
-            farther down, passes the failure back up immediately */
-         if(!Checker_treeCheck(child, counter))
-            return FALSE;
       }
    }
-   return TRUE;
+
+   DynArray_free(stack);
+   return isValid;
 }
 
 /* see checker.h for specification */
@@ -0,0 +1,92 @@
+/*--------------------------------------------------------------------*/
+/* gen.h                                                              */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef GEN_INCLUDED
+#define GEN_INCLUDED
+
+
+#include <stddef.h>
+#include <stdio.h>
+
+
+/* The shape of a synthetic tree for Gen_new to generate. */
+struct Gen_shape {
+   /* the number of levels below the root */
+   size_t depth;
+
+   /* the number of children of each directory above the last level */
+   size_t fanout;
+
+   /* the chance, from 0 to 1, that each child is a file rather than
+      a directory */
+   double fileRatio;
+
+   /* the number of characters in each name, so that a path at level
+      k is (k + 1) * (nameLength + 1) - 1 characters long */
+   size_t nameLength;
+
+   /* the seed that picks the names and which children are files */
+   unsigned long seed;
+};
+
+
+/*
+    a Gen_T is the list of paths of a synthetic tree, parents before
+    their children, each marked as a file or a directory. The same
+    shape always generates the same paths.
+*/
+typedef struct Gen* Gen_T;
+
+
+/*
+    Sets the fields of *pShape given by the options in argv, which
+    are -d depth, -w fanout, -f fileRatio, -l nameLength and -s seed,
+    leaving the others as they are. Returns 1 if every argument is
+    such an option with a valid value, and 0 otherwise.
+*/
+int Gen_parseShape(int argc, char* argv[], struct Gen_shape* pShape);
+
+
+/*
+    Returns a new Gen_T holding the paths of a tree of shape *pShape,
+    or NULL if allocation error occurs. If nameLength is too short to
+    tell fanout siblings apart, it is lengthened.
+*/
+Gen_T Gen_new(const struct Gen_shape* pShape);
+
+
+/*
+    Frees g and its paths.
+*/
+void Gen_free(Gen_T g);
+
+
+/*
+    Returns the number of paths in g.
+*/
+size_t Gen_getCount(Gen_T g);
+
+
+/*
+    Returns path i of g, which lives as long as g.
+*/
+char* Gen_getPath(Gen_T g, size_t i);
+
+
+/*
+    Returns 1 if path i of g is a file, and 0 if it is a directory.
+*/
+int Gen_isFile(Gen_T g, size_t i);
+
+
+/*
+    Writes a line describing the shape of g and its number of paths to
+    stream, starting with '#' so that readers of the benchmark output
+    may skip it.
+*/
+void Gen_printShape(Gen_T g, FILE* stream);
+
+#endif
@@ -0,0 +1,317 @@
+/*--------------------------------------------------------------------*/
+/* arena.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+#include "arena.h"
+#include "stats.h"
+
+
+/* The alignment of every block, and the step between size classes. */
+enum { ARENA_ALIGN = 16 };
+
+/* The largest block carved from slabs; larger ones are malloc'd. */
+enum { ARENA_MAX_SMALL = 512 };
+
+/* The number of size classes of small blocks. */
+enum { ARENA_CLASSES = ARENA_MAX_SMALL / ARENA_ALIGN };
+
+/* The sizes of the first slab and of the largest ones; each new slab
+   is twice the size of the last until it reaches the largest. */
+enum { ARENA_FIRST_SLAB = 4096, ARENA_MAX_SLAB = 65536 };
+
+
+/* The header of a slab, which is followed by the blocks carved from
+   it. */
+struct ArenaSlab {
+   /* the slab allocated before this one, or NULL */
+   struct ArenaSlab* next;
+};
+
+
+/* The header of a block too large for slabs, which is followed by
+   the block itself. Large blocks are kept on a list so that freeing
+   the arena finds them, and can be released one by one. */
+struct ArenaLarge {
+   /* the neighbouring large blocks on the list, or NULL */
+   struct ArenaLarge* prev;
+   struct ArenaLarge* next;
+};
+
+
+/* The sizes of the headers, rounded up to keep blocks aligned. */
+enum {
+   ARENA_SLAB_HEADER = (sizeof(struct ArenaSlab) + ARENA_ALIGN - 1)
+      / ARENA_ALIGN * ARENA_ALIGN,
+   ARENA_LARGE_HEADER = (sizeof(struct ArenaLarge) + ARENA_ALIGN - 1)
+      / ARENA_ALIGN * ARENA_ALIGN
+};
+
+
+/* A released small block, waiting to be handed out again. */
+struct ArenaFree {
+   /* the next released block of the same size class, or NULL */
+   struct ArenaFree* next;
+};
+
+
+/* A structure that carves blocks out of slabs. */
+struct Arena {
+   /* the released blocks of each size class */
+   struct ArenaFree* freeLists[ARENA_CLASSES];
+
+   /* the part of the newest slab not yet carved up */
+   char* next;
+   char* limit;
+
+   /* the slabs, newest first, and the size of the next one */
+   struct ArenaSlab* slabs;
+   size_t slabSize;
+
+   /* the large blocks */
+   struct ArenaLarge* large;
+
+   /* the state attached by Arena_setExtra, or NULL */
+   void* extra;
+};
+
+
+/*
+   Returns the size class of a small block of size bytes.
+*/
+static size_t Arena_class(size_t size) {
+   assert(size <= ARENA_MAX_SMALL);
+
+   if (size == 0)
+      return 0;
+   return (size - 1) / ARENA_ALIGN;
+}
+
+
+/* see arena.h for specification */
+Arena_T Arena_new(void) {
+   Arena_T a;
+   size_t i;
+
+   a = malloc(sizeof(struct Arena));
+   if (a == NULL)
+      return NULL;
+
+   for (i = 0; i < ARENA_CLASSES; i++)
+      a->freeLists[i] = NULL;
+   a->next = NULL;
+   a->limit = NULL;
+   a->slabs = NULL;
+   a->slabSize = ARENA_FIRST_SLAB;
+   a->large = NULL;
+   a->extra = NULL;
+
+   return a;
+}
+
+
+/* see arena.h for specification */
+void Arena_free(Arena_T a) {
+   struct ArenaSlab* slab;
+   struct ArenaLarge* large;
+
+   if (a == NULL)
+      return;
+
+   while (a->slabs != NULL) {
+      slab = a->slabs;
+      a->slabs = slab->next;
+      free(slab);
+   }
+   while (a->large != NULL) {
+      large = a->large;
+      a->large = large->next;
+      free(large);
+   }
+   free(a);
+}
+
+
+/*
+   Returns a new block of size bytes, too large for slabs, from a, or
+   NULL if allocation error occurs.
+*/
+static void* Arena_allocLarge(Arena_T a, size_t size) {
+   struct ArenaLarge* large;
+
+   assert(a != NULL);
+
+   large = malloc(ARENA_LARGE_HEADER + size);
+   if (large == NULL)
+      return NULL;
+
+   large->prev = NULL;
+   large->next = a->large;
+   if (a->large != NULL)
+      a->large->prev = large;
+   a->large = large;
+
+   return (char*) large + ARENA_LARGE_HEADER;
+}
+
+
+/*
+   Returns the header of the large block pv.
+*/
+static struct ArenaLarge* Arena_largeHeader(void* pv) {
+   return (struct ArenaLarge*) (void*)
+      ((char*) pv - ARENA_LARGE_HEADER);
+}
+
+
+/*
+   Starts a new slab in a with room for at least size bytes. Returns
+   nonzero if successful, or 0 if allocation error occurs.
+*/
+static int Arena_addSlab(Arena_T a, size_t size) {
+   struct ArenaSlab* slab;
+
+   assert(a != NULL);
+   assert(size <= a->slabSize - ARENA_SLAB_HEADER);
+
+   slab = malloc(a->slabSize);
+   if (slab == NULL)
+      return 0;
+
+   slab->next = a->slabs;
+   a->slabs = slab;
+   a->next = (char*) slab + ARENA_SLAB_HEADER;
+   a->limit = (char*) slab + a->slabSize;
+
+   if (a->slabSize < ARENA_MAX_SLAB)
+      a->slabSize *= 2;
+   return 1;
+}
+
+
+/* see arena.h for specification */
+void* Arena_alloc(Arena_T a, size_t size) {
+   struct ArenaFree* block;
+   size_t class;
+   size_t blockSize;
+
+   STATS_COUNT(STATS_ALLOCS, 1);
+   if (a == NULL)
+      return malloc(size);
+
+   if (size > ARENA_MAX_SMALL)
+      return Arena_allocLarge(a, size);
+
+   class = Arena_class(size);
+   block = a->freeLists[class];
+   if (block != NULL) {
+      a->freeLists[class] = block->next;
+      return block;
+   }
+
+   /* the rest of the current slab is abandoned if it is too small;
+      every block is a multiple of ARENA_ALIGN, so it is at most a
+      few small blocks' worth */
+   blockSize = (class + 1) * ARENA_ALIGN;
+   if (a->next == NULL || (size_t) (a->limit - a->next) < blockSize)
+      if (!Arena_addSlab(a, blockSize))
+         return NULL;
+
+   block = (struct ArenaFree*) (void*) a->next;
+   a->next += blockSize;
+   return block;
+}
+
+
+/* see arena.h for specification */
+void Arena_release(Arena_T a, void* pv, size_t size) {
+   struct ArenaFree* block;
+   struct ArenaLarge* large;
+   size_t class;
+
+   if (a == NULL) {
+      free(pv);
+      return;
+   }
+   if (pv == NULL)
+      return;
+
+   if (size > ARENA_MAX_SMALL) {
+      large = Arena_largeHeader(pv);
+      if (large->prev != NULL)
+         large->prev->next = large->next;
+      else
+         a->large = large->next;
+      if (large->next != NULL)
+         large->next->prev = large->prev;
+      free(large);
+      return;
+   }
+
+   class = Arena_class(size);
+   block = pv;
+   block->next = a->freeLists[class];
+   a->freeLists[class] = block;
+}
+
+
+/* see arena.h for specification */
+void* Arena_resize(Arena_T a, void* pv, size_t oldSize, size_t newSize){
+   struct ArenaLarge* large;
+   void* new;
+
+   if (a == NULL)
+      return realloc(pv, newSize);
+
+   /* a small block already has room for anything in its class */
+   if (pv != NULL && oldSize <= ARENA_MAX_SMALL &&
+       newSize <= ARENA_MAX_SMALL &&
+       Arena_class(oldSize) == Arena_class(newSize))
+      return pv;
+
+   /* a large block can be resized in place by realloc */
+   if (pv != NULL && oldSize > ARENA_MAX_SMALL &&
+       newSize > ARENA_MAX_SMALL) {
+      large = realloc(Arena_largeHeader(pv),
+                      ARENA_LARGE_HEADER + newSize);
+      if (large == NULL)
+         return NULL;
+      if (large->prev != NULL)
+         large->prev->next = large;
+      else
+         a->large = large;
+      if (large->next != NULL)
+         large->next->prev = large;
+      return (char*) large + ARENA_LARGE_HEADER;
+   }
+
+   new = Arena_alloc(a, newSize);
+   if (new == NULL)
+      return NULL;
+   if (pv != NULL) {
+      memcpy(new, pv, oldSize < newSize ? oldSize : newSize);
+      Arena_release(a, pv, oldSize);
+   }
+   return new;
+}
+
+
+/* see arena.h for specification */
+void Arena_setExtra(Arena_T a, void* pvExtra) {
+   assert(a != NULL);
+   a->extra = pvExtra;
+}
+
+
+/* see arena.h for specification */
+void* Arena_getExtra(Arena_T a) {
+   if (a == NULL)
+      return NULL;
+   return a->extra;
+}
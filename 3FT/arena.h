@@ -0,0 +1,80 @@
+/*--------------------------------------------------------------------*/
+/* arena.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+
+#include <stddef.h>
+
+
+/*
+    an Arena_T hands out blocks of memory carved from large slabs.
+    Small blocks are grouped by size, and a released block is kept
+    for reuse by the next request of its size rather than returned to
+    the system. Freeing the arena frees every block in it at once, in
+    time proportional to the number of slabs.
+
+    Wherever an Arena_T is expected, NULL may be passed instead, in
+    which case blocks come from and return to malloc and free.
+
+    An Arena_T is not safe to use from several threads at once.
+*/
+typedef struct Arena* Arena_T;
+
+
+/*
+    Creates and returns a new, empty Arena_T, or NULL if allocation
+    error occurs.
+*/
+Arena_T Arena_new(void);
+
+
+/*
+    Frees a and every block allocated from it, whether released or
+    not. Does nothing if a is NULL.
+*/
+void Arena_free(Arena_T a);
+
+
+/*
+    Returns a block of size bytes from a, suitably aligned for any
+    object, or NULL if allocation error occurs.
+*/
+void* Arena_alloc(Arena_T a, size_t size);
+
+
+/*
+    Returns a block of newSize bytes from a holding the first bytes of
+    the block pv, which was allocated from a with oldSize bytes, or
+    NULL if allocation error occurs, in which case pv is unchanged.
+    pv may be NULL if oldSize is 0.
+*/
+void* Arena_resize(Arena_T a, void* pv, size_t oldSize, size_t newSize);
+
+
+/*
+    Gives the block pv, allocated from a with size bytes, back to a.
+    Does nothing if pv is NULL.
+*/
+void Arena_release(Arena_T a, void* pv, size_t size);
+
+
+/*
+    Attaches pvExtra to a, for a module that keeps state of its own
+    for each arena, such as the names of the nodes allocated from it
+    (see names.h). a must not be NULL.
+*/
+void Arena_setExtra(Arena_T a, void* pvExtra);
+
+
+/*
+    Returns what was last attached to a by Arena_setExtra, or NULL if
+    nothing was or a is NULL.
+*/
+void* Arena_getExtra(Arena_T a);
+
+#endif
@@ -0,0 +1,90 @@
+/*--------------------------------------------------------------------*/
+/* bench.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+
+#include "bench.h"
+
+
+/* The number of calls to malloc, calloc and realloc so far. */
+static size_t numAllocs;
+
+
+/* The time and allocation count when the current run started. */
+static struct timespec startTime;
+static size_t startAllocs;
+
+
+/* The allocators the linker renames to make way for the wrappers. */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+
+
+/* Counts a call to malloc and passes it on. */
+void* __wrap_malloc(size_t size) {
+   numAllocs++;
+   return __real_malloc(size);
+}
+
+
+/* Counts a call to calloc and passes it on. */
+void* __wrap_calloc(size_t count, size_t size) {
+   numAllocs++;
+   return __real_calloc(count, size);
+}
+
+
+/* Counts a call to realloc and passes it on. */
+void* __wrap_realloc(void* p, size_t size) {
+   numAllocs++;
+   return __real_realloc(p, size);
+}
+
+
+/* see bench.h for specification */
+void Bench_printHeader(void) {
+   printf("# tree op ops ns_per_op allocs_per_op peak_rss_kb\n");
+}
+
+
+/* see bench.h for specification */
+void Bench_start(void) {
+   startAllocs = numAllocs;
+   clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+
+/* see bench.h for specification */
+void Bench_stop(const char* tree, const char* op, size_t ops) {
+   struct timespec endTime;
+   struct rusage usage;
+   double ns;
+   size_t allocs;
+
+   assert(tree != NULL);
+   assert(op != NULL);
+   assert(ops > 0);
+
+   clock_gettime(CLOCK_MONOTONIC, &endTime);
+   allocs = numAllocs - startAllocs;
+   ns = (endTime.tv_sec - startTime.tv_sec) * 1e9 +
+        (endTime.tv_nsec - startTime.tv_nsec);
+   getrusage(RUSAGE_SELF, &usage);
+
+   printf("%s %s %lu %.1f %.2f %ld\n", tree, op, (unsigned long) ops,
+          ns / ops, (double) allocs / ops, usage.ru_maxrss);
+   fflush(stdout);
+}
@@ -0,0 +1,125 @@
+/*--------------------------------------------------------------------*/
+/* blob.c                                                             */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "blob.h"
+
+
+/* A run of bytes shared by counted references. */
+struct Blob {
+   /* the number of references to this blob */
+   size_t refs;
+
+   /* the bytes held, of which there are length; for a blob made by
+      Blob_new, they are stored just after this struct */
+   void* bytes;
+   size_t length;
+};
+
+
+/* see blob.h for specification */
+Blob_T Blob_new(const void* bytes, size_t length) {
+   Blob_T b;
+
+   assert(bytes != NULL || length == 0);
+
+   if (length > (size_t) -1 - sizeof(struct Blob))
+      return NULL;
+   b = malloc(sizeof(struct Blob) + length);
+   if (b == NULL)
+      return NULL;
+
+   b->refs = 1;
+   b->bytes = b + 1;
+   b->length = length;
+   if (length > 0)
+      memcpy(b->bytes, bytes, length);
+   return b;
+}
+
+
+/* see blob.h for specification */
+Blob_T Blob_adopt(void* bytes, size_t length) {
+   Blob_T b;
+
+   assert(bytes != NULL || length == 0);
+
+   b = malloc(sizeof(struct Blob));
+   if (b == NULL)
+      return NULL;
+
+   b->refs = 1;
+   b->bytes = bytes;
+   b->length = length;
+   return b;
+}
+
+
+/* see blob.h for specification */
+void* Blob_disown(Blob_T b) {
+   void* bytes;
+
+   assert(b != NULL);
+   assert(b->refs == 1);
+   assert(b->bytes != (void*) (b + 1) || b->length == 0);
+
+   bytes = b->bytes;
+   free(b);
+   return bytes;
+}
+
+
+/* see blob.h for specification */
+Blob_T Blob_retain(Blob_T b) {
+   assert(b != NULL);
+
+   (void) __atomic_add_fetch(&b->refs, 1, __ATOMIC_RELAXED);
+   return b;
+}
+
+
+/* see blob.h for specification */
+void Blob_release(Blob_T b) {
+   if (b == NULL)
+      return;
+
+   /* the release orders every holder's use of the bytes before the
+      free, which the last holder's acquire waits for */
+   if (__atomic_sub_fetch(&b->refs, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+
+   if (b->bytes != (void*) (b + 1))
+      free(b->bytes);
+   free(b);
+}
+
+
+/* see blob.h for specification */
+size_t Blob_countRefs(Blob_T b) {
+   assert(b != NULL);
+
+   return __atomic_load_n(&b->refs, __ATOMIC_ACQUIRE);
+}
+
+
+/* see blob.h for specification */
+void* Blob_getBytes(Blob_T b) {
+   assert(b != NULL);
+
+   return b->bytes;
+}
+
+
+/* see blob.h for specification */
+size_t Blob_getLength(Blob_T b) {
+   assert(b != NULL);
+
+   return b->length;
+}
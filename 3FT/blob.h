@@ -0,0 +1,82 @@
+/*--------------------------------------------------------------------*/
+/* blob.h                                                             */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef BLOB_INCLUDED
+#define BLOB_INCLUDED
+
+
+#include <stddef.h>
+
+
+/*
+    a Blob_T is an immutable run of bytes shared by counted
+    references: it is freed, bytes and all, when the last reference
+    to it is released. References may be taken and released by many
+    threads at once.
+*/
+typedef struct Blob* Blob_T;
+
+
+/*
+    Returns a new Blob_T holding a copy of the length bytes at bytes
+    (which may be NULL if length is 0), with one reference held by
+    the caller, or NULL if allocation error occurs.
+*/
+Blob_T Blob_new(const void* bytes, size_t length);
+
+
+/*
+    Returns a new Blob_T holding the length bytes at bytes without
+    copying them, with one reference held by the caller, or NULL if
+    allocation error occurs. bytes must be NULL or have been
+    allocated with malloc; the Blob_T frees them with free once the
+    last reference is released, and until then nobody may change
+    them.
+*/
+Blob_T Blob_adopt(void* bytes, size_t length);
+
+
+/*
+    Frees b, which must have come from Blob_adopt and to which the
+    caller must hold the only reference, without freeing its bytes,
+    and returns them, to be owned by the caller again.
+*/
+void* Blob_disown(Blob_T b);
+
+
+/*
+    Takes another reference to b and returns b.
+*/
+Blob_T Blob_retain(Blob_T b);
+
+
+/*
+    Releases a reference to b, freeing b if it was the last. Does
+    nothing if b is NULL.
+*/
+void Blob_release(Blob_T b);
+
+
+/*
+    Returns the number of references to b. Other threads may take or
+    release references meanwhile, unless the count is 1 and the
+    caller holds the only one.
+*/
+size_t Blob_countRefs(Blob_T b);
+
+
+/*
+    Returns the bytes b holds, which live as long as b.
+*/
+void* Blob_getBytes(Blob_T b);
+
+
+/*
+    Returns the number of bytes b holds.
+*/
+size_t Blob_getLength(Blob_T b);
+
+#endif
@@ -4,8 +4,10 @@
 /*--------------------------------------------------------------------*/
 
 #include "dynarray.h"
+#include "stats.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*--------------------------------------------------------------------*/
 
@@ -30,6 +32,14 @@ struct DynArray
 
    /* The array that underlies the DynArray. */
    const void **ppvArray;
+
+   /* The keys that go with the elements of ppvArray, one for each,
+      or NULL if the DynArray has no keys. */
+   size_t *puKeys;
+
+   /* The arena the DynArray and its array are allocated from, or
+      NULL if they are malloc'd. */
+   Arena_T oArena;
 };
 
 /*--------------------------------------------------------------------*/
@@ -60,15 +70,42 @@ static int DynArray_grow(DynArray_T oDynArray)
 
    size_t uNewLength;
    const void **ppvNewArray;
+   size_t *puNewKeys = NULL;
 
    assert(oDynArray != NULL);
 
    uNewLength = GROWTH_FACTOR * oDynArray->uPhysLength;
 
+   /* The new keys are allocated first, so that if either allocation
+      fails both arrays keep their old physical length. */
+   if (oDynArray->puKeys != NULL)
+   {
+      puNewKeys = (size_t*)
+         Arena_alloc(oDynArray->oArena, sizeof(size_t) * uNewLength);
+      if (puNewKeys == NULL)
+         return 0;
+   }
+
    ppvNewArray = (const void**)
-      realloc(oDynArray->ppvArray, sizeof(void*) * uNewLength);
+      Arena_resize(oDynArray->oArena, (void*)oDynArray->ppvArray,
+                   sizeof(void*) * oDynArray->uPhysLength,
+                   sizeof(void*) * uNewLength);
    if (ppvNewArray == NULL)
+   {
+      if (oDynArray->puKeys != NULL)
+         Arena_release(oDynArray->oArena, puNewKeys,
+                       sizeof(size_t) * uNewLength);
       return 0;
+   }
+
+   if (oDynArray->puKeys != NULL)
+   {
+      memcpy(puNewKeys, oDynArray->puKeys,
+             sizeof(size_t) * oDynArray->uPhysLength);
+      Arena_release(oDynArray->oArena, oDynArray->puKeys,
+                    sizeof(size_t) * oDynArray->uPhysLength);
+      oDynArray->puKeys = puNewKeys;
+   }
 
    oDynArray->uPhysLength = uNewLength;
    oDynArray->ppvArray = ppvNewArray;
@@ -78,26 +115,62 @@ static int DynArray_grow(DynArray_T oDynArray)
 /*--------------------------------------------------------------------*/
 
 DynArray_T DynArray_new(size_t uLength)
+{
+   return DynArray_newIn(uLength, NULL);
+}
+
+/*--------------------------------------------------------------------*/
+
+DynArray_T DynArray_newIn(size_t uLength, Arena_T oArena)
 {
    DynArray_T oDynArray;
 
-   oDynArray = (struct DynArray*)malloc(sizeof(struct DynArray));
+   oDynArray = (struct DynArray*)
+      Arena_alloc(oArena, sizeof(struct DynArray));
    if (oDynArray == NULL)
       return NULL;
 
+   oDynArray->oArena = oArena;
+
    oDynArray->uLength = uLength;
    if (uLength > MIN_PHYS_LENGTH)
       oDynArray->uPhysLength = uLength;
    else
       oDynArray->uPhysLength = MIN_PHYS_LENGTH;
 
-   oDynArray->ppvArray =
-      (const void**)calloc(oDynArray->uPhysLength, sizeof(void*));
+   oDynArray->ppvArray = (const void**)
+      Arena_alloc(oArena, sizeof(void*) * oDynArray->uPhysLength);
    if (oDynArray->ppvArray == NULL)
    {
-      free(oDynArray);
+      Arena_release(oArena, oDynArray, sizeof(struct DynArray));
+      return NULL;
+   }
+   memset(oDynArray->ppvArray, 0,
+          sizeof(void*) * oDynArray->uPhysLength);
+   oDynArray->puKeys = NULL;
+
+   return oDynArray;
+}
+
+/*--------------------------------------------------------------------*/
+
+DynArray_T DynArray_newKeyedIn(size_t uLength, Arena_T oArena)
+{
+   DynArray_T oDynArray;
+
+   oDynArray = DynArray_newIn(uLength, oArena);
+   if (oDynArray == NULL)
+      return NULL;
+
+   oDynArray->puKeys = (size_t*)
+      Arena_alloc(oArena, sizeof(size_t) * oDynArray->uPhysLength);
+   if (oDynArray->puKeys == NULL)
+   {
+      DynArray_free(oDynArray);
       return NULL;
    }
+   memset(oDynArray->puKeys, 0,
+          sizeof(size_t) * oDynArray->uPhysLength);
 
    return oDynArray;
 }
@@ -109,8 +182,12 @@ void DynArray_free(DynArray_T oDynArray)
    assert(oDynArray != NULL);
    assert(DynArray_isValid(oDynArray));
 
-   free(oDynArray->ppvArray);
-   free(oDynArray);
+   if (oDynArray->puKeys != NULL)
+      Arena_release(oDynArray->oArena, oDynArray->puKeys,
+                    sizeof(size_t) * oDynArray->uPhysLength);
+   Arena_release(oDynArray->oArena, (void*)oDynArray->ppvArray,
+                 sizeof(void*) * oDynArray->uPhysLength);
+   Arena_release(oDynArray->oArena, oDynArray, sizeof(struct DynArray));
 }
 
 /*--------------------------------------------------------------------*/
@@ -155,6 +232,28 @@ void *DynArray_set(DynArray_T oDynArray, size_t uIndex,
 
 /*--------------------------------------------------------------------*/
 
+size_t DynArray_getKey(DynArray_T oDynArray, size_t uIndex)
+{
+   assert(oDynArray != NULL);
+   assert(oDynArray->puKeys != NULL);
+   assert(uIndex < oDynArray->uLength);
+
+   return oDynArray->puKeys[uIndex];
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_setKey(DynArray_T oDynArray, size_t uIndex, size_t uKey)
+{
+   assert(oDynArray != NULL);
+   assert(oDynArray->puKeys != NULL);
+   assert(uIndex < oDynArray->uLength);
+
+   oDynArray->puKeys[uIndex] = uKey;
+}
+
+/*--------------------------------------------------------------------*/
+
 int DynArray_add(DynArray_T oDynArray, const void *pvElement)
 {
    assert(oDynArray != NULL);
@@ -165,6 +264,8 @@ int DynArray_add(DynArray_T oDynArray, const void *pvElement)
          return 0;
 
    oDynArray->ppvArray[oDynArray->uLength] = pvElement;
+   if (oDynArray->puKeys != NULL)
+      oDynArray->puKeys[oDynArray->uLength] = 0;
    oDynArray->uLength++;
 
    assert(DynArray_isValid(oDynArray));
@@ -177,8 +278,6 @@ int DynArray_add(DynArray_T oDynArray, const void *pvElement)
 int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
                    const void *pvElement)
 {
-   size_t u;
-
    assert(oDynArray != NULL);
    assert(uIndex <= oDynArray->uLength);
    assert(DynArray_isValid(oDynArray));
@@ -187,8 +286,17 @@ int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
       if (! DynArray_grow(oDynArray))
          return 0;
 
-   for (u = oDynArray->uLength; u > uIndex; u--)
-      oDynArray->ppvArray[u] = oDynArray->ppvArray[u-1];
+   STATS_COUNT(STATS_SHIFTS, oDynArray->uLength - uIndex);
+   memmove(&oDynArray->ppvArray[uIndex + 1],
+           &oDynArray->ppvArray[uIndex],
+           (oDynArray->uLength - uIndex) * sizeof(void*));
+   if (oDynArray->puKeys != NULL)
+   {
+      memmove(&oDynArray->puKeys[uIndex + 1],
+              &oDynArray->puKeys[uIndex],
+              (oDynArray->uLength - uIndex) * sizeof(size_t));
+      oDynArray->puKeys[uIndex] = 0;
+   }
 
    oDynArray->ppvArray[uIndex] = pvElement;
    oDynArray->uLength++;
@@ -203,7 +311,6 @@ int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
 void *DynArray_removeAt(DynArray_T oDynArray, size_t uIndex)
 {
    const void *pvOldElement;
-   size_t u;
 
    assert(oDynArray != NULL);
    assert(uIndex < oDynArray->uLength);
@@ -213,8 +320,14 @@ void *DynArray_removeAt(DynArray_T oDynArray, size_t uIndex)
 
    oDynArray->uLength--;
 
-   for (u = uIndex; u < oDynArray->uLength; u++)
-      oDynArray->ppvArray[u] = oDynArray->ppvArray[u+1];
+   STATS_COUNT(STATS_SHIFTS, oDynArray->uLength - uIndex);
+   memmove(&oDynArray->ppvArray[uIndex],
+           &oDynArray->ppvArray[uIndex + 1],
+           (oDynArray->uLength - uIndex) * sizeof(void*));
+   if (oDynArray->puKeys != NULL)
+      memmove(&oDynArray->puKeys[uIndex],
+              &oDynArray->puKeys[uIndex + 1],
+              (oDynArray->uLength - uIndex) * sizeof(size_t));
 
    assert(DynArray_isValid(oDynArray));
 
@@ -255,7 +368,8 @@ void DynArray_map(DynArray_T oDynArray,
 
 /* Sort the array of elements that resides in memory at
    addresses ppvLo...ppvHi in ascending order, as determined
-   by *pfCompare.
+   by *pfCompare, moving the keys in puKeys (if it is not NULL), which
+   go with the elements of the array starting at ppvBase, along.
    *pfCompare must return <0, 0, or >0 depending upon whether
    *pvElement1 is less than, equal to, or greater than *pvElement2,
    respectively. */
@@ -263,7 +377,9 @@ void DynArray_map(DynArray_T oDynArray,
 static void DynArray_qsort(
    const void **ppvLo,
    const void **ppvHi,
-   int (*pfCompare) (const void *pvElement1, const void *pvElement2))
+   int (*pfCompare) (const void *pvElement1, const void *pvElement2),
+   const void **ppvBase,
+   size_t *puKeys)
 {
    /* This function implements a variation of the quicksort algorithm
       shown in the book "Algorithms + Data Structures = Programs" by
@@ -276,6 +392,7 @@ static void DynArray_qsort(
    const void **ppvLeft;
    const void *pvPivot;
    const void *pvTemp;
+   size_t uTemp;
 
    assert(ppvLo != NULL);
    assert(ppvHi != NULL);
@@ -297,6 +414,12 @@ static void DynArray_qsort(
          pvTemp = *ppvRight;
          *ppvRight = *ppvLeft;
          *ppvLeft = pvTemp;
+         if (puKeys != NULL)
+         {
+            uTemp = puKeys[ppvRight - ppvBase];
+            puKeys[ppvRight - ppvBase] = puKeys[ppvLeft - ppvBase];
+            puKeys[ppvLeft - ppvBase] = uTemp;
+         }
 
          ppvRight++;
          ppvLeft--;
@@ -304,9 +427,9 @@ static void DynArray_qsort(
    }
 
    if (ppvLo < ppvLeft)
-      DynArray_qsort(ppvLo, ppvLeft, pfCompare);
+      DynArray_qsort(ppvLo, ppvLeft, pfCompare, ppvBase, puKeys);
    if (ppvRight < ppvHi)
-      DynArray_qsort(ppvRight, ppvHi, pfCompare);
+      DynArray_qsort(ppvRight, ppvHi, pfCompare, ppvBase, puKeys);
 }
 
 /*--------------------------------------------------------------------*/
@@ -325,7 +448,9 @@ void DynArray_sort(DynArray_T oDynArray,
    DynArray_qsort(
       &oDynArray->ppvArray[0],
       &oDynArray->ppvArray[oDynArray->uLength-1],
-      pfCompare);
+      pfCompare,
+      oDynArray->ppvArray,
+      oDynArray->puKeys);
 
    assert(DynArray_isValid(oDynArray));
 }
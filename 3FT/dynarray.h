@@ -7,6 +7,7 @@
 #define DYNARRAY_INCLUDED
 
 #include <stddef.h>
+#include "arena.h"
 
 /* A DynArray_T object is an array whose length can expand
    dynamically. */
@@ -22,6 +23,25 @@ DynArray_T DynArray_new(size_t uLength);
 
 /*--------------------------------------------------------------------*/
 
+/* Return a new DynArray_T object whose length is uLength, allocated
+   along with its underlying array from oArena, or NULL if
+   insufficient memory is available. */
+
+DynArray_T DynArray_newIn(size_t uLength, Arena_T oArena);
+
+/*--------------------------------------------------------------------*/
+
+/* Return a new DynArray_T object as DynArray_newIn does, which also
+   keeps a key of type size_t with each element, in an array of its
+   own so that keys can be scanned without touching the elements.
+   Keys move with their elements when elements are added, removed or
+   sorted; an added element's key is 0, and DynArray_set leaves the
+   key where it is. */
+
+DynArray_T DynArray_newKeyedIn(size_t uLength, Arena_T oArena);
+
+/*--------------------------------------------------------------------*/
+
 /* Free oDynArray. */
 
 void DynArray_free(DynArray_T oDynArray);
@@ -48,6 +68,20 @@ void *DynArray_set(DynArray_T oDynArray, size_t uIndex,
 
 /*--------------------------------------------------------------------*/
 
+/* Return the key of the uIndex'th element of oDynArray, which must
+   have been created by DynArray_newKeyedIn. */
+
+size_t DynArray_getKey(DynArray_T oDynArray, size_t uIndex);
+
+/*--------------------------------------------------------------------*/
+
+/* Assign uKey to the key of the uIndex'th element of oDynArray, which
+   must have been created by DynArray_newKeyedIn. */
+
+void DynArray_setKey(DynArray_T oDynArray, size_t uIndex, size_t uKey);
+
+/*--------------------------------------------------------------------*/
+
 /* Add pvElement to the end of oDynArray, thus incrementing its length.
    Return 1 (TRUE) if successful, or 0 (FALSE) if insufficient memory
    is available. */
@@ -0,0 +1,248 @@
+/*--------------------------------------------------------------------*/
+/* epoch.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+
+#include "epoch.h"
+
+
+/* The number of reader counter slots; threads are spread over them. */
+enum { EPOCH_SLOTS = 64 };
+
+/* The size of a cache line, which each slot is padded to fill. */
+enum { EPOCH_LINE = 64 };
+
+
+/*
+   The readers counted in one slot, one counter per phase. Each slot
+   has a cache line to itself so that readers in different slots never
+   write to the same line.
+*/
+struct EpochSlot {
+   /* the number of active readers that entered in each phase */
+   size_t readers[2];
+
+   /* padding up to a full cache line */
+   char pad[EPOCH_LINE - 2 * sizeof(size_t)];
+};
+
+
+/* An item waiting for a grace period before it is freed. */
+struct EpochRetired {
+   /* the item, and the function that frees it */
+   void* pvItem;
+   void (*pfFree)(void*);
+
+   /* the item retired before this one, or NULL */
+   struct EpochRetired* next;
+};
+
+
+/* A structure that tracks readers and retired items. */
+struct Epoch {
+   /* reader counters, one padded slot per group of threads */
+   struct EpochSlot slots[EPOCH_SLOTS];
+
+   /* the current phase; readers count themselves in slot counter
+      phase % 2, and each grace period advances it */
+   size_t phase;
+
+   /* the items retired so far, most recent first, and their count */
+   struct EpochRetired* retired;
+   size_t numRetired;
+};
+
+
+/* The key under which each thread keeps a pointer to its slot's tag. */
+static pthread_key_t slotKey;
+
+/* One tag per slot, whose addresses identify slots under slotKey. */
+static char slotTags[EPOCH_SLOTS];
+
+/* Makes sure slotKey is created exactly once. */
+static pthread_once_t slotKeyOnce = PTHREAD_ONCE_INIT;
+
+/* The slot the next thread to need one is given. */
+static size_t nextSlot;
+
+
+/*
+   Creates slotKey.
+*/
+static void Epoch_createSlotKey(void) {
+   (void) pthread_key_create(&slotKey, NULL);
+}
+
+
+/*
+   Returns the slot the calling thread counts itself in, assigning
+   slots to threads round-robin on first use.
+*/
+static size_t Epoch_threadSlot(void) {
+   char* tag;
+   size_t slot;
+
+   (void) pthread_once(&slotKeyOnce, Epoch_createSlotKey);
+
+   tag = pthread_getspecific(slotKey);
+   if (tag != NULL)
+      return (size_t) (tag - slotTags);
+
+   slot = __atomic_fetch_add(&nextSlot, 1, __ATOMIC_RELAXED)
+      % EPOCH_SLOTS;
+   (void) pthread_setspecific(slotKey, &slotTags[slot]);
+   return slot;
+}
+
+
+/* see epoch.h for specification */
+Epoch_T Epoch_new(void) {
+   Epoch_T e;
+   size_t i;
+
+   e = malloc(sizeof(struct Epoch));
+   if (e == NULL)
+      return NULL;
+
+   for (i = 0; i < EPOCH_SLOTS; i++) {
+      e->slots[i].readers[0] = 0;
+      e->slots[i].readers[1] = 0;
+   }
+   e->phase = 0;
+   e->retired = NULL;
+   e->numRetired = 0;
+
+   return e;
+}
+
+
+/*
+   Frees every item on the list starting at retired, and the list.
+*/
+static void Epoch_freeRetired(struct EpochRetired* retired) {
+   struct EpochRetired* next;
+
+   while (retired != NULL) {
+      next = retired->next;
+      (*retired->pfFree)(retired->pvItem);
+      free(retired);
+      retired = next;
+   }
+}
+
+
+/* see epoch.h for specification */
+void Epoch_free(Epoch_T e) {
+   if (e == NULL)
+      return;
+
+   Epoch_freeRetired(e->retired);
+   free(e);
+}
+
+
+/* see epoch.h for specification */
+size_t Epoch_enter(Epoch_T e) {
+   size_t slot;
+   size_t parity;
+
+   assert(e != NULL);
+
+   slot = Epoch_threadSlot();
+   for (;;) {
+      parity = __atomic_load_n(&e->phase, __ATOMIC_SEQ_CST) % 2;
+      (void) __atomic_add_fetch(&e->slots[slot].readers[parity], 1,
+                                __ATOMIC_SEQ_CST);
+
+      /* if a grace period began in between, it may already have
+         checked this counter, so count this reader in the new phase */
+      if (__atomic_load_n(&e->phase, __ATOMIC_SEQ_CST) % 2 == parity)
+         break;
+      (void) __atomic_sub_fetch(&e->slots[slot].readers[parity], 1,
+                                __ATOMIC_SEQ_CST);
+   }
+
+   return slot * 2 + parity;
+}
+
+
+/* see epoch.h for specification */
+void Epoch_exit(Epoch_T e, size_t ticket) {
+   assert(e != NULL);
+   assert(ticket < 2 * EPOCH_SLOTS);
+
+   (void) __atomic_sub_fetch(&e->slots[ticket / 2].readers[ticket % 2],
+                             1, __ATOMIC_SEQ_CST);
+}
+
+
+/* see epoch.h for specification */
+void Epoch_synchronize(Epoch_T e) {
+   size_t parity;
+   size_t i;
+
+   assert(e != NULL);
+
+   /* new readers count themselves in the other phase from now on,
+      so only those already counted in this one need to drain */
+   parity = __atomic_fetch_add(&e->phase, 1, __ATOMIC_SEQ_CST) % 2;
+
+   for (i = 0; i < EPOCH_SLOTS; i++)
+      while (__atomic_load_n(&e->slots[i].readers[parity],
+                             __ATOMIC_SEQ_CST) != 0)
+         (void) sched_yield();
+}
+
+
+/* see epoch.h for specification */
+void Epoch_retire(Epoch_T e, void* pvItem, void (*pfFree)(void*)) {
+   struct EpochRetired* retired;
+
+   assert(e != NULL);
+   assert(pfFree != NULL);
+
+   retired = malloc(sizeof(struct EpochRetired));
+   if (retired == NULL) {
+      Epoch_synchronize(e);
+      (*pfFree)(pvItem);
+      return;
+   }
+
+   retired->pvItem = pvItem;
+   retired->pfFree = pfFree;
+   retired->next = e->retired;
+   e->retired = retired;
+   e->numRetired++;
+}
+
+
+/* see epoch.h for specification */
+size_t Epoch_getNumRetired(Epoch_T e) {
+   assert(e != NULL);
+   return e->numRetired;
+}
+
+
+/* see epoch.h for specification */
+void Epoch_reclaim(Epoch_T e) {
+   struct EpochRetired* retired;
+
+   assert(e != NULL);
+
+   if (e->retired == NULL)
+      return;
+
+   retired = e->retired;
+   e->retired = NULL;
+   e->numRetired = 0;
+
+   Epoch_synchronize(e);
+   Epoch_freeRetired(retired);
+}
@@ -0,0 +1,84 @@
+/*--------------------------------------------------------------------*/
+/* epoch.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef EPOCH_INCLUDED
+#define EPOCH_INCLUDED
+
+
+#include <stddef.h>
+
+
+/*
+    an Epoch_T lets readers use a shared structure without locks
+    while a writer changes it. Readers bracket each use with
+    Epoch_enter and Epoch_exit. A writer that unlinks something
+    readers may still be using retires it instead of freeing it, and
+    it is freed only after every reader that could have seen it has
+    exited (a "grace period").
+
+    Readers only touch per-thread counters, so they scale with cores.
+    Writers must be serialized by the client.
+*/
+typedef struct Epoch* Epoch_T;
+
+
+/*
+    Creates and returns a new Epoch_T with no active readers and
+    nothing retired, or NULL if allocation error occurs.
+*/
+Epoch_T Epoch_new(void);
+
+
+/*
+    Frees everything retired through e and then e itself. There must
+    be no active readers.
+*/
+void Epoch_free(Epoch_T e);
+
+
+/*
+    Starts a read-side section on e for the calling thread and returns
+    a ticket to pass to Epoch_exit. Sections may nest but must not
+    call Epoch_synchronize or Epoch_reclaim on e.
+*/
+size_t Epoch_enter(Epoch_T e);
+
+
+/*
+    Ends the read-side section on e that returned ticket.
+*/
+void Epoch_exit(Epoch_T e, size_t ticket);
+
+
+/*
+    Waits until every read-side section on e that was active when the
+    call began has ended.
+*/
+void Epoch_synchronize(Epoch_T e);
+
+
+/*
+    Hands pvItem, which readers may still be using, to e, which calls
+    (*pfFree)(pvItem) once they can no longer be. If there is no
+    memory to record pvItem, waits for a grace period and frees it at
+    once.
+*/
+void Epoch_retire(Epoch_T e, void* pvItem, void (*pfFree)(void*));
+
+
+/*
+    Returns the number of items retired through e and not yet freed.
+*/
+size_t Epoch_getNumRetired(Epoch_T e);
+
+
+/*
+    Waits for a grace period and then frees everything retired
+    through e before the call. Does not wait if nothing is retired.
+*/
+void Epoch_reclaim(Epoch_T e);
+
+#endif
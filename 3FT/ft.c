@@ -10,28 +10,183 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 
+#include "arena.h"
+#include "blob.h"
 #include "dynarray.h"
+#include "epoch.h"
 #include "ft.h"
+#include "names.h"
 #include "nodeDir.h" /* this includes nodeFile.h too */
+#include "path.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "store.h"
 
 
 /**********************************************************************/
 
 
-/* A Directory Tree is an AO with 3 state variables: */
-/* a flag for if it is in an initialized state (TRUE) or not (FALSE) */
-static boolean isInitialized;
+/*
+   The number of retired nodes and arrays a concurrent File Tree lets
+   pile up before its writer waits for readers and frees them.
+*/
+enum { FT_RECLAIM_BATCH = 64 };
+
+
+/*
+   The number of nodes of removed hierarchies a File Tree destroys at
+   the end of each change, so that no change waits for a large
+   hierarchy to be destroyed all at once.
+*/
+enum { FT_RECLAIM_STEP = 256 };
+
+
+/* The kinds of change FT_T_applyBatch logs, so as to undo them. */
+enum { FT_CHANGE_ATTACH_DIR, FT_CHANGE_ATTACH_FILE,
+       FT_CHANGE_DETACH_DIR, FT_CHANGE_DETACH_FILE,
+       FT_CHANGE_DISCARD_DIR, FT_CHANGE_DISCARD_FILE,
+       FT_CHANGE_REPLACE, FT_CHANGE_SPLIT };
+
+
+/* A change made to a File Tree by a batch, as logged to undo it. */
+struct FT_change {
+   /* one of the FT_CHANGE_* kinds */
+   int kind;
+
+   /* the node linked, unlinked, discarded, given new contents or
+      split, and the NodeDir it was linked to or unlinked from (NULL
+      if it became or stopped being the root, or was split) */
+   void* node;
+   NodeDir parent;
+
+   /* for a concurrent File Tree, the array of parent's children the
+      change replaced, kept so it can be published again; NULL
+      otherwise */
+   DynArray_T kept;
+
+   /* the contents, of size length, a replacement replaced, and the
+      reference to the Blob_T holding them, or NULL if they were
+      borrowed */
+   void* contents;
+   size_t length;
+   Blob_T blob;
+};
+
+
+/* The log of the batch of changes being applied to a File Tree. */
+struct FT_batchLog {
+   /* the changes made so far, of which there are numChanges, in an
+      array with room for maxChanges */
+   struct FT_change* changes;
+   size_t numChanges;
+   size_t maxChanges;
+
+   /* the NodeDir whose path is the first lastEnd chars of lastPath,
+      the path of the last change, through which the next change's
+      path is resolved if it starts the same way; NULL if none */
+   NodeDir lastDir;
+   const char* lastPath;
+   size_t lastEnd;
+};
 
-/* (only one of these will ever be non-NULL) */
-/* a pointer to the root NodeDir in the hierarchy */
-static NodeDir rootDir;
-/* a pointer to the root NodeFile in the hierarchy */
-static NodeFile rootFile;
 
-/* a counter for the number of NodeDirs in the hierarchy */
-static size_t countDirs;
+/*
+   Contents on their way into a File Tree, as FT_openPayload settles
+   them.
+*/
+struct FT_payload {
+   /* the contents, of size length, and the Blob_T holding them, or
+      NULL if they are borrowed */
+   void* contents;
+   size_t length;
+   Blob_T blob;
+
+   /* a Blob_T made to hold a copy of borrowed contents, whose
+      reference is released once they are in, or NULL */
+   Blob_T made;
+
+   /* whether blob is to be put in the content store, under hash,
+      once the contents are in */
+   boolean isNew;
+   size_t hash;
+};
+
+
+/* A File Tree is an object with 17 state variables: */
+struct FT {
+   /* a flag for if it is in an initialized state (TRUE) or not
+      (FALSE) */
+   boolean isInitialized;
+
+   /* (only one of these will ever be non-NULL) */
+   /* a pointer to the root NodeDir in the hierarchy */
+   NodeDir rootDir;
+   /* a pointer to the root NodeFile in the hierarchy */
+   NodeFile rootFile;
+
+   /* a counter for the number of NodeDirs in the hierarchy */
+   size_t countDirs;
+
+   /* the arena every node in the hierarchy is allocated from, so
+      that the whole hierarchy can be freed a slab at a time; the
+      nodes' names are taken through its table (see
+      Names_openArena) */
+   Arena_T arena;
+
+   /* TRUE if a file in the hierarchy may hold a Blob_T, whose
+      reference must be released before the arena is freed */
+   boolean hasBlobs;
+
+   /* the store of contents shared by every file with equal ones,
+      or NULL if contents are not deduplicated */
+   Store_T store;
+
+   /* TRUE if each chain of new directories inserted at once is kept
+      in one NodeDir (see NodeDir_getLabel), which is split when a
+      directory inside it is removed or given another child */
+   boolean isCompressed;
+
+   /* the snapshot the hierarchy was loaded from, or NULL; files
+      loaded from it keep their contents in it */
+   Snapshot_T snapshot;
+
+   /* TRUE while the hierarchy exists only in snapshot: lookups are
+      answered from the snapshot, and anything else first builds the
+      hierarchy out of nodes */
+   boolean isFrozen;
+
+   /* for a concurrent File Tree, the readers' epochs, through which
+      unlinked nodes and arrays are retired; NULL otherwise */
+   Epoch_T epoch;
+
+   /* for a concurrent File Tree, the lock serializing writers */
+   pthread_mutex_t writeLock;
+
+   /* the log of the batch FT_T_applyBatch is applying, or NULL;
+      while there is one, changes are logged so they can be undone,
+      and nodes unlinked are only destroyed once the batch is done */
+   struct FT_batchLog* log;
+
+   /* the hierarchies removed from this one and not yet destroyed, in
+      an array from the arena, or NULL until one is removed; they are
+      destroyed a few nodes at a time, the last removed first */
+   DynArray_T pending;
+
+   /* the hierarchy being destroyed, or NULL, and the node where its
+      destruction left off (see NodeDir_destroySome) */
+   NodeDir reclaimRoot;
+   NodeDir reclaimAt;
+
+   /* TRUE if readers may still be using some of the hierarchies in
+      pending, which must then be waited out before destroying them */
+   boolean isPendingShared;
+};
+
+/* the File Tree behind the handle-free FT_* functions */
+static struct FT defaultTree;
 
 
 /**********************************************************************/
@@ -43,13 +198,185 @@ static size_t countDirs;
    Destroys the entire hierarchy of Nodes rooted at NodeDir curr,
    including curr itself.
 */
-static void FT_removePathFromDir(NodeDir curr) {
+static void FT_removePathFromDir(FT_T ft, NodeDir curr) {
    if(curr != NULL) {
-      countDirs -= NodeDir_destroy(curr);
+      ft->countDirs -= NodeDir_destroy(curr);
+   }
+}
+
+
+/* Adapters from the node and array destructors to Epoch_retire's. */
+static void FT_freeDir(void* pvDir) {
+   (void) NodeDir_destroy(pvDir);
+}
+static void FT_freeFile(void* pvFile) {
+   (void) NodeFile_destroy(pvFile);
+}
+static void FT_freeArray(void* pvArray) {
+   DynArray_free(pvArray);
+}
+static void FT_releaseBlob(void* pvBlob) {
+   Blob_release(pvBlob);
+}
+
+
+/*
+   Frees the array of children old, which a Shared link or unlink in
+   ft's hierarchy replaced, once no reader can be using it. Does
+   nothing if old is NULL.
+*/
+static void FT_retireArray(FT_T ft, DynArray_T old) {
+   assert(ft != NULL);
+   assert(ft->epoch != NULL);
+
+   if (old != NULL)
+      Epoch_retire(ft->epoch, old, FT_freeArray);
+}
+
+
+/*
+   Releases a reference to blob that ft's hierarchy held, at once,
+   or if ft is concurrent, once no reader can be about to take a
+   reference of its own through it. Does nothing if blob is NULL.
+*/
+static void FT_dropBlob(FT_T ft, Blob_T blob) {
+   assert(ft != NULL);
+
+   if (blob == NULL)
+      return;
+   if (ft->epoch == NULL)
+      Blob_release(blob);
+   else
+      Epoch_retire(ft->epoch, blob, FT_releaseBlob);
+}
+
+
+/*
+   Logs a change of kind kind to node, below parent, in the batch
+   being applied to ft, keeping kept, as FT_change describes. Room
+   for it must have been made with FT_reserveChanges. Returns TRUE,
+   or FALSE if no batch is being applied, in which case nothing is
+   logged.
+*/
+static boolean FT_logChange(FT_T ft, int kind, void* node,
+NodeDir parent, DynArray_T kept) {
+   struct FT_change* change;
+
+   assert(ft != NULL);
+   assert(node != NULL);
+
+   if (ft->log == NULL)
+      return FALSE;
+
+   assert(ft->log->numChanges < ft->log->maxChanges);
+   change = &ft->log->changes[ft->log->numChanges++];
+   change->kind = kind;
+   change->node = node;
+   change->parent = parent;
+   change->kept = kept;
+   change->contents = NULL;
+   change->length = 0;
+   change->blob = NULL;
+
+   /* the NodeDir the next path would be resolved through may be
+      going away, or no longer have the path it had */
+   if (kind == FT_CHANGE_DISCARD_DIR || kind == FT_CHANGE_SPLIT)
+      ft->log->lastDir = NULL;
+   return TRUE;
+}
+
+
+/*
+   Queues the hierarchy rooted at NodeDir n, which has been unlinked
+   from ft's, to be destroyed bit by bit by FT_reclaimSome, once no
+   reader can be using it. If there is no memory to queue it, it is
+   destroyed as a whole instead: at once, or if ft is concurrent,
+   once no reader can be using it. While a batch is being applied,
+   only logs it instead.
+*/
+static void FT_discardDir(FT_T ft, NodeDir n) {
+   size_t dirs;
+   size_t files;
+   size_t bytes;
+
+   assert(ft != NULL);
+   assert(n != NULL);
+
+   if (FT_logChange(ft, FT_CHANGE_DISCARD_DIR, n, NodeDir_getParent(n),
+                    NULL))
+      return;
+
+   if (ft->pending == NULL)
+      ft->pending = DynArray_newIn(0, ft->arena);
+   if (ft->pending == NULL || !DynArray_add(ft->pending, n)) {
+      if (ft->epoch == NULL) {
+         FT_removePathFromDir(ft, n);
+         return;
+      }
+      NodeDir_getTotals(n, &dirs, &files, &bytes);
+      ft->countDirs -= dirs;
+      Epoch_retire(ft->epoch, n, FT_freeDir);
+      return;
+   }
+
+   NodeDir_getTotals(n, &dirs, &files, &bytes);
+   ft->countDirs -= dirs;
+   if (ft->epoch != NULL)
+      ft->isPendingShared = TRUE;
+}
+
+
+/*
+   Destroys up to budget nodes of the hierarchies removed from ft's
+   and queued by FT_discardDir, the last queued first, first waiting
+   out any readers that may still be using them.
+*/
+static void FT_reclaimSome(FT_T ft, size_t budget) {
+   size_t num;
+
+   assert(ft != NULL);
+
+   while (budget > 0) {
+      if (ft->reclaimRoot == NULL) {
+         if (ft->pending == NULL)
+            return;
+         num = DynArray_getLength(ft->pending);
+         if (num == 0)
+            return;
+         if (ft->isPendingShared) {
+            Epoch_synchronize(ft->epoch);
+            ft->isPendingShared = FALSE;
+         }
+         ft->reclaimRoot = DynArray_removeAt(ft->pending, num - 1);
+         ft->reclaimAt = ft->reclaimRoot;
+      }
+      if (NodeDir_destroySome(ft->reclaimRoot, &ft->reclaimAt,
+                              &budget))
+         ft->reclaimRoot = NULL;
    }
 }
 
 
+/*
+   Destroys NodeFile n, which has been unlinked from ft's hierarchy,
+   at once, or if ft is concurrent, once no reader can be using it.
+   While a batch is being applied, only logs it instead.
+*/
+static void FT_discardFile(FT_T ft, NodeFile n) {
+   assert(ft != NULL);
+   assert(n != NULL);
+
+   if (FT_logChange(ft, FT_CHANGE_DISCARD_FILE, n,
+                    NodeFile_getParent(n), NULL))
+      return;
+
+   if (ft->epoch == NULL)
+      (void) NodeFile_destroy(n);
+   else
+      Epoch_retire(ft->epoch, n, FT_freeFile);
+}
+
+
 /*
    Given a prospective parent NodeDir and child NodeDir,
    adds child to parent's children list, if possible.
@@ -90,832 +417,4329 @@ static int FT_linkParentToChildFile(NodeDir parent, NodeFile child) {
 }
 
 
-/**********************************************************************/
-/* Static functions for traversing path */
-/**********************************************************************/
+/*
+   Links the new hierarchy rooted at child below parent, which is
+   already part of ft's hierarchy, as FT_linkParentToChildDir does. If
+   ft is concurrent, parent's children are replaced rather than
+   changed in place, so readers never see them half updated. The
+   change is logged if a batch is being applied.
+*/
+static int FT_attachDir(FT_T ft, NodeDir parent, NodeDir child) {
+   DynArray_T old;
+   int result;
+
+   assert(ft != NULL);
+   assert(parent != NULL);
+
+   if (ft->epoch == NULL) {
+      result = FT_linkParentToChildDir(parent, child);
+      if (result == SUCCESS)
+         (void) FT_logChange(ft, FT_CHANGE_ATTACH_DIR, child, parent,
+                             NULL);
+      return result;
+   }
+
+   if (NodeDir_linkChildDirShared(parent, child, &old) != SUCCESS) {
+      (void) NodeDir_destroy(child);
+      return PARENT_CHILD_ERROR;
+   }
+   if (!FT_logChange(ft, FT_CHANGE_ATTACH_DIR, child, parent, old))
+      FT_retireArray(ft, old);
+   return SUCCESS;
+}
 
 
 /*
-    Helper recursive function for FT_traversePathDir.
+   Links the new NodeFile child below parent, which is already part
+   of ft's hierarchy, as FT_linkParentToChildFile does, publishing the
+   change as FT_attachDir does if ft is concurrent.
+*/
+static int FT_attachFile(FT_T ft, NodeDir parent, NodeFile child) {
+   DynArray_T old;
+   int result;
+
+   assert(ft != NULL);
+   assert(parent != NULL);
 
-    Starting at the parameter curr, traverses as far down
-    the hierarchy as possible, just considering NodeDir's, while
-    still matching the path parameter.
+   if (ft->epoch == NULL) {
+      result = FT_linkParentToChildFile(parent, child);
+      if (result == SUCCESS)
+         (void) FT_logChange(ft, FT_CHANGE_ATTACH_FILE, child, parent,
+                             NULL);
+      return result;
+   }
+
+   if (NodeDir_linkChildFileShared(parent, child, &old) != SUCCESS) {
+      (void) NodeFile_destroy(child);
+      return PARENT_CHILD_ERROR;
+   }
+   if (!FT_logChange(ft, FT_CHANGE_ATTACH_FILE, child, parent, old))
+      FT_retireArray(ft, old);
+   return SUCCESS;
+}
 
-    Returns a pointer to the farthest matching NodeDir down that path,
-    or NULL if there is no NodeDir in curr's hierarchy that matches
-    a prefix of the path.
 
-    This will not work if the end of the path is a NodeFile. Use
-    FT_traversePathFromFile & FT_traversePathFile instead.
+/*
+   Unlinks NodeDir n from its parent in ft's hierarchy, publishing the
+   change as FT_attachDir does if ft is concurrent. Returns SUCCESS or
+   MEMORY_ERROR.
 */
-static NodeDir FT_traversePathFromDir(char* path, NodeDir curr) {
-   NodeDir found;
-   size_t i;
+static int FT_detachDir(FT_T ft, NodeDir n) {
+   NodeDir parent;
+   DynArray_T old = NULL;
+   int result;
+
+   assert(ft != NULL);
+   assert(n != NULL);
+
+   parent = NodeDir_getParent(n);
+   if (ft->epoch == NULL)
+      result = NodeDir_unlinkChildDir(parent, n);
+   else
+      result = NodeDir_unlinkChildDirShared(parent, n, &old);
+
+   if (result == SUCCESS &&
+       !FT_logChange(ft, FT_CHANGE_DETACH_DIR, n, parent, old) &&
+       old != NULL)
+      FT_retireArray(ft, old);
+   return result;
+}
 
-   assert(path != NULL);
 
-   if (curr == NULL)
-      return NULL;
+/*
+   Unlinks NodeFile n from its parent in ft's hierarchy, publishing
+   the change as FT_attachDir does if ft is concurrent. Returns
+   SUCCESS or MEMORY_ERROR.
+*/
+static int FT_detachFile(FT_T ft, NodeFile n) {
+   NodeDir parent;
+   DynArray_T old = NULL;
+   int result;
+
+   assert(ft != NULL);
+   assert(n != NULL);
+
+   parent = NodeFile_getParent(n);
+   if (ft->epoch == NULL)
+      result = NodeDir_unlinkChildFile(parent, n);
+   else
+      result = NodeDir_unlinkChildFileShared(parent, n, &old);
+
+   if (result == SUCCESS &&
+       !FT_logChange(ft, FT_CHANGE_DETACH_FILE, n, parent, old) &&
+       old != NULL)
+      FT_retireArray(ft, old);
+   return result;
+}
 
-   else if (!strcmp(path, NodeDir_getPath(curr)))
-      return curr;
 
+/*
+   Returns ft's root NodeDir, or NULL. The load is ordered after the
+   root's publication, so a reader sees the root fully built.
+*/
+static NodeDir FT_getRootDir(FT_T ft) {
+   assert(ft != NULL);
+   return __atomic_load_n(&ft->rootDir, __ATOMIC_ACQUIRE);
+}
 
-   else if (!strncmp(path, NodeDir_getPath(curr), 
-   strlen(NodeDir_getPath(curr)))) {
-      for (i = 0; i < NodeDir_getNumChildDirs(curr); i++) {
-         found = FT_traversePathFromDir(path,
-                                NodeDir_getChildDir(curr, i));
-         if(found != NULL)
-            return found;
-      }
-      return curr;
-   }
-   return NULL;
+
+/*
+   Returns ft's root NodeFile, or NULL, ordered as FT_getRootDir is.
+*/
+static NodeFile FT_getRootFile(FT_T ft) {
+   assert(ft != NULL);
+   return __atomic_load_n(&ft->rootFile, __ATOMIC_ACQUIRE);
 }
 
 
 /*
-   Returns the farthest NodeDir reachable from root following a given
-   path, or NULL if there is no Node in the hierarchy that matches a
-   prefix of the path.
+   Makes root ft's root NodeDir, publishing it to readers fully built.
 */
-static NodeDir FT_traversePathDir(char* path) {
-    assert(path != NULL);
+static void FT_setRootDir(FT_T ft, NodeDir root) {
+   assert(ft != NULL);
+   __atomic_store_n(&ft->rootDir, root, __ATOMIC_RELEASE);
+}
 
-    if (rootFile != NULL) return NULL;
 
-    return FT_traversePathFromDir(path, rootDir);
+/*
+   Makes root ft's root NodeFile, published as FT_setRootDir does.
+*/
+static void FT_setRootFile(FT_T ft, NodeFile root) {
+   assert(ft != NULL);
+   __atomic_store_n(&ft->rootFile, root, __ATOMIC_RELEASE);
 }
 
 
 /*
-    Recursive helper function for FT_traversePathFile
+   Starts a read of ft. If ft is concurrent, nodes unlinked from here
+   on stay allocated until the matching FT_endRead; returns the ticket
+   to pass to it.
+*/
+static size_t FT_beginRead(FT_T ft) {
+   assert(ft != NULL);
+
+   if (ft->epoch == NULL)
+      return 0;
+   return Epoch_enter(ft->epoch);
+}
 
-    Starting at the parameter curr, traverses as far down
-    the hierarchy as possible, just considering NodeDir's, while
-    still matching the path parameter.
 
-    Returns a pointer to the farthest matching NodeDir down that path,
-    or NULL if there is no NodeDir in curr's hierarchy that matches
-    a prefix of the path.
+/*
+   Ends the read of ft that FT_beginRead returned ticket for.
 */
-static NodeDir FT_traversePathFromFile(char* path, NodeDir curr) {
-    NodeDir found;
-    size_t i;
+static void FT_endRead(FT_T ft, size_t ticket) {
+   assert(ft != NULL);
 
-    assert(path != NULL);
+   if (ft->epoch != NULL)
+      Epoch_exit(ft->epoch, ticket);
+}
 
-    if (curr == NULL)
-        return NULL;
 
-    if (NodeDir_hasChildFile(curr, path, NULL) == 1) return curr;
-    if (NodeDir_hasChildDir(curr, path, NULL) == 1) return curr;
+/*
+   Starts a change to ft. If ft is concurrent, waits until no other
+   thread is changing it.
+*/
+static void FT_beginWrite(FT_T ft) {
+   assert(ft != NULL);
 
-    if (!strncmp(path, NodeDir_getPath(curr), 
-    strlen(NodeDir_getPath(curr)))) {
-        for (i = 0; i < NodeDir_getNumChildDirs(curr); i++) {
-            found = FT_traversePathFromFile(path, 
-            NodeDir_getChildDir(curr, i));
-            if(found != NULL)
-                return found;
-        }
-        return curr;
-    }
-    return NULL;
+   if (ft->epoch != NULL)
+      (void) pthread_mutex_lock(&ft->writeLock);
 }
 
 
 /*
-    Returns the farthest NodeDir reachable from root following a given
-    path, or NULL if there is no Node in the hierarchy that matches a
-    prefix of the path.
+   Ends a change to ft begun by FT_beginWrite, first destroying some
+   of the nodes of the hierarchies removed from ft. If ft is
+   concurrent and enough has been retired, also waits out the readers
+   that may still be using it and frees it. Returns result.
+*/
+static int FT_endWrite(FT_T ft, int result) {
+   assert(ft != NULL);
+
+   FT_reclaimSome(ft, FT_RECLAIM_STEP);
+   if (ft->epoch == NULL)
+      return result;
+
+   if (Epoch_getNumRetired(ft->epoch) >= FT_RECLAIM_BATCH)
+      Epoch_reclaim(ft->epoch);
+   (void) pthread_mutex_unlock(&ft->writeLock);
+   return result;
+}
+
 
-    To clarify: even if NodeFile is in the hierarchy, this will return
-    its parent NodeFile.
+/*
+   Builds the hierarchy of ft, if it exists only in the snapshot it
+   was loaded from, out of nodes. Returns SUCCESS, MEMORY_ERROR, or
+   FILE_ERROR if the snapshot is damaged; on failure ft is unchanged.
 */
-static NodeDir FT_traversePathFile(char* path) {
-    assert(path != NULL);
+static int FT_thaw(FT_T ft) {
+   NodeDir rootDir;
+   NodeFile rootFile;
+   size_t countDirs;
+   int result;
 
-    if (rootFile != NULL) return NULL;
+   assert(ft != NULL);
+
+   if (!ft->isFrozen)
+      return SUCCESS;
+
+   result = Snapshot_build(ft->snapshot, ft->arena, &rootDir, &rootFile,
+                           &countDirs);
+   if (result != SUCCESS)
+      return result;
 
-    return FT_traversePathFromFile(path, rootDir);
+   ft->countDirs = countDirs;
+   FT_setRootFile(ft, rootFile);
+   FT_setRootDir(ft, rootDir);
+   ft->isFrozen = FALSE;
+   return SUCCESS;
 }
 
 
 /**********************************************************************/
-/* Inserting path */
+/* Static functions for resolving paths */
 /**********************************************************************/
 
 
 /*
-    Helper function for FT_insertDir.
+   The outcome of resolving a path against the hierarchy, one
+   component at a time from the root.
+*/
+struct FT_lookup {
+   /* the deepest NodeDir whose path is a prefix of the query path,
+      or NULL if not even the root matches */
+   NodeDir dir;
 
-    Inserts a new path of NodeDirs into the tree rooted at parent, or,
-    if parent is NULL, as the root of the data structure.
+   /* the NodeFile named by the component right after dir
+      (or the root NodeFile), or NULL if there is none */
+   NodeFile file;
 
-    If a node representing path already exists, returns ALREADY_IN_TREE
+   /* the offset in the query path just past the last component
+      matched, by file if it is non-NULL and by dir otherwise */
+   size_t end;
 
-    If there is an allocation error in creating any of the new nodes or
-    their fields, returns MEMORY_ERROR
+   /* if dir stands for a chain of directories (see
+      NodeDir_getLabel), the number of them above and below the one
+      matched, which is the last unless below is nonzero; both are 0
+      otherwise */
+   size_t above;
+   size_t below;
+};
 
-    If there is an error linking any of the new nodes,
-    returns PARENT_CHILD_ERROR
 
-    Otherwise, returns SUCCESS
+/*
+   Compares name against the len bytes starting at comp, which hold
+   no '\0'. Returns <0, 0, or >0 if name is less than, equal to, or
+   greater than that component, respectively.
 */
-static int FT_insertRestOfPathDir(char* path, NodeDir parent) {
-    NodeDir curr = parent;
-    NodeDir firstNew = NULL;
-    NodeDir new;
-    char* copyPath;
-    char* restPath = path;
-    char* dirToken;
-    char* fileCheck;
-    char* fileCheckChange;
-    int result;
-    size_t newCount = 0;
+static int FT_compareName(const char* name, const char* comp,
+size_t len) {
+   assert(name != NULL);
+   assert(comp != NULL);
 
-    assert(path != NULL);
+   return Path_compare(name, strlen(name), comp, len);
+}
 
-    if (curr == NULL) {
-        /* if root exists but we have a NULL */
-        if (rootDir != NULL || rootFile != NULL) {
-            return CONFLICTING_PATH;
-        }
-    }
-    else { /* if inserting path from already existing curr */
 
-        if(!strcmp(path, NodeDir_getPath(curr)))
-            return ALREADY_IN_TREE;
+/*
+   Matches the directories of the chain NodeDir n stands for, if it
+   does (see NodeDir_getLabel), after the first, whose name ends at
+   offset end in path, against the components of path that follow,
+   as far as they go, and sets pLookup's above and below for the last
+   one matched. Returns the offset in path just past it. If that is
+   past end and more of path follows, restarts *pTokens there.
+*/
+static size_t FT_matchChain(NodeDir n, const char* path, size_t end,
+struct Path_tokens* pTokens, struct FT_lookup* pLookup) {
+   /* the label is a prefix of an interned string, whose '\0' ends
+      the tokens after a '/' that may follow the label */
+   struct Path_tokens labelTokens;
+   struct Path_tokens pathTokens;
+   boolean isMatching;
+   const char* label;
+   size_t labelLen;
+   size_t start;
+   size_t len;
+   size_t pathStart;
+   size_t pathLen;
+
+   assert(n != NULL);
+   assert(path != NULL);
+   assert(pTokens != NULL);
+   assert(pLookup != NULL);
+
+   pLookup->above = 0;
+   pLookup->below = 0;
+   label = NodeDir_getLabel(n, &labelLen);
+   if (label == NodeDir_getName(n))
+      return end;
+   start = Names_getLength(NodeDir_getName(n));
+   if (start == labelLen)
+      return end;
+
+   /* each directory of the chain is matched against the component
+      of path in the same place, until one differs */
+   Path_startTokensAt(&labelTokens, label, start + 1);
+   isMatching = path[end] == '/';
+   if (isMatching)
+      Path_startTokensAt(&pathTokens, path, end + 1);
+   while (Path_nextToken(&labelTokens, &start, &len) &&
+          start < labelLen) {
+      if (isMatching &&
+          Path_nextToken(&pathTokens, &pathStart, &pathLen) &&
+          Path_compare(label + start, len, path + pathStart,
+                       pathLen) == 0) {
+         pLookup->above++;
+         end = pathStart + pathLen;
+      }
+      else {
+         isMatching = FALSE;
+         pLookup->below++;
+      }
+   }
 
-        /* checking if this final dir has a child nodeFile that overlaps
-        w/ a prefix of the path of nodeDir we're trying to insert. */
-        fileCheck = malloc(strlen(path)+1);
-        if (fileCheck == NULL) return MEMORY_ERROR;
-        fileCheck = strcpy(fileCheck, path);
-        if (fileCheck == NULL) return MEMORY_ERROR;
-        
+   if (pLookup->above > 0 && path[end] == '/')
+      Path_startTokensAt(pTokens, path, end + 1);
+   return end;
+}
 
-        if (NodeDir_hasChildFile(curr, path, NULL) == 1) {
-            free(fileCheck);
-            return ALREADY_IN_TREE;
-        }
 
-        /* use fileCheckChange to turn fileCheck into path of what
-        this childFile would be */
-        fileCheckChange = fileCheck;
-        fileCheckChange += strlen(NodeDir_getPath(curr)) + 1;
-        fileCheckChange = strstr(fileCheckChange, "/");
+/*
+   Finishes resolving path into *pLookup from NodeDir curr, whose path
+   is the first end chars of path, and below which *pTokens passes
+   back the rest of path's components.
+*/
+static void FT_descendPath(NodeDir curr, const char* path, size_t end,
+struct Path_tokens* pTokens, struct FT_lookup* pLookup) {
+   NodeDir next;
+   NodeFile file;
+   size_t start;
+   size_t len;
+
+   assert(curr != NULL);
+   assert(path != NULL);
+   assert(pTokens != NULL);
+   assert(pLookup != NULL);
+
+   for (;;) {
+      pLookup->dir = curr;
+      pLookup->end = end;
+      if (!Path_nextToken(pTokens, &start, &len))
+         return;
+
+      next = NodeDir_lookupChildDir(curr, path + start, len);
+      if (next == NULL) {
+         file = NodeDir_lookupChildFile(curr, path + start, len);
+         if (file != NULL) {
+            pLookup->file = file;
+            pLookup->end = start + len;
+         }
+         return;
+      }
+      curr = next;
+      end = FT_matchChain(curr, path, start + len, pTokens, pLookup);
+
+      /* nothing is below a directory inside a chain but the next,
+         and a chain matched to the end of path leaves *pTokens
+         behind */
+      if (pLookup->below > 0 || path[end] == '\0') {
+         pLookup->dir = curr;
+         pLookup->end = end;
+         return;
+      }
+   }
+}
 
-        if (fileCheckChange != NULL) *fileCheckChange = '\0';
 
-        if (NodeDir_hasChildFile(curr, fileCheck, NULL) == 1) {
-            free(fileCheck);
-            return PARENT_CHILD_ERROR;
-        }
-        free(fileCheck);
-        
-         
-        
-        restPath += (strlen(NodeDir_getPath(curr)) + 1);
-    }
-    /* check for empty string at end of path */
-    if (*(restPath+strlen(restPath)-1) == '/') {
-        return PARENT_CHILD_ERROR;
-    }
+/*
+   Resolves path against the hierarchy, filling in *pLookup.
+
+   The path is split into components by Path_tokens, which finds
+   its '/'s a chunk at a time in one pass, and each component is
+   matched against the children of the NodeDir reached so far, so a
+   lookup costs one binary search per level of path rather than a
+   walk over the hierarchy. Child NodeDirs are tried before child
+   NodeFiles; descent stops at the first component that names a
+   NodeFile or names nothing.
+*/
+static void FT_resolvePath(FT_T ft, const char* path,
+struct FT_lookup* pLookup) {
+   struct Path_tokens tokens;
+   NodeDir curr;
+   NodeFile file;
+   size_t start;
+   size_t len;
+   size_t end;
 
-    copyPath = malloc(strlen(restPath)+1);
-    if(copyPath == NULL)
-        return MEMORY_ERROR;
-    strcpy(copyPath, restPath);
-    dirToken = strtok(copyPath, "/");
-
-    while(dirToken != NULL) {
-        /* check for empty string in path */
-        if (*(dirToken-1) == '/') {
-            free(copyPath);
-            return PARENT_CHILD_ERROR;
-        }
-        new = NodeDir_create(dirToken, curr);
-        newCount++;
-
-        if(firstNew == NULL)
-            firstNew = new;
-        else {
-            result = FT_linkParentToChildDir(curr, new); 
-            /* hopefully success */
-            if(result != SUCCESS) {
-                (void) NodeDir_destroy(new);
-                (void) NodeDir_destroy(firstNew);
-                free(copyPath);
-                return result;
-            }
-        }
+   assert(path != NULL);
+   assert(pLookup != NULL);
+
+   pLookup->dir = NULL;
+   pLookup->file = NULL;
+   pLookup->end = 0;
+   pLookup->above = 0;
+   pLookup->below = 0;
+
+   Path_startTokens(&tokens, path);
+   (void) Path_nextToken(&tokens, &start, &len);
+
+   /* edge case - root is file */
+   file = FT_getRootFile(ft);
+   if (file != NULL) {
+      if (!FT_compareName(NodeFile_getName(file), path + start, len)) {
+         pLookup->file = file;
+         pLookup->end = start + len;
+      }
+      return;
+   }
 
-        if(new == NULL) {
-            (void) NodeDir_destroy(firstNew);
-            free(copyPath);
-            return MEMORY_ERROR;
-        }
+   curr = FT_getRootDir(ft);
+   if (curr == NULL ||
+       FT_compareName(NodeDir_getName(curr), path + start, len))
+      return;
 
-        curr = new;
-        dirToken = strtok(NULL, "/");
-    }
+   end = FT_matchChain(curr, path, start + len, &tokens, pLookup);
+   if (pLookup->below > 0 || path[end] == '\0') {
+      pLookup->dir = curr;
+      pLookup->end = end;
+      return;
+   }
+   FT_descendPath(curr, path, end, &tokens, pLookup);
+}
 
 
-   free(copyPath);
+/*
+   Resolves path against ft's hierarchy for a change to it, as
+   FT_resolvePath does. While a batch is being applied, a path that
+   goes through the NodeDir the last one reached is resolved from
+   there rather than from the root, and the NodeDir this one reaches
+   is noted for the next.
+*/
+static void FT_resolveForChange(FT_T ft, const char* path,
+struct FT_lookup* pLookup) {
+   struct FT_batchLog* log;
+   struct Path_tokens tokens;
+   size_t end;
 
-   if(parent == NULL) {
-      rootDir = firstNew;
-      countDirs = newCount;
-      return SUCCESS;
+   assert(ft != NULL);
+   assert(path != NULL);
+   assert(pLookup != NULL);
+
+   log = ft->log;
+   if (log == NULL) {
+      FT_resolvePath(ft, path, pLookup);
+      return;
    }
-   else {
-      result = FT_linkParentToChildDir(parent, firstNew);
-      if(result == SUCCESS)
-         countDirs += newCount;
-      else
-         (void) NodeDir_destroy(firstNew);
 
-      return result;
+   if (log->lastDir != NULL &&
+       strncmp(path, log->lastPath, log->lastEnd) == 0 &&
+       path[log->lastEnd] == '/') {
+      pLookup->file = NULL;
+      pLookup->above = 0;
+      pLookup->below = 0;
+      Path_startTokensAt(&tokens, path, log->lastEnd + 1);
+      FT_descendPath(log->lastDir, path, log->lastEnd, &tokens,
+                     pLookup);
    }
+   else
+      FT_resolvePath(ft, path, pLookup);
+
+   /* a directory inside a chain has no path of its own NodeDir */
+   log->lastDir = pLookup->below == 0 ? pLookup->dir : NULL;
+   log->lastPath = path;
+   end = pLookup->end;
+   if (pLookup->file != NULL && pLookup->dir != NULL)
+      end -= strlen(NodeFile_getName(pLookup->file)) + 1;
+   log->lastEnd = end;
 }
 
 
-/* see ft.h for specification */
-int FT_insertDir(char *path) {
-    NodeDir curr;
-    int result;
-
-    assert(path != NULL);
+/*
+   Returns TRUE if pLookup, resolved from path, found a NodeDir at
+   exactly path, and FALSE otherwise.
+*/
+static boolean FT_isDirAt(const char* path, struct FT_lookup* pLookup) {
+   assert(path != NULL);
+   assert(pLookup != NULL);
 
-    if(!isInitialized)
-        return INITIALIZATION_ERROR;
-    curr = FT_traversePathDir(path);
-    result = FT_insertRestOfPathDir(path, curr);
-    return result;
+   return pLookup->dir != NULL && pLookup->file == NULL &&
+      path[pLookup->end] == '\0';
 }
 
 
 /*
-    Helper function for FT_insertPath.
-
-    Inserts a new path of NodeDirs with a final NodeFile into the 
-    tree rooted at parent, or, if parent is NULL, a NodeFile as the root
+   Returns TRUE if pLookup, resolved from path, found a NodeFile at
+   exactly path, and FALSE otherwise.
+*/
+static boolean FT_isFileAt(const char* path, struct FT_lookup* pLookup){
+   assert(path != NULL);
+   assert(pLookup != NULL);
 
-    Adds contents and length to final NodeFile.
+   return pLookup->file != NULL && path[pLookup->end] == '\0';
+}
 
-    If a node representing path already exists, returns ALREADY_IN_TREE
 
-    If there is an allocation error in creating any of the new nodes or
-    their fields, returns MEMORY_ERROR
+/**********************************************************************/
+/* Inserting path */
+/**********************************************************************/
 
-    If there is an error linking any of the new nodes,
-    returns PARENT_CHILD_ERROR
 
-    Otherwise, returns SUCCESS
+/*
+   Returns TRUE if rest is a non-empty sequence of non-empty
+   components separated by single slashes, and FALSE otherwise.
 */
-static int FT_insertRestOfPathFile(char* path, NodeDir parent, 
-void* contents, size_t length) {
-    NodeDir curr = parent;
-    NodeDir firstNew = NULL;
-    NodeDir new;
-    NodeFile finalFile;
-    char* copyPath;
-    char* restPath = path;
-    char* dirToken;
-    char* findFile;
-    char* fileCheck;
-    char* fileCheckChange;
-    int result;
-    size_t newCount = 0;
+static boolean FT_isValidRest(const char* rest) {
+   struct Path_tokens tokens;
+   size_t start;
+   size_t len;
 
-    assert(path != NULL);
-
-    if (curr == NULL) {
-        if (rootDir != NULL || rootFile != NULL)
-            return CONFLICTING_PATH;
-    }
-    else {
-        if (NodeDir_hasChildFile(curr, path, NULL) == 1 || 
-        NodeDir_hasChildDir(curr, path, NULL) == 1)
-            return ALREADY_IN_TREE;
-
-        /* checking if this final dir has a child nodeFile that overlaps
-        w/ a prefix of the path of nodeDir we're trying to insert. */
-        fileCheck = malloc(strlen(path)+1);
-        if (fileCheck == NULL) return MEMORY_ERROR;
-        fileCheck = strcpy(fileCheck, path);
-        if (fileCheck == NULL) return MEMORY_ERROR;
-
-        fileCheckChange = fileCheck;
-        fileCheckChange += strlen(NodeDir_getPath(curr)) + 1;
-        fileCheckChange = strstr(fileCheckChange, "/");
-
-        if (fileCheckChange != NULL) {
-            *fileCheckChange = '\0';
-
-            if (NodeDir_hasChildFile(curr, fileCheck, NULL) == 1) {
-                free(fileCheck);
-                return NOT_A_DIRECTORY;
-            }
-                
-        }
-        free(fileCheck);
+   assert(rest != NULL);
 
-        restPath += (strlen(NodeDir_getPath(curr)) + 1);
-    }
-    /* check for empty string at end of path */
-    if (*(restPath+strlen(restPath)-1) == '/') {
-        return PARENT_CHILD_ERROR;
-    }
+   Path_startTokens(&tokens, rest);
+   while (Path_nextToken(&tokens, &start, &len))
+      if (len == 0)
+         return FALSE;
 
-    copyPath = malloc(strlen(restPath)+1);
-    if(copyPath == NULL)
-        return MEMORY_ERROR;
-    strcpy(copyPath, restPath);
-    dirToken = strtok(copyPath, "/");
-
-    /* special case - checking if this is where we should put in file */
-    findFile = strstr(restPath, "/");
-    if (findFile == NULL) {
-        /* if file should be root */
-        if (parent == NULL) {
-            finalFile = NodeFile_create(path, NULL, contents, length);
-
-            if (finalFile == NULL) {
-                (void) NodeFile_destroy(finalFile);
-                free(copyPath);
-                return MEMORY_ERROR;
-            }
+   return TRUE;
+}
 
-            rootFile = finalFile;
-            free(copyPath);
-            return SUCCESS;
-        } 
-        /* adding file to end of hiararchy */
-        finalFile = NodeFile_create(restPath, parent, contents, length);
-        if (finalFile == NULL) {
-            (void) NodeFile_destroy(finalFile);
-            free(copyPath);
-            return MEMORY_ERROR;
-        }
-        result = FT_linkParentToChildFile(parent, finalFile);
-        if (result != SUCCESS) (void) NodeFile_destroy(finalFile);
 
-        free(copyPath);
-        return result;
-    }
+/*
+   Cleans up after a failed FT_insertRest: destroys the new NodeDirs
+   from last up to firstNew (if there are any), which are not linked
+   to one another, each with what is linked below it. Returns result.
+*/
+static int FT_abandonInsert(NodeDir firstNew, NodeDir last,
+int result) {
+   NodeDir above;
 
-    while(dirToken != NULL) {
-        /* check for empty string in path */
-        if (*(dirToken-1) == '/') {
-            free(copyPath);
-            return PARENT_CHILD_ERROR;
-        }
-        /* checking if we have the final file */
-        if (findFile == NULL) {
-            finalFile = NodeFile_create(dirToken, curr, contents, 
-            length);
-            if (finalFile == NULL) {
-                (void) NodeDir_destroy(firstNew);
-                free(copyPath);
-                return MEMORY_ERROR;
-            }
+   if (firstNew == NULL)
+      return result;
 
-            result = FT_linkParentToChildFile(curr, finalFile);
-            if(result != SUCCESS) {
-                (void) NodeFile_destroy(finalFile);
-                (void) NodeDir_destroy(firstNew);
-                free(copyPath);
-                return result;
-            }
-            break;
-        }
+   for (;;) {
+      above = last == firstNew ? NULL : NodeDir_getParent(last);
+      (void) NodeDir_destroy(last);
+      if (above == NULL)
+         return result;
+      last = above;
+   }
+}
 
-        /* if node isn't final file but just lame NodeDir */
-        new = NodeDir_create(dirToken, curr);
-        newCount++;
-
-        if (firstNew == NULL) 
-        firstNew = new;
-        else {
-            result = FT_linkParentToChildDir(curr, new);
-            if(result != SUCCESS) {
-                (void) NodeDir_destroy(new);
-                (void) NodeDir_destroy(firstNew);
-                free(copyPath);
-                return result;
-            }
-        }
 
-        if(new == NULL) {
-            (void) NodeDir_destroy(firstNew);
-            free(copyPath);
-            return MEMORY_ERROR;
-        }
+/*
+   Creates a NodeDir below *pCurr standing for the directories named
+   by the components of the length chars starting at label (see
+   NodeDir_createChainIn), which is an ordinary NodeDir if there is
+   one, and makes it the new *pCurr. The first NodeDir created starts
+   the detached chain *pFirstNew; later ones are only linked to their
+   predecessor by FT_linkNew, once all of them are made.
+   Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_appendDir(FT_T ft, const char* label, size_t length,
+NodeDir* pCurr, NodeDir* pFirstNew) {
+   NodeDir new;
 
-        curr = new;
-        dirToken = strtok(NULL, "/");
+   assert(label != NULL);
+   assert(pCurr != NULL);
+   assert(pFirstNew != NULL);
 
-        findFile++;
-        findFile = strstr(findFile, "/");
-    }
+   new = NodeDir_createChainIn(label, length, *pCurr, ft->arena);
+   if (new == NULL)
+      return MEMORY_ERROR;
 
-   free(copyPath);
+   if (*pFirstNew == NULL)
+      *pFirstNew = new;
+   *pCurr = new;
+   return SUCCESS;
+}
 
-   if(parent == NULL) {
-      rootDir = firstNew;
-      countDirs = newCount;
-      return SUCCESS;
-   }
-   else {
-      result = FT_linkParentToChildDir(parent, firstNew);
-      if(result == SUCCESS)
-         countDirs += newCount;
-      else
-         (void) NodeDir_destroy(firstNew);
 
-      return result;
+/*
+   Links each new NodeDir from last up to, but not including,
+   firstNew to its parent, deepest first, so that each is counted in
+   the totals of only the one above it, which is not linked yet, and
+   the whole chain is counted in those of the tree once, by
+   FT_attachDir. Returns SUCCESS, or PARENT_CHILD_ERROR after
+   destroying the new NodeDirs.
+*/
+static int FT_linkNew(NodeDir firstNew, NodeDir last) {
+   NodeDir parent;
+
+   assert(firstNew != NULL);
+   assert(last != NULL);
+
+   while (last != firstNew) {
+      parent = NodeDir_getParent(last);
+      /* a failed link destroys last with what is below it */
+      if (FT_linkParentToChildDir(parent, last) != SUCCESS)
+         return FT_abandonInsert(firstNew, parent,
+                                 PARENT_CHILD_ERROR);
+      last = parent;
    }
+   return SUCCESS;
 }
 
 
-/*  See ft.h for specification. */
-int FT_insertFile(char *path, void *contents, size_t length) {
-    NodeDir curr;
-    int result;
+/*
+   Helper function for FT_insertDir and FT_insertFile.
 
-    assert(path != NULL);
+   Inserts the components of rest into the tree below parent, or,
+   if parent is NULL, as the root of the data structure. Each
+   component becomes a new NodeDir, except that if isFile is TRUE
+   the last one becomes a NodeFile with contents and length, held in
+   blob unless it is NULL. If ft is compressed, the new directories
+   are one NodeDir standing for their chain instead.
 
-    if(!isInitialized)
-        return INITIALIZATION_ERROR;
-    curr = FT_traversePathFile(path);
-    result = FT_insertRestOfPathFile(path, curr, contents, length);
-    return result;
-}
+   rest must satisfy FT_isValidRest, and its first component must not
+   already be a child of parent. The new nodes are built detached,
+   linked to one another from the deepest up (see FT_linkNew), and
+   linked to parent last, so on failure the tree is unchanged and
+   each node's totals are updated once.
 
+   If there is an allocation error in creating any of the new nodes or
+   their fields, returns MEMORY_ERROR
 
-/**********************************************************************/
-/* Simple API functions */
-/**********************************************************************/
+   If there is an error linking any of the new nodes,
+   returns PARENT_CHILD_ERROR
 
+   Otherwise, returns SUCCESS
+*/
+static int FT_insertRest(FT_T ft, const char* rest, NodeDir parent,
+boolean isFile, void* contents, size_t length, Blob_T blob) {
+   NodeDir curr = parent;
+   NodeDir firstNew = NULL;
+   NodeFile newFile;
+   struct Path_tokens tokens;
+   size_t start;
+   size_t len;
+   size_t newCount = 0;
+   int result;
+
+   assert(rest != NULL);
+
+   /* rest is split, and every component but a file's name is a
+      NodeDir, made as it is passed unless they are to be one */
+   Path_startTokens(&tokens, rest);
+   (void) Path_nextToken(&tokens, &start, &len);
+   while (!isFile || !Path_isLastToken(&tokens)) {
+      if (!ft->isCompressed) {
+         result = FT_appendDir(ft, rest + start, len, &curr,
+                               &firstNew);
+         if (result != SUCCESS)
+            return FT_abandonInsert(firstNew, curr, result);
+      }
+      newCount++;
+      if (Path_isLastToken(&tokens))
+         break;
+      (void) Path_nextToken(&tokens, &start, &len);
+   }
 
-/*  See ft.h for specification. */
-boolean FT_containsDir(char *path) {
-    NodeDir curr;
+   if (ft->isCompressed && newCount > 0) {
+      result = FT_appendDir(ft, rest, isFile ? start - 1 : start + len,
+                            &curr, &firstNew);
+      if (result != SUCCESS)
+         return FT_abandonInsert(firstNew, curr, result);
+   }
 
-    assert(path != NULL);
+   if (isFile) {
+      /* the name is the last component, so it ends where rest does */
+      newFile = NodeFile_createIn(rest + start, curr, contents, length,
+                                  blob, ft->arena);
+      if (newFile == NULL)
+         return FT_abandonInsert(firstNew, curr, MEMORY_ERROR);
+
+      /* if file should be root */
+      if (curr == NULL) {
+         FT_setRootFile(ft, newFile);
+         (void) FT_logChange(ft, FT_CHANGE_ATTACH_FILE, newFile, NULL,
+                             NULL);
+         return SUCCESS;
+      }
 
-    if(!isInitialized)
-        return FALSE;
+      /* if file goes directly below the existing parent */
+      if (firstNew == NULL)
+         return FT_attachFile(ft, parent, newFile);
 
-    curr = FT_traversePathDir(path);
+      result = FT_linkParentToChildFile(curr, newFile);
+      if (result != SUCCESS)
+         return FT_abandonInsert(firstNew, curr, result);
+   }
 
-    if (curr == NULL)
-        return FALSE;
-    else if(strcmp(path, NodeDir_getPath(curr)))
-        return FALSE;
-    else
-        return TRUE;
+   result = FT_linkNew(firstNew, curr);
+   if (result != SUCCESS)
+      return result;
+
+   if (parent == NULL) {
+      ft->countDirs = newCount;
+      FT_setRootDir(ft, firstNew);
+      (void) FT_logChange(ft, FT_CHANGE_ATTACH_DIR, firstNew, NULL,
+                          NULL);
+      return SUCCESS;
+   }
+
+   result = FT_attachDir(ft, parent, firstNew);
+   if (result == SUCCESS)
+      ft->countDirs += newCount;
+   return result;
 }
 
 
-/*  See ft.h for specification. */
-boolean FT_containsFile(char *path) {
-    NodeDir curr;
+/*
+   Splits the chain of directories pLookup's dir stands for (see
+   NodeDir_getLabel), if the one pLookup matched is inside it, after
+   that one, so that dir's path is the one matched. The split is
+   logged if a batch is being applied. Returns SUCCESS or
+   MEMORY_ERROR.
+*/
+static int FT_splitBelow(FT_T ft, struct FT_lookup* pLookup) {
+   assert(ft != NULL);
+   assert(pLookup != NULL);
 
-    assert(path != NULL);
+   if (pLookup->below == 0)
+      return SUCCESS;
+   if (NodeDir_splitChain(pLookup->dir, pLookup->above + 1) == NULL)
+      return MEMORY_ERROR;
+   (void) FT_logChange(ft, FT_CHANGE_SPLIT, pLookup->dir, NULL, NULL);
+   pLookup->below = 0;
+   return SUCCESS;
+}
 
-    if(!isInitialized)
-        return FALSE;
 
-    /* edge case - if root is a file */
-    if (rootFile != NULL) {
-        if (!strcmp(NodeFile_getPath(rootFile), path))
-            return TRUE;
-        else 
-            return FALSE;
-    }
+/*
+   Splits the chain of directories pLookup's dir stands for, if the
+   one pLookup matched is inside it but not its first, before that
+   one, and makes the NodeDir standing for the rest of the chain
+   pLookup's dir, so that its first directory is the one matched.
+   Logged and returning as FT_splitBelow.
+*/
+static int FT_splitAbove(FT_T ft, struct FT_lookup* pLookup) {
+   NodeDir rest;
 
-    curr = FT_traversePathFile(path);
+   assert(ft != NULL);
+   assert(pLookup != NULL);
 
-    if (curr == NULL)
-        return FALSE;
-    else if (NodeDir_hasChildFile(curr, path, NULL) == 1)
-        return TRUE;
-    else
-        return FALSE;
+   if (pLookup->above == 0)
+      return SUCCESS;
+   rest = NodeDir_splitChain(pLookup->dir, pLookup->above);
+   if (rest == NULL)
+      return MEMORY_ERROR;
+   (void) FT_logChange(ft, FT_CHANGE_SPLIT, pLookup->dir, NULL, NULL);
+   pLookup->dir = rest;
+   pLookup->above = 0;
+   return SUCCESS;
 }
 
 
-/* see ft.h for specification */
-int FT_rmDir(char *path) {
-    NodeDir curr;
+/*
+   Returns the part of path that remains to be inserted after the
+   lookup pLookup, whose dir (if any) is a strict prefix of path.
+*/
+static const char* FT_restOfPath(const char* path,
+struct FT_lookup* pLookup) {
+   assert(path != NULL);
+   assert(pLookup != NULL);
 
-    assert(path != NULL);
-    if (!isInitialized) return INITIALIZATION_ERROR;
+   if (pLookup->dir == NULL)
+      return path;
+   return path + pLookup->end + 1;
+}
 
-    curr = FT_traversePathDir(path);
 
-    if (curr == NULL) 
-        return NO_SUCH_PATH;
-    else if (NodeDir_hasChildFile(curr, path, NULL) == 1)
-        return NOT_A_DIRECTORY;
-    else if (strcmp(NodeDir_getPath(curr), path))
-        return NO_SUCH_PATH;
-    else {
-        if (NodeDir_getParent(curr) == NULL) {
-            FT_removePathFromDir(curr);
-            rootDir = NULL;
-            return SUCCESS;
-        }
-        NodeDir_unlinkChildDir(NodeDir_getParent(curr), curr);
-        FT_removePathFromDir(curr);
-        return SUCCESS;        
-    } 
-    
-}
+/*
+   Settles *pPayload for the contents, of size length, held in blob
+   unless it is NULL, that are to go into ft. If ft keeps a content
+   store, they are replaced by the equal contents in it, or, if
+   there are none, put in a Blob_T (copying them if they are
+   borrowed) that goes into the store once they are in. Returns
+   SUCCESS or MEMORY_ERROR.
+*/
+static int FT_openPayload(FT_T ft, struct FT_payload* pPayload,
+void* contents, size_t length, Blob_T blob) {
+    Blob_T stored;
 
+    assert(ft != NULL);
+    assert(pPayload != NULL);
 
-/* see ft.h for specification */
-int FT_rmFile(char *path) {
-    NodeDir curr;
-    NodeFile child;
-    size_t childIndex;
+    pPayload->contents = contents;
+    pPayload->length = length;
+    pPayload->blob = blob;
+    pPayload->made = NULL;
+    pPayload->isNew = FALSE;
 
-    assert(path != NULL);
-    if (!isInitialized) return INITIALIZATION_ERROR;
+    if (ft->store == NULL)
+        return SUCCESS;
 
-    /* edge case - root is file */
-    if (rootFile != NULL) {
-        if (!strcmp(NodeFile_getPath(rootFile), path)) {
-            (void) NodeFile_destroy(rootFile);
-            rootFile = NULL;
-            return SUCCESS;
+    stored = Store_lookup(ft->store, contents, length,
+                          &pPayload->hash);
+    if (stored == NULL) {
+        if (blob == NULL) {
+            stored = Blob_new(contents, length);
+            if (stored == NULL)
+                return MEMORY_ERROR;
+            pPayload->made = stored;
         }
-        return NO_SUCH_PATH;
+        else
+            stored = blob;
+        pPayload->isNew = TRUE;
     }
 
-    curr = FT_traversePathFile(path);
+    pPayload->contents = Blob_getBytes(stored);
+    pPayload->blob = stored;
+    return SUCCESS;
+}
 
-    if (curr == NULL)
-        return NO_SUCH_PATH;
-        
-    else if (NodeDir_hasChildFile(curr, path, &childIndex) == 1) {
-        child = NodeDir_getChildFile(curr, childIndex);
-        NodeDir_unlinkChildFile(curr, child);
-        (void) NodeFile_destroy(child);
-        return SUCCESS;
-    }
-    else if (NodeDir_hasChildDir(curr, path, NULL))
-        return NOT_A_FILE;
-    else
-        return NO_SUCH_PATH;    
+
+/*
+   Finishes *pPayload once the change bringing it into ft is over,
+   with status result: if the contents are in, and are new to ft's
+   content store, they are put in it.
+*/
+static void FT_closePayload(FT_T ft, struct FT_payload* pPayload,
+int result) {
+    assert(ft != NULL);
+    assert(pPayload != NULL);
+
+    /* if there is no memory for them in the store, they are only
+       not shared */
+    if (result == SUCCESS && pPayload->isNew)
+        (void) Store_insert(ft->store, pPayload->blob, pPayload->hash);
+    Blob_release(pPayload->made);
 }
 
 
-/* see ft.h for specification */
-void *FT_getFileContents(char *path) {
-    NodeDir curr;
-    size_t childIndex;
+/*
+   Does the work of FT_T_insertDir, which ft's writers are serialized
+   around.
+*/
+static int FT_insertDirLocked(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    const char* rest;
+    int result;
 
+    assert(ft != NULL);
     assert(path != NULL);
 
-    /* edge case - root is file */
-    if (rootFile != NULL) {
-        if (!strcmp(NodeFile_getPath(rootFile), path)) {
-            return NodeFile_getContents(rootFile);
-        }
-        return NULL;
-    }
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
 
+    FT_resolveForChange(ft, path, &lookup);
+
+    if (FT_isDirAt(path, &lookup) || FT_isFileAt(path, &lookup))
+        return ALREADY_IN_TREE;
+    if (ft->rootFile != NULL)
+        return CONFLICTING_PATH;
+    /* a prefix of path is a file */
+    if (lookup.file != NULL)
+        return PARENT_CHILD_ERROR;
+    if (lookup.dir == NULL && ft->rootDir != NULL)
+        return CONFLICTING_PATH;
 
-    curr = FT_traversePathFile(path);
+    rest = FT_restOfPath(path, &lookup);
+    if (!FT_isValidRest(rest))
+        return PARENT_CHILD_ERROR;
 
-    if (NodeDir_hasChildFile(curr, path, &childIndex) == 1)
-        return NodeFile_getContents(NodeDir_getChildFile(curr, 
-        childIndex));
-    
-    return NULL;
+    result = FT_splitBelow(ft, &lookup);
+    if (result != SUCCESS)
+        return result;
+    return FT_insertRest(ft, rest, lookup.dir, FALSE, NULL, 0, NULL);
 }
 
 
-/* see ft.h for specification */
-void *FT_replaceFileContents(char *path, void *newContents,
-                             size_t newLength) {
-    NodeDir curr;
-    size_t childIndex;
+/*
+   Does the work of FT_T_insertFile, which ft's writers are serialized
+   around, the contents being held in blob unless it is NULL.
+*/
+static int FT_insertFileLocked(FT_T ft, char *path, void *contents,
+size_t length, Blob_T blob) {
+    struct FT_lookup lookup;
+    struct FT_payload payload;
+    const char* rest;
+    int result;
 
+    assert(ft != NULL);
     assert(path != NULL);
 
-    /* edge case - root is file */
-    if (rootFile != NULL) {
-        if (!strcmp(NodeFile_getPath(rootFile), path)) {
-            return NodeFile_replaceContents(rootFile, 
-            newContents, newLength);
-        }
-        return NULL;
-    }
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    FT_resolveForChange(ft, path, &lookup);
 
-    curr = FT_traversePathFile(path);
+    if (FT_isDirAt(path, &lookup) || FT_isFileAt(path, &lookup))
+        return ALREADY_IN_TREE;
+    if (ft->rootFile != NULL)
+        return CONFLICTING_PATH;
+    /* a prefix of path is a file */
+    if (lookup.file != NULL)
+        return NOT_A_DIRECTORY;
+    if (lookup.dir == NULL && ft->rootDir != NULL)
+        return CONFLICTING_PATH;
+
+    rest = FT_restOfPath(path, &lookup);
+    if (!FT_isValidRest(rest))
+        return PARENT_CHILD_ERROR;
 
-    if (NodeDir_hasChildFile(curr, path, &childIndex) == 1)
-        return NodeFile_replaceContents(NodeDir_getChildFile(curr, 
-        childIndex), newContents, newLength);
-    
-    return NULL;
+    result = FT_splitBelow(ft, &lookup);
+    if (result != SUCCESS)
+        return result;
+    result = FT_openPayload(ft, &payload, contents, length, blob);
+    if (result != SUCCESS)
+        return result;
+    if (payload.blob != NULL)
+        ft->hasBlobs = TRUE;
+    result = FT_insertRest(ft, rest, lookup.dir, TRUE, payload.contents,
+                           payload.length, payload.blob);
+    FT_closePayload(ft, &payload, result);
+    return result;
 }
 
 
 /* see ft.h for specification */
-int FT_init(void) {
-    if (isInitialized) return INITIALIZATION_ERROR;
+int FT_T_insertDir(FT_T ft, char *path) {
+    int result;
 
-    isInitialized = 1;
-    rootDir = NULL;
-    rootFile = NULL;
-    countDirs = 0;
-    return SUCCESS;
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if(!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_insertDirLocked(ft, path));
+    return STATS_END(STATS_INSERT_DIR, path, result);
 }
 
 
-/* see ft.h for specification */
-int FT_destroy(void) {
-    if (!isInitialized) return INITIALIZATION_ERROR;
+/*  See ft.h for specification. */
+int FT_T_insertFile(FT_T ft, char *path, void *contents,
+                    size_t length) {
+    int result;
 
-    if (rootDir == NULL && rootFile == NULL) {
-        isInitialized = 0;
-        return SUCCESS;
-    }
+    assert(ft != NULL);
+    assert(path != NULL);
 
-    if (rootFile != NULL) {
-        (void) NodeFile_destroy(rootFile);
-        rootFile = NULL;
-        isInitialized = 0;
-        return SUCCESS;
-    }
+    if(!ft->isInitialized)
+        return INITIALIZATION_ERROR;
 
-    FT_removePathFromDir(rootDir);
-    rootDir = NULL;
-    isInitialized = 0;
-    return SUCCESS;
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_insertFileLocked(ft, path, contents,
+                                                 length, NULL));
+    return STATS_END(STATS_INSERT_FILE, path, result);
 }
 
 
 /* see ft.h for specification */
-int FT_stat(char *path, boolean* type, size_t* length) {
-    NodeDir curr;
-    size_t childIndex;
+int FT_T_insertFileOwned(FT_T ft, char *path, void *contents,
+                         size_t length) {
+    Blob_T blob;
+    int result;
 
+    assert(ft != NULL);
     assert(path != NULL);
-    assert(type != NULL);
-    assert(length != NULL);
 
-    if (!isInitialized) return INITIALIZATION_ERROR;
+    if(!ft->isInitialized)
+        return INITIALIZATION_ERROR;
 
-    /* edge case - root is file */
-    if (rootFile != NULL) {
-        if (!strcmp(NodeFile_getPath(rootFile), path)) {
-            *type = TRUE;
-            *length = NodeFile_getLength(rootFile);
-            return SUCCESS;
-        }
-        return NO_SUCH_PATH;
-    }
+    blob = Blob_adopt(contents, length);
+    if (blob == NULL)
+        return MEMORY_ERROR;
 
-    curr = FT_traversePathFile(path);
+    result = FT_T_insertFileBlob(ft, path, blob);
+    /* the new file holds its own reference; without one, the client
+       owns contents again */
+    if (result == SUCCESS)
+        Blob_release(blob);
+    else
+        (void) Blob_disown(blob);
+    return result;
+}
 
-    if (curr == NULL) return NO_SUCH_PATH;
 
-    if (NodeDir_hasChildDir(curr, path, NULL) == 1) {
-        *type = FALSE;
-        return SUCCESS;
-    } else if (NodeDir_hasChildFile(curr, path, &childIndex) == 1) {
-        *type = TRUE;
-        *length = NodeFile_getLength(NodeDir_getChildFile(curr, 
-        childIndex));
-        return SUCCESS;
-    }
-    return NO_SUCH_PATH;
+/* see ft.h for specification */
+int FT_T_insertFileBlob(FT_T ft, char *path, Blob_T blob) {
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    assert(blob != NULL);
+
+    if(!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_insertFileLocked(ft, path,
+                                                 Blob_getBytes(blob),
+                                                 Blob_getLength(blob),
+                                                 blob));
+    return STATS_END(STATS_INSERT_FILE, path, result);
 }
 
 
 /**********************************************************************/
-/* toString */
+/* Simple API functions */
 /**********************************************************************/
 
 
-/*
-   Performs a pre-order traversal of the NodeDirs' in the tree 
-   rooted at n,
-   inserting each payload to DynArray_T d beginning at index i.
-   Returns the next unused index in d after the insertion(s).
-*/
-static size_t FT_preOrderTraversal(NodeDir n, DynArray_T d, size_t i) {
-   size_t c;
+/*  See ft.h for specification. */
+boolean FT_T_containsDir(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    boolean result;
+    boolean isFile;
+    void* contents;
+    size_t length;
+
+    assert(ft != NULL);
+    assert(path != NULL);
 
-   assert(d != NULL);
+    if(!ft->isInitialized)
+        return FALSE;
 
-   if(n != NULL) {
-      (void) DynArray_set(d, i, n);
-      i++;
-      for(c = 0; c < NodeDir_getNumChildDirs(n); c++)
-         i = FT_preOrderTraversal(NodeDir_getChildDir(n, c), d, i);
-   }
-   return i;
+    STATS_BEGIN();
+    if (ft->isFrozen)
+        result = Snapshot_lookup(ft->snapshot, path, &isFile,
+                                 &contents, &length) == SUCCESS &&
+                 !isFile;
+    else {
+        ticket = FT_beginRead(ft);
+        FT_resolvePath(ft, path, &lookup);
+        result = FT_isDirAt(path, &lookup);
+        FT_endRead(ft, ticket);
+    }
+    return (boolean) STATS_END(STATS_CONTAINS, path, result);
 }
 
 
-/*
-   Alternate version of strlen that uses pAcc as an in-out parameter
-   to accumulate a string length, rather than returning the length of
-   str, and also always adds one more in addition to str's length.
+/*  See ft.h for specification. */
+boolean FT_T_containsFile(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    boolean result;
+    boolean isFile;
+    void* contents;
+    size_t length;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if(!ft->isInitialized)
+        return FALSE;
+
+    STATS_BEGIN();
+    if (ft->isFrozen)
+        result = Snapshot_lookup(ft->snapshot, path, &isFile,
+                                 &contents, &length) == SUCCESS &&
+                 isFile;
+    else {
+        ticket = FT_beginRead(ft);
+        FT_resolvePath(ft, path, &lookup);
+        result = FT_isFileAt(path, &lookup);
+        FT_endRead(ft, ticket);
+    }
+    return (boolean) STATS_END(STATS_CONTAINS, path, result);
+}
+
 
-   Accumulates all dirs and files.
+/*
+   Does the work of FT_T_rmDir, which ft's writers are serialized
+   around.
 */
-static void FT_strlenAccumulate(NodeDir n, size_t* pAcc) {
-    size_t i;
+static int FT_rmDirLocked(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    NodeDir curr;
+    int result;
 
-    assert(pAcc != NULL);
-    assert(n != NULL);
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    FT_resolveForChange(ft, path, &lookup);
+
+    if (FT_isFileAt(path, &lookup))
+        return NOT_A_DIRECTORY;
+    if (!FT_isDirAt(path, &lookup))
+        return NO_SUCH_PATH;
 
-    *pAcc += strlen(NodeDir_getPath(n)) + 1;
+    /* only the part of a chain from path down is removed */
+    result = FT_splitAbove(ft, &lookup);
+    if (result != SUCCESS)
+        return result;
 
-    for (i = 0; i < NodeDir_getNumChildFiles(n); i++) {
-        *pAcc += strlen(NodeFile_getPath(NodeDir_getChildFile(n, i)))
-         + 1;
+    curr = lookup.dir;
+    if (NodeDir_getParent(curr) == NULL)
+        FT_setRootDir(ft, NULL);
+    else {
+        result = FT_detachDir(ft, curr);
+        if (result != SUCCESS)
+            return result;
     }
+    FT_discardDir(ft, curr);
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+int FT_T_rmDir(FT_T ft, char *path) {
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    if (!ft->isInitialized) return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_rmDirLocked(ft, path));
+    return STATS_END(STATS_RM_DIR, path, result);
 }
 
 
 /*
-   Alternate version of strcat that inverts the typical argument
-   order, appending str onto acc, and also always adds a newline at
-   the end of the concatenated string.
+   Does the work of FT_T_rmFile, which ft's writers are serialized
+   around.
 */
-static void FT_strcatAccumulate(NodeDir n, char* acc) {
-    size_t i;
-    
+static int FT_rmFileLocked(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    int result;
 
-    assert(acc != NULL);
-    assert(n != NULL);
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    FT_resolveForChange(ft, path, &lookup);
 
-    strcat(acc, NodeDir_getPath(n));
-    strcat(acc, "\n");
+    if (FT_isDirAt(path, &lookup))
+        return NOT_A_FILE;
+    if (!FT_isFileAt(path, &lookup))
+        return NO_SUCH_PATH;
 
-    for (i = 0; i < NodeDir_getNumChildFiles(n); i++) {
-        strcat(acc, NodeFile_getPath(NodeDir_getChildFile(n, i)));
-        strcat(acc, "\n");
+    /* edge case - root is file */
+    if (lookup.file == ft->rootFile)
+        FT_setRootFile(ft, NULL);
+    else {
+        result = FT_detachFile(ft, lookup.file);
+        if (result != SUCCESS)
+            return result;
     }
+
+    FT_discardFile(ft, lookup.file);
+    return SUCCESS;
 }
 
 
-/*
-  Returns a string representation of the
-  data structure, or NULL if the structure is
-  not initialized or there is an allocation error.
+/* see ft.h for specification */
+int FT_T_rmFile(FT_T ft, char *path) {
+    int result;
 
-  Allocates memory for the returned string,
-  which is then owned by client!
+    assert(ft != NULL);
+    assert(path != NULL);
+    if (!ft->isInitialized) return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_rmFileLocked(ft, path));
+    return STATS_END(STATS_RM_FILE, path, result);
+}
+
+
+/*
+   Moves NodeDir n, which is in ft's hierarchy, below parent, renaming
+   it to interned name, whose reference the caller hands over. If
+   parent is NULL, n must be the root, and is only renamed. Nothing
+   below n is touched: n is unlinked, given its new name and parent,
+   and linked again, with the totals of both parents' ancestors kept
+   up to date as it goes. If ft is concurrent, readers are waited out
+   before n changes, so none sees it half renamed, and until it is
+   linked again lookups find it at neither path. Returns SUCCESS, or
+   MEMORY_ERROR, in which case n is back where it was and name has
+   been released.
 */
-char *FT_toString() {
-    DynArray_T nodes;
-    size_t totalStrlen = 1;
-    char* result = NULL;
+static int FT_moveDir(FT_T ft, NodeDir n, NodeDir parent,
+const char* name) {
+   NodeDir oldParent;
+   DynArray_T kept = NULL;
+   DynArray_T old = NULL;
+   const char* oldName;
+   int result;
+
+   assert(ft != NULL);
+   assert(n != NULL);
+   assert(name != NULL);
+
+   oldParent = NodeDir_getParent(n);
+   if (oldParent == NULL) {
+      assert(parent == NULL);
+      if (ft->epoch != NULL) {
+         FT_setRootDir(ft, NULL);
+         Epoch_synchronize(ft->epoch);
+      }
+      Names_releaseIn(ft->arena, NodeDir_rename(n, name));
+      FT_setRootDir(ft, n);
+      return SUCCESS;
+   }
 
-    if (!isInitialized)
-        return NULL;
+   if (ft->epoch == NULL)
+      result = NodeDir_unlinkChildDir(oldParent, n);
+   else
+      result = NodeDir_unlinkChildDirShared(oldParent, n, &kept);
+   if (result != SUCCESS) {
+      Names_releaseIn(ft->arena, name);
+      return result;
+   }
+   if (ft->epoch != NULL)
+      Epoch_synchronize(ft->epoch);
+
+   oldName = NodeDir_rename(n, name);
+   NodeDir_setParent(n, parent);
+   if (ft->epoch == NULL)
+      result = NodeDir_linkChildDir(parent, n);
+   else
+      result = NodeDir_linkChildDirShared(parent, n, &old);
+
+   if (result != SUCCESS) {
+      /* no reader has seen n since the wait, so it goes back as if
+         it had never left */
+      Names_releaseIn(ft->arena, NodeDir_rename(n, oldName));
+      NodeDir_setParent(n, oldParent);
+      if (ft->epoch == NULL)
+         NodeDir_relinkChildDir(oldParent, n);
+      else {
+         NodeDir_restoreChildDirsShared(oldParent, n, kept, &old);
+         FT_retireArray(ft, old);
+      }
+      return result;
+   }
 
-    /* edge case - root is file */
-    if (rootFile != NULL)
-        return strcat((char *) NodeFile_getPath(rootFile), 
-        (const char*)  "\n");
-    
-    nodes = DynArray_new(countDirs);
+   Names_releaseIn(ft->arena, oldName);
+   if (ft->epoch != NULL) {
+      FT_retireArray(ft, kept);
+      FT_retireArray(ft, old);
+   }
+   return SUCCESS;
+}
 
-    (void) FT_preOrderTraversal(rootDir, nodes, 0);
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate, 
-    (void*) &totalStrlen);
+/*
+   Moves NodeFile n, which is in ft's hierarchy, below parent, renaming
+   it to interned name, as FT_moveDir does, and returns as it does.
+*/
+static int FT_moveFile(FT_T ft, NodeFile n, NodeDir parent,
+const char* name) {
+   NodeDir oldParent;
+   DynArray_T kept = NULL;
+   DynArray_T old = NULL;
+   const char* oldName;
+   int result;
+
+   assert(ft != NULL);
+   assert(n != NULL);
+   assert(name != NULL);
+
+   oldParent = NodeFile_getParent(n);
+   if (oldParent == NULL) {
+      assert(parent == NULL);
+      if (ft->epoch != NULL) {
+         FT_setRootFile(ft, NULL);
+         Epoch_synchronize(ft->epoch);
+      }
+      Names_releaseIn(ft->arena, NodeFile_rename(n, name));
+      FT_setRootFile(ft, n);
+      return SUCCESS;
+   }
 
-    result = malloc(totalStrlen);
+   if (ft->epoch == NULL)
+      result = NodeDir_unlinkChildFile(oldParent, n);
+   else
+      result = NodeDir_unlinkChildFileShared(oldParent, n, &kept);
+   if (result != SUCCESS) {
+      Names_releaseIn(ft->arena, name);
+      return result;
+   }
+   if (ft->epoch != NULL)
+      Epoch_synchronize(ft->epoch);
+
+   oldName = NodeFile_rename(n, name);
+   NodeFile_setParent(n, parent);
+   if (ft->epoch == NULL)
+      result = NodeDir_linkChildFile(parent, n);
+   else
+      result = NodeDir_linkChildFileShared(parent, n, &old);
+
+   if (result != SUCCESS) {
+      Names_releaseIn(ft->arena, NodeFile_rename(n, oldName));
+      NodeFile_setParent(n, oldParent);
+      if (ft->epoch == NULL)
+         NodeDir_relinkChildFile(oldParent, n);
+      else {
+         NodeDir_restoreChildFilesShared(oldParent, n, kept, &old);
+         FT_retireArray(ft, old);
+      }
+      return result;
+   }
 
-    if(result == NULL) {
-        DynArray_free(nodes);
-        return NULL;
-    }
-    *result = '\0';
+   Names_releaseIn(ft->arena, oldName);
+   if (ft->epoch != NULL) {
+      FT_retireArray(ft, kept);
+      FT_retireArray(ft, old);
+   }
+   return SUCCESS;
+}
+
+
+/*
+   Does the work of FT_T_move, which ft's writers are serialized
+   around.
+*/
+static int FT_moveLocked(FT_T ft, char *srcPath, char *dstPath) {
+    struct FT_lookup src;
+    struct FT_lookup dst;
+    struct Path_tokens tokens;
+    boolean isFile;
+    boolean isNested;
+    boolean isRoot;
+    const char* rest;
+    const char* name;
+    size_t srcLen;
+    size_t start;
+    size_t len;
+    int result;
 
-    if (rootDir == NULL && rootFile == NULL) {
-        DynArray_free(nodes);
+    assert(ft != NULL);
+    assert(srcPath != NULL);
+    assert(dstPath != NULL);
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
         return result;
-    }
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate, 
-    (void *) result);
 
-    DynArray_free(nodes);
-    return result;
-}
\ No newline at end of file
+    FT_resolveForChange(ft, srcPath, &src);
+    isFile = FT_isFileAt(srcPath, &src);
+    if (!isFile && !FT_isDirAt(srcPath, &src))
+        return NO_SUCH_PATH;
+
+    /* a directory cannot go below itself */
+    srcLen = strlen(srcPath);
+    if (!isFile && strlen(dstPath) > srcLen &&
+        Path_compare(dstPath, srcLen, srcPath, srcLen) == 0 &&
+        dstPath[srcLen] == '/')
+        return PARENT_CHILD_ERROR;
+
+    FT_resolveForChange(ft, dstPath, &dst);
+    if (FT_isDirAt(dstPath, &dst) || FT_isFileAt(dstPath, &dst))
+        return ALREADY_IN_TREE;
+    /* a prefix of dstPath is a file */
+    if (dst.file != NULL)
+        return NOT_A_DIRECTORY;
+
+    rest = FT_restOfPath(dstPath, &dst);
+    if (!FT_isValidRest(rest))
+        return PARENT_CHILD_ERROR;
+    Path_startTokens(&tokens, rest);
+    (void) Path_nextToken(&tokens, &start, &len);
+    isNested = !Path_isLastToken(&tokens);
+    /* dstPath is outside the hierarchy unless it renames the root,
+       which a directory inside the root's chain is not */
+    if (isFile)
+        isRoot = NodeFile_getParent(src.file) == NULL;
+    else
+        isRoot = src.above == 0 && NodeDir_getParent(src.dir) == NULL;
+    if (dst.dir == NULL && (isNested || !isRoot))
+        return CONFLICTING_PATH;
+    /* the directory dstPath goes in must exist */
+    if (isNested)
+        return NO_SUCH_PATH;
+
+    /* the directory moved is given a NodeDir of its own, so neither
+       the chain above it nor the one below goes with it */
+    if (!isFile) {
+        result = FT_splitAbove(ft, &src);
+        if (result == SUCCESS)
+            result = FT_splitBelow(ft, &src);
+        if (result != SUCCESS)
+            return result;
+        /* the splits may have changed the NodeDirs along dstPath */
+        FT_resolveForChange(ft, dstPath, &dst);
+    }
+    result = FT_splitBelow(ft, &dst);
+    if (result != SUCCESS)
+        return result;
+
+    /* rest is now a single component, of length len */
+    name = Names_internIn(ft->arena, rest, len);
+    if (name == NULL)
+        return MEMORY_ERROR;
+    if (isFile)
+        return FT_moveFile(ft, src.file, dst.dir, name);
+    return FT_moveDir(ft, src.dir, dst.dir, name);
+}
+
+
+/* see ft.h for specification */
+int FT_T_move(FT_T ft, char *srcPath, char *dstPath) {
+    int result;
+
+    assert(ft != NULL);
+    assert(srcPath != NULL);
+    assert(dstPath != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_moveLocked(ft, srcPath, dstPath));
+    return STATS_END(STATS_MOVE, srcPath, result);
+}
+
+
+/* see ft.h for specification */
+int FT_T_flushRemoved(FT_T ft) {
+    assert(ft != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    FT_beginWrite(ft);
+    FT_reclaimSome(ft, (size_t) -1);
+    /* a hierarchy that could not be queued was retired whole */
+    if (ft->epoch != NULL)
+        Epoch_reclaim(ft->epoch);
+    return FT_endWrite(ft, SUCCESS);
+}
+
+
+/* see ft.h for specification */
+void *FT_T_getFileContents(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    void* contents = NULL;
+    boolean isFile;
+    size_t length;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if (!ft->isInitialized)
+        return NULL;
+
+    STATS_BEGIN();
+    if (ft->isFrozen) {
+        if (Snapshot_lookup(ft->snapshot, path, &isFile, &contents,
+                            &length) != SUCCESS || !isFile)
+            contents = NULL;
+    }
+    else {
+        ticket = FT_beginRead(ft);
+        FT_resolvePath(ft, path, &lookup);
+        if (FT_isFileAt(path, &lookup))
+            contents = NodeFile_getContents(lookup.file);
+        FT_endRead(ft, ticket);
+    }
+    (void) STATS_END(STATS_GET_CONTENTS, path, contents != NULL);
+    return contents;
+}
+
+
+/* see ft.h for specification */
+Blob_T FT_T_getFileBlob(FT_T ft, char *path) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    Blob_T blob = NULL;
+    boolean isFile;
+    void* contents;
+    size_t length;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if (!ft->isInitialized)
+        return NULL;
+
+    STATS_BEGIN();
+    if (ft->isFrozen) {
+        if (Snapshot_lookup(ft->snapshot, path, &isFile, &contents,
+                            &length) == SUCCESS && isFile)
+            blob = Blob_new(contents, length);
+    }
+    else {
+        ticket = FT_beginRead(ft);
+        FT_resolvePath(ft, path, &lookup);
+        if (FT_isFileAt(path, &lookup)) {
+            /* the reference is taken before the read ends, so a
+               writer replacing or removing the file cannot free blob
+               first */
+            blob = NodeFile_getBlob(lookup.file);
+            if (blob != NULL)
+                (void) Blob_retain(blob);
+            else
+                blob = Blob_new(NodeFile_getContents(lookup.file),
+                                NodeFile_getLength(lookup.file));
+        }
+        FT_endRead(ft, ticket);
+    }
+    (void) STATS_END(STATS_GET_CONTENTS, path, blob != NULL);
+    return blob;
+}
+
+
+/*
+   Does the work of the functions replacing a file's contents, which
+   ft's writers are serialized around: replaces the contents of the
+   file at path with contents, of size length, held in blob unless it
+   is NULL, and sets *pOldContents to the old ones if they were
+   borrowed, or else to NULL, dropping the file's reference to their
+   Blob_T. While a batch is being applied, the old contents and
+   their Blob_T are logged instead, to be restored or dropped when it
+   is done. Returns SUCCESS, NO_SUCH_PATH, NOT_A_FILE, MEMORY_ERROR,
+   or FILE_ERROR.
+*/
+static int FT_replaceFileLocked(FT_T ft, char *path, void *contents,
+size_t length, Blob_T blob, void **pOldContents) {
+    struct FT_lookup lookup;
+    struct FT_payload payload;
+    struct FT_change* change;
+    NodeFile file;
+    void* oldContents;
+    size_t oldLength;
+    Blob_T oldBlob;
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    assert(pOldContents != NULL);
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    FT_resolveForChange(ft, path, &lookup);
+    if (FT_isDirAt(path, &lookup))
+        return NOT_A_FILE;
+    if (!FT_isFileAt(path, &lookup))
+        return NO_SUCH_PATH;
+
+    result = FT_openPayload(ft, &payload, contents, length, blob);
+    if (result != SUCCESS)
+        return result;
+    if (payload.blob != NULL)
+        ft->hasBlobs = TRUE;
+
+    file = lookup.file;
+    oldLength = NodeFile_getLength(file);
+    oldContents = NodeFile_replaceContents(file, payload.contents,
+                                           payload.length, payload.blob,
+                                           &oldBlob);
+    *pOldContents = oldBlob == NULL ? oldContents : NULL;
+    FT_closePayload(ft, &payload, SUCCESS);
+
+    if (FT_logChange(ft, FT_CHANGE_REPLACE, file, NULL, NULL)) {
+        change = &ft->log->changes[ft->log->numChanges - 1];
+        change->contents = oldContents;
+        change->length = oldLength;
+        change->blob = oldBlob;
+    }
+    else
+        FT_dropBlob(ft, oldBlob);
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+void *FT_T_replaceFileContents(FT_T ft, char *path,
+                               void *newContents, size_t newLength) {
+    void* oldContents = NULL;
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if (!ft->isInitialized)
+        return NULL;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_replaceFileLocked(ft, path, newContents,
+                                                  newLength, NULL,
+                                                  &oldContents));
+    (void) STATS_END(STATS_REPLACE_CONTENTS, path, result);
+    return oldContents;
+}
+
+
+/* see ft.h for specification */
+int FT_T_replaceFileBlob(FT_T ft, char *path, Blob_T blob,
+                         void **pOldContents) {
+    void* oldContents = NULL;
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    assert(blob != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    FT_beginWrite(ft);
+    result = FT_endWrite(ft, FT_replaceFileLocked(ft, path,
+                                                  Blob_getBytes(blob),
+                                                  Blob_getLength(blob),
+                                                  blob, &oldContents));
+    if (pOldContents != NULL)
+        *pOldContents = oldContents;
+    return STATS_END(STATS_REPLACE_CONTENTS, path, result);
+}
+
+
+/* see ft.h for specification */
+int FT_T_replaceFileOwned(FT_T ft, char *path, void *contents,
+                          size_t length, void **pOldContents) {
+    Blob_T blob;
+    int result;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    blob = Blob_adopt(contents, length);
+    if (blob == NULL)
+        return MEMORY_ERROR;
+
+    result = FT_T_replaceFileBlob(ft, path, blob, pOldContents);
+    if (result == SUCCESS)
+        Blob_release(blob);
+    else
+        (void) Blob_disown(blob);
+    return result;
+}
+
+
+/*
+   Sets ft to initialized status with an empty hierarchy. Returns
+   SUCCESS, or MEMORY_ERROR if there is no memory for its arena.
+*/
+static int FT_initTree(FT_T ft) {
+    assert(ft != NULL);
+
+    ft->arena = Arena_new();
+    if (ft->arena == NULL)
+        return MEMORY_ERROR;
+    if (!Names_openArena(ft->arena)) {
+        Arena_free(ft->arena);
+        return MEMORY_ERROR;
+    }
+
+    ft->isInitialized = TRUE;
+    ft->rootDir = NULL;
+    ft->rootFile = NULL;
+    ft->countDirs = 0;
+    ft->hasBlobs = FALSE;
+    ft->store = NULL;
+    ft->isCompressed = FALSE;
+    ft->snapshot = NULL;
+    ft->isFrozen = FALSE;
+    ft->log = NULL;
+    ft->pending = NULL;
+    ft->reclaimRoot = NULL;
+    ft->reclaimAt = NULL;
+    ft->isPendingShared = FALSE;
+    return SUCCESS;
+}
+
+
+/*
+   Removes all contents of ft and returns it to uninitialized status.
+   Every node is in ft's arena, and every reference to a name its
+   nodes hold is let go of through the arena's table, so rather than
+   destroying the nodes one by one, frees the arena's slabs.
+*/
+static void FT_clearTree(FT_T ft) {
+    size_t i;
+
+    assert(ft != NULL);
+
+    /* retired nodes and arrays are in the arena too */
+    if (ft->epoch != NULL)
+        Epoch_reclaim(ft->epoch);
+
+    /* nodes holding Blob_Ts are destroyed to let go of them, those
+       of the removed hierarchies not yet destroyed included; the
+       rest are freed with the arena */
+    if (ft->hasBlobs) {
+        if (ft->rootDir != NULL)
+            (void) NodeDir_destroy(ft->rootDir);
+        else if (ft->rootFile != NULL)
+            (void) NodeFile_destroy(ft->rootFile);
+        if (ft->reclaimRoot != NULL)
+            (void) NodeDir_destroy(ft->reclaimRoot);
+        for (i = 0; ft->pending != NULL &&
+                    i < DynArray_getLength(ft->pending); i++)
+            (void) NodeDir_destroy(DynArray_get(ft->pending, i));
+    }
+
+    /* the queue of removed hierarchies is in the arena as well */
+    Names_closeArena(ft->arena);
+    Arena_free(ft->arena);
+    ft->arena = NULL;
+    ft->rootFile = NULL;
+    ft->rootDir = NULL;
+    ft->countDirs = 0;
+    ft->hasBlobs = FALSE;
+    ft->pending = NULL;
+    ft->reclaimRoot = NULL;
+    ft->reclaimAt = NULL;
+    ft->isPendingShared = FALSE;
+
+    /* only after the nodes, whose contents may be in it */
+    Snapshot_close(ft->snapshot);
+    ft->snapshot = NULL;
+    ft->isFrozen = FALSE;
+    ft->isInitialized = FALSE;
+}
+
+
+/* see ft.h for specification */
+int FT_T_save(FT_T ft, char *filename) {
+    int result;
+
+    assert(ft != NULL);
+    assert(filename != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    FT_beginWrite(ft);
+    result = FT_thaw(ft);
+    if (result == SUCCESS)
+        result = Snapshot_save(filename, ft->rootDir, ft->rootFile);
+    return FT_endWrite(ft, result);
+}
+
+
+/* see ft.h for specification */
+int FT_T_load(FT_T ft, char *filename) {
+    Snapshot_T snapshot;
+    Arena_T arena;
+    NodeDir rootDir = NULL;
+    NodeFile rootFile = NULL;
+    size_t countDirs = 0;
+    int result;
+
+    assert(ft != NULL);
+    assert(filename != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    result = Snapshot_open(filename, &snapshot);
+    if (result != SUCCESS)
+        return result;
+    arena = Arena_new();
+    if (arena == NULL || !Names_openArena(arena)) {
+        Arena_free(arena);
+        Snapshot_close(snapshot);
+        return MEMORY_ERROR;
+    }
+
+    /* a concurrent tree's readers cannot build the hierarchy as they
+       go, so it is built now */
+    if (ft->epoch != NULL) {
+        result = Snapshot_build(snapshot, arena, &rootDir, &rootFile,
+                                &countDirs);
+        if (result != SUCCESS) {
+            Names_closeArena(arena);
+            Arena_free(arena);
+            Snapshot_close(snapshot);
+            return result;
+        }
+    }
+
+    FT_clearTree(ft);
+    ft->isInitialized = TRUE;
+    ft->arena = arena;
+    ft->rootDir = rootDir;
+    ft->rootFile = rootFile;
+    ft->countDirs = countDirs;
+    ft->snapshot = snapshot;
+    ft->isFrozen = ft->epoch == NULL;
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+FT_T FT_new(void) {
+    FT_T ft;
+
+    ft = malloc(sizeof(struct FT));
+    if (ft == NULL)
+        return NULL;
+
+    ft->epoch = NULL;
+    if (FT_initTree(ft) != SUCCESS) {
+        free(ft);
+        return NULL;
+    }
+    return ft;
+}
+
+
+/* see ft.h for specification */
+FT_T FT_newConcurrent(void) {
+    FT_T ft;
+
+    ft = FT_new();
+    if (ft == NULL)
+        return NULL;
+
+    ft->epoch = Epoch_new();
+    if (ft->epoch == NULL) {
+        FT_free(ft);
+        return NULL;
+    }
+    if (pthread_mutex_init(&ft->writeLock, NULL) != 0) {
+        Epoch_free(ft->epoch);
+        ft->epoch = NULL;
+        FT_free(ft);
+        return NULL;
+    }
+
+    return ft;
+}
+
+
+/* see ft.h for specification */
+void FT_free(FT_T ft) {
+    if (ft == NULL)
+        return;
+
+    FT_clearTree(ft);
+    Store_free(ft->store);
+    if (ft->epoch != NULL) {
+        Epoch_free(ft->epoch);
+        (void) pthread_mutex_destroy(&ft->writeLock);
+    }
+    free(ft);
+}
+
+
+/* see ft.h for specification */
+int FT_T_enableDedup(FT_T ft) {
+    assert(ft != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    FT_beginWrite(ft);
+    if (ft->store == NULL) {
+        ft->store = Store_new();
+        if (ft->store == NULL)
+            return FT_endWrite(ft, MEMORY_ERROR);
+    }
+    return FT_endWrite(ft, SUCCESS);
+}
+
+
+/* see ft.h for specification */
+int FT_T_getDedupStats(FT_T ft, struct FT_DedupStats *pStats) {
+    struct Store_stats stats;
+
+    assert(ft != NULL);
+    assert(pStats != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* pruning first leaves only the payloads files still hold, once
+       the files removed are freed */
+    memset(&stats, 0, sizeof stats);
+    FT_beginWrite(ft);
+    if (ft->store != NULL) {
+        FT_reclaimSome(ft, (size_t) -1);
+        if (ft->epoch != NULL)
+            Epoch_reclaim(ft->epoch);
+        Store_prune(ft->store);
+        Store_getStats(ft->store, &stats);
+    }
+    (void) FT_endWrite(ft, SUCCESS);
+
+    pStats->payloads = stats.numBlobs;
+    pStats->payloadBytes = stats.numBytes;
+    pStats->references = stats.numRefs;
+    pStats->referencedBytes = stats.numRefBytes;
+    pStats->hits = stats.numHits;
+    pStats->misses = stats.numMisses;
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+int FT_T_enableCompression(FT_T ft) {
+    assert(ft != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* readers of a concurrent tree could not follow a split */
+    FT_beginWrite(ft);
+    ft->isCompressed = ft->epoch == NULL;
+    return FT_endWrite(ft, SUCCESS);
+}
+
+
+/* see ft.h for specification */
+int FT_T_stat(FT_T ft, char *path, boolean* type, size_t* length) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    int result = SUCCESS;
+    boolean isFile;
+    void* contents;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    assert(type != NULL);
+    assert(length != NULL);
+
+    if (!ft->isInitialized) return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    if (ft->isFrozen) {
+        if (Snapshot_lookup(ft->snapshot, path, &isFile, &contents,
+                            length) != SUCCESS)
+            result = NO_SUCH_PATH;
+        else
+            *type = isFile;
+        return STATS_END(STATS_STAT, path, result);
+    }
+
+    ticket = FT_beginRead(ft);
+    FT_resolvePath(ft, path, &lookup);
+
+    if (FT_isFileAt(path, &lookup)) {
+        *type = TRUE;
+        *length = NodeFile_getLength(lookup.file);
+    }
+    else if (FT_isDirAt(path, &lookup))
+        *type = FALSE;
+    else
+        result = NO_SUCH_PATH;
+
+    FT_endRead(ft, ticket);
+    return STATS_END(STATS_STAT, path, result);
+}
+
+
+/* see ft.h for specification */
+int FT_T_statDir(FT_T ft, char *path, size_t *dirs, size_t *files,
+                 size_t *bytes) {
+    struct FT_lookup lookup;
+    size_t ticket;
+    int result = SUCCESS;
+
+    assert(ft != NULL);
+    assert(path != NULL);
+    assert(dirs != NULL);
+    assert(files != NULL);
+    assert(bytes != NULL);
+
+    if (!ft->isInitialized) return INITIALIZATION_ERROR;
+
+    STATS_BEGIN();
+    /* a snapshot keeps no totals, so the hierarchy is built */
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return STATS_END(STATS_STAT, path, result);
+
+    ticket = FT_beginRead(ft);
+    FT_resolvePath(ft, path, &lookup);
+
+    /* the directories of a chain above path's are not below it */
+    if (FT_isDirAt(path, &lookup)) {
+        NodeDir_getTotals(lookup.dir, dirs, files, bytes);
+        *dirs -= lookup.above;
+    }
+    else if (FT_isFileAt(path, &lookup))
+        result = NOT_A_DIRECTORY;
+    else
+        result = NO_SUCH_PATH;
+
+    FT_endRead(ft, ticket);
+    return STATS_END(STATS_STAT, path, result);
+}
+
+
+/**********************************************************************/
+/* toString */
+/**********************************************************************/
+
+
+/*
+   Returns the end of the first prefix of label, which is length
+   chars long, that is longer than at chars and ends at a '/' or at
+   the end of label. at must be less than length. The paths of the
+   directories a NodeDir stands for (see NodeDir_getLabel) are its
+   parent's path followed by a '/' and each such prefix of its
+   label, in turn.
+*/
+static size_t FT_nextPrefix(const char* label, size_t length,
+size_t at) {
+    const char* slash;
+
+    assert(label != NULL);
+    assert(at < length);
+
+    slash = memchr(label + at + 1, '/', length - at - 1);
+    return slash == NULL ? length : (size_t) (slash - label);
+}
+
+
+/*
+   Returns the number of chars FT_toString uses for the hierarchy
+   rooted at n: one line, with its trailing newline, for each of its
+   nodes. Walks it with w, leaving the length of each NodeDir's path
+   in its level. Returns 0 if allocation error.
+*/
+static size_t FT_measureDir(NodeDir n, struct NodeDir_walk* w) {
+    struct NodeDir_level* level;
+    struct NodeDir_level* parent;
+    const char* label;
+    size_t labelLen;
+    size_t base;
+    size_t total = 0;
+    size_t at;
+    size_t i;
+    int step;
+
+    assert(n != NULL);
+    assert(w != NULL);
+
+    NodeDir_walkBegin(w, n);
+    while ((step = NodeDir_walkNext(w, &level)) > 0) {
+        STATS_COUNT(STATS_NODES_VISITED,
+                    1 + NodeDir_getNumChildFiles(level->dir));
+        parent = NodeDir_walkParent(w);
+        base = parent == NULL ? 0 : parent->length + 1;
+        label = NodeDir_getLabel(level->dir, &labelLen);
+        for (at = 0; at < labelLen; total += base + at + 1)
+            at = FT_nextPrefix(label, labelLen, at);
+        level->length = base + labelLen;
+
+        for (i = 0; i < NodeDir_getNumChildFiles(level->dir); i++)
+            total += level->length + 1 + Names_getLength(
+                NodeFile_getName(NodeDir_getChildFile(level->dir, i)))
+                + 1;
+    }
+
+    if (step < 0)
+        return 0;
+    return total;
+}
+
+
+/*
+   Writes path (pathLen chars), a '/', name (nameLen chars) and a
+   newline at cursor. path may be NULL for the root, in which case
+   only name and the newline are written. Returns the position just
+   past the newline.
+*/
+static char* FT_writeLine(char* cursor, const char* path,
+size_t pathLen, const char* name, size_t nameLen) {
+    assert(cursor != NULL);
+    assert(name != NULL);
+
+    if (path != NULL) {
+        memcpy(cursor, path, pathLen);
+        cursor += pathLen;
+        *cursor++ = '/';
+    }
+    memcpy(cursor, name, nameLen);
+    cursor += nameLen;
+    *cursor++ = '\n';
+
+    return cursor;
+}
+
+
+/*
+   Writes the lines of the hierarchy rooted at n at cursor, in the
+   order FT_toString specifies, and returns the position just past
+   them. w must have walked the hierarchy already, so that its stack
+   is as deep as it needs to be and walking it again cannot fail.
+   Each NodeDir's path is built by copying its parent's, which is
+   found already written where the parent's level says, so every
+   char of output is written exactly once.
+*/
+static char* FT_writeDir(NodeDir n, struct NodeDir_walk* w,
+char* cursor) {
+    struct NodeDir_level* level;
+    struct NodeDir_level* parent;
+    char* base = cursor;
+    const char* path;
+    const char* label;
+    const char* name;
+    size_t labelLen;
+    size_t at;
+    size_t i;
+    int step;
+
+    assert(n != NULL);
+    assert(w != NULL);
+    assert(cursor != NULL);
+
+    NodeDir_walkBegin(w, n);
+    while ((step = NodeDir_walkNext(w, &level)) > 0) {
+        STATS_COUNT(STATS_NODES_VISITED,
+                    1 + NodeDir_getNumChildFiles(level->dir));
+        parent = NodeDir_walkParent(w);
+        label = NodeDir_getLabel(level->dir, &labelLen);
+
+        /* a line for each directory of a chain, the last one's
+           path being the NodeDir's */
+        for (at = 0; at < labelLen; ) {
+            at = FT_nextPrefix(label, labelLen, at);
+            level->start = (size_t) (cursor - base);
+            if (parent == NULL)
+                cursor = FT_writeLine(cursor, NULL, 0, label, at);
+            else
+                cursor = FT_writeLine(cursor, base + parent->start,
+                                      parent->length, label, at);
+        }
+        level->length = (size_t) (cursor - base) - level->start - 1;
+
+        path = base + level->start;
+        for (i = 0; i < NodeDir_getNumChildFiles(level->dir); i++) {
+            name = NodeFile_getName(NodeDir_getChildFile(level->dir,
+                                                         i));
+            cursor = FT_writeLine(cursor, path, level->length, name,
+                                  Names_getLength(name));
+        }
+    }
+
+    assert(step == 0);
+    return cursor;
+}
+
+
+/*
+   Does the work of FT_T_toString, which ft's writers are serialized
+   around.
+*/
+static char *FT_toStringLocked(FT_T ft) {
+    struct NodeDir_walk walk;
+    size_t totalStrlen = 1;
+    size_t dirsStrlen;
+    char* result;
+    char* end;
+
+    assert(ft != NULL);
+
+    if (FT_thaw(ft) != SUCCESS)
+        return NULL;
+
+    NodeDir_walkInit(&walk);
+    if (ft->rootFile != NULL)
+        totalStrlen += strlen(NodeFile_getName(ft->rootFile)) + 1;
+    else if (ft->rootDir != NULL) {
+        dirsStrlen = FT_measureDir(ft->rootDir, &walk);
+        if (dirsStrlen == 0) {
+            NodeDir_walkFree(&walk);
+            return NULL;
+        }
+        totalStrlen += dirsStrlen;
+    }
+
+    STATS_COUNT(STATS_ALLOCS, 1);
+    result = malloc(totalStrlen);
+    if (result == NULL) {
+        NodeDir_walkFree(&walk);
+        return NULL;
+    }
+
+    end = result;
+    /* edge case - root is file */
+    if (ft->rootFile != NULL)
+        end = FT_writeLine(end, NULL, 0,
+                           NodeFile_getName(ft->rootFile),
+                           Names_getLength(
+                               NodeFile_getName(ft->rootFile)));
+    else if (ft->rootDir != NULL)
+        end = FT_writeDir(ft->rootDir, &walk, end);
+    NodeDir_walkFree(&walk);
+    *end = '\0';
+
+    assert((size_t) (end - result) + 1 == totalStrlen);
+    return result;
+}
+
+
+/*
+  Returns a string representation of the
+  data structure, or NULL if the structure is
+  not initialized or there is an allocation error.
+
+  Allocates memory for the returned string,
+  which is then owned by client!
+*/
+char *FT_T_toString(FT_T ft) {
+    char* result;
+
+    assert(ft != NULL);
+
+    if (!ft->isInitialized)
+        return NULL;
+
+    STATS_BEGIN();
+    /* the hierarchy must not change between measuring and writing */
+    FT_beginWrite(ft);
+    result = FT_toStringLocked(ft);
+    (void) FT_endWrite(ft, SUCCESS);
+    (void) STATS_END(STATS_TO_STRING, NULL, result != NULL);
+    return result;
+}
+
+
+/*
+   A growable buffer holding the path of the node being streamed,
+   followed by a newline.
+*/
+struct FT_lineBuffer {
+    /* the chars of the buffer */
+    char* chars;
+
+    /* the number of chars allocated for chars */
+    size_t size;
+};
+
+
+/*
+   Makes pLine's path (pathLen chars) followed by a '/' and name
+   (nameLen chars), or just name if pathLen is 0, and a newline, then
+   passes the line to *pfApply. Returns the length of the new path,
+   or 0 if allocation error occurs.
+*/
+static size_t FT_emitLine(struct FT_lineBuffer* pLine, size_t pathLen,
+const char* name, size_t nameLen,
+void (*pfApply)(const char* line, size_t length, void* pvExtra),
+void* pvExtra) {
+    size_t newLen;
+    size_t newSize;
+    char* newChars;
+
+    assert(pLine != NULL);
+    assert(name != NULL);
+    assert(pfApply != NULL);
+
+    newLen = (pathLen == 0 ? 0 : pathLen + 1) + nameLen;
+    if (newLen + 1 > pLine->size) {
+        newSize = 2 * pLine->size;
+        if (newSize < newLen + 1)
+            newSize = newLen + 1;
+        newChars = realloc(pLine->chars, newSize);
+        if (newChars == NULL)
+            return 0;
+        pLine->chars = newChars;
+        pLine->size = newSize;
+    }
+
+    if (pathLen != 0)
+        pLine->chars[pathLen++] = '/';
+    memcpy(pLine->chars + pathLen, name, newLen - pathLen);
+    pLine->chars[newLen] = '\n';
+    (*pfApply)(pLine->chars, newLen + 1, pvExtra);
+
+    return newLen;
+}
+
+
+/*
+   Streams the lines of the hierarchy rooted at n to *pfApply in the
+   order FT_toString specifies, building them in pLine. Each NodeDir's
+   path is left in pLine by the time its children's lines are built,
+   so each line is built on the path of its parent already there.
+   Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_streamDir(NodeDir n, struct FT_lineBuffer* pLine,
+void (*pfApply)(const char* line, size_t length, void* pvExtra),
+void* pvExtra) {
+    struct NodeDir_walk walk;
+    struct NodeDir_level* level;
+    struct NodeDir_level* parent;
+    NodeDir dir;
+    NodeFile file;
+    const char* label;
+    size_t labelLen;
+    size_t at;
+    size_t i;
+    int step;
+
+    assert(n != NULL);
+    assert(pLine != NULL);
+
+    NodeDir_walkInit(&walk);
+    NodeDir_walkBegin(&walk, n);
+    while ((step = NodeDir_walkNext(&walk, &level)) > 0) {
+        parent = NodeDir_walkParent(&walk);
+        label = NodeDir_getLabel(level->dir, &labelLen);
+        for (at = 0; at < labelLen; ) {
+            at = FT_nextPrefix(label, labelLen, at);
+            level->length = FT_emitLine(pLine,
+                                  parent == NULL ? 0 : parent->length,
+                                  label, at, pfApply, pvExtra);
+            if (level->length == 0)
+                break;
+        }
+        if (level->length == 0)
+            break;
+
+        /* children are fetched one at a time, rather than up to a
+           count taken first, so that a concurrent writer cannot
+           shrink them out from under the loop */
+        dir = level->dir;
+        for (i = 0; (file = NodeDir_getChildFile(dir, i)) != NULL; i++)
+            if (FT_emitLine(pLine, level->length,
+                            NodeFile_getName(file),
+                            Names_getLength(NodeFile_getName(file)),
+                            pfApply, pvExtra) == 0)
+                break;
+        if (file != NULL)
+            break;
+    }
+    NodeDir_walkFree(&walk);
+
+    if (step != 0)
+        return MEMORY_ERROR;
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+int FT_T_toCallback(FT_T ft,
+void (*pfApply)(const char* line, size_t length, void* pvExtra),
+void* pvExtra) {
+    struct FT_lineBuffer line;
+    NodeFile rootFile;
+    NodeDir rootDir;
+    size_t ticket;
+    int result = SUCCESS;
+
+    assert(ft != NULL);
+    assert(pfApply != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    line.chars = NULL;
+    line.size = 0;
+
+    ticket = FT_beginRead(ft);
+    rootFile = FT_getRootFile(ft);
+    rootDir = FT_getRootDir(ft);
+
+    /* edge case - root is file */
+    if (rootFile != NULL) {
+        if (FT_emitLine(&line, 0, NodeFile_getName(rootFile),
+                        Names_getLength(NodeFile_getName(rootFile)),
+                        pfApply, pvExtra) == 0)
+            result = MEMORY_ERROR;
+    }
+    else if (rootDir != NULL)
+        result = FT_streamDir(rootDir, &line, pfApply, pvExtra);
+    FT_endRead(ft, ticket);
+
+    free(line.chars);
+    return result;
+}
+
+
+/*
+   Writes the length chars of line to the FILE* stream pvExtra.
+*/
+static void FT_fileWrite(const char* line, size_t length,
+void* pvExtra) {
+    assert(line != NULL);
+    assert(pvExtra != NULL);
+
+    (void) fwrite(line, 1, length, (FILE*) pvExtra);
+}
+
+
+/* see ft.h for specification */
+int FT_T_toFile(FT_T ft, FILE* stream) {
+    assert(ft != NULL);
+    assert(stream != NULL);
+
+    return FT_T_toCallback(ft, FT_fileWrite, stream);
+}
+
+
+/**********************************************************************/
+/* Walking */
+/**********************************************************************/
+
+
+/* A cursor over the hierarchy rooted at a path. */
+struct FT_Cursor {
+    /* the walk over the NodeDirs, each of whose levels holds the
+       length of its NodeDir's path */
+    struct NodeDir_walk walk;
+
+    /* the NodeDir last entered, whose NodeFiles are yielded before
+       the walk goes on, the length of its path, and the index of the
+       next of them to yield; dir is NULL once they all have been */
+    NodeDir dir;
+    size_t pathLen;
+    size_t nextFile;
+
+    /* if dir stands for a chain of directories (see
+       NodeDir_getLabel), the length of the path of the one of them
+       last yielded, at which the path buffer holds a '\0' in place
+       of a '/' until the last of them has been */
+    size_t chainEnd;
+
+    /* the path of the node last yielded, holding size chars */
+    char* path;
+    size_t size;
+
+    /* the node the walk starts at: exactly one of these is non-NULL
+       unless the walk is over the whole of an empty hierarchy */
+    NodeDir startDir;
+    NodeFile startFile;
+
+    /* TRUE once the starting node has been yielded */
+    boolean started;
+
+    /* TRUE if the node last yielded is a NodeDir whose descendants
+       have not been yielded yet */
+    boolean canPrune;
+
+    /* for a cursor over a concurrent File Tree, the tree's epochs and
+       the ticket of the read the cursor holds open; NULL otherwise */
+    Epoch_T epoch;
+    size_t ticket;
+};
+
+
+/*
+   Makes c's path buffer hold at least size chars, keeping its
+   contents. Returns TRUE if successful, or FALSE if allocation error.
+*/
+static boolean FT_Cursor_reserve(FT_Cursor_T c, size_t size) {
+    char* newPath;
+    size_t newSize;
+
+    assert(c != NULL);
+
+    if (size <= c->size)
+        return TRUE;
+
+    newSize = 2 * c->size;
+    if (newSize < size)
+        newSize = size;
+    newPath = realloc(c->path, newSize);
+    if (newPath == NULL)
+        return FALSE;
+
+    c->path = newPath;
+    c->size = newSize;
+    return TRUE;
+}
+
+
+/*
+   Writes a '/' and name (nameLen chars) after the first pathLen chars
+   of c's path buffer, and '\0'-terminates it. Returns the new path's
+   length, or 0 if allocation error.
+*/
+static size_t FT_Cursor_appendName(FT_Cursor_T c, size_t pathLen,
+const char* name, size_t nameLen) {
+    assert(c != NULL);
+    assert(name != NULL);
+
+    if (!FT_Cursor_reserve(c, pathLen + 1 + nameLen + 1))
+        return 0;
+
+    c->path[pathLen] = '/';
+    memcpy(c->path + pathLen + 1, name, nameLen);
+    c->path[pathLen + 1 + nameLen] = '\0';
+    return pathLen + 1 + nameLen;
+}
+
+
+/*
+   Returns a new cursor starting at startDir or startFile (at most one
+   of which is non-NULL; if both are NULL the cursor yields nothing),
+   or NULL if allocation error. If startDir stands for a chain of
+   directories, the cursor starts at the one whose path is startEnd
+   chars long.
+*/
+static FT_Cursor_T FT_Cursor_create(NodeDir startDir,
+NodeFile startFile, size_t startEnd) {
+    FT_Cursor_T c;
+    size_t pathLen = 0;
+
+    c = malloc(sizeof(struct FT_Cursor));
+    if (c == NULL)
+        return NULL;
+
+    NodeDir_walkInit(&c->walk);
+    c->dir = NULL;
+    c->pathLen = 0;
+    c->nextFile = 0;
+    c->chainEnd = 0;
+    c->path = NULL;
+    c->size = 0;
+    c->startDir = startDir;
+    c->startFile = startFile;
+    c->started = FALSE;
+    c->canPrune = FALSE;
+    c->epoch = NULL;
+    c->ticket = 0;
+
+    if (startDir != NULL)
+        pathLen = NodeDir_getPathLength(startDir);
+    else if (startFile != NULL)
+        pathLen = NodeFile_getPathLength(startFile);
+
+    if (!FT_Cursor_reserve(c, pathLen + 1)) {
+        free(c);
+        return NULL;
+    }
+
+    *c->path = '\0';
+    if (startDir != NULL) {
+        (void) NodeDir_writePath(startDir, c->path);
+        c->pathLen = pathLen;
+        c->chainEnd = startEnd;
+        c->path[startEnd] = '\0';
+    }
+    else if (startFile != NULL)
+        (void) NodeFile_writePath(startFile, c->path);
+
+    return c;
+}
+
+
+/*
+   Finds the node a walk over path starts at: the whole hierarchy if
+   path is NULL, and otherwise the NodeDir or NodeFile at path. If
+   it is a NodeDir standing for a chain of directories, passes back
+   the length of the path of the one the walk starts at in *pEnd.
+   Returns SUCCESS or NO_SUCH_PATH.
+*/
+static int FT_findWalkStart(FT_T ft, const char* path,
+NodeDir* pDir, NodeFile* pFile, size_t* pEnd) {
+    struct FT_lookup lookup;
+
+    assert(pDir != NULL);
+    assert(pFile != NULL);
+    assert(pEnd != NULL);
+
+    *pDir = NULL;
+    *pFile = NULL;
+    *pEnd = 0;
+
+    if (path == NULL) {
+        *pDir = FT_getRootDir(ft);
+        *pFile = FT_getRootFile(ft);
+        if (*pDir != NULL)
+            *pEnd = Names_getLength(NodeDir_getName(*pDir));
+        return SUCCESS;
+    }
+
+    FT_resolvePath(ft, path, &lookup);
+    if (FT_isFileAt(path, &lookup))
+        *pFile = lookup.file;
+    else if (FT_isDirAt(path, &lookup)) {
+        *pDir = lookup.dir;
+        *pEnd = lookup.end;
+    }
+    else
+        return NO_SUCH_PATH;
+
+    return SUCCESS;
+}
+
+
+/*
+   Creates a cursor over the hierarchy of ft rooted at path (all of it
+   if path is NULL) and passes it back in *pCursor. If ft is
+   concurrent, the cursor holds a read of ft open until it is freed,
+   so the nodes it refers to stay allocated even if they are removed.
+   Returns SUCCESS, NO_SUCH_PATH, MEMORY_ERROR or FILE_ERROR.
+*/
+static int FT_openCursor(FT_T ft, const char* path,
+FT_Cursor_T* pCursor) {
+    NodeDir startDir;
+    NodeFile startFile;
+    size_t startEnd;
+    size_t ticket;
+    int result;
+
+    assert(ft != NULL);
+    assert(pCursor != NULL);
+
+    result = FT_thaw(ft);
+    if (result != SUCCESS)
+        return result;
+
+    ticket = FT_beginRead(ft);
+    if (FT_findWalkStart(ft, path, &startDir, &startFile, &startEnd)
+        != SUCCESS) {
+        FT_endRead(ft, ticket);
+        return NO_SUCH_PATH;
+    }
+
+    *pCursor = FT_Cursor_create(startDir, startFile, startEnd);
+    if (*pCursor == NULL) {
+        FT_endRead(ft, ticket);
+        return MEMORY_ERROR;
+    }
+
+    (*pCursor)->epoch = ft->epoch;
+    (*pCursor)->ticket = ticket;
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+FT_Cursor_T FT_T_newCursor(FT_T ft, char *path) {
+    FT_Cursor_T c;
+
+    assert(ft != NULL);
+
+    if (!ft->isInitialized)
+        return NULL;
+    if (FT_openCursor(ft, path, &c) != SUCCESS)
+        return NULL;
+    return c;
+}
+
+
+/* see ft.h for specification */
+void FT_Cursor_free(FT_Cursor_T c) {
+    if (c == NULL)
+        return;
+
+    if (c->epoch != NULL)
+        Epoch_exit(c->epoch, c->ticket);
+
+    NodeDir_walkFree(&c->walk);
+    free(c->path);
+    free(c);
+}
+
+
+/* see ft.h for specification */
+int FT_Cursor_next(FT_Cursor_T c, const char **pPath, boolean *pIsFile,
+                   size_t *pLength) {
+    struct NodeDir_level* level;
+    struct NodeDir_level* parent;
+    NodeFile file;
+    const char* label;
+    const char* slash;
+    size_t labelLen;
+    int step;
+
+    assert(c != NULL);
+    assert(pPath != NULL);
+    assert(pIsFile != NULL);
+    assert(pLength != NULL);
+
+    c->canPrune = FALSE;
+
+    if (!c->started) {
+        c->started = TRUE;
+        if (c->startFile != NULL) {
+            *pPath = c->path;
+            *pIsFile = TRUE;
+            *pLength = NodeFile_getLength(c->startFile);
+            return 1;
+        }
+        if (c->startDir == NULL)
+            return 0;
+        NodeDir_walkBegin(&c->walk, c->startDir);
+    }
+
+    /* the rest of a chain of directories comes first, then files
+       before subdirectories, as in FT_toString */
+    if (c->dir != NULL && c->chainEnd < c->pathLen) {
+        c->path[c->chainEnd] = '/';
+        slash = memchr(c->path + c->chainEnd + 1, '/',
+                       c->pathLen - c->chainEnd - 1);
+        c->chainEnd = slash == NULL ? c->pathLen
+                                    : (size_t) (slash - c->path);
+        c->path[c->chainEnd] = '\0';
+        c->canPrune = TRUE;
+        *pPath = c->path;
+        *pIsFile = FALSE;
+        *pLength = 0;
+        return 1;
+    }
+    if (c->dir != NULL) {
+        file = NodeDir_getChildFile(c->dir, c->nextFile);
+        if (file != NULL) {
+            c->nextFile++;
+            if (FT_Cursor_appendName(c, c->pathLen,
+                    NodeFile_getName(file),
+                    Names_getLength(NodeFile_getName(file))) == 0)
+                return -1;
+            *pPath = c->path;
+            *pIsFile = TRUE;
+            *pLength = NodeFile_getLength(file);
+            return 1;
+        }
+        c->dir = NULL;
+    }
+
+    step = NodeDir_walkNext(&c->walk, &level);
+    if (step <= 0)
+        return step;
+
+    /* the starting NodeDir's path is already in the buffer, cut
+       short at the directory of its chain the walk starts at */
+    parent = NodeDir_walkParent(&c->walk);
+    if (parent == NULL)
+        level->length = c->pathLen;
+    else {
+        label = NodeDir_getLabel(level->dir, &labelLen);
+        level->length = FT_Cursor_appendName(c, parent->length,
+                                             label, labelLen);
+        if (level->length == 0)
+            return -1;
+        c->chainEnd = parent->length + 1 +
+                      FT_nextPrefix(label, labelLen, 0);
+        c->path[c->chainEnd] = '\0';
+    }
+
+    c->dir = level->dir;
+    c->pathLen = level->length;
+    c->nextFile = 0;
+    c->canPrune = TRUE;
+    *pPath = c->path;
+    *pIsFile = FALSE;
+    *pLength = 0;
+    return 1;
+}
+
+
+/* see ft.h for specification */
+boolean FT_Cursor_prune(FT_Cursor_T c) {
+    assert(c != NULL);
+
+    if (!c->canPrune)
+        return FALSE;
+
+    (void) NodeDir_walkSkip(&c->walk);
+    c->dir = NULL;
+    c->canPrune = FALSE;
+    return TRUE;
+}
+
+
+/* see ft.h for specification */
+int FT_T_walk(FT_T ft, char *path,
+              int (*pfVisit)(const char *path, boolean isFile,
+                             size_t length, void *pvExtra),
+              void *pvExtra) {
+    FT_Cursor_T c;
+    const char* nodePath;
+    boolean isFile;
+    size_t length;
+    int found;
+    int action;
+    int result;
+
+    assert(ft != NULL);
+    assert(pfVisit != NULL);
+
+    if (!ft->isInitialized)
+        return INITIALIZATION_ERROR;
+
+    result = FT_openCursor(ft, path, &c);
+    if (result != SUCCESS)
+        return result;
+
+    while ((found = FT_Cursor_next(c, &nodePath, &isFile, &length))
+           == 1) {
+        action = (*pfVisit)(nodePath, isFile, length, pvExtra);
+        if (action == FT_WALK_STOP)
+            break;
+        if (action == FT_WALK_PRUNE)
+            (void) FT_Cursor_prune(c);
+    }
+
+    FT_Cursor_free(c);
+    return found == -1 ? MEMORY_ERROR : SUCCESS;
+}
+
+
+/**********************************************************************/
+/* Bulk loading */
+/**********************************************************************/
+
+
+/*
+   Compares paths p1 and p2 component by component: returns <0, 0, or
+   >0 if p1 comes before, is the same as, or comes after p2 when
+   every directory's children are listed in order of name, each
+   followed by its own descendants. Since a component's end sorts
+   before any character in it, all the paths below a directory come
+   together, right after the directory's own path.
+*/
+static int FT_comparePaths(const char* p1, const char* p2) {
+   const unsigned char* c1 = (const unsigned char*) p1;
+   const unsigned char* c2 = (const unsigned char*) p2;
+
+   assert(p1 != NULL);
+   assert(p2 != NULL);
+
+   while (*c1 == *c2 && *c1 != '\0') {
+      c1++;
+      c2++;
+   }
+
+   if (*c1 == *c2)
+      return 0;
+   if (*c1 == '\0' || (*c1 == '/' && *c2 != '\0'))
+      return -1;
+   if (*c2 == '\0' || *c2 == '/')
+      return 1;
+   return (int) *c1 - (int) *c2;
+}
+
+
+/*
+   Compares the FT_Records pointed to by pv1 and pv2, which are
+   themselves pointers to FT_Records, by path, for qsort.
+*/
+static int FT_compareRecords(const void* pv1, const void* pv2) {
+   const struct FT_Record* const* pr1 = pv1;
+   const struct FT_Record* const* pr2 = pv2;
+
+   return FT_comparePaths((*pr1)->path, (*pr2)->path);
+}
+
+
+/* A hierarchy being built by FT_T_bulkLoad, one file at a time. */
+struct FT_builder {
+   /* the root of the hierarchy built so far (only one of these will
+      ever be non-NULL) */
+   NodeDir rootDir;
+   NodeFile rootFile;
+
+   /* the NodeDirs along the path of the last file added, from the
+      root down, which are the only ones later files can go in */
+   NodeDir* open;
+   size_t depth;
+   size_t maxDepth;
+
+   /* a scratch buffer for the component being added, of size
+      nameSize */
+   char* name;
+   size_t nameSize;
+
+   /* the number of NodeDirs built */
+   size_t countDirs;
+};
+
+
+/*
+   Copies the len bytes starting at comp into pBuilder's scratch
+   buffer as a string. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_setBuilderName(struct FT_builder* pBuilder,
+const char* comp, size_t len) {
+   char* name;
+
+   assert(pBuilder != NULL);
+   assert(comp != NULL);
+
+   if (len + 1 > pBuilder->nameSize) {
+      name = realloc(pBuilder->name, len + 1);
+      if (name == NULL)
+         return MEMORY_ERROR;
+      pBuilder->name = name;
+      pBuilder->nameSize = len + 1;
+   }
+
+   memcpy(pBuilder->name, comp, len);
+   pBuilder->name[len] = '\0';
+   return SUCCESS;
+}
+
+
+/*
+   Creates a NodeDir called pBuilder's scratch name as the last child
+   of pBuilder's deepest open NodeDir (or as the root, if none is
+   open), and opens it below that one. Returns SUCCESS, MEMORY_ERROR,
+   or NOT_A_DIRECTORY if the last file added there has the same name.
+*/
+static int FT_openBuilderDir(FT_T ft, struct FT_builder* pBuilder) {
+   NodeDir parent = NULL;
+   NodeDir new;
+   NodeDir* open;
+   size_t numFiles;
+   int result;
+
+   assert(ft != NULL);
+   assert(pBuilder != NULL);
+
+   if (pBuilder->depth == pBuilder->maxDepth) {
+      open = realloc(pBuilder->open,
+                     2 * (pBuilder->maxDepth + 1) * sizeof(NodeDir));
+      if (open == NULL)
+         return MEMORY_ERROR;
+      pBuilder->open = open;
+      pBuilder->maxDepth = 2 * (pBuilder->maxDepth + 1);
+   }
+
+   /* a file sorts right before the paths below it, so if one of
+      them is a directory's, the file is the last one added */
+   if (pBuilder->depth > 0) {
+      parent = pBuilder->open[pBuilder->depth - 1];
+      numFiles = NodeDir_getNumChildFiles(parent);
+      if (numFiles > 0 &&
+          strcmp(NodeFile_getName(NodeDir_getChildFile(parent,
+                                                       numFiles - 1)),
+                 pBuilder->name) == 0)
+         return NOT_A_DIRECTORY;
+   }
+
+   new = NodeDir_createIn(pBuilder->name, parent, ft->arena);
+   if (new == NULL)
+      return MEMORY_ERROR;
+
+   if (parent == NULL)
+      pBuilder->rootDir = new;
+   else {
+      result = NodeDir_appendChildDir(parent, new);
+      if (result != SUCCESS) {
+         (void) NodeDir_destroy(new);
+         return result;
+      }
+   }
+
+   pBuilder->open[pBuilder->depth] = new;
+   pBuilder->depth++;
+   pBuilder->countDirs++;
+   return SUCCESS;
+}
+
+
+/*
+   Adds the file of record r to the hierarchy pBuilder is building.
+   r's path must come after those of the files added before it.
+   Returns SUCCESS, CONFLICTING_PATH if it is not underneath the root,
+   NOT_A_DIRECTORY if one of its prefixes is a file,
+   PARENT_CHILD_ERROR if it is not a valid path, or MEMORY_ERROR.
+*/
+static int FT_addBuilderFile(FT_T ft, struct FT_builder* pBuilder,
+const struct FT_Record* r) {
+   struct Path_tokens tokens;
+   const char* path;
+   const char* comp;
+   size_t start;
+   size_t len;
+   size_t depth = 0;
+   NodeFile new;
+   int result;
+
+   assert(ft != NULL);
+   assert(pBuilder != NULL);
+   assert(r != NULL);
+   assert(r->path != NULL);
+
+   path = r->path;
+   if (!FT_isValidRest(path))
+      return PARENT_CHILD_ERROR;
+
+   Path_startTokens(&tokens, path);
+   (void) Path_nextToken(&tokens, &start, &len);
+
+   if (pBuilder->rootFile != NULL) {
+      if (FT_compareName(NodeFile_getName(pBuilder->rootFile),
+                         path + start, len) == 0)
+         return NOT_A_DIRECTORY;
+      return CONFLICTING_PATH;
+   }
+
+   /* the NodeDirs this file shares with the last one are reused,
+      and the rest are finished */
+   while (!Path_isLastToken(&tokens) && depth < pBuilder->depth &&
+          FT_compareName(NodeDir_getName(pBuilder->open[depth]),
+                         path + start, len) == 0) {
+      depth++;
+      (void) Path_nextToken(&tokens, &start, &len);
+   }
+   if (depth == 0 && pBuilder->rootDir != NULL)
+      return CONFLICTING_PATH;
+   pBuilder->depth = depth;
+
+   while (!Path_isLastToken(&tokens)) {
+      result = FT_setBuilderName(pBuilder, path + start, len);
+      if (result == SUCCESS)
+         result = FT_openBuilderDir(ft, pBuilder);
+      if (result != SUCCESS)
+         return result;
+      (void) Path_nextToken(&tokens, &start, &len);
+   }
+   comp = path + start;
+
+   if (pBuilder->depth == 0) {
+      new = NodeFile_createIn(comp, NULL, r->contents, r->length,
+                              NULL, ft->arena);
+      if (new == NULL)
+         return MEMORY_ERROR;
+      pBuilder->rootFile = new;
+      return SUCCESS;
+   }
+
+   new = NodeFile_createIn(comp, pBuilder->open[pBuilder->depth - 1],
+                           r->contents, r->length, NULL,
+                           ft->arena);
+   if (new == NULL)
+      return MEMORY_ERROR;
+   result = NodeDir_appendChildFile(pBuilder->open[pBuilder->depth - 1],
+                                    new);
+   if (result != SUCCESS)
+      (void) NodeFile_destroy(new);
+   return result;
+}
+
+
+/*
+   Does the work of FT_T_bulkLoad, which ft's writers are serialized
+   around. The hierarchy is built detached and only published once
+   it is complete, so on failure ft is unchanged.
+*/
+static int FT_bulkLoadLocked(FT_T ft, struct FT_Record* records,
+size_t count) {
+   struct FT_Record** sorted;
+   struct FT_builder builder;
+   boolean isSorted = TRUE;
+   size_t i;
+   int result = SUCCESS;
+
+   assert(ft != NULL);
+
+   result = FT_thaw(ft);
+   if (result != SUCCESS)
+      return result;
+
+   if (ft->rootDir != NULL || ft->rootFile != NULL)
+      return CONFLICTING_PATH;
+   if (count == 0)
+      return SUCCESS;
+
+   /* the records are sorted once, through pointers, so that the
+      client's array is left as it is */
+   if (count > (size_t) -1 / sizeof(struct FT_Record*))
+      return MEMORY_ERROR;
+   sorted = malloc(count * sizeof(struct FT_Record*));
+   if (sorted == NULL)
+      return MEMORY_ERROR;
+   for (i = 0; i < count; i++) {
+      assert(records[i].path != NULL);
+      sorted[i] = &records[i];
+      if (i > 0 && isSorted &&
+          FT_comparePaths(records[i - 1].path, records[i].path) > 0)
+         isSorted = FALSE;
+   }
+   if (!isSorted)
+      qsort(sorted, count, sizeof(struct FT_Record*),
+            FT_compareRecords);
+
+   builder.rootDir = NULL;
+   builder.rootFile = NULL;
+   builder.open = NULL;
+   builder.depth = 0;
+   builder.maxDepth = 0;
+   builder.name = NULL;
+   builder.nameSize = 0;
+   builder.countDirs = 0;
+
+   for (i = 0; i < count && result == SUCCESS; i++) {
+      if (i > 0 &&
+          FT_comparePaths(sorted[i - 1]->path, sorted[i]->path) == 0)
+         result = ALREADY_IN_TREE;
+      else
+         result = FT_addBuilderFile(ft, &builder, sorted[i]);
+   }
+
+   free(sorted);
+   free(builder.open);
+   free(builder.name);
+
+   if (result != SUCCESS) {
+      if (builder.rootDir != NULL)
+         (void) NodeDir_destroy(builder.rootDir);
+      if (builder.rootFile != NULL)
+         (void) NodeFile_destroy(builder.rootFile);
+      return result;
+   }
+
+   ft->countDirs = builder.countDirs;
+   FT_setRootFile(ft, builder.rootFile);
+   FT_setRootDir(ft, builder.rootDir);
+   return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+int FT_T_bulkLoad(FT_T ft, struct FT_Record *records, size_t count) {
+   assert(ft != NULL);
+   assert(records != NULL || count == 0);
+
+   if (!ft->isInitialized)
+      return INITIALIZATION_ERROR;
+
+   FT_beginWrite(ft);
+   return FT_endWrite(ft, FT_bulkLoadLocked(ft, records, count));
+}
+
+
+/**********************************************************************/
+/* Batched lookups */
+/**********************************************************************/
+
+
+/* A path in a batch, and its index in the batch. */
+struct FT_batchEntry {
+   const char* path;
+   size_t index;
+};
+
+
+/*
+   A batch of paths being looked up together, and where the outcome
+   for each one goes: in found if it is non-NULL, and in results,
+   types and lengths otherwise.
+*/
+struct FT_batch {
+   char** paths;
+
+   /* the paths, sorted by FT_comparePaths so that the paths below
+      any NodeDir are consecutive */
+   struct FT_batchEntry* sorted;
+
+   boolean* found;
+   int* results;
+   boolean* types;
+   size_t* lengths;
+};
+
+
+/* Below this many paths FT_sortBatch switches to insertion sort. */
+enum { FT_BATCH_SMALL_SORT = 16 };
+
+
+/*
+   Returns the byte of path at offset depth, numbered so that bytes
+   sort as in FT_comparePaths: the '\0' first, then '/', then the
+   rest in order.
+*/
+static int FT_batchByte(const char* path, size_t depth) {
+   assert(path != NULL);
+
+   if (path[depth] == '\0')
+      return 0;
+   if (path[depth] == '/')
+      return 1;
+   return (int) (unsigned char) path[depth] + 1;
+}
+
+
+/*
+   Sorts the n entries starting at sorted by FT_comparePaths of
+   their paths, given that the paths agree in their first depth
+   bytes. This is a three-way radix quicksort: each pass splits the
+   paths on one byte, so the long prefixes the paths in a batch tend
+   to share are each looked at once per path rather than once per
+   comparison.
+*/
+static void FT_sortBatch(struct FT_batchEntry* sorted, size_t n,
+size_t depth) {
+   struct FT_batchEntry swap;
+   size_t lt;
+   size_t gt;
+   size_t i;
+   size_t j;
+   int pivot;
+   int byte;
+
+   assert(sorted != NULL);
+
+   while (n >= FT_BATCH_SMALL_SORT) {
+      pivot = FT_batchByte(sorted[n / 2].path, depth);
+      lt = 0;
+      gt = n;
+      i = 0;
+      while (i < gt) {
+         byte = FT_batchByte(sorted[i].path, depth);
+         if (byte < pivot) {
+            swap = sorted[lt];
+            sorted[lt] = sorted[i];
+            sorted[i] = swap;
+            lt++;
+            i++;
+         }
+         else if (byte > pivot) {
+            gt--;
+            swap = sorted[gt];
+            sorted[gt] = sorted[i];
+            sorted[i] = swap;
+         }
+         else
+            i++;
+      }
+
+      FT_sortBatch(sorted, lt, depth);
+      FT_sortBatch(sorted + gt, n - gt, depth);
+
+      /* paths equal through their '\0' are done */
+      if (pivot == 0)
+         return;
+      sorted += lt;
+      n = gt - lt;
+      depth++;
+   }
+
+   for (i = 1; i < n; i++)
+      for (j = i; j > 0 &&
+              FT_comparePaths(sorted[j - 1].path + depth,
+                              sorted[j].path + depth) > 0; j--) {
+         swap = sorted[j - 1];
+         sorted[j - 1] = sorted[j];
+         sorted[j] = swap;
+      }
+}
+
+
+/*
+   Records in pBatch that its path at index i names file, or a
+   NodeDir if file is NULL.
+*/
+static void FT_recordBatchHit(struct FT_batch* pBatch, size_t i,
+NodeFile file) {
+   assert(pBatch != NULL);
+
+   if (pBatch->found != NULL) {
+      pBatch->found[i] = (file != NULL);
+      return;
+   }
+
+   pBatch->results[i] = SUCCESS;
+   pBatch->types[i] = (file != NULL);
+   if (file != NULL)
+      pBatch->lengths[i] = NodeFile_getLength(file);
+}
+
+
+/*
+   Returns the length of the component of path starting at offset
+   start.
+*/
+static size_t FT_componentLength(const char* path, size_t start) {
+   size_t slash;
+   size_t end;
+
+   assert(path != NULL);
+
+   if (Path_scan(path, start, &slash, 1, &end) == 1)
+      return slash - start;
+   return end - start;
+}
+
+
+/*
+   The children of a NodeDir, looked up by name in increasing order.
+   If isSweep, they are found by walking each array of children once,
+   in step with the names; otherwise each one is looked up on its
+   own, which is cheaper when few are wanted.
+*/
+struct FT_sweep {
+   NodeDir dir;
+   boolean isSweep;
+   size_t nextDir;
+   size_t nextFile;
+};
+
+
+/*
+   Returns the child NodeDir of pSweep's NodeDir named by the len
+   bytes starting at name, or NULL if there is none. name must not
+   come before any name passed to an earlier call.
+*/
+static NodeDir FT_sweepDir(struct FT_sweep* pSweep, const char* name,
+size_t len) {
+   NodeDir child;
+   int result;
+
+   assert(pSweep != NULL);
+   assert(name != NULL);
+
+   if (!pSweep->isSweep)
+      return NodeDir_lookupChildDir(pSweep->dir, name, len);
+
+   while ((child = NodeDir_getChildDir(pSweep->dir, pSweep->nextDir))
+          != NULL) {
+      result = FT_compareName(NodeDir_getName(child), name, len);
+      if (result > 0)
+         return NULL;
+      if (result == 0)
+         return child;
+      pSweep->nextDir++;
+   }
+   return NULL;
+}
+
+
+/*
+   Returns the child NodeFile of pSweep's NodeDir named by the len
+   bytes starting at name, or NULL if there is none. name must not
+   come before any name passed to an earlier call.
+*/
+static NodeFile FT_sweepFile(struct FT_sweep* pSweep, const char* name,
+size_t len) {
+   NodeFile child;
+   int result;
+
+   assert(pSweep != NULL);
+   assert(name != NULL);
+
+   if (!pSweep->isSweep)
+      return NodeDir_lookupChildFile(pSweep->dir, name, len);
+
+   while ((child = NodeDir_getChildFile(pSweep->dir, pSweep->nextFile))
+          != NULL) {
+      result = FT_compareName(NodeFile_getName(child), name, len);
+      if (result > 0)
+         return NULL;
+      if (result == 0)
+         return child;
+      pSweep->nextFile++;
+   }
+   return NULL;
+}
+
+
+/*
+   Narrows the sorted paths *pLo through *pHi - 1 of pBatch, each of
+   which is the path of the first of the directories NodeDir dir
+   stands for (see NodeDir_getLabel), which is *pEnd chars long, or
+   continues it with a '/', to those continuing the path of the last
+   of them, whose length is passed back in *pEnd. Paths of the
+   others are recorded as found on the way, and paths leaving the
+   chain are dropped, as they name nothing.
+*/
+static void FT_resolveBatchChain(struct FT_batch* pBatch, NodeDir dir,
+size_t* pEnd, size_t* pLo, size_t* pHi) {
+   const char* label;
+   const char* path;
+   size_t labelLen;
+   size_t at;
+   size_t next;
+   size_t lo;
+
+   assert(pBatch != NULL);
+   assert(dir != NULL);
+   assert(pEnd != NULL);
+   assert(pLo != NULL);
+   assert(pHi != NULL);
+
+   label = NodeDir_getLabel(dir, &labelLen);
+   for (at = Names_getLength(NodeDir_getName(dir)); at < labelLen;
+        at = next) {
+      while (*pLo < *pHi && pBatch->sorted[*pLo].path[*pEnd] == '\0') {
+         FT_recordBatchHit(pBatch, pBatch->sorted[*pLo].index, NULL);
+         (*pLo)++;
+      }
+
+      /* the paths going on to the next directory are consecutive,
+         the segment matched including its leading '/' */
+      next = FT_nextPrefix(label, labelLen, at);
+      for (lo = *pLo; lo < *pHi; lo++) {
+         path = pBatch->sorted[lo].path + *pEnd;
+         if (strncmp(path, label + at, next - at) == 0 &&
+             (path[next - at] == '\0' || path[next - at] == '/'))
+            break;
+      }
+      for (*pLo = lo; lo < *pHi; lo++) {
+         path = pBatch->sorted[lo].path + *pEnd;
+         if (strncmp(path, label + at, next - at) != 0 ||
+             (path[next - at] != '\0' && path[next - at] != '/'))
+            break;
+      }
+      *pHi = lo;
+      *pEnd += next - at;
+   }
+}
+
+
+/* The number of levels FT_resolveBatch holds before it allocates
+   any. */
+enum { FT_BATCH_LEVELS = 32 };
+
+
+/*
+   A NodeDir FT_resolveBatch has entered and not yet left: the sweep
+   over its children, the length of its path, and the sorted paths
+   below it not yet resolved, lo through hi - 1.
+*/
+struct FT_batchLevel {
+   struct FT_sweep sweep;
+   size_t end;
+   size_t lo;
+   size_t hi;
+};
+
+
+/*
+   The NodeDirs FT_resolveBatch is inside of, kept on a stack of its
+   own rather than on the C stack, as a NodeDir_walk keeps them, so
+   that paths of any depth can be resolved. The stack is held in
+   fixed until it goes deeper than FT_BATCH_LEVELS.
+*/
+struct FT_batchStack {
+   /* the levels, from the root down; only the first depth of
+      maxDepth are in use */
+   struct FT_batchLevel* levels;
+   size_t depth;
+   size_t maxDepth;
+
+   struct FT_batchLevel fixed[FT_BATCH_LEVELS];
+};
+
+
+/*
+   Pushes a level for NodeDir dir onto *pStack and returns it, or
+   returns NULL if allocation error, in which case *pStack is
+   unchanged. The sorted paths lo through hi - 1 of pBatch are each
+   the path of dir, which is end chars long, or continue it with a
+   '/'. If dir stands for a chain of directories, end is the length
+   of the path of the first of them, and the paths are narrowed to
+   those below the last (see FT_resolveBatchChain). The paths naming
+   dir itself are recorded as found, so the level is left with only
+   those to be split among dir's children.
+*/
+static struct FT_batchLevel* FT_pushBatchLevel(FT_T ft,
+struct FT_batch* pBatch, struct FT_batchStack* pStack, NodeDir dir,
+size_t end, size_t lo, size_t hi) {
+   struct FT_batchLevel* newLevels;
+   struct FT_batchLevel* level;
+   size_t newMax;
+
+   assert(ft != NULL);
+   assert(pBatch != NULL);
+   assert(pStack != NULL);
+   assert(dir != NULL);
+
+   if (pStack->depth == pStack->maxDepth) {
+      newMax = 2 * pStack->maxDepth;
+      if (pStack->levels == pStack->fixed) {
+         newLevels = malloc(newMax * sizeof(struct FT_batchLevel));
+         if (newLevels != NULL)
+            memcpy(newLevels, pStack->fixed, sizeof pStack->fixed);
+      }
+      else
+         newLevels = realloc(pStack->levels,
+                             newMax * sizeof(struct FT_batchLevel));
+      if (newLevels == NULL)
+         return NULL;
+      pStack->levels = newLevels;
+      pStack->maxDepth = newMax;
+   }
+
+   FT_resolveBatchChain(pBatch, dir, &end, &lo, &hi);
+
+   /* dir's own path sorts before every path below it */
+   while (lo < hi && pBatch->sorted[lo].path[end] == '\0') {
+      FT_recordBatchHit(pBatch, pBatch->sorted[lo].index, NULL);
+      lo++;
+   }
+
+   level = &pStack->levels[pStack->depth++];
+   /* a concurrent tree's arrays may change under a sweep, so its
+      children are always looked up on their own */
+   level->sweep.dir = dir;
+   level->sweep.isSweep = ft->epoch == NULL &&
+      (hi - lo) * 4 >= NodeDir_getNumChildDirs(dir) +
+                       NodeDir_getNumChildFiles(dir);
+   level->sweep.nextDir = 0;
+   level->sweep.nextFile = 0;
+   level->end = end;
+   level->lo = lo;
+   level->hi = hi;
+   return level;
+}
+
+
+/*
+   Resolves the sorted paths lo through hi - 1 of pBatch, each of
+   which is the path of NodeDir dir, which is end chars long, or
+   continues it with a '/'. The paths are split among dir's children
+   by their next component, and each child found has the paths
+   below it resolved in turn, so a prefix shared by many paths is
+   only matched once. If dir stands for a chain of directories, end
+   is the length of the path of the first of them. Returns TRUE, or
+   FALSE if allocation error, in which case some of the paths may
+   have been recorded.
+*/
+static boolean FT_resolveBatch(FT_T ft, struct FT_batch* pBatch,
+NodeDir dir, size_t end, size_t lo, size_t hi) {
+   struct FT_batchStack stack;
+   struct FT_batchLevel* top;
+   const char* path;
+   const char* other;
+   NodeDir childDir;
+   NodeFile childFile;
+   size_t start;
+   size_t len;
+   size_t next;
+   size_t i;
+   boolean isDone = TRUE;
+
+   assert(ft != NULL);
+   assert(pBatch != NULL);
+   assert(dir != NULL);
+
+   stack.levels = stack.fixed;
+   stack.depth = 0;
+   stack.maxDepth = FT_BATCH_LEVELS;
+   (void) FT_pushBatchLevel(ft, pBatch, &stack, dir, end, lo, hi);
+
+   while (stack.depth > 0) {
+      top = &stack.levels[stack.depth - 1];
+      if (top->lo == top->hi) {
+         stack.depth--;
+         continue;
+      }
+
+      start = top->end + 1;
+      path = pBatch->sorted[top->lo].path;
+      len = FT_componentLength(path, start);
+
+      /* the paths sharing this component are consecutive */
+      for (next = top->lo + 1; next < top->hi; next++) {
+         other = pBatch->sorted[next].path;
+         if (strncmp(path + start, other + start, len) != 0 ||
+             (other[start + len] != '\0' && other[start + len] != '/'))
+            break;
+      }
+      lo = top->lo;
+      top->lo = next;
+
+      childDir = FT_sweepDir(&top->sweep, path + start, len);
+      if (childDir != NULL) {
+         if (FT_pushBatchLevel(ft, pBatch, &stack, childDir,
+                               start + len, lo, next) == NULL) {
+            isDone = FALSE;
+            break;
+         }
+      }
+      else {
+         childFile = FT_sweepFile(&top->sweep, path + start, len);
+         if (childFile != NULL)
+            for (i = lo; i < next; i++)
+               if (pBatch->sorted[i].path[start + len] == '\0')
+                  FT_recordBatchHit(pBatch, pBatch->sorted[i].index,
+                                    childFile);
+      }
+   }
+
+   if (stack.levels != stack.fixed)
+      free(stack.levels);
+   return isDone;
+}
+
+
+/*
+   Resolves the sorted paths of pBatch, of which there are count,
+   from the root of ft. Paths naming nothing are left as they are.
+   Returns TRUE, or FALSE if allocation error, in which case some of
+   the paths may have been recorded.
+*/
+static boolean FT_resolveBatchFromRoot(FT_T ft,
+struct FT_batch* pBatch, size_t count) {
+   NodeDir rootDir;
+   NodeFile rootFile;
+   const char* name;
+   const char* path;
+   size_t nameLen;
+   size_t lo;
+   size_t hi;
+
+   assert(ft != NULL);
+   assert(pBatch != NULL);
+
+   rootFile = FT_getRootFile(ft);
+   rootDir = FT_getRootDir(ft);
+   if (rootFile != NULL)
+      name = NodeFile_getName(rootFile);
+   else if (rootDir != NULL)
+      name = NodeDir_getName(rootDir);
+   else
+      return TRUE;
+   nameLen = strlen(name);
+
+   /* the paths in the root are consecutive */
+   for (lo = 0; lo < count; lo++) {
+      path = pBatch->sorted[lo].path;
+      if (strncmp(path, name, nameLen) == 0 &&
+          (path[nameLen] == '\0' || path[nameLen] == '/'))
+         break;
+   }
+   for (hi = lo; hi < count; hi++) {
+      path = pBatch->sorted[hi].path;
+      if (strncmp(path, name, nameLen) != 0 ||
+          (path[nameLen] != '\0' && path[nameLen] != '/'))
+         break;
+   }
+
+   if (rootDir != NULL)
+      return FT_resolveBatch(ft, pBatch, rootDir, nameLen, lo, hi);
+   for (; lo < hi; lo++)
+      if (pBatch->sorted[lo].path[nameLen] == '\0')
+         FT_recordBatchHit(pBatch, pBatch->sorted[lo].index, rootFile);
+   return TRUE;
+}
+
+
+/*
+   Looks up the count paths of pBatch in ft, recording the outcome
+   for each one. Returns SUCCESS, INITIALIZATION_ERROR, or
+   MEMORY_ERROR, in which case nothing is recorded.
+*/
+static int FT_lookupBatch(FT_T ft, struct FT_batch* pBatch,
+size_t count) {
+   struct FT_batchEntry* sorted;
+   boolean isSorted = TRUE;
+   boolean isResolved;
+   boolean isFile;
+   void* contents;
+   size_t length;
+   size_t ticket;
+   size_t i;
+
+   assert(ft != NULL);
+   assert(pBatch != NULL);
+
+   if (!ft->isInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* a snapshot is searched one path at a time */
+   if (ft->isFrozen) {
+      for (i = 0; i < count; i++)
+         if (Snapshot_lookup(ft->snapshot, pBatch->paths[i], &isFile,
+                             &contents, &length) == SUCCESS) {
+            if (pBatch->found != NULL)
+               pBatch->found[i] = isFile;
+            else {
+               pBatch->results[i] = SUCCESS;
+               pBatch->types[i] = isFile;
+               if (isFile)
+                  pBatch->lengths[i] = length;
+            }
+         }
+      return SUCCESS;
+   }
+   if (count == 0)
+      return SUCCESS;
+
+   /* the paths are sorted in a copy that remembers where each came
+      from, so the client's array is left as it is and the outcomes
+      go back in its order */
+   if (count > (size_t) -1 / sizeof(struct FT_batchEntry))
+      return MEMORY_ERROR;
+   sorted = malloc(count * sizeof(struct FT_batchEntry));
+   if (sorted == NULL)
+      return MEMORY_ERROR;
+   for (i = 0; i < count; i++) {
+      assert(pBatch->paths[i] != NULL);
+      sorted[i].path = pBatch->paths[i];
+      sorted[i].index = i;
+      if (i > 0 && isSorted &&
+          FT_comparePaths(pBatch->paths[i - 1], pBatch->paths[i]) > 0)
+         isSorted = FALSE;
+   }
+   if (!isSorted)
+      FT_sortBatch(sorted, count, 0);
+   pBatch->sorted = sorted;
+
+   ticket = FT_beginRead(ft);
+   isResolved = FT_resolveBatchFromRoot(ft, pBatch, count);
+   FT_endRead(ft, ticket);
+
+   free(sorted);
+   if (isResolved)
+      return SUCCESS;
+   /* what was recorded before the failure is taken back */
+   if (pBatch->found != NULL)
+      for (i = 0; i < count; i++)
+         pBatch->found[i] = FALSE;
+   return MEMORY_ERROR;
+}
+
+
+/* see ft.h for specification */
+int FT_T_containsFileBatch(FT_T ft, char **paths, size_t count,
+                           boolean *found) {
+   struct FT_batch batch;
+   size_t i;
+
+   assert(ft != NULL);
+   assert(paths != NULL || count == 0);
+   assert(found != NULL || count == 0);
+
+   for (i = 0; i < count; i++)
+      found[i] = FALSE;
+
+   batch.paths = paths;
+   batch.sorted = NULL;
+   batch.found = found;
+   batch.results = NULL;
+   batch.types = NULL;
+   batch.lengths = NULL;
+   return FT_lookupBatch(ft, &batch, count);
+}
+
+
+/* see ft.h for specification */
+int FT_T_statBatch(FT_T ft, char **paths, size_t count, int *results,
+                   boolean *types, size_t *lengths) {
+   struct FT_batch batch;
+   size_t i;
+   int result;
+
+   assert(ft != NULL);
+   assert(paths != NULL || count == 0);
+   assert(results != NULL || count == 0);
+   assert(types != NULL || count == 0);
+   assert(lengths != NULL || count == 0);
+
+   batch.paths = paths;
+   batch.sorted = NULL;
+   batch.found = NULL;
+   batch.results = results;
+   batch.types = types;
+   batch.lengths = lengths;
+
+   for (i = 0; i < count; i++)
+      results[i] = NO_SUCH_PATH;
+   result = FT_lookupBatch(ft, &batch, count);
+   if (result != SUCCESS)
+      for (i = 0; i < count; i++)
+         results[i] = result;
+   return result;
+}
+
+
+/**********************************************************************/
+/* Batched changes */
+/**********************************************************************/
+
+
+/*
+   The most changes one operation of a batch logs: splitting a chain
+   of directories, unlinking a node and discarding it.
+*/
+enum { FT_CHANGES_PER_OP = 3 };
+
+
+/*
+   Makes room in *pLog for FT_CHANGES_PER_OP more changes, so that
+   logging the next operation's cannot fail. Returns SUCCESS or
+   MEMORY_ERROR.
+*/
+static int FT_reserveChanges(struct FT_batchLog* pLog) {
+   struct FT_change* changes;
+   size_t maxChanges;
+
+   assert(pLog != NULL);
+
+   if (pLog->numChanges + FT_CHANGES_PER_OP <= pLog->maxChanges)
+      return SUCCESS;
+
+   maxChanges = 2 * pLog->maxChanges + FT_CHANGES_PER_OP;
+   if (maxChanges > (size_t) -1 / sizeof(struct FT_change))
+      return MEMORY_ERROR;
+   changes = realloc(pLog->changes,
+                     maxChanges * sizeof(struct FT_change));
+   if (changes == NULL)
+      return MEMORY_ERROR;
+
+   pLog->changes = changes;
+   pLog->maxChanges = maxChanges;
+   return SUCCESS;
+}
+
+
+/*
+   Publishes oldChildren again as the children of pChange's parent of
+   its node's kind, undoing pChange, and retires the array it
+   replaces.
+*/
+static void FT_restoreChildren(FT_T ft, struct FT_change* pChange,
+boolean isDir) {
+   DynArray_T replaced;
+
+   assert(ft != NULL);
+   assert(pChange != NULL);
+
+   if (isDir)
+      NodeDir_restoreChildDirsShared(pChange->parent, pChange->node,
+                                     pChange->kept, &replaced);
+   else
+      NodeDir_restoreChildFilesShared(pChange->parent, pChange->node,
+                                      pChange->kept, &replaced);
+   FT_retireArray(ft, replaced);
+}
+
+
+/*
+   Undoes *pChange, which is the last change to ft not yet undone.
+   Allocates no memory, so it cannot fail.
+*/
+static void FT_undoChange(FT_T ft, struct FT_change* pChange) {
+   Blob_T replacedBlob;
+
+   assert(ft != NULL);
+   assert(ft->log == NULL);
+   assert(pChange != NULL);
+
+   switch (pChange->kind) {
+   case FT_CHANGE_ATTACH_DIR:
+      if (pChange->parent == NULL)
+         FT_setRootDir(ft, NULL);
+      else if (pChange->kept != NULL)
+         FT_restoreChildren(ft, pChange, TRUE);
+      else
+         (void) NodeDir_unlinkChildDir(pChange->parent, pChange->node);
+      FT_discardDir(ft, pChange->node);
+      break;
+
+   case FT_CHANGE_ATTACH_FILE:
+      if (pChange->parent == NULL)
+         FT_setRootFile(ft, NULL);
+      else if (pChange->kept != NULL)
+         FT_restoreChildren(ft, pChange, FALSE);
+      else
+         (void) NodeDir_unlinkChildFile(pChange->parent,
+                                        pChange->node);
+      FT_discardFile(ft, pChange->node);
+      break;
+
+   case FT_CHANGE_DETACH_DIR:
+      if (pChange->kept != NULL)
+         FT_restoreChildren(ft, pChange, TRUE);
+      else
+         NodeDir_relinkChildDir(pChange->parent, pChange->node);
+      break;
+
+   case FT_CHANGE_DETACH_FILE:
+      if (pChange->kept != NULL)
+         FT_restoreChildren(ft, pChange, FALSE);
+      else
+         NodeDir_relinkChildFile(pChange->parent, pChange->node);
+      break;
+
+   /* a discarded node other than the root is relinked by undoing
+      its detachment */
+   case FT_CHANGE_DISCARD_DIR:
+      if (pChange->parent == NULL)
+         FT_setRootDir(ft, pChange->node);
+      break;
+
+   case FT_CHANGE_DISCARD_FILE:
+      if (pChange->parent == NULL)
+         FT_setRootFile(ft, pChange->node);
+      break;
+
+   /* the node takes a new reference to the Blob_T restored, in
+      place of the logged one */
+   case FT_CHANGE_REPLACE:
+      (void) NodeFile_replaceContents(pChange->node, pChange->contents,
+                                      pChange->length, pChange->blob,
+                                      &replacedBlob);
+      if (pChange->blob != NULL)
+         Blob_release(pChange->blob);
+      FT_dropBlob(ft, replacedBlob);
+      break;
+
+   case FT_CHANGE_SPLIT:
+      NodeDir_joinChain(pChange->node);
+      break;
+
+   default:
+      assert(FALSE);
+   }
+}
+
+
+/*
+   Finishes the changes logged in *pLog, which are to stay: the nodes
+   they discarded, and the arrays of children they replaced, are
+   freed, and the Blob_Ts of the contents they replaced dropped, at
+   last.
+*/
+static void FT_commitChanges(FT_T ft, struct FT_batchLog* pLog) {
+   struct FT_change* change;
+   size_t i;
+
+   assert(ft != NULL);
+   assert(ft->log == NULL);
+   assert(pLog != NULL);
+
+   for (i = 0; i < pLog->numChanges; i++) {
+      change = &pLog->changes[i];
+      if (change->kept != NULL)
+         FT_retireArray(ft, change->kept);
+      if (change->kind == FT_CHANGE_DISCARD_DIR)
+         FT_discardDir(ft, change->node);
+      else if (change->kind == FT_CHANGE_DISCARD_FILE)
+         FT_discardFile(ft, change->node);
+      else if (change->kind == FT_CHANGE_REPLACE)
+         FT_dropBlob(ft, change->blob);
+   }
+}
+
+
+/*
+   Makes the change *pOp to ft, as FT_T_applyBatch does. Returns
+   SUCCESS or the status of the failure.
+*/
+static int FT_applyOp(FT_T ft, struct FT_Op* pOp) {
+   assert(ft != NULL);
+   assert(pOp != NULL);
+   assert(pOp->path != NULL);
+
+   switch (pOp->kind) {
+   case FT_INSERT_DIR:
+      return FT_insertDirLocked(ft, pOp->path);
+   case FT_INSERT_FILE:
+      return FT_insertFileLocked(ft, pOp->path, pOp->contents,
+                                 pOp->length, NULL);
+   case FT_RM_DIR:
+      return FT_rmDirLocked(ft, pOp->path);
+   case FT_RM_FILE:
+      return FT_rmFileLocked(ft, pOp->path);
+   case FT_REPLACE_CONTENTS:
+      return FT_replaceFileLocked(ft, pOp->path, pOp->contents,
+                                  pOp->length, NULL,
+                                  &pOp->oldContents);
+   default:
+      assert(FALSE);
+      return PARENT_CHILD_ERROR;
+   }
+}
+
+
+/*
+   Does the work of FT_T_applyBatch, which ft's writers are
+   serialized around. Each change is logged as it is made, so that
+   if one fails, those before it are undone, last first, leaving the
+   hierarchy as it was without having to copy or rebuild it.
+*/
+static int FT_applyBatchLocked(FT_T ft, struct FT_Op* ops,
+size_t count, size_t* pFailed) {
+   struct FT_batchLog log;
+   size_t i;
+   int result = SUCCESS;
+
+   assert(ft != NULL);
+
+   log.changes = NULL;
+   log.numChanges = 0;
+   log.maxChanges = 0;
+   log.lastDir = NULL;
+   log.lastPath = NULL;
+   log.lastEnd = 0;
+
+   ft->log = &log;
+   for (i = 0; i < count; i++) {
+      result = FT_reserveChanges(&log);
+      if (result == SUCCESS)
+         result = FT_applyOp(ft, &ops[i]);
+      if (result != SUCCESS)
+         break;
+   }
+   ft->log = NULL;
+
+   if (result == SUCCESS)
+      FT_commitChanges(ft, &log);
+   else {
+      if (pFailed != NULL)
+         *pFailed = i;
+      while (log.numChanges > 0)
+         FT_undoChange(ft, &log.changes[--log.numChanges]);
+   }
+
+   free(log.changes);
+   return result;
+}
+
+
+/* see ft.h for specification */
+int FT_T_applyBatch(FT_T ft, struct FT_Op *ops, size_t count,
+                    size_t *pFailed) {
+   int result;
+
+   assert(ft != NULL);
+   assert(ops != NULL || count == 0);
+
+   if (!ft->isInitialized)
+      return INITIALIZATION_ERROR;
+
+   STATS_BEGIN();
+   FT_beginWrite(ft);
+   result = FT_endWrite(ft, FT_applyBatchLocked(ft, ops, count,
+                                                pFailed));
+   return STATS_END(STATS_BATCH, NULL, result);
+}
+
+
+/**********************************************************************/
+/* The default File Tree */
+/**********************************************************************/
+
+
+/* see ft.h for specification */
+int FT_init(void) {
+    if (defaultTree.isInitialized) return INITIALIZATION_ERROR;
+
+    return FT_initTree(&defaultTree);
+}
+
+
+/* see ft.h for specification */
+int FT_destroy(void) {
+    if (!defaultTree.isInitialized) return INITIALIZATION_ERROR;
+
+    FT_clearTree(&defaultTree);
+    Store_free(defaultTree.store);
+    defaultTree.store = NULL;
+    return SUCCESS;
+}
+
+
+/* see ft.h for specification */
+int FT_save(char *filename) {
+    return FT_T_save(&defaultTree, filename);
+}
+
+
+/* see ft.h for specification */
+int FT_load(char *filename) {
+    int result;
+
+    if (defaultTree.isInitialized) return INITIALIZATION_ERROR;
+
+    result = FT_initTree(&defaultTree);
+    if (result != SUCCESS)
+        return result;
+
+    result = FT_T_load(&defaultTree, filename);
+    if (result != SUCCESS)
+        FT_clearTree(&defaultTree);
+    return result;
+}
+
+
+/* see ft.h for specification */
+int FT_bulkLoad(struct FT_Record *records, size_t count) {
+    return FT_T_bulkLoad(&defaultTree, records, count);
+}
+
+
+/* see ft.h for specification */
+int FT_insertDir(char *path) {
+    return FT_T_insertDir(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+boolean FT_containsDir(char *path) {
+    return FT_T_containsDir(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+int FT_rmDir(char *path) {
+    return FT_T_rmDir(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+int FT_insertFile(char *path, void *contents, size_t length) {
+    return FT_T_insertFile(&defaultTree, path, contents, length);
+}
+
+
+/* see ft.h for specification */
+boolean FT_containsFile(char *path) {
+    return FT_T_containsFile(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+int FT_rmFile(char *path) {
+    return FT_T_rmFile(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+int FT_move(char *srcPath, char *dstPath) {
+    return FT_T_move(&defaultTree, srcPath, dstPath);
+}
+
+
+/* see ft.h for specification */
+int FT_flushRemoved(void) {
+    return FT_T_flushRemoved(&defaultTree);
+}
+
+
+/* see ft.h for specification */
+void *FT_getFileContents(char *path) {
+    return FT_T_getFileContents(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+void *FT_replaceFileContents(char *path, void *newContents,
+                             size_t newLength) {
+    return FT_T_replaceFileContents(&defaultTree, path, newContents,
+                                    newLength);
+}
+
+
+/* see ft.h for specification */
+int FT_insertFileOwned(char *path, void *contents, size_t length) {
+    return FT_T_insertFileOwned(&defaultTree, path, contents, length);
+}
+
+
+/* see ft.h for specification */
+int FT_insertFileBlob(char *path, Blob_T blob) {
+    return FT_T_insertFileBlob(&defaultTree, path, blob);
+}
+
+
+/* see ft.h for specification */
+Blob_T FT_getFileBlob(char *path) {
+    return FT_T_getFileBlob(&defaultTree, path);
+}
+
+
+/* see ft.h for specification */
+int FT_replaceFileOwned(char *path, void *newContents,
+                        size_t newLength, void **pOldContents) {
+    return FT_T_replaceFileOwned(&defaultTree, path, newContents,
+                                 newLength, pOldContents);
+}
+
+
+/* see ft.h for specification */
+int FT_replaceFileBlob(char *path, Blob_T blob, void **pOldContents) {
+    return FT_T_replaceFileBlob(&defaultTree, path, blob,
+                                pOldContents);
+}
+
+
+/* see ft.h for specification */
+int FT_enableDedup(void) {
+    return FT_T_enableDedup(&defaultTree);
+}
+
+
+/* see ft.h for specification */
+int FT_getDedupStats(struct FT_DedupStats *pStats) {
+    return FT_T_getDedupStats(&defaultTree, pStats);
+}
+
+
+/* see ft.h for specification */
+int FT_enableCompression(void) {
+    return FT_T_enableCompression(&defaultTree);
+}
+
+
+/* see ft.h for specification */
+void FT_getNameStats(struct FT_NameStats *pStats) {
+    struct Names_stats stats;
+
+    assert(pStats != NULL);
+
+    Names_getStats(&stats);
+    pStats->names = stats.numNames;
+    pStats->nameBytes = stats.numBytes;
+    pStats->references = stats.numRefs;
+    pStats->referencedBytes = stats.numRefBytes;
+}
+
+
+/* see ft.h for specification */
+int FT_stat(char *path, boolean* type, size_t* length) {
+    return FT_T_stat(&defaultTree, path, type, length);
+}
+
+
+/* see ft.h for specification */
+int FT_statDir(char *path, size_t *dirs, size_t *files,
+               size_t *bytes) {
+    return FT_T_statDir(&defaultTree, path, dirs, files, bytes);
+}
+
+
+/* see ft.h for specification */
+int FT_applyBatch(struct FT_Op *ops, size_t count, size_t *pFailed) {
+    return FT_T_applyBatch(&defaultTree, ops, count, pFailed);
+}
+
+
+/* see ft.h for specification */
+int FT_containsFileBatch(char **paths, size_t count, boolean *found) {
+    return FT_T_containsFileBatch(&defaultTree, paths, count, found);
+}
+
+
+/* see ft.h for specification */
+int FT_statBatch(char **paths, size_t count, int *results,
+                 boolean *types, size_t *lengths) {
+    return FT_T_statBatch(&defaultTree, paths, count, results, types,
+                          lengths);
+}
+
+
+/* see ft.h for specification */
+boolean FT_getStats(struct Stats_report *pReport) {
+    assert(pReport != NULL);
+
+    Stats_getReport(pReport);
+#ifdef FT_STATS
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+
+/* see ft.h for specification */
+void FT_resetStats(void) {
+    Stats_reset();
+}
+
+
+/* see ft.h for specification */
+void FT_setTraceHook(Stats_hook hook, void *pvExtra) {
+    Stats_setHook(hook, pvExtra);
+}
+
+
+/* see ft.h for specification */
+char *FT_toString() {
+    return FT_T_toString(&defaultTree);
+}
+
+
+/* see ft.h for specification */
+int FT_toCallback(
+void (*pfApply)(const char* line, size_t length, void* pvExtra),
+void* pvExtra) {
+    return FT_T_toCallback(&defaultTree, pfApply, pvExtra);
+}
+
+
+/* see ft.h for specification */
+int FT_toFile(FILE* stream) {
+    return FT_T_toFile(&defaultTree, stream);
+}
+
+
+/* see ft.h for specification */
+int FT_walk(char *path,
+            int (*pfVisit)(const char *path, boolean isFile,
+                           size_t length, void *pvExtra),
+            void *pvExtra) {
+    return FT_T_walk(&defaultTree, path, pfVisit, pvExtra);
+}
+
+
+/* see ft.h for specification */
+FT_Cursor_T FT_Cursor_new(char *path) {
+    return FT_T_newCursor(&defaultTree, path);
+}
@@ -13,7 +13,10 @@
 */
 
 #include <stddef.h>
+#include <stdio.h>
 #include "a4def.h"
+#include "blob.h"
+#include "stats.h"
 
 
 /*
@@ -39,9 +42,21 @@ boolean FT_containsDir(char *path);
   Returns INITIALIZATION_ERROR if not in an initialized state.
   Returns NOT_A_DIRECTORY if path exists but is a file not a directory.
   Returns NO_SUCH_PATH if the path does not exist in the hierarchy.
+  The hierarchy is unlinked in time proportional to the depth of path,
+  however large it is. Its nodes are then freed a few at a time at the
+  end of each later change to the tree, or all at once by
+  FT_flushRemoved.
 */
 int FT_rmDir(char *path);
 
+/*
+  Frees every node of the hierarchies removed by FT_rmDir that has
+  not been freed yet.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state.
+*/
+int FT_flushRemoved(void);
+
 /*
    Inserts a new file into the hierarchy at the given path, with the
    given contents of size length. The path's parent must exist as
@@ -71,6 +86,30 @@ boolean FT_containsFile(char *path);
 */
 int FT_rmFile(char *path);
 
+/*
+  Moves the directory or file at srcPath, with everything below it,
+  to dstPath, whose last component becomes its name. The directory
+  dstPath goes in must already exist; it may be the one srcPath is in,
+  which renames srcPath in place. If srcPath is the root, dstPath may
+  also be a single component, which renames the root.
+  Returns SUCCESS if moved.
+  Returns INITIALIZATION_ERROR if not in an initialized state.
+  Returns NO_SUCH_PATH if srcPath does not exist in the hierarchy, or
+  if the directory dstPath would go in does not.
+  Returns ALREADY_IN_TREE if dstPath already exists (as dir or file).
+  Returns PARENT_CHILD_ERROR if dstPath is below srcPath, or is not a
+  valid path.
+  Returns NOT_A_DIRECTORY if a prefix of dstPath is a file.
+  Returns CONFLICTING_PATH if dstPath is not underneath the existing
+  root and does not rename it.
+  Returns MEMORY_ERROR if unable to allocate sufficient memory, in
+  which case nothing has moved.
+  Paths are not stored in the nodes, so only the node at srcPath is
+  relinked, and the move takes time proportional to the depths of
+  srcPath and dstPath however large the hierarchy below it is.
+*/
+int FT_move(char *srcPath, char *dstPath);
+
 /*
   Returns the contents of the file at the full path parameter.
   Returns NULL if the path does not exist or is a directory.
@@ -85,10 +124,154 @@ void *FT_getFileContents(char *path);
   the parameter newContents of size newLength.
   Returns the old contents if successful.
   Returns NULL if the path does not already exist or is a directory.
+  Also returns NULL if the old contents were held by the tree, as
+  those inserted by FT_insertFileOwned or FT_insertFileBlob are:
+  the tree then lets go of them itself.
 */
 void *FT_replaceFileContents(char *path, void *newContents,
                              size_t newLength);
 
+/*
+  The contents of a file are borrowed from the client, who keeps them
+  alive and frees them, if they are inserted by FT_insertFile or
+  FT_replaceFileContents; they are held by the tree if they are
+  inserted by the functions below. Contents the tree holds are kept
+  in a Blob_T (see blob.h), which any number of files, and clients,
+  may share by reference without copying; the tree frees them once
+  no file holds them and the client holds no reference to them.
+*/
+
+/*
+  Inserts a new file as FT_insertFile does, but hands contents, of
+  size length, over to the tree, which frees them with free when the
+  file no longer needs them. contents must be NULL or have been
+  allocated with malloc, and must not be changed afterwards.
+  Returns what FT_insertFile would; on failure contents stay the
+  client's.
+*/
+int FT_insertFileOwned(char *path, void *contents, size_t length);
+
+/*
+  Inserts a new file as FT_insertFile does, with the contents held in
+  blob, to which the file takes a reference of its own; the client's
+  stays the client's. Returns what FT_insertFile would.
+*/
+int FT_insertFileBlob(char *path, Blob_T blob);
+
+/*
+  Returns a new reference to a Blob_T holding the contents of the
+  file at the full path parameter, which the client releases with
+  Blob_release. Contents the tree holds are not copied, so files
+  sharing a Blob_T hand out references to it; contents borrowed from
+  the client are copied into a new Blob_T.
+  Returns NULL if the path does not exist or is a directory, or if
+  unable to allocate sufficient memory.
+*/
+Blob_T FT_getFileBlob(char *path);
+
+/*
+  Replaces the contents of the file at path as FT_replaceFileContents
+  does, but hands newContents, of size newLength, over to the tree as
+  FT_insertFileOwned does. If pOldContents is not NULL, *pOldContents
+  is set as FT_replaceFileContents would return it.
+  Returns SUCCESS if the contents are replaced,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns NO_SUCH_PATH if the path does not exist,
+  returns NOT_A_FILE if the path is a directory,
+  returns MEMORY_ERROR if unable to allocate sufficient memory,
+  in which case newContents stay the client's.
+*/
+int FT_replaceFileOwned(char *path, void *newContents,
+                        size_t newLength, void **pOldContents);
+
+/*
+  Replaces the contents of the file at path with those held in blob,
+  to which the file takes a reference of its own, and otherwise
+  behaves as FT_replaceFileOwned does.
+*/
+int FT_replaceFileBlob(char *path, Blob_T blob, void **pOldContents);
+
+/*
+  Makes the tree deduplicate file contents from now on: contents
+  inserted by FT_insertFile, FT_replaceFileContents, their Owned and
+  Blob forms and FT_applyBatch are looked up by a hash of their bytes
+  in a store of the distinct contents the tree holds, and verified
+  byte by byte, and a file whose contents are already there shares
+  them rather than keeping another copy. Contents not found are
+  copied, if borrowed, into the store, so every file inserted or
+  changed this way holds its contents (which the client may then
+  free), and FT_replaceFileContents returns NULL for them; contents
+  passed in must then be readable for their whole length. Files
+  already in the tree, and those loaded in bulk or from a snapshot,
+  are not deduplicated. Does nothing if the tree already
+  deduplicates.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns MEMORY_ERROR if unable to allocate sufficient memory.
+*/
+int FT_enableDedup(void);
+
+/* Counts describing a tree's deduplication, from FT_getDedupStats. */
+struct FT_DedupStats {
+   /* the distinct contents stored, and their total size */
+   size_t payloads;
+   size_t payloadBytes;
+   /* the references files and clients hold to them, and the total
+      size those would take if each were a copy */
+   size_t references;
+   size_t referencedBytes;
+   /* the contents brought in that were found in the store, and
+      those that were not */
+   size_t hits;
+   size_t misses;
+};
+
+/*
+  Fills in *pStats for the tree, with every count 0 if it does not
+  deduplicate. Contents no file or client holds any more are let go
+  of first, so they are not counted.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state.
+*/
+int FT_getDedupStats(struct FT_DedupStats *pStats);
+
+/* Counts describing the names of nodes, from FT_getNameStats. */
+struct FT_NameStats {
+   /* the distinct names stored, and their total length */
+   size_t names;
+   size_t nameBytes;
+   /* the references to them, a tree holding one to each of its
+      names however many of its nodes bear it, and the total length
+      the names would take if each were a copy */
+   size_t references;
+   size_t referencedBytes;
+};
+
+/*
+  Fills in *pStats for the names of the nodes of every tree, which
+  share one pool, however many trees there are. The names of nodes
+  removed but not yet freed are counted too, as may be those a tree's
+  nodes no longer bear, which it lets go of when next it needs room
+  for more.
+*/
+void FT_getNameStats(struct FT_NameStats *pStats);
+
+/*
+  Makes the tree compress chains of directories from now on: the
+  directories one insertion creates are kept in a single node, which
+  spares the memory and lookup steps of all but one of them, and
+  which is split in two when a directory inside it is removed or
+  given another child. The tree otherwise behaves exactly as before.
+  Directories already in the tree, and those loaded in bulk or from a
+  snapshot, are not compressed, and a snapshot holds each directory
+  on its own. Does nothing if the tree already compresses, or if it
+  is a File Tree from FT_newConcurrent, whose readers could not
+  follow a split.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state.
+*/
+int FT_enableCompression(void);
+
 /*
   Returns SUCCESS if path exists in the hierarchy,
   returns NO_SUCH_PATH if it does not, and
@@ -103,10 +286,117 @@ void *FT_replaceFileContents(char *path, void *newContents,
  */
 int FT_stat(char *path, boolean* type, size_t* length);
 
+/*
+  Returns SUCCESS if path is a directory in the hierarchy, and sets
+  *dirs to the number of directories in the hierarchy rooted at it
+  (path itself included), *files to the number of files in it, and
+  *bytes to the total length of their contents,
+  returns NOT_A_DIRECTORY if path is a file,
+  returns NO_SUCH_PATH if it does not exist, and
+  returns INITIALIZATION_ERROR if the structure is not initialized.
+  Every directory keeps these totals as the hierarchy changes, so
+  this takes time proportional to the depth of path rather than the
+  size of its hierarchy. When returning a non-SUCCESS status, *dirs,
+  *files and *bytes are unchanged.
+*/
+int FT_statDir(char *path, size_t *dirs, size_t *files, size_t *bytes);
+
+/*
+  Fills in *pReport with the totals of every operation run on any
+  File Tree so far: the calls, the time they took, a histogram of
+  their latencies, and the nodes visited, names compared, allocations
+  made and array elements shifted (see stats.h). Operations that
+  find, insert, remove, replace or stat a single path, FT_toString
+  and FT_applyBatch are counted; the others, and operations that
+  fail for want of initialization, are not.
+  Returns TRUE, or FALSE, with every total 0, if FT was built without
+  FT_STATS defined, in which case it keeps no totals and costs
+  nothing.
+*/
+boolean FT_getStats(struct Stats_report *pReport);
+
+/*
+  Sets the totals FT_getStats reports back to zero.
+*/
+void FT_resetStats(void);
+
+/*
+  Makes FT call hook, if not NULL, with each counted operation and
+  pvExtra, in the thread that ran it and after it has finished, until
+  another hook is set. The hook must not use any File Tree, and is
+  never called if FT was built without FT_STATS defined. Must not be
+  called while any File Tree is in use.
+*/
+void FT_setTraceHook(Stats_hook hook, void *pvExtra);
+
+/* The kinds of change an FT_Op makes. */
+enum { FT_INSERT_DIR, FT_INSERT_FILE, FT_RM_DIR, FT_RM_FILE,
+       FT_REPLACE_CONTENTS };
+
+/*
+  A change for FT_applyBatch to make: kind is one of the kinds above,
+  path the full path it applies to, and contents, of size length,
+  the contents of the file to insert or the new contents of the file
+  to change. Once the batch is applied, the oldContents of an
+  FT_REPLACE_CONTENTS change are the contents it replaced, which are
+  then owned by the client, or NULL if the tree held them.
+*/
+struct FT_Op {
+   int kind;
+   char *path;
+   void *contents;
+   size_t length;
+   void *oldContents;
+};
+
+/*
+  Makes the count changes in ops, in order, as the matching calls to
+  FT_insertDir, FT_insertFile, FT_rmDir, FT_rmFile and
+  FT_replaceFileContents would, but as one unit: if one fails, the
+  changes made before it are undone, leaving the hierarchy as it
+  was. A change whose path goes through the directory the last one
+  reached finds its path from there rather than from the root.
+  Returns SUCCESS if every change is made,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  otherwise returns the status the first change to fail returned
+    (an FT_REPLACE_CONTENTS change fails with NO_SUCH_PATH or
+    NOT_A_FILE if path is not a file), or MEMORY_ERROR, and sets
+    *pFailed, if pFailed is not NULL, to its index in ops.
+*/
+int FT_applyBatch(struct FT_Op *ops, size_t count, size_t *pFailed);
+
+/*
+  Sets found[i] to whether the tree contains paths[i] as a file, as
+  FT_containsFile would, for each of the count paths, but faster than
+  as many calls: the paths are sorted once, each prefix they share is
+  matched only once, and the siblings sought in a directory are
+  found together. paths is left as it is.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns MEMORY_ERROR if unable to allocate sufficient memory.
+  On failure every found[i] is FALSE.
+*/
+int FT_containsFileBatch(char **paths, size_t count, boolean *found);
+
+/*
+  Sets results[i], types[i] and lengths[i] as
+  FT_stat(paths[i], &types[i], &lengths[i]) would set its return
+  value, *type and *length, for each of the count paths, resolving
+  them together as FT_containsFileBatch does.
+  Returns SUCCESS,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns MEMORY_ERROR if unable to allocate sufficient memory.
+  On failure every results[i] is set to that status, and types and
+  lengths are unchanged.
+*/
+int FT_statBatch(char **paths, size_t count, int *results,
+                 boolean *types, size_t *lengths);
+
 /*
   Sets the data structure to initialized status.
   The data structure is initially empty.
   Returns INITIALIZATION_ERROR if already initialized,
+  MEMORY_ERROR if there is an allocation error,
   and SUCCESS otherwise.
 */
 int FT_init(void);
@@ -119,6 +409,68 @@ int FT_init(void);
 */
 int FT_destroy(void);
 
+/*
+  Saves the hierarchy to the file filename as a snapshot, replacing
+  the file if it exists. A snapshot holds a table of the nodes, a
+  pool of their names and a blob of the files' contents, linked by
+  offsets, so that it can be mapped into memory and used as it is.
+  Returns SUCCESS, INITIALIZATION_ERROR if not in an initialized
+  state, MEMORY_ERROR if unable to allocate sufficient memory, or
+  FILE_ERROR if the file cannot be written.
+*/
+int FT_save(char *filename);
+
+/*
+  Sets the data structure to initialized status holding the hierarchy
+  saved in the snapshot in file filename. The snapshot is mapped into
+  memory rather than read, and lookups (FT_containsDir,
+  FT_containsFile, FT_getFileContents, FT_stat and their batched
+  forms) are answered from it directly; the hierarchy is only built
+  out of nodes, in one pass, by the first other operation, which may
+  then also return MEMORY_ERROR or FILE_ERROR.
+
+  The contents of files loaded from a snapshot are read-only and
+  belong to the data structure: they stay valid until FT_destroy,
+  even if replaced or removed, and must not be freed by the client.
+  Snapshots are only readable on machines like the one that saved
+  them.
+  Returns SUCCESS, INITIALIZATION_ERROR if already initialized,
+  MEMORY_ERROR if unable to allocate sufficient memory, or FILE_ERROR
+  if the file cannot be read or is not a snapshot.
+*/
+int FT_load(char *filename);
+
+/*
+  A file for FT_bulkLoad to insert: its full path, and its contents
+  of size length.
+*/
+struct FT_Record {
+   char *path;
+   void *contents;
+   size_t length;
+};
+
+/*
+  Inserts the count files in records, in any order, into the empty
+  hierarchy, creating the directories above them as needed, as many
+  calls to FT_insertFile would but much faster: the paths are sorted
+  once and the hierarchy is built from them in order, each
+  directory's children being added in their final order with no
+  searching, and the directories shared by consecutive paths being
+  created only once. records is left as it is.
+  Either all the files are inserted or, on failure, none is.
+  Returns SUCCESS if the files are inserted,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns CONFLICTING_PATH if the hierarchy is not empty or the paths
+    do not all share the same root,
+  returns ALREADY_IN_TREE if two records have the same path,
+  returns NOT_A_DIRECTORY if one record's path is a prefix of
+    another's,
+  returns PARENT_CHILD_ERROR if a path is not valid,
+  returns MEMORY_ERROR if unable to allocate sufficient memory.
+*/
+int FT_bulkLoad(struct FT_Record *records, size_t count);
+
 /*
   Returns a string representation of the
   data structure, or NULL if the structure is
@@ -129,4 +481,197 @@ int FT_destroy(void);
 */
 char *FT_toString();
 
+/*
+  Streams the string representation FT_toString would return to
+  *pfApply, one line at a time, without building the whole string:
+  for each directory and file, calls (*pfApply)(line, length, pvExtra)
+  where line holds the path followed by a newline, length counts the
+  newline, and line is not '\0'-terminated or valid after the call.
+  Returns SUCCESS, INITIALIZATION_ERROR if the structure is not
+  initialized, or MEMORY_ERROR if there is an allocation error, in
+  which case only some lines have been passed to *pfApply.
+*/
+int FT_toCallback(
+   void (*pfApply)(const char *line, size_t length, void *pvExtra),
+   void *pvExtra);
+
+/*
+  Writes the string representation FT_toString would return to
+  stream, one line at a time. Returns as FT_toCallback does; write
+  errors are left for the client to detect with ferror(stream).
+*/
+int FT_toFile(FILE *stream);
+
+/*
+  Values a visit function passed to FT_walk returns to steer the walk.
+*/
+enum { FT_WALK_CONTINUE, FT_WALK_PRUNE, FT_WALK_STOP };
+
+/*
+  Visits every directory and file in the hierarchy rooted at path
+  (or the whole hierarchy if path is NULL) in the order FT_toString
+  lists them, calling (*pfVisit)(nodePath, isFile, length, pvExtra)
+  for each. nodePath is the node's full path and is only valid during
+  the call; isFile is TRUE for files, whose contents' length is
+  length, and FALSE for directories, whose length is 0.
+  *pfVisit returns FT_WALK_CONTINUE to go on, FT_WALK_PRUNE to skip
+  the descendants of the directory just visited, or FT_WALK_STOP to
+  end the walk. The hierarchy must not be changed during the walk.
+  Returns SUCCESS if the walk completed or was stopped,
+  returns INITIALIZATION_ERROR if not in an initialized state,
+  returns NO_SUCH_PATH if path does not exist in the hierarchy,
+  returns MEMORY_ERROR if unable to allocate sufficient memory.
+*/
+int FT_walk(char *path,
+            int (*pfVisit)(const char *path, boolean isFile,
+                           size_t length, void *pvExtra),
+            void *pvExtra);
+
+/*
+  An FT_Cursor_T is a resumable walk over the hierarchy that yields
+  the same nodes in the same order as FT_walk, one per call, using
+  memory proportional to the depth of the hierarchy rather than its
+  size. The hierarchy must not be changed while a cursor is in use.
+*/
+typedef struct FT_Cursor *FT_Cursor_T;
+
+/*
+  Returns a new cursor positioned before the node at path (or the
+  root of the hierarchy if path is NULL), or NULL if not in an
+  initialized state, path does not exist, or there is an allocation
+  error. The cursor is owned by the client, who frees it with
+  FT_Cursor_free.
+*/
+FT_Cursor_T FT_Cursor_new(char *path);
+
+/*
+  Advances cursor c to the next node. Returns 1 and sets *pPath,
+  *pIsFile and *pLength as FT_walk passes them to its visit function
+  if there is one (*pPath stays valid until the next call on c),
+  returns 0 if the walk is over, and returns -1 if there is an
+  allocation error, after which c may only be freed.
+*/
+int FT_Cursor_next(FT_Cursor_T c, const char **pPath, boolean *pIsFile,
+                   size_t *pLength);
+
+/*
+  Makes cursor c skip the descendants of the directory it just
+  yielded. Returns TRUE if so, or FALSE (doing nothing) if the last
+  node yielded was not a directory.
+*/
+boolean FT_Cursor_prune(FT_Cursor_T c);
+
+/*
+  Frees cursor c. Does nothing if c is NULL.
+*/
+void FT_Cursor_free(FT_Cursor_T c);
+
+/*
+  An FT_T is an independent File Tree. Any number of them can live in
+  one process, each behaving like the single File Tree above; the
+  FT_* functions without a handle act on a built-in default tree.
+  All FT_Ts share one pool of node names, guarded by one lock, which
+  is taken whenever a tree stores a name it does not already hold.
+  Different threads may still each use their own FT_T at the same
+  time, but those that insert, rename or load may wait briefly for
+  one another on that lock; a tree's other operations, and names it
+  already holds, involve no other tree.
+*/
+typedef struct FT *FT_T;
+
+/*
+  Returns a new File Tree, already initialized and empty, or NULL if
+  there is an allocation error. The File Tree is owned by the client,
+  who frees it with FT_free.
+*/
+FT_T FT_new(void);
+
+/*
+  Returns a new File Tree like FT_new does, except that many threads
+  may use it at once. Lookups (FT_T_containsDir, FT_T_containsFile,
+  FT_T_getFileContents, FT_T_getFileBlob, FT_T_stat, FT_T_statDir,
+  the batched forms, FT_T_toCallback, FT_T_toFile, FT_T_walk and
+  cursors) take no locks and never wait for each other or for
+  changes; changes and FT_T_toString are serialized.
+
+  A lookup, or each path of a batched one, sees each change either
+  wholly or not at all (the changes of a batch being seen one by one,
+  and, if it fails, undone one by one), but a streamed listing or a
+  cursor running during changes may miss or repeat nodes that move
+  under it, and FT_T_statDir may count a change in some of its
+  totals before the others. FT_T_move is the exception: it waits out
+  the lookups and cursors running when it begins before renaming
+  anything, and while it does, lookups find what it moves at neither
+  path.
+  Removed nodes stay allocated until no lookup can be using them, so
+  a cursor may outlive their removal. Callbacks passed to
+  FT_T_toCallback or FT_T_walk, and a thread holding a cursor, must
+  not change the same tree. The borrowed contents of a replaced or
+  removed file are freed by the client as usual, who must make sure
+  no other thread is still using them; contents the tree holds are
+  only let go of once no lookup can be using them, and a Blob_T from
+  FT_T_getFileBlob stays valid however the file changes.
+*/
+FT_T FT_newConcurrent(void);
+
+/*
+  Removes all contents of ft and frees it. Does nothing if ft is NULL.
+  No other thread may be using ft, and no cursor over it may remain.
+*/
+void FT_free(FT_T ft);
+
+/* Each of these behaves as its FT_* counterpart, on File Tree ft. */
+int FT_T_insertDir(FT_T ft, char *path);
+boolean FT_T_containsDir(FT_T ft, char *path);
+int FT_T_rmDir(FT_T ft, char *path);
+int FT_T_insertFile(FT_T ft, char *path, void *contents,
+                    size_t length);
+boolean FT_T_containsFile(FT_T ft, char *path);
+int FT_T_rmFile(FT_T ft, char *path);
+int FT_T_move(FT_T ft, char *srcPath, char *dstPath);
+int FT_T_flushRemoved(FT_T ft);
+void *FT_T_getFileContents(FT_T ft, char *path);
+void *FT_T_replaceFileContents(FT_T ft, char *path,
+                               void *newContents, size_t newLength);
+int FT_T_insertFileOwned(FT_T ft, char *path, void *contents,
+                         size_t length);
+int FT_T_insertFileBlob(FT_T ft, char *path, Blob_T blob);
+Blob_T FT_T_getFileBlob(FT_T ft, char *path);
+int FT_T_replaceFileOwned(FT_T ft, char *path, void *contents,
+                          size_t length, void **pOldContents);
+int FT_T_replaceFileBlob(FT_T ft, char *path, Blob_T blob,
+                         void **pOldContents);
+int FT_T_enableDedup(FT_T ft);
+int FT_T_getDedupStats(FT_T ft, struct FT_DedupStats *pStats);
+int FT_T_enableCompression(FT_T ft);
+int FT_T_stat(FT_T ft, char *path, boolean* type, size_t* length);
+int FT_T_statDir(FT_T ft, char *path, size_t *dirs, size_t *files,
+                 size_t *bytes);
+int FT_T_applyBatch(FT_T ft, struct FT_Op *ops, size_t count,
+                    size_t *pFailed);
+int FT_T_containsFileBatch(FT_T ft, char **paths, size_t count,
+                           boolean *found);
+int FT_T_statBatch(FT_T ft, char **paths, size_t count, int *results,
+                   boolean *types, size_t *lengths);
+char *FT_T_toString(FT_T ft);
+int FT_T_toCallback(FT_T ft,
+   void (*pfApply)(const char *line, size_t length, void *pvExtra),
+   void *pvExtra);
+int FT_T_toFile(FT_T ft, FILE *stream);
+int FT_T_walk(FT_T ft, char *path,
+              int (*pfVisit)(const char *path, boolean isFile,
+                             size_t length, void *pvExtra),
+              void *pvExtra);
+FT_Cursor_T FT_T_newCursor(FT_T ft, char *path);
+int FT_T_bulkLoad(FT_T ft, struct FT_Record *records, size_t count);
+int FT_T_save(FT_T ft, char *filename);
+
+/*
+  Replaces the hierarchy of ft with the one saved in the snapshot in
+  file filename, as FT_load does; on failure ft is unchanged. A
+  concurrent File Tree builds the hierarchy at once. No other thread
+  may be using ft meanwhile.
+*/
+int FT_T_load(FT_T ft, char *filename);
+
 #endif
@@ -0,0 +1,125 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#include "ft.h"
+#include "a4def.h"
+#include "gen.h"
+#include "bench.h"
+
+
+/* The number of times the whole tree is turned into a string. */
+enum { BENCH_TO_STRINGS = 10 };
+
+
+/*
+    Inserts the paths of g into the default tree, which must hold
+    none of them, in order.
+*/
+static void insertAll(Gen_T g) {
+   size_t i;
+   int status;
+
+   for (i = 0; i < Gen_getCount(g); i++) {
+      if (Gen_isFile(g, i))
+         status = FT_insertFile(Gen_getPath(g, i), NULL, 0);
+      else
+         status = FT_insertDir(Gen_getPath(g, i));
+      assert(status == SUCCESS);
+   }
+   (void) status;
+}
+
+
+/*
+    Times each operation of the FT on a tree of the shape given by
+    the options in argv, which are described in gen.h, and writes
+    the results to stdout as described in bench.h. Returns 0, or
+    EXIT_FAILURE if the options are not valid or the tree cannot be
+    generated.
+*/
+int main(int argc, char* argv[]) {
+   struct Gen_shape shape = { 5, 6, 0.25, 8, 1 };
+   Gen_T g;
+   size_t count;
+   size_t i;
+   boolean found;
+   boolean isFile;
+   size_t length;
+   char* string;
+   int status;
+
+   if (!Gen_parseShape(argc, argv, &shape)) {
+      fprintf(stderr, "usage: %s [-d depth] [-w fanout] "
+              "[-f fileRatio] [-l nameLength] [-s seed]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   g = Gen_new(&shape);
+   if (g == NULL) {
+      fprintf(stderr, "%s: cannot generate the tree\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   count = Gen_getCount(g);
+   Gen_printShape(g, stdout);
+   Bench_printHeader();
+
+   status = FT_init();
+   assert(status == SUCCESS);
+   Bench_start();
+   insertAll(g);
+   Bench_stop("ft", "insert", count);
+
+   Bench_start();
+   for (i = 0; i < count; i++) {
+      if (Gen_isFile(g, i))
+         found = FT_containsFile(Gen_getPath(g, i));
+      else
+         found = FT_containsDir(Gen_getPath(g, i));
+      assert(found);
+   }
+   Bench_stop("ft", "contains", count);
+
+   Bench_start();
+   for (i = 0; i < count; i++) {
+      status = FT_stat(Gen_getPath(g, i), &isFile, &length);
+      assert(status == SUCCESS);
+   }
+   Bench_stop("ft", "stat", count);
+
+   Bench_start();
+   for (i = 0; i < BENCH_TO_STRINGS; i++) {
+      string = FT_toString();
+      assert(string != NULL);
+      free(string);
+   }
+   Bench_stop("ft", "toString", BENCH_TO_STRINGS);
+
+   /* children come after their parents, so go from the end */
+   Bench_start();
+   for (i = count; i-- > 0; ) {
+      if (Gen_isFile(g, i))
+         status = FT_rmFile(Gen_getPath(g, i));
+      else
+         status = FT_rmDir(Gen_getPath(g, i));
+      assert(status == SUCCESS);
+   }
+   Bench_stop("ft", "rm", count);
+
+   insertAll(g);
+   Bench_start();
+   status = FT_destroy();
+   assert(status == SUCCESS);
+   Bench_stop("ft", "destroy", 1);
+
+   (void) found;
+   (void) status;
+   Gen_free(g);
+   return 0;
+}
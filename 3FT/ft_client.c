@@ -8,16 +8,100 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "ft.h"
 #include "a4def.h"
+#include "blob.h"
+#include "path.h"
 
 
+/* Appends the length chars of line to the string pvExtra, which must
+   have room for them. Used to check FT_toCallback against
+   FT_toString. */
+static void appendLine(const char *line, size_t length, void *pvExtra) {
+  char *acc = pvExtra;
+  acc += strlen(acc);
+  memcpy(acc, line, length);
+  acc[length] = '\0';
+}
+
+/* Adds the length of line to the count pvExtra. Used to check
+   FT_toCallback against FT_toString where appending would be slow. */
+static void countChars(const char *line, size_t length,
+                       void *pvExtra) {
+  (void) line;
+  *(size_t *) pvExtra += length;
+}
+
+/* Appends path and a newline to the string pvExtra, which must have
+   room for them, pruning below "a/y". Used to check FT_walk against
+   FT_toString. */
+static int appendPath(const char *path, boolean isFile, size_t length,
+                      void *pvExtra) {
+  (void) length;
+  strcat(pvExtra, path);
+  strcat(pvExtra, "\n");
+  if (!isFile && !strcmp(path, "a/y"))
+    return FT_WALK_PRUNE;
+  return FT_WALK_CONTINUE;
+}
+
+/* Counts the directory or file at path in the array of three
+   counts pvExtra, as dirs, files and bytes. Used to check
+   FT_statDir against FT_walk. */
+static int countNode(const char *path, boolean isFile, size_t length,
+                     void *pvExtra) {
+  size_t *counts = pvExtra;
+  (void) path;
+  if (isFile) {
+    counts[1]++;
+    counts[2] += length;
+  }
+  else
+    counts[0]++;
+  return FT_WALK_CONTINUE;
+}
+
+/* Counts the call pCall in the array of two counts pvExtra, as calls
+   and directories searched. Used to check FT_setTraceHook against
+   FT_getStats. */
+static void countCall(const struct Stats_call *pCall, void *pvExtra) {
+  size_t *counts = pvExtra;
+  counts[0]++;
+  counts[1] += pCall->counts[STATS_NODES_VISITED];
+}
+
+/* Set once the writer in the concurrent test is done. */
+static int writerDone;
+
+/* Repeatedly looks up paths in the concurrent File Tree pvTree until
+   the writer is done. "a/keep" is never removed, so it must always be
+   found, whatever the writer is doing around it. */
+static void *readTree(void *pvTree) {
+  FT_T ft = pvTree;
+  char buf[8];
+  int i;
+  boolean isFile;
+  size_t length;
+  while (!__atomic_load_n(&writerDone, __ATOMIC_ACQUIRE)) {
+    assert(FT_T_containsFile(ft, "a/keep") == TRUE);
+    assert(FT_T_stat(ft, "a", &isFile, &length) == SUCCESS);
+    assert(isFile == FALSE);
+    for (i = 0; i < 10; i++) {
+      sprintf(buf, "a/%d/b", i);
+      (void) FT_T_containsDir(ft, buf);
+    }
+  }
+  return NULL;
+}
+
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
 int main(void) {
   char* temp;
+  char* streamed;
   boolean b;
   size_t l;
 
@@ -30,6 +114,7 @@ int main(void) {
   assert(FT_insertFile("a/b/c/D",NULL,0) == INITIALIZATION_ERROR);
   assert(FT_containsDir("a/b/c/D") == FALSE);
   assert((temp = FT_toString()) == NULL);
+  assert(FT_toFile(stderr) == INITIALIZATION_ERROR);
 
   /* After initialization, the data structure is empty, so
      contains* should still return FALSE for any non-NULL string,
@@ -133,6 +218,13 @@ int main(void) {
   assert(FT_insertFile("B",NULL,0) == CONFLICTING_PATH);
   assert(FT_insertDir("a") == CONFLICTING_PATH);
   assert(FT_insertFile("b/B",NULL,0) == CONFLICTING_PATH);
+  /* our addition: the root file itself is already in the tree */
+  assert(FT_insertFile("A",NULL,0) == ALREADY_IN_TREE);
+  assert((temp = FT_toString()) != NULL);
+  assert(!strcmp(temp,"A\n"));
+  free(temp);
+  assert(FT_rmDir("A") == NOT_A_DIRECTORY);
+  assert(FT_containsFile("A/b") == FALSE);
 
   /* file contents work as expected */
   assert(FT_getFileContents("A") == NULL);
@@ -155,6 +247,10 @@ int main(void) {
   assert(FT_stat("a/z", &b, &l) == SUCCESS);
   assert(b == FALSE);
   assert(l == 1000);
+  /* our addition: the root directory can be stat'ed too */
+  assert(FT_stat("a", &b, &l) == SUCCESS);
+  assert(b == FALSE);
+  assert(FT_stat("a/z/q", &b, &l) == NO_SUCH_PATH);
 
   /* children should be printed in lexicographic order,
      depth first, file children before directory children */
@@ -185,10 +281,921 @@ int main(void) {
   assert(FT_insertDir("a/y/CHILD2DIR/CHILD4DIR") == SUCCESS);
   assert((temp = FT_toString()) != NULL);
   fprintf(stderr, "%s\n", temp);
+
+  /* our addition: streaming produces exactly toString's text */
+  assert((streamed = calloc(strlen(temp) + 1, 1)) != NULL);
+  assert(FT_toCallback(appendLine, streamed) == SUCCESS);
+  assert(!strcmp(streamed, temp));
+
+  /* our addition: walking yields toString's paths, minus pruned
+     subtrees, and cursors yield the same nodes one at a time */
+  *streamed = '\0';
+  assert(FT_walk("a/y", appendPath, streamed) == SUCCESS);
+  assert(!strcmp(streamed, "a/y\n"));
+  *streamed = '\0';
+  assert(FT_walk(NULL, appendPath, streamed) == SUCCESS);
+  assert(strlen(streamed) < strlen(temp));
+  assert(!strncmp(streamed, temp, strlen("a\na/x\na/x/B\n")));
+  assert(FT_walk("a/nope", appendPath, streamed) == NO_SUCH_PATH);
+  {
+    FT_Cursor_T c;
+    const char *p;
+    size_t n = 0;
+    assert((c = FT_Cursor_new("a/x")) != NULL);
+    while (FT_Cursor_next(c, &p, &b, &l) == 1) {
+      assert(n != 0 || (!strcmp(p, "a/x") && b == FALSE));
+      assert(n != 1 || (!strcmp(p, "a/x/B") && b == TRUE && l == 9));
+      assert(n != 2 || (!strcmp(p, "a/x/C") && b == TRUE && l == 8));
+      n++;
+    }
+    assert(n == 3);
+    assert(FT_Cursor_prune(c) == FALSE);
+    FT_Cursor_free(c);
+  }
+  free(streamed);
   free(temp);
 
+  /* our addition: separate trees are independent of the default
+     one and of each other */
+  {
+    FT_T t1, t2;
+    assert((t1 = FT_new()) != NULL);
+    assert((t2 = FT_new()) != NULL);
+    assert(FT_T_insertFile(t1, "a/x/C", "Kernighan", 10) == SUCCESS);
+    assert(FT_T_insertDir(t2, "b/c") == SUCCESS);
+    assert(FT_T_containsFile(t1, "a/x/C") == TRUE);
+    assert(!strcmp(FT_T_getFileContents(t1, "a/x/C"), "Kernighan"));
+    assert(!strcmp(FT_getFileContents("a/x/C"), "Ritchie"));
+    assert(FT_T_containsDir(t2, "a") == FALSE);
+    assert(FT_containsDir("b") == FALSE);
+    assert(FT_T_rmDir(t1, "a") == SUCCESS);
+    assert((temp = FT_T_toString(t1)) != NULL);
+    assert(!strcmp(temp, ""));
+    free(temp);
+    assert((temp = FT_T_toString(t2)) != NULL);
+    assert(!strcmp(temp, "b\nb/c\n"));
+    free(temp);
+    FT_free(t1);
+    FT_free(t2);
+  }
+
+  /* a directory wide enough that its children outgrow the arena's
+     small blocks still keeps them in order, and freeing the tree
+     frees them */
+  {
+    FT_T ft;
+    char buf[8];
+    int i;
+    assert((ft = FT_new()) != NULL);
+    for (i = 199; i >= 0; i--) {
+      sprintf(buf, "w/%03d", i);
+      assert(FT_T_insertFile(ft, buf, NULL, 0) == SUCCESS);
+    }
+    for (i = 0; i < 200; i += 2) {
+      sprintf(buf, "w/%03d", i);
+      assert(FT_T_rmFile(ft, buf) == SUCCESS);
+    }
+    assert(FT_T_containsFile(ft, "w/199") == TRUE);
+    assert(FT_T_containsFile(ft, "w/198") == FALSE);
+    assert((temp = FT_T_toString(ft)) != NULL);
+    assert(!strncmp(temp, "w\nw/001\nw/003\n", 14));
+    assert(strlen(temp) == 2 + 100 * 6);
+    free(temp);
+    FT_free(ft);
+  }
+
+  /* children added out of order to a directory wide enough to be
+     indexed are found by name at once and still listed in order,
+     whether or not the tree is concurrent */
+  {
+    FT_T t1, t2;
+    char buf[16];
+    int i;
+    assert((t1 = FT_new()) != NULL);
+    assert((t2 = FT_newConcurrent()) != NULL);
+    for (i = 0; i < 300; i++) {
+      sprintf(buf, "w/%03d", (i * 7) % 300);
+      assert(FT_T_insertDir(t1, buf) == SUCCESS);
+      assert(FT_T_insertDir(t2, buf) == SUCCESS);
+      assert(FT_T_insertFile(t1, buf, NULL, 0) == ALREADY_IN_TREE);
+      strcat(buf, "f");
+      assert(FT_T_insertFile(t1, buf, NULL, 0) == SUCCESS);
+      assert(FT_T_insertFile(t2, buf, NULL, 0) == SUCCESS);
+      assert(FT_T_containsFile(t1, buf) == TRUE);
+      assert(FT_T_containsDir(t2, buf) == FALSE);
+    }
+    for (i = 0; i < 300; i += 3) {
+      sprintf(buf, "w/%03d", i);
+      assert(FT_T_rmDir(t1, buf) == SUCCESS);
+      assert(FT_T_rmDir(t2, buf) == SUCCESS);
+      assert(FT_T_containsDir(t2, buf) == FALSE);
+    }
+    assert(FT_T_insertDir(t1, "w/000") == SUCCESS);
+    assert(FT_T_insertDir(t2, "w/000") == SUCCESS);
+    assert(FT_T_containsDir(t1, "w/299") == TRUE);
+    assert(FT_T_containsFile(t2, "w/299f") == TRUE);
+    assert((temp = FT_T_toString(t1)) != NULL);
+    assert((streamed = FT_T_toString(t2)) != NULL);
+    assert(!strcmp(temp, streamed));
+    assert(!strncmp(temp, "w\nw/000f\nw/001f\n", 16));
+    assert(strstr(temp, "w/299f\nw/000\nw/001\nw/002\nw/004\n")
+           != NULL);
+    free(temp);
+    free(streamed);
+    FT_free(t1);
+    FT_free(t2);
+  }
+
+  /* names that agree in their first several bytes, or are prefixes
+     of one another, are still told apart and kept in order */
+  {
+    FT_T ft;
+    assert((ft = FT_new()) != NULL);
+    assert(FT_T_insertFile(ft, "p/abcdefghij", NULL, 0) == SUCCESS);
+    assert(FT_T_insertFile(ft, "p/abcdefgh", NULL, 0) == SUCCESS);
+    assert(FT_T_insertFile(ft, "p/abcdefghi", NULL, 0) == SUCCESS);
+    assert(FT_T_insertFile(ft, "p/abc", NULL, 0) == SUCCESS);
+    assert(FT_T_insertFile(ft, "p/abcdefgha", NULL, 0) == SUCCESS);
+    assert(FT_T_insertFile(ft, "p/abcdefgh", NULL, 0)
+           == ALREADY_IN_TREE);
+    assert(FT_T_containsFile(ft, "p/abcdefg") == FALSE);
+    assert(FT_T_containsFile(ft, "p/abcdefghij") == TRUE);
+    assert(FT_T_rmFile(ft, "p/abcdefghi") == SUCCESS);
+    assert(FT_T_containsFile(ft, "p/abcdefghi") == FALSE);
+    assert((temp = FT_T_toString(ft)) != NULL);
+    assert(!strcmp(temp, "p\np/abc\np/abcdefgh\np/abcdefgha\n"
+                         "p/abcdefghij\n"));
+    free(temp);
+    FT_free(ft);
+  }
+
+  /* a saved tree loads back with the same hierarchy and contents,
+     answering lookups from the snapshot until it is changed */
+  {
+    FT_T t1, t2;
+    assert((t1 = FT_new()) != NULL);
+    assert((t2 = FT_new()) != NULL);
+    assert(FT_T_insertFile(t1, "a/b/c", "Ritchie", 8) == SUCCESS);
+    assert(FT_T_insertFile(t1, "a/b/empty", NULL, 0) == SUCCESS);
+    assert(FT_T_insertDir(t1, "a/x") == SUCCESS);
+    assert(FT_T_save(t1, "ft_client.snap") == SUCCESS);
+    assert(FT_T_insertDir(t2, "z") == SUCCESS);
+    assert(FT_T_load(t2, "no/such/file") == FILE_ERROR);
+    assert(FT_T_containsDir(t2, "z") == TRUE);
+    assert(FT_T_load(t2, "ft_client.snap") == SUCCESS);
+    assert(FT_T_containsDir(t2, "z") == FALSE);
+    assert(FT_T_containsDir(t2, "a/b") == TRUE);
+    assert(FT_T_containsDir(t2, "a/b/c") == FALSE);
+    assert(FT_T_containsFile(t2, "a/b/c") == TRUE);
+    assert(FT_T_containsFile(t2, "a/b/c/d") == FALSE);
+    assert(!strcmp(FT_T_getFileContents(t2, "a/b/c"), "Ritchie"));
+    assert(FT_T_getFileContents(t2, "a/b/empty") == NULL);
+    assert(FT_T_stat(t2, "a/b/c", &b, &l) == SUCCESS);
+    assert(b == TRUE && l == 8);
+    assert((temp = FT_T_toString(t1)) != NULL);
+    assert((streamed = FT_T_toString(t2)) != NULL);
+    assert(!strcmp(temp, streamed));
+    free(temp);
+    free(streamed);
+    assert(FT_T_insertFile(t2, "a/x/y", NULL, 0) == SUCCESS);
+    assert(FT_T_containsFile(t2, "a/x/y") == TRUE);
+    assert(!strcmp(FT_T_getFileContents(t2, "a/b/c"), "Ritchie"));
+    FT_free(t1);
+    FT_free(t2);
+    assert(remove("ft_client.snap") == 0);
+  }
+
+  /* a concurrent tree can be read by several threads while another
+     one inserts and removes around what they read */
+  {
+    FT_T ft;
+    pthread_t readers[4];
+    char buf[8];
+    int i, round;
+    assert((ft = FT_newConcurrent()) != NULL);
+    assert(FT_T_insertFile(ft, "a/keep", "Thompson", 9) == SUCCESS);
+    for (i = 0; i < 4; i++)
+      assert(pthread_create(&readers[i], NULL, readTree, ft) == 0);
+    for (round = 0; round < 50; round++)
+      for (i = 0; i < 10; i++) {
+        sprintf(buf, "a/%d/b", i);
+        assert(FT_T_insertDir(ft, buf) == SUCCESS);
+        assert(FT_T_containsDir(ft, buf) == TRUE);
+        sprintf(buf, "a/%d", i);
+        assert(FT_T_rmDir(ft, buf) == SUCCESS);
+      }
+    __atomic_store_n(&writerDone, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < 4; i++)
+      assert(pthread_join(readers[i], NULL) == 0);
+    assert((temp = FT_T_toString(ft)) != NULL);
+    assert(!strcmp(temp, "a\na/keep\n"));
+    free(temp);
+    FT_free(ft);
+  }
+
+  /* a bulk load builds, from unsorted records, the same tree as
+     inserting them one by one, and on failure builds nothing */
+  {
+    FT_T t1, t2;
+    struct FT_Record records[6];
+    char *paths[6] = {"a/b-c", "a/b/d/e", "a/b/c", "a/b0", "a/b/d/f",
+                      "a/b/a"};
+    int i;
+    assert((t1 = FT_new()) != NULL);
+    assert((t2 = FT_new()) != NULL);
+    for (i = 0; i < 6; i++) {
+      records[i].path = paths[i];
+      records[i].contents = paths[i];
+      records[i].length = strlen(paths[i]) + 1;
+      assert(FT_T_insertFile(t1, paths[i], paths[i],
+                             strlen(paths[i]) + 1) == SUCCESS);
+    }
+    assert(FT_T_bulkLoad(t2, records, 6) == SUCCESS);
+    assert(records[0].path == paths[0]);
+    assert((temp = FT_T_toString(t1)) != NULL);
+    assert((streamed = FT_T_toString(t2)) != NULL);
+    assert(!strcmp(temp, streamed));
+    free(temp);
+    free(streamed);
+    assert(FT_T_containsDir(t2, "a/b/d") == TRUE);
+    assert(!strcmp(FT_T_getFileContents(t2, "a/b/d/f"), "a/b/d/f"));
+    assert(FT_T_bulkLoad(t2, records, 6) == CONFLICTING_PATH);
+    FT_free(t2);
+
+    assert((t2 = FT_new()) != NULL);
+    records[5].path = "a/b0";
+    assert(FT_T_bulkLoad(t2, records, 6) == ALREADY_IN_TREE);
+    records[5].path = "a/b/c/g";
+    assert(FT_T_bulkLoad(t2, records, 6) == NOT_A_DIRECTORY);
+    records[5].path = "z/b";
+    assert(FT_T_bulkLoad(t2, records, 6) == CONFLICTING_PATH);
+    records[5].path = "a//b";
+    assert(FT_T_bulkLoad(t2, records, 6) == PARENT_CHILD_ERROR);
+    assert(FT_T_containsDir(t2, "a") == FALSE);
+    assert(FT_T_bulkLoad(t2, records, 1) == SUCCESS);
+    assert(FT_T_containsFile(t2, "a/b-c") == TRUE);
+    FT_free(t1);
+    FT_free(t2);
+  }
+
+  /* a batched lookup answers, in the order asked, what looking up
+     each path on its own would, whether the siblings it asks for are
+     swept up together or looked up one by one */
+  {
+    FT_T ft;
+    char *paths[10] = {"r/w/010f", "r/x", "r/w/005", "r", "r/w/010f/y",
+                       "r/x", "r/w", "r//x", "q", "r/w/005/"};
+    char names[200][12];
+    char *wide[200];
+    int results[200];
+    boolean types[200], found[200];
+    size_t lengths[200];
+    boolean isFile;
+    size_t length;
+    int i, pass;
+    for (pass = 0; pass < 3; pass++) {
+      assert((ft = pass == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      assert(FT_T_insertFile(ft, "r/x", "Kernighan", 10) == SUCCESS);
+      for (i = 0; i < 200; i++) {
+        sprintf(names[i], "r/w/%03d%s", i, i % 2 == 0 ? "f" : "");
+        wide[199 - i] = names[i];
+        if (i % 2 == 0)
+          assert(FT_T_insertFile(ft, names[i], NULL, 0) == SUCCESS);
+        else
+          assert(FT_T_insertDir(ft, names[i]) == SUCCESS);
+      }
+      if (pass == 2) {
+        assert(FT_T_save(ft, "ft_client.snap") == SUCCESS);
+        assert(FT_T_load(ft, "ft_client.snap") == SUCCESS);
+      }
+      assert(FT_T_statBatch(ft, paths, 10, results, types, lengths)
+             == SUCCESS);
+      assert(FT_T_containsFileBatch(ft, paths, 10, found) == SUCCESS);
+      for (i = 0; i < 10; i++) {
+        length = 0;
+        assert(results[i] == FT_T_stat(ft, paths[i], &isFile,
+                                       &length));
+        if (results[i] == SUCCESS) {
+          assert(types[i] == isFile);
+          assert(!isFile || lengths[i] == length);
+        }
+        assert(found[i] == FT_T_containsFile(ft, paths[i]));
+      }
+      assert(types[1] == TRUE && lengths[1] == 10);
+      assert(found[0] == TRUE && found[5] == TRUE && found[6] == FALSE);
+      assert(results[4] == NO_SUCH_PATH && results[7] == NO_SUCH_PATH);
+      assert(results[8] == NO_SUCH_PATH && results[9] == NO_SUCH_PATH);
+      assert(FT_T_containsFileBatch(ft, wide, 200, found) == SUCCESS);
+      for (i = 0; i < 200; i++)
+        assert(found[199 - i] == (i % 2 == 0));
+      FT_free(ft);
+    }
+    assert(remove("ft_client.snap") == 0);
+    assert(FT_statBatch(paths, 10, results, types, lengths)
+           == SUCCESS);
+    for (i = 0; i < 10; i++)
+      assert(results[i] == FT_stat(paths[i], &isFile, &length));
+  }
+
+  /* a batch of changes is made as one: when a change fails, those
+     before it are undone and the tree is left as it was */
+  {
+    FT_T ft;
+    struct FT_Op ops[8];
+    char name[16];
+    size_t failed;
+    int i, pass;
+    char *before;
+    for (pass = 0; pass < 2; pass++) {
+      assert((ft = pass == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      assert(FT_T_insertFile(ft, "m/a", "Ritchie", 8) == SUCCESS);
+      assert(FT_T_insertDir(ft, "m/d/x/deep") == SUCCESS);
+      for (i = 0; i < 100; i++) {
+        sprintf(name, "m/w/%03d", i);
+        assert(FT_T_insertFile(ft, name, NULL, 0) == SUCCESS);
+      }
+      assert((before = FT_T_toString(ft)) != NULL);
+
+      ops[0].kind = FT_INSERT_FILE; ops[0].path = "m/n/f";
+      ops[0].contents = "Pike"; ops[0].length = 5;
+      ops[1].kind = FT_INSERT_DIR; ops[1].path = "m/d/y";
+      ops[2].kind = FT_RM_FILE; ops[2].path = "m/w/050";
+      ops[3].kind = FT_RM_DIR; ops[3].path = "m/d/x";
+      ops[4].kind = FT_REPLACE_CONTENTS; ops[4].path = "m/a";
+      ops[4].contents = "Thompson"; ops[4].length = 9;
+      ops[5].kind = FT_INSERT_FILE; ops[5].path = "m/w/100";
+      ops[5].contents = NULL; ops[5].length = 0;
+      ops[6].kind = FT_INSERT_DIR; ops[6].path = "m/w/050";
+      ops[7].kind = FT_INSERT_FILE; ops[7].path = "m/d/y";
+      ops[7].contents = NULL; ops[7].length = 0;
+      assert(FT_T_applyBatch(ft, ops, 8, &failed) == ALREADY_IN_TREE);
+      assert(failed == 7);
+      assert((temp = FT_T_toString(ft)) != NULL);
+      assert(!strcmp(temp, before));
+      free(temp);
+      assert(!strcmp(FT_T_getFileContents(ft, "m/a"), "Ritchie"));
+      assert(FT_T_containsFile(ft, "m/w/050") == TRUE);
+      assert(FT_T_containsDir(ft, "m/d/x/deep") == TRUE);
+
+      ops[7].kind = FT_REPLACE_CONTENTS; ops[7].path = "m/d";
+      assert(FT_T_applyBatch(ft, ops, 8, &failed) == NOT_A_FILE);
+      assert(failed == 7);
+      assert(FT_T_applyBatch(ft, ops, 7, NULL) == SUCCESS);
+      assert(!strcmp(ops[4].oldContents, "Ritchie"));
+      assert(!strcmp(FT_T_getFileContents(ft, "m/a"), "Thompson"));
+      assert(!strcmp(FT_T_getFileContents(ft, "m/n/f"), "Pike"));
+      assert(FT_T_containsDir(ft, "m/d/x") == FALSE);
+      assert(FT_T_containsDir(ft, "m/w/050") == TRUE);
+      assert(FT_T_containsFile(ft, "m/w/100") == TRUE);
+
+      ops[0].kind = FT_RM_DIR; ops[0].path = "m";
+      ops[1].kind = FT_INSERT_FILE; ops[1].path = "r";
+      ops[1].contents = NULL; ops[1].length = 0;
+      ops[2].kind = FT_RM_FILE; ops[2].path = "r/x";
+      assert(FT_T_applyBatch(ft, ops, 3, &failed) == NO_SUCH_PATH);
+      assert(failed == 2);
+      assert(FT_T_containsDir(ft, "m/w") == TRUE);
+      assert(FT_T_containsFile(ft, "r") == FALSE);
+      assert(FT_T_applyBatch(ft, ops, 2, NULL) == SUCCESS);
+      assert((temp = FT_T_toString(ft)) != NULL);
+      assert(!strcmp(temp, "r\n"));
+      free(temp);
+      free(before);
+      FT_free(ft);
+    }
+  }
+
+  /* contents handed over to the tree, or shared through a Blob_T,
+     are freed by the tree once nothing holds them, and a reference
+     handed out stays valid after its file changes */
+  {
+    FT_T ft;
+    Blob_T blob, got;
+    struct FT_Op ops[2];
+    char *owned;
+    void *old;
+    int pass;
+    for (pass = 0; pass < 2; pass++) {
+      assert((ft = pass == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      assert((owned = malloc(6)) != NULL);
+      strcpy(owned, "owned");
+      assert(FT_T_insertFileOwned(ft, "b/o", owned, 6) == SUCCESS);
+      assert(FT_T_getFileContents(ft, "b/o") == owned);
+      assert((owned = malloc(6)) != NULL);
+      assert(FT_T_insertFileOwned(ft, "b/o", owned, 6)
+             == ALREADY_IN_TREE);
+      free(owned);
+      assert(FT_T_insertFile(ft, "b/c", "borrowed", 9) == SUCCESS);
+
+      assert((blob = Blob_new("shared", 7)) != NULL);
+      assert(FT_T_insertFileBlob(ft, "b/s1", blob) == SUCCESS);
+      assert(FT_T_insertFileBlob(ft, "b/s2", blob) == SUCCESS);
+      Blob_release(blob);
+      assert((got = FT_T_getFileBlob(ft, "b/s1")) == blob);
+      assert(FT_T_getFileBlob(ft, "b/s2") == blob);
+      Blob_release(got);
+      Blob_release(got);
+      assert((got = FT_T_getFileBlob(ft, "b/c")) != NULL);
+      assert(Blob_getBytes(got) != FT_T_getFileContents(ft, "b/c"));
+      assert(!strcmp(Blob_getBytes(got), "borrowed"));
+      Blob_release(got);
+      assert(FT_T_getFileBlob(ft, "b") == NULL);
+      assert(FT_T_getFileBlob(ft, "b/x") == NULL);
+
+      assert(FT_T_replaceFileContents(ft, "b/o", "x", 2) == NULL);
+      assert((owned = malloc(3)) != NULL);
+      strcpy(owned, "ok");
+      assert(FT_T_replaceFileOwned(ft, "b", owned, 3, &old)
+             == NOT_A_FILE);
+      assert(FT_T_replaceFileOwned(ft, "b/c", owned, 3, &old)
+             == SUCCESS);
+      assert(!strcmp(old, "borrowed"));
+
+      /* a batch rolled back gives the file its Blob_T back */
+      ops[0].kind = FT_REPLACE_CONTENTS; ops[0].path = "b/c";
+      ops[0].contents = "batched"; ops[0].length = 8;
+      ops[1].kind = FT_RM_FILE; ops[1].path = "b/x";
+      assert(FT_T_applyBatch(ft, ops, 2, NULL) == NO_SUCH_PATH);
+      assert(FT_T_getFileContents(ft, "b/c") == owned);
+      assert(FT_T_applyBatch(ft, ops, 1, NULL) == SUCCESS);
+      assert(ops[0].oldContents == NULL);
+
+      got = FT_T_getFileBlob(ft, "b/s1");
+      assert(FT_T_rmFile(ft, "b/s1") == SUCCESS);
+      assert((blob = Blob_new(NULL, 0)) != NULL);
+      assert(FT_T_replaceFileBlob(ft, "b/s2", blob, &old) == SUCCESS);
+      assert(old == NULL);
+      Blob_release(blob);
+      assert(FT_T_getFileContents(ft, "b/s2") == Blob_getBytes(blob));
+      assert(!strcmp(Blob_getBytes(got), "shared"));
+      assert(Blob_getLength(got) == 7);
+      Blob_release(got);
+      FT_free(ft);
+    }
+  }
+
+  /* a tree that deduplicates keeps one copy of each distinct
+     contents, shared by every file holding them */
+  {
+    FT_T ft;
+    struct FT_DedupStats stats;
+    char name[16];
+    char buf[64];
+    char *owned;
+    int i, pass;
+    for (pass = 0; pass < 2; pass++) {
+      assert((ft = pass == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      assert(FT_T_getDedupStats(ft, &stats) == SUCCESS);
+      assert(stats.payloads == 0 && stats.hits == 0);
+      assert(FT_T_enableDedup(ft) == SUCCESS);
+      assert(FT_T_enableDedup(ft) == SUCCESS);
+      for (i = 0; i < 300; i++) {
+        sprintf(name, "d/%03d", i);
+        /* equal lengths, so only the bytes tell them apart */
+        sprintf(buf, "license header %d of the project", i % 3);
+        assert(FT_T_insertFile(ft, name, buf, strlen(buf) + 1)
+               == SUCCESS);
+      }
+      memset(buf, 0, sizeof buf);
+      assert(FT_T_getFileContents(ft, "d/000")
+             == FT_T_getFileContents(ft, "d/297"));
+      assert(FT_T_getFileContents(ft, "d/000")
+             != FT_T_getFileContents(ft, "d/001"));
+      assert(!strcmp(FT_T_getFileContents(ft, "d/299"),
+                     "license header 2 of the project"));
+      assert(FT_T_getDedupStats(ft, &stats) == SUCCESS);
+      assert(stats.payloads == 3 && stats.references == 300);
+      assert(stats.payloadBytes == 3 * 32);
+      assert(stats.referencedBytes == 300 * 32);
+      assert(stats.hits == 297 && stats.misses == 3);
+
+      assert((owned = malloc(32)) != NULL);
+      strcpy(owned, "license header 1 of the project");
+      assert(FT_T_replaceFileOwned(ft, "d/000", owned, 32, NULL)
+             == SUCCESS);
+      assert(FT_T_getFileContents(ft, "d/000")
+             == FT_T_getFileContents(ft, "d/001"));
+      assert(FT_T_replaceFileContents(ft, "d/003", "", 1) == NULL);
+      for (i = 2; i < 300; i += 3) {
+        sprintf(name, "d/%03d", i);
+        assert(FT_T_rmFile(ft, name) == SUCCESS);
+      }
+      assert(FT_T_getDedupStats(ft, &stats) == SUCCESS);
+      assert(stats.payloads == 3 && stats.references == 200);
+      assert(stats.payloadBytes == 2 * 32 + 1);
+      FT_free(ft);
+    }
+  }
+
+  /* every directory's totals match a walk of its hierarchy, however
+     it came to be */
+  {
+    FT_T ft;
+    struct FT_Op ops[3];
+    struct FT_Record records[2];
+    char *dirs[5] = { "t", "t/a", "t/a/b", "t/c", "t/a/b/d" };
+    size_t counts[3], dirCount, fileCount, byteCount;
+    int i, j, pass;
+    for (pass = 0; pass < 3; pass++) {
+      assert((ft = pass == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      assert(FT_T_insertFile(ft, "t/a/b/d/f", "12345", 5) == SUCCESS);
+      assert(FT_T_insertFile(ft, "t/a/g", "123", 3) == SUCCESS);
+      assert(FT_T_insertFile(ft, "t/c/h", NULL, 0) == SUCCESS);
+      assert(FT_T_insertFile(ft, "t/c/i", "1234567", 7) == SUCCESS);
+      assert(FT_T_replaceFileContents(ft, "t/a/g", "1", 1) != NULL);
+      assert(FT_T_insertDir(ft, "t/c/x/y") == SUCCESS);
+      assert(FT_T_rmDir(ft, "t/c/x") == SUCCESS);
+      ops[0].kind = FT_RM_DIR; ops[0].path = "t/a/b";
+      ops[1].kind = FT_REPLACE_CONTENTS; ops[1].path = "t/c/i";
+      ops[1].contents = NULL; ops[1].length = 0;
+      ops[2].kind = FT_RM_FILE; ops[2].path = "t/c/x";
+      assert(FT_T_applyBatch(ft, ops, 3, NULL) == NO_SUCH_PATH);
+      if (pass == 2) {
+        assert(FT_T_save(ft, "ft_client.snap") == SUCCESS);
+        assert(FT_T_load(ft, "ft_client.snap") == SUCCESS);
+        assert(remove("ft_client.snap") == 0);
+      }
+      for (i = 0; i < 5; i++) {
+        for (j = 0; j < 3; j++)
+          counts[j] = 0;
+        assert(FT_T_walk(ft, dirs[i], countNode, counts) == SUCCESS);
+        assert(FT_T_statDir(ft, dirs[i], &dirCount, &fileCount,
+                            &byteCount) == SUCCESS);
+        assert(dirCount == counts[0] && fileCount == counts[1]);
+        assert(byteCount == counts[2]);
+      }
+      assert(FT_T_statDir(ft, "t", &dirCount, &fileCount, &byteCount)
+             == SUCCESS);
+      assert(dirCount == 5 && fileCount == 4 && byteCount == 13);
+      assert(FT_T_statDir(ft, "t/c/h", &dirCount, &fileCount,
+                          &byteCount) == NOT_A_DIRECTORY);
+      assert(FT_T_statDir(ft, "t/z", &dirCount, &fileCount,
+                          &byteCount) == NO_SUCH_PATH);
+      FT_free(ft);
+    }
+
+    records[0].path = "r/s/u"; records[0].contents = "abc";
+    records[0].length = 4;
+    records[1].path = "r/v"; records[1].contents = NULL;
+    records[1].length = 0;
+    assert((ft = FT_new()) != NULL);
+    assert(FT_T_bulkLoad(ft, records, 2) == SUCCESS);
+    assert(FT_T_statDir(ft, "r", &dirCount, &fileCount, &byteCount)
+           == SUCCESS);
+    assert(dirCount == 2 && fileCount == 2 && byteCount == 4);
+    FT_free(ft);
+  }
+
+  /* every path kernel the CPU has splits and compares paths the
+     same way, including paths of more components than fit in one
+     scan and names longer than one vector block */
+  {
+    FT_T ft;
+    char deep[40 * 4 + 32];
+    int kernel, i;
+    for (kernel = PATH_SCALAR; kernel <= PATH_AVX2; kernel++) {
+      if (!Path_useKernel(kernel))
+        continue;
+      assert((ft = FT_new()) != NULL);
+      deep[0] = '\0';
+      for (i = 0; i < 40; i++)
+        sprintf(deep + strlen(deep), "%s%03d", i == 0 ? "" : "/", i);
+      assert(FT_T_insertDir(ft, deep) == SUCCESS);
+      assert(FT_T_containsDir(ft, deep) == TRUE);
+      strcat(deep, "/a-name-longer-than-a-block");
+      assert(FT_T_insertFile(ft, deep, NULL, 0) == SUCCESS);
+      assert(FT_T_containsFile(ft, deep) == TRUE);
+      deep[strlen(deep) - 1] = 'j';
+      assert(FT_T_containsFile(ft, deep) == FALSE);
+      deep[4 * 33 - 1] = '\0';
+      assert(FT_T_containsDir(ft, deep) == TRUE);
+      assert(FT_T_insertDir(ft, "000//x") == PARENT_CHILD_ERROR);
+      assert(FT_T_insertDir(ft, "000/x/") == PARENT_CHILD_ERROR);
+      assert(FT_T_insertDir(ft, "/000") == CONFLICTING_PATH);
+      assert(FT_T_containsDir(ft, "000/") == FALSE);
+      assert(Path_compare("abcdefghijklmnopq", 17,
+                          "abcdefghijklmnopr", 17) < 0);
+      assert(Path_compare("abcdefghijklmnopq", 17,
+                          "abcdefghijklmnop", 16) > 0);
+      FT_free(ft);
+    }
+    assert(Path_useKernel(PATH_AUTO) == TRUE);
+  }
+
+  /* A removed hierarchy is unlinked at once and freed a little at a
+     time by later changes, or all at once by FT_flushRemoved; one
+     still waiting is freed with its tree, contents and all. */
+  {
+    size_t pass;
+    for (pass = 0; pass < 2; pass++) {
+      FT_T ft = pass ? FT_newConcurrent() : FT_new();
+      char path[32];
+      char *contents;
+      size_t round, j, dirs, files, bytes;
+      assert(ft != NULL);
+      assert(FT_T_insertDir(ft, "r/keep") == SUCCESS);
+      for (round = 0; round < 2; round++) {
+        for (j = 0; j < 400; j++) {
+          sprintf(path, "r/gone/d%lu/e/f", (unsigned long) j);
+          assert(FT_T_insertDir(ft, path) == SUCCESS);
+          sprintf(path, "r/gone/d%lu/x", (unsigned long) j);
+          contents = malloc(4);
+          assert(contents != NULL);
+          strcpy(contents, "abc");
+          assert(FT_T_insertFileOwned(ft, path, contents, 4) ==
+                 SUCCESS);
+        }
+        assert(FT_T_rmDir(ft, "r/gone") == SUCCESS);
+        assert(FT_T_containsDir(ft, "r/gone") == FALSE);
+        assert(FT_T_containsFile(ft, "r/gone/d7/x") == FALSE);
+        assert(FT_T_statDir(ft, "r", &dirs, &files, &bytes) == SUCCESS);
+        assert(dirs == 2 && files == 0 && bytes == 0);
+        assert(FT_T_insertDir(ft, "r/gone/d7") == SUCCESS);
+        assert(FT_T_rmDir(ft, "r/gone") == SUCCESS);
+        if (round == 0)
+          assert(FT_T_flushRemoved(ft) == SUCCESS);
+      }
+      assert((temp = FT_T_toString(ft)) != NULL);
+      assert(!strcmp(temp, "r\nr/keep\n"));
+      free(temp);
+      FT_free(ft);
+    }
+    assert(FT_flushRemoved() == SUCCESS);
+  }
+
+  /* A hierarchy far deeper than a walk holds without allocating is
+     walked, written out, looked up in batches, saved and loaded, and
+     removed whole. */
+  {
+    enum { DEPTH = 3000 };
+    FT_T ft = FT_new();
+    FT_T copy = FT_newConcurrent();
+    char *path = malloc(2 * DEPTH + 2);
+    char *temp2;
+    char *paths[2];
+    boolean found[2];
+    int results[2];
+    boolean types[2];
+    size_t lengths[2];
+    size_t counts[3] = { 0, 0, 0 };
+    size_t chars = 0;
+    size_t i;
+    assert(ft != NULL && copy != NULL && path != NULL);
+    strcpy(path, "d");
+    for (i = 1; i < DEPTH; i++)
+      strcpy(path + 2 * i - 1, "/d");
+    assert(FT_T_insertDir(ft, path) == SUCCESS);
+    strcat(path, "/f");
+    assert(FT_T_insertFile(ft, path, NULL, 0) == SUCCESS);
+    assert(FT_T_walk(ft, NULL, countNode, counts) == SUCCESS);
+    assert(counts[0] == DEPTH && counts[1] == 1);
+    assert(FT_T_toCallback(ft, countChars, &chars) == SUCCESS);
+    assert(chars == DEPTH * (DEPTH + 1) + 2 * DEPTH + 2);
+    assert((temp = FT_T_toString(ft)) != NULL);
+    assert(strlen(temp) == chars);
+    assert(!strncmp(temp + chars - (2 * DEPTH + 2), path,
+                    2 * DEPTH + 1));
+    assert(FT_T_save(ft, "ft_client.snap") == SUCCESS);
+    assert(FT_T_load(copy, "ft_client.snap") == SUCCESS);
+    assert(remove("ft_client.snap") == 0);
+    assert(FT_T_containsFile(copy, path) == TRUE);
+    paths[0] = path;
+    paths[1] = "d/d";
+    assert(FT_T_containsFileBatch(ft, paths, 2, found) == SUCCESS);
+    assert(found[0] == TRUE && found[1] == FALSE);
+    assert(FT_T_containsFileBatch(copy, paths, 2, found) == SUCCESS);
+    assert(found[0] == TRUE && found[1] == FALSE);
+    assert(FT_T_statBatch(ft, paths, 2, results, types, lengths) ==
+           SUCCESS);
+    assert(results[0] == SUCCESS && types[0] == TRUE &&
+           lengths[0] == 0);
+    assert(results[1] == SUCCESS && types[1] == FALSE);
+    assert((temp2 = FT_T_toString(copy)) != NULL);
+    assert(!strcmp(temp, temp2));
+    free(temp);
+    free(temp2);
+    assert(FT_T_rmDir(ft, "d") == SUCCESS);
+    assert(FT_T_flushRemoved(ft) == SUCCESS);
+    assert(FT_T_containsDir(ft, "d") == FALSE);
+    free(path);
+    FT_free(ft);
+    FT_free(copy);
+  }
+
+  /* Each distinct name is stored once, however many nodes of
+     however many trees bear it, each tree holds one reference to it
+     however many of its nodes do, and it is let go of with them. */
+  {
+    FT_T ft[2];
+    struct FT_NameStats before, stats;
+    char name[48];
+    int i, j;
+    FT_getNameStats(&before);
+    for (j = 0; j < 2; j++) {
+      assert((ft[j] = j == 1 ? FT_newConcurrent() : FT_new()) != NULL);
+      for (i = 0; i < 100; i++) {
+        sprintf(name, "interned-r/interned-%02d/interned-lib", i);
+        assert(FT_T_insertFile(ft[j], name, NULL, 0) == SUCCESS);
+      }
+      FT_getNameStats(&stats);
+      assert(stats.names == before.names + 102);
+      assert(stats.nameBytes == before.nameBytes + 10 + 100 * 11 + 12);
+      assert(stats.references == before.references + (j + 1) * 102);
+      assert(stats.referencedBytes == before.referencedBytes +
+             (j + 1) * (10 + 100 * 11 + 12));
+    }
+    assert(FT_T_containsFile(ft[1], "interned-r/interned-42/"
+                             "interned-lib") == TRUE);
+    assert(FT_T_rmDir(ft[0], "interned-r/interned-42") == SUCCESS);
+    assert(FT_T_containsDir(ft[1], "interned-r/interned-42") == TRUE);
+    FT_free(ft[0]);
+    FT_free(ft[1]);
+    FT_getNameStats(&stats);
+    assert(stats.names == before.names);
+    assert(stats.references == before.references);
+  }
+
+  /* A tree compressing chains of directories behaves as one that
+     does not, as its chains are split by insertions, removals and
+     batches, and undone batches join them up again. */
+  {
+    FT_T ft[2];
+    struct FT_Op ops[3];
+    char *temp2;
+    char walked[2][256];
+    size_t dirs, files, bytes;
+    int i, j;
+    assert((ft[0] = FT_new()) != NULL && (ft[1] = FT_new()) != NULL);
+    assert(FT_T_enableCompression(ft[0]) == SUCCESS);
+    ops[0].kind = FT_INSERT_DIR;
+    ops[0].path = "c/d1/d2/e";
+    ops[1].kind = FT_INSERT_DIR;
+    ops[1].path = "c/d1/d2/d3/g/h";
+    ops[2].kind = FT_RM_DIR;
+    ops[2].path = "c/nope";
+    for (j = 0; j < 2; j++) {
+      assert(FT_T_insertDir(ft[j], "c/d1/d2/d3/d4") == SUCCESS);
+      assert(FT_T_insertFile(ft[j], "c/d1/d2/d3/d4/f", "ab", 2) ==
+             SUCCESS);
+      assert(FT_T_insertDir(ft[j], "c/d1/d2") == ALREADY_IN_TREE);
+      assert(FT_T_containsDir(ft[j], "c/d1/d2/d3") == TRUE);
+      assert(FT_T_containsDir(ft[j], "c/d1/d2/d") == FALSE);
+      assert(FT_T_statDir(ft[j], "c/d1/d2", &dirs, &files, &bytes) ==
+             SUCCESS);
+      assert(dirs == 3 && files == 1 && bytes == 2);
+      walked[j][0] = '\0';
+      assert(FT_T_walk(ft[j], "c/d1/d2", appendPath, walked[j]) ==
+             SUCCESS);
+      assert(!strcmp(walked[j], "c/d1/d2\nc/d1/d2/d3\nc/d1/d2/d3/d4\n"
+                     "c/d1/d2/d3/d4/f\n"));
+      assert(FT_T_insertDir(ft[j], "c/d1/x/y") == SUCCESS);
+      assert(FT_T_applyBatch(ft[j], ops, 3, NULL) == NO_SUCH_PATH);
+      assert(FT_T_rmDir(ft[j], "c/d1/d2/d3") == SUCCESS);
+      assert(FT_T_insertDir(ft[j], "c/d1/d2/e/f/g") == SUCCESS);
+      assert(FT_T_rmDir(ft[j], "c/d1/d2/e/f/g") == SUCCESS);
+    }
+    assert((temp = FT_T_toString(ft[0])) != NULL);
+    assert((temp2 = FT_T_toString(ft[1])) != NULL);
+    assert(!strcmp(temp, temp2));
+    assert(!strcmp(temp, "c\nc/d1\nc/d1/d2\nc/d1/d2/e\nc/d1/d2/e/f\n"
+                   "c/d1/x\nc/d1/x/y\n"));
+    free(temp2);
+    assert(FT_T_save(ft[0], "ft_client.snap") == SUCCESS);
+    FT_free(ft[1]);
+    assert((ft[1] = FT_new()) != NULL);
+    assert(FT_T_load(ft[1], "ft_client.snap") == SUCCESS);
+    assert(remove("ft_client.snap") == 0);
+    assert((temp2 = FT_T_toString(ft[1])) != NULL);
+    assert(!strcmp(temp, temp2));
+    free(temp);
+    free(temp2);
+    for (i = 0; i < 2; i++)
+      FT_free(ft[i]);
+  }
+
+  /* A move relinks a single node, whichever kind of tree it is in,
+     and leaves the tree as it was if it fails. */
+  {
+    FT_T ft[3];
+    char *temp2;
+    size_t dirs, files, bytes;
+    int i;
+    assert((ft[0] = FT_new()) != NULL);
+    assert((ft[1] = FT_new()) != NULL);
+    assert((ft[2] = FT_newConcurrent()) != NULL);
+    assert(FT_T_enableCompression(ft[1]) == SUCCESS);
+    for (i = 0; i < 3; i++) {
+      assert(FT_T_insertDir(ft[i], "m/a/b/c") == SUCCESS);
+      assert(FT_T_insertFile(ft[i], "m/a/b/c/f", "xy", 2) == SUCCESS);
+      assert(FT_T_insertFile(ft[i], "m/a/g", "z", 1) == SUCCESS);
+      assert(FT_T_insertDir(ft[i], "m/d") == SUCCESS);
+      assert(FT_T_move(ft[i], "m/a/b", "m/d/b2") == SUCCESS);
+      assert(FT_T_containsDir(ft[i], "m/a/b") == FALSE);
+      assert(FT_T_containsDir(ft[i], "m/d/b2/c") == TRUE);
+      assert(FT_T_move(ft[i], "m/a/g", "m/d/b2/g2") == SUCCESS);
+      assert(FT_T_move(ft[i], "m/d", "m/e") == SUCCESS);
+      assert(!strcmp(FT_T_getFileContents(ft[i], "m/e/b2/c/f"), "xy"));
+      assert(FT_T_statDir(ft[i], "m/e", &dirs, &files, &bytes) ==
+             SUCCESS);
+      assert(dirs == 3 && files == 2 && bytes == 3);
+      assert(FT_T_statDir(ft[i], "m/a", &dirs, &files, &bytes) ==
+             SUCCESS);
+      assert(dirs == 1 && files == 0 && bytes == 0);
+      assert(FT_T_move(ft[i], "m/e", "m/e/b2/x") == PARENT_CHILD_ERROR);
+      assert(FT_T_move(ft[i], "m/nope", "m/z") == NO_SUCH_PATH);
+      assert(FT_T_move(ft[i], "m/a", "m/q/r") == NO_SUCH_PATH);
+      assert(FT_T_move(ft[i], "m/a", "m/e") == ALREADY_IN_TREE);
+      assert(FT_T_move(ft[i], "m/a", "n") == CONFLICTING_PATH);
+      assert(FT_T_move(ft[i], "m/a", "m/e/b2/g2/x") == NOT_A_DIRECTORY);
+      assert(FT_T_move(ft[i], "m", "r") == SUCCESS);
+      assert(FT_T_containsFile(ft[i], "r/e/b2/g2") == TRUE);
+    }
+    assert((temp = FT_T_toString(ft[0])) != NULL);
+    assert(!strcmp(temp, "r\nr/a\nr/e\nr/e/b2\nr/e/b2/g2\nr/e/b2/c\n"
+                   "r/e/b2/c/f\n"));
+    for (i = 1; i < 3; i++) {
+      assert((temp2 = FT_T_toString(ft[i])) != NULL);
+      assert(!strcmp(temp, temp2));
+      free(temp2);
+    }
+    free(temp);
+    for (i = 0; i < 3; i++)
+      FT_free(ft[i]);
+
+    /* a directory inside the root's chain is not the root, so it
+       cannot take a path of a single component */
+    assert((ft[0] = FT_new()) != NULL);
+    assert((ft[1] = FT_new()) != NULL);
+    assert((ft[2] = FT_newConcurrent()) != NULL);
+    assert(FT_T_enableCompression(ft[1]) == SUCCESS);
+    for (i = 0; i < 3; i++) {
+      assert(FT_T_insertDir(ft[i], "c/a") == SUCCESS);
+      assert(FT_T_move(ft[i], "c/a", "ab") == CONFLICTING_PATH);
+      assert((temp = FT_T_toString(ft[i])) != NULL);
+      assert(!strcmp(temp, "c\nc/a\n"));
+      free(temp);
+      assert(FT_T_move(ft[i], "c", "d") == SUCCESS);
+      assert(FT_T_containsDir(ft[i], "d/a") == TRUE);
+      FT_free(ft[i]);
+    }
+  }
+
+  /* Operations are only counted in builds with FT_STATS, in which a
+     hook sees each counted call as the totals do; otherwise every
+     total stays 0 and the hook is never called. */
+  {
+    FT_T ft = FT_new();
+    struct Stats_report report;
+    size_t counts[2] = { 0, 0 };
+    size_t calls = 0;
+    size_t i;
+    boolean hasStats;
+    assert(ft != NULL);
+    FT_resetStats();
+    FT_setTraceHook(countCall, counts);
+    assert(FT_T_insertDir(ft, "s/a") == SUCCESS);
+    assert(FT_T_insertFile(ft, "s/a/f", NULL, 0) == SUCCESS);
+    assert(FT_T_containsFile(ft, "s/a/f") == TRUE);
+    assert(FT_T_rmDir(ft, "s/b") == NO_SUCH_PATH);
+    assert((temp = FT_T_toString(ft)) != NULL);
+    free(temp);
+    assert(FT_T_containsDir(ft, "s") == TRUE);
+    FT_setTraceHook(NULL, NULL);
+    hasStats = FT_getStats(&report);
+    if (hasStats) {
+      assert(counts[0] == 6);
+      assert(report.ops[STATS_INSERT_DIR].calls == 1);
+      assert(report.ops[STATS_INSERT_FILE].calls == 1);
+      assert(report.ops[STATS_CONTAINS].calls == 2);
+      assert(report.ops[STATS_RM_DIR].calls == 1);
+      assert(report.ops[STATS_TO_STRING].calls == 1);
+      assert(report.ops[STATS_INSERT_FILE].counts[STATS_ALLOCS] > 0);
+      assert(report.ops[STATS_TO_STRING].counts[STATS_NODES_VISITED]
+             >= 3);
+      for (i = 0; i < STATS_NUM_OPS; i++)
+        calls += report.ops[i].counts[STATS_NODES_VISITED];
+      assert(calls == counts[1]);
+      calls = 0;
+      for (i = 0; i < STATS_NUM_BUCKETS; i++)
+        calls += report.ops[STATS_CONTAINS].latency[i];
+      assert(calls == 2);
+    }
+    else {
+      assert(counts[0] == 0);
+      assert(report.ops[STATS_INSERT_DIR].calls == 0);
+      assert(report.ops[STATS_CONTAINS].counts[STATS_COMPARES] == 0);
+    }
+    FT_resetStats();
+    assert(FT_getStats(&report) == hasStats);
+    assert(report.ops[STATS_INSERT_DIR].calls == 0);
+    FT_free(ft);
+  }
+
   assert(FT_destroy() == SUCCESS);
   assert(FT_destroy() == INITIALIZATION_ERROR);
+  temp = "a";
+  assert(FT_containsFileBatch(&temp, 1, &b) == INITIALIZATION_ERROR);
+  assert(b == FALSE);
   assert(FT_containsDir("a") == FALSE);
   assert(FT_containsFile("a") == FALSE);
 
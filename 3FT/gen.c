@@ -0,0 +1,288 @@
+/*--------------------------------------------------------------------*/
+/* gen.c                                                              */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "gen.h"
+
+
+/* The number of paths a Gen_T has room for at first. */
+enum { GEN_MIN_PATHS = 64 };
+
+
+/* The number of letters names are spelled with. */
+enum { GEN_LETTERS = 26 };
+
+
+/* The paths of a synthetic tree. */
+struct Gen {
+   /* the shape the paths were generated from */
+   struct Gen_shape shape;
+
+   /* the paths, parents before children, whether each is a file,
+      and the number of each there are and there is room for */
+   char** paths;
+   char* isFile;
+   size_t count;
+   size_t capacity;
+
+   /* the state of the generator picking names and files */
+   unsigned long state;
+};
+
+
+/*
+    Returns the next of a sequence of numbers from 0 to 65535 drawn
+    from g's state, which is the same on every machine for a seed.
+*/
+static unsigned Gen_next(Gen_T g) {
+   assert(g != NULL);
+
+   g->state = (g->state * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+   return (unsigned) (g->state >> 16);
+}
+
+
+/*
+    Appends path, a file if isFile is 1, to g, which takes ownership
+    of it. Returns 1, or 0 if allocation error occurs, in which case g
+    is unchanged.
+*/
+static int Gen_add(Gen_T g, char* path, int isFile) {
+   char** paths;
+   char* flags;
+
+   assert(g != NULL);
+   assert(path != NULL);
+
+   if (g->count == g->capacity) {
+      paths = realloc(g->paths, 2 * g->capacity * sizeof(char*));
+      if (paths == NULL)
+         return 0;
+      g->paths = paths;
+      flags = realloc(g->isFile, 2 * g->capacity);
+      if (flags == NULL)
+         return 0;
+      g->isFile = flags;
+      g->capacity *= 2;
+   }
+
+   g->paths[g->count] = path;
+   g->isFile[g->count] = (char) isFile;
+   g->count++;
+   return 1;
+}
+
+
+/*
+    Returns a new path naming child index of parent, which is NULL for
+    the root, or NULL if allocation error occurs. The name is random
+    letters, ending with index spelled in letters so that siblings
+    differ.
+*/
+static char* Gen_name(Gen_T g, const char* parent, size_t index) {
+   char* path;
+   char* name;
+   size_t start = 0;
+   size_t i;
+
+   assert(g != NULL);
+
+   if (parent != NULL)
+      start = strlen(parent) + 1;
+   path = malloc(start + g->shape.nameLength + 1);
+   if (path == NULL)
+      return NULL;
+
+   if (parent != NULL) {
+      strcpy(path, parent);
+      path[start - 1] = '/';
+   }
+   name = path + start;
+   for (i = 0; i < g->shape.nameLength; i++)
+      name[i] = (char) ('a' + Gen_next(g) % GEN_LETTERS);
+   for (i = g->shape.nameLength; index > 0; index /= GEN_LETTERS)
+      name[--i] = (char) ('a' + index % GEN_LETTERS);
+   name[g->shape.nameLength] = '\0';
+   return path;
+}
+
+
+/*
+    Appends to g the paths below parent, a directory at level level,
+    parents before children. Returns 1, or 0 if allocation error
+    occurs.
+*/
+static int Gen_grow(Gen_T g, const char* parent, size_t level) {
+   char* path;
+   int isFile;
+   size_t i;
+
+   assert(g != NULL);
+   assert(parent != NULL);
+
+   if (level == g->shape.depth)
+      return 1;
+
+   for (i = 0; i < g->shape.fanout; i++) {
+      isFile = Gen_next(g) < g->shape.fileRatio * 65536.0;
+      path = Gen_name(g, parent, i);
+      if (path == NULL)
+         return 0;
+      if (!Gen_add(g, path, isFile)) {
+         free(path);
+         return 0;
+      }
+      if (!isFile && !Gen_grow(g, path, level + 1))
+         return 0;
+   }
+   return 1;
+}
+
+
+/* see gen.h for specification */
+int Gen_parseShape(int argc, char* argv[], struct Gen_shape* pShape) {
+   char* end;
+   double value;
+   int i;
+
+   assert(argv != NULL);
+   assert(pShape != NULL);
+
+   for (i = 1; i < argc; i += 2) {
+      if (strlen(argv[i]) != 2 || argv[i][0] != '-' || i + 1 == argc)
+         return 0;
+      value = strtod(argv[i + 1], &end);
+      if (end == argv[i + 1] || *end != '\0' || value < 0)
+         return 0;
+
+      switch (argv[i][1]) {
+         case 'f':
+            if (value > 1)
+               return 0;
+            pShape->fileRatio = value;
+            continue;
+         case 'd':
+            pShape->depth = (size_t) value;
+            break;
+         case 'w':
+            pShape->fanout = (size_t) value;
+            break;
+         case 'l':
+            pShape->nameLength = (size_t) value;
+            break;
+         case 's':
+            pShape->seed = (unsigned long) value;
+            break;
+         default:
+            return 0;
+      }
+      /* the others are counts */
+      if (value != (double) (unsigned long) value)
+         return 0;
+   }
+   return 1;
+}
+
+
+/* see gen.h for specification */
+Gen_T Gen_new(const struct Gen_shape* pShape) {
+   Gen_T g;
+   char* root;
+   size_t digits = 1;
+   size_t last;
+
+   assert(pShape != NULL);
+
+   g = malloc(sizeof(struct Gen));
+   if (g == NULL)
+      return NULL;
+
+   g->shape = *pShape;
+   for (last = g->shape.fanout; last > GEN_LETTERS; last /= GEN_LETTERS)
+      digits++;
+   if (g->shape.nameLength < digits)
+      g->shape.nameLength = digits;
+   g->state = g->shape.seed;
+   g->count = 0;
+   g->capacity = GEN_MIN_PATHS;
+   g->paths = malloc(GEN_MIN_PATHS * sizeof(char*));
+   g->isFile = malloc(GEN_MIN_PATHS);
+   if (g->paths == NULL || g->isFile == NULL) {
+      Gen_free(g);
+      return NULL;
+   }
+
+   root = Gen_name(g, NULL, 0);
+   if (root == NULL || !Gen_add(g, root, 0)) {
+      free(root);
+      Gen_free(g);
+      return NULL;
+   }
+   if (!Gen_grow(g, root, 0)) {
+      Gen_free(g);
+      return NULL;
+   }
+   return g;
+}
+
+
+/* see gen.h for specification */
+void Gen_free(Gen_T g) {
+   size_t i;
+
+   assert(g != NULL);
+
+   for (i = 0; i < g->count; i++)
+      free(g->paths[i]);
+   free(g->paths);
+   free(g->isFile);
+   free(g);
+}
+
+
+/* see gen.h for specification */
+size_t Gen_getCount(Gen_T g) {
+   assert(g != NULL);
+
+   return g->count;
+}
+
+
+/* see gen.h for specification */
+char* Gen_getPath(Gen_T g, size_t i) {
+   assert(g != NULL);
+   assert(i < g->count);
+
+   return g->paths[i];
+}
+
+
+/* see gen.h for specification */
+int Gen_isFile(Gen_T g, size_t i) {
+   assert(g != NULL);
+   assert(i < g->count);
+
+   return g->isFile[i];
+}
+
+
+/* see gen.h for specification */
+void Gen_printShape(Gen_T g, FILE* stream) {
+   assert(g != NULL);
+   assert(stream != NULL);
+
+   fprintf(stream,
+           "# depth=%lu fanout=%lu files=%.2f length=%lu seed=%lu "
+           "paths=%lu\n",
+           (unsigned long) g->shape.depth,
+           (unsigned long) g->shape.fanout, g->shape.fileRatio,
+           (unsigned long) g->shape.nameLength, g->shape.seed,
+           (unsigned long) g->count);
+}
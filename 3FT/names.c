@@ -0,0 +1,534 @@
+/*--------------------------------------------------------------------*/
+/* names.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+#include "a4def.h"
+#include "arena.h"
+#include "names.h"
+#include "stats.h"
+
+
+/* The number of slots the pool, and an arena's table, start with,
+   powers of two. */
+enum { NAMES_MIN_SLOTS = 256, NAMES_MIN_LOCAL = 32 };
+
+
+/* An interned name, whose chars are stored just after this struct,
+   which is kept to 16 bytes so that an entry for a short name fits
+   in a block of 32. */
+struct Names_entry {
+   /* the number of references to this name */
+   size_t refs;
+
+   /* the length of the name, and its hash */
+   unsigned int length;
+   unsigned int hash;
+};
+
+
+/* A slot of the pool. */
+struct Names_slot {
+   /* the hash of the name, compared before the name itself so that
+      most probes need not touch it */
+   size_t hash;
+
+   /* the name, or NULL if the slot is free */
+   struct Names_entry* entry;
+};
+
+
+/* A slot of an arena's table. */
+struct Names_local {
+   /* the name, or NULL if the slot is free */
+   const char* name;
+
+   /* the references to the name taken through the arena, which
+      together hold one in the pool */
+   size_t refs;
+};
+
+
+/* The table of the names of the nodes allocated from an arena (see
+   Names_openArena), which is kept like the pool but fuller (see
+   Names_reserveLocal). */
+struct Names_table {
+   /* the arena the table is allocated from */
+   Arena_T arena;
+
+   /* the slots, NULL until the first name comes, and how many of
+      them hold one */
+   struct Names_local* slots;
+   size_t numSlots;
+   size_t numEntries;
+};
+
+
+/*
+   The pool is a hash table of names with open addressing and linear
+   probing, kept at most half full so that probes are short and
+   always end. Names only leave it when it is rebuilt, so it needs no
+   markers for removed ones, and references are released without the
+   lock, as they never free anything. The names are carved from the
+   slabs of entries.
+*/
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct Names_slot* slots;
+static size_t numSlots;
+static size_t numEntries;
+static Arena_T entries;
+
+
+/*
+   Returns the entry of interned name.
+*/
+static struct Names_entry* Names_entryOf(const char* name) {
+   assert(name != NULL);
+
+   return (struct Names_entry*) name - 1;
+}
+
+
+/* see names.h for specification */
+size_t Names_hash(const char* chars, size_t len) {
+   size_t hash = 2166136261U;
+   size_t i;
+
+   assert(chars != NULL);
+
+   /* FNV-1a */
+   for (i = 0; i < len; i++) {
+      hash ^= (unsigned char) chars[i];
+      hash *= 16777619U;
+   }
+   /* the slot is picked by the low bits, which FNV mixes least, and
+      an entry keeps only those that fit in an unsigned int */
+   return (unsigned int) (hash ^ (hash >> 16));
+}
+
+
+/*
+   Returns the size of the block entry is stored in, which holds a
+   name of length len.
+*/
+static size_t Names_entrySize(size_t len) {
+   return sizeof(struct Names_entry) + len + 1;
+}
+
+
+/*
+   Puts entry in the first free slot of the count slots it probes in
+   table.
+*/
+static void Names_put(struct Names_slot* table, size_t count,
+struct Names_entry* entry) {
+   size_t mask = count - 1;
+   size_t i;
+
+   for (i = entry->hash & mask; table[i].entry != NULL;
+        i = (i + 1) & mask)
+      ;
+   table[i].hash = entry->hash;
+   table[i].entry = entry;
+}
+
+
+/*
+   Moves the names in the pool into a new table of count slots, which
+   must have room for them, freeing those no one refers to. Returns
+   TRUE if successful, or FALSE if allocation error, in which case
+   the pool is unchanged. The lock must be held.
+*/
+static boolean Names_rebuild(size_t count) {
+   struct Names_slot* table;
+   struct Names_entry* entry;
+   size_t i;
+
+   table = calloc(count, sizeof(struct Names_slot));
+   if (table == NULL)
+      return FALSE;
+
+   for (i = 0; i < numSlots; i++) {
+      entry = slots[i].entry;
+      if (entry == NULL)
+         continue;
+      /* only Names_intern, which holds the lock, takes a reference
+         to a name no one refers to */
+      if (__atomic_load_n(&entry->refs, __ATOMIC_ACQUIRE) == 0) {
+         Arena_release(entries, entry, Names_entrySize(entry->length));
+         numEntries--;
+      }
+      else
+         Names_put(table, count, entry);
+   }
+
+   free(slots);
+   slots = table;
+   numSlots = count;
+   return TRUE;
+}
+
+
+/*
+   Makes room in the pool for one more name, first by freeing the
+   names no one refers to and then, if that does not leave it at
+   most a quarter full, by growing it, so that it fills up again only
+   after as many names as it has. Returns TRUE if successful, or
+   FALSE if allocation error. The lock must be held.
+*/
+static boolean Names_reserve(void) {
+   if (slots == NULL)
+      return Names_rebuild(NAMES_MIN_SLOTS);
+   if (2 * (numEntries + 1) <= numSlots)
+      return TRUE;
+
+   if (!Names_rebuild(numSlots))
+      return FALSE;
+   if (4 * (numEntries + 1) > numSlots &&
+       !Names_rebuild(2 * numSlots) &&
+       2 * (numEntries + 1) > numSlots)
+      return FALSE;
+   return TRUE;
+}
+
+
+/*
+   Does the work of Names_intern, hash being Names_hash of the len
+   chars at chars.
+*/
+static const char* Names_internHash(const char* chars, size_t len,
+size_t hash) {
+   struct Names_entry* entry;
+   size_t mask;
+   size_t i;
+
+   assert(chars != NULL);
+
+   (void) pthread_mutex_lock(&lock);
+
+   if (slots != NULL) {
+      mask = numSlots - 1;
+      for (i = hash & mask; slots[i].entry != NULL;
+           i = (i + 1) & mask) {
+         entry = slots[i].entry;
+         if (slots[i].hash == hash && entry->length == len &&
+             memcmp(entry + 1, chars, len) == 0) {
+            (void) __atomic_add_fetch(&entry->refs, 1,
+                                      __ATOMIC_RELAXED);
+            (void) pthread_mutex_unlock(&lock);
+            return (const char*) (entry + 1);
+         }
+      }
+   }
+
+   if (entries == NULL)
+      entries = Arena_new();
+   entry = NULL;
+   if (entries != NULL &&
+       len < UINT_MAX &&
+       Names_reserve())
+      entry = Arena_alloc(entries, Names_entrySize(len));
+   if (entry == NULL) {
+      (void) pthread_mutex_unlock(&lock);
+      return NULL;
+   }
+
+   entry->refs = 1;
+   entry->length = (unsigned int) len;
+   entry->hash = (unsigned int) hash;
+   memcpy(entry + 1, chars, len);
+   ((char*) (entry + 1))[len] = '\0';
+   Names_put(slots, numSlots, entry);
+   numEntries++;
+
+   (void) pthread_mutex_unlock(&lock);
+   return (const char*) (entry + 1);
+}
+
+
+/* see names.h for specification */
+const char* Names_intern(const char* chars, size_t len) {
+   assert(chars != NULL);
+
+   return Names_internHash(chars, len, Names_hash(chars, len));
+}
+
+
+/* see names.h for specification */
+const char* Names_retain(const char* name) {
+   assert(name != NULL);
+
+   (void) __atomic_add_fetch(&Names_entryOf(name)->refs, 1,
+                             __ATOMIC_RELAXED);
+   return name;
+}
+
+
+/* see names.h for specification */
+void Names_release(const char* name) {
+   if (name == NULL)
+      return;
+
+   /* the name is freed, by a rebuild, only once this is seen */
+   (void) __atomic_sub_fetch(&Names_entryOf(name)->refs, 1,
+                             __ATOMIC_RELEASE);
+}
+
+
+/* see names.h for specification */
+size_t Names_getLength(const char* name) {
+   return Names_entryOf(name)->length;
+}
+
+
+/* see names.h for specification */
+size_t Names_getHash(const char* name) {
+   return Names_entryOf(name)->hash;
+}
+
+
+/* see names.h for specification */
+void Names_getStats(struct Names_stats* pStats) {
+   struct Names_entry* entry;
+   size_t refs;
+   size_t i;
+
+   assert(pStats != NULL);
+
+   pStats->numNames = 0;
+   pStats->numBytes = 0;
+   pStats->numRefs = 0;
+   pStats->numRefBytes = 0;
+
+   (void) pthread_mutex_lock(&lock);
+   for (i = 0; i < numSlots; i++) {
+      entry = slots[i].entry;
+      if (entry == NULL)
+         continue;
+      refs = __atomic_load_n(&entry->refs, __ATOMIC_RELAXED);
+      if (refs == 0)
+         continue;
+      pStats->numNames++;
+      pStats->numBytes += entry->length;
+      pStats->numRefs += refs;
+      pStats->numRefBytes += refs * entry->length;
+   }
+   (void) pthread_mutex_unlock(&lock);
+}
+
+
+/*
+   Puts name, with refs references, in the first free slot of the
+   count slots it probes in table.
+*/
+static void Names_putLocal(struct Names_local* table, size_t count,
+const char* name, size_t refs) {
+   size_t mask = count - 1;
+   size_t i;
+
+   for (i = Names_getHash(name) & mask; table[i].name != NULL;
+        i = (i + 1) & mask)
+      ;
+   table[i].name = name;
+   table[i].refs = refs;
+}
+
+
+/*
+   Moves the names in pTable into new slots, count of them, which
+   must have room for them, letting go of those no reference is
+   taken to through pTable's arena. Returns TRUE if successful, or
+   FALSE if allocation error, in which case pTable is unchanged.
+*/
+static boolean Names_rebuildLocal(struct Names_table* pTable,
+size_t count) {
+   struct Names_local* table;
+   struct Names_local* local;
+   size_t i;
+
+   table = Arena_alloc(pTable->arena,
+                       count * sizeof(struct Names_local));
+   if (table == NULL)
+      return FALSE;
+   for (i = 0; i < count; i++)
+      table[i].name = NULL;
+
+   for (i = 0; i < pTable->numSlots; i++) {
+      local = &pTable->slots[i];
+      if (local->name == NULL)
+         continue;
+      if (local->refs == 0) {
+         Names_release(local->name);
+         pTable->numEntries--;
+      }
+      else
+         Names_putLocal(table, count, local->name, local->refs);
+   }
+
+   Arena_release(pTable->arena, pTable->slots,
+                 pTable->numSlots * sizeof(struct Names_local));
+   pTable->slots = table;
+   pTable->numSlots = count;
+   return TRUE;
+}
+
+
+/*
+   Makes room in pTable for one more name, as Names_reserve does for
+   the pool, but letting pTable fill up to three quarters, since it
+   is probed by pointer and is as large as the pool for a tree of
+   distinct names. Returns TRUE if successful, or FALSE if allocation
+   error.
+*/
+static boolean Names_reserveLocal(struct Names_table* pTable) {
+   if (pTable->slots == NULL)
+      return Names_rebuildLocal(pTable, NAMES_MIN_LOCAL);
+   if (4 * (pTable->numEntries + 1) <= 3 * pTable->numSlots)
+      return TRUE;
+
+   if (!Names_rebuildLocal(pTable, pTable->numSlots))
+      return FALSE;
+   if (2 * (pTable->numEntries + 1) > pTable->numSlots &&
+       !Names_rebuildLocal(pTable, 2 * pTable->numSlots) &&
+       4 * (pTable->numEntries + 1) > 3 * pTable->numSlots)
+      return FALSE;
+   return TRUE;
+}
+
+
+/*
+   Returns the slot of interned name in pTable, which must hold it.
+*/
+static struct Names_local* Names_findLocal(struct Names_table* pTable,
+const char* name) {
+   size_t mask;
+   size_t i;
+
+   assert(pTable != NULL);
+   assert(name != NULL);
+   assert(pTable->slots != NULL);
+
+   mask = pTable->numSlots - 1;
+   for (i = Names_getHash(name) & mask; pTable->slots[i].name != name;
+        i = (i + 1) & mask)
+      assert(pTable->slots[i].name != NULL);
+   return &pTable->slots[i];
+}
+
+
+/* see names.h for specification */
+boolean Names_openArena(Arena_T arena) {
+   struct Names_table* table;
+
+   assert(arena != NULL);
+   assert(Arena_getExtra(arena) == NULL);
+
+   table = Arena_alloc(arena, sizeof(struct Names_table));
+   if (table == NULL)
+      return FALSE;
+   table->arena = arena;
+   table->slots = NULL;
+   table->numSlots = 0;
+   table->numEntries = 0;
+   Arena_setExtra(arena, table);
+   return TRUE;
+}
+
+
+/* see names.h for specification */
+void Names_closeArena(Arena_T arena) {
+   struct Names_table* table;
+   size_t i;
+
+   table = Arena_getExtra(arena);
+   if (table == NULL)
+      return;
+
+   for (i = 0; i < table->numSlots; i++)
+      Names_release(table->slots[i].name);
+   Arena_setExtra(arena, NULL);
+}
+
+
+/* see names.h for specification */
+const char* Names_internIn(Arena_T arena, const char* chars,
+size_t len) {
+   struct Names_table* table;
+   struct Names_local* local;
+   const char* name;
+   size_t hash;
+   size_t mask;
+   size_t i;
+
+   assert(chars != NULL);
+
+   table = Arena_getExtra(arena);
+   if (table == NULL)
+      return Names_intern(chars, len);
+
+   hash = Names_hash(chars, len);
+   if (table->slots != NULL) {
+      mask = table->numSlots - 1;
+      for (i = hash & mask; table->slots[i].name != NULL;
+           i = (i + 1) & mask) {
+         local = &table->slots[i];
+         if (Names_getHash(local->name) == hash &&
+             Names_getLength(local->name) == len &&
+             memcmp(local->name, chars, len) == 0) {
+            local->refs++;
+            return local->name;
+         }
+      }
+   }
+
+   if (!Names_reserveLocal(table))
+      return NULL;
+   name = Names_internHash(chars, len, hash);
+   if (name == NULL)
+      return NULL;
+   Names_putLocal(table->slots, table->numSlots, name, 1);
+   table->numEntries++;
+   return name;
+}
+
+
+/* see names.h for specification */
+const char* Names_retainIn(Arena_T arena, const char* name) {
+   struct Names_table* table;
+
+   assert(name != NULL);
+
+   table = Arena_getExtra(arena);
+   if (table == NULL)
+      return Names_retain(name);
+
+   Names_findLocal(table, name)->refs++;
+   return name;
+}
+
+
+/* see names.h for specification */
+void Names_releaseIn(Arena_T arena, const char* name) {
+   struct Names_table* table;
+
+   if (name == NULL)
+      return;
+
+   table = Arena_getExtra(arena);
+   if (table == NULL) {
+      Names_release(name);
+      return;
+   }
+
+   /* the name stays in the table, holding its reference in the
+      pool, until the table is next rebuilt */
+   Names_findLocal(table, name)->refs--;
+}
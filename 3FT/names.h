@@ -0,0 +1,131 @@
+/*--------------------------------------------------------------------*/
+/* names.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef NAMES_INCLUDED
+#define NAMES_INCLUDED
+
+
+#include <stddef.h>
+#include "a4def.h"
+#include "arena.h"
+
+
+/*
+    The pool of interned names. Each distinct name given to a node of
+    any File Tree is stored once, with a count of the references to
+    it, however many nodes bear it, and keeps its length and hash
+    beside it, so that neither needs its chars gone over again. Two
+    interned names are equal exactly if they are the same pointer.
+
+    A name whose last reference is released stays in the pool, to be
+    taken up again if interned, until the pool next needs room. The
+    pool may be used by many threads at once; its names are carved
+    from slabs (see arena.h), and those interned, but not those
+    released, take a lock shared by every thread.
+
+    An arena's nodes take their names through a table of the arena's
+    own, layered on the pool (see Names_openArena).
+*/
+
+
+/* Counts describing the pool, as Names_getStats fills them in. */
+struct Names_stats {
+   /* the names referred to, and their total length */
+   size_t numNames;
+   size_t numBytes;
+
+   /* the references to them, an arena's table holding one to each
+      of its names however many of its nodes bear it, and the total
+      length they would take if each were a copy */
+   size_t numRefs;
+   size_t numRefBytes;
+};
+
+
+/*
+    Returns the interned copy of the len chars at chars, which hold
+    no '\0', with a reference held by the caller, or NULL if
+    allocation error occurs. The copy is '\0'-terminated.
+*/
+const char* Names_intern(const char* chars, size_t len);
+
+
+/*
+    Takes another reference to interned name and returns it.
+*/
+const char* Names_retain(const char* name);
+
+
+/*
+    Releases a reference to interned name. Does nothing if name is
+    NULL.
+*/
+void Names_release(const char* name);
+
+
+/*
+    Returns the length of interned name.
+*/
+size_t Names_getLength(const char* name);
+
+
+/*
+    Returns the hash of interned name, which is Names_hash of its
+    chars.
+*/
+size_t Names_getHash(const char* name);
+
+
+/*
+    Returns the hash of the len chars at chars.
+*/
+size_t Names_hash(const char* chars, size_t len);
+
+
+/*
+    Gives arena a table of the names of the nodes allocated from it,
+    itself allocated from arena. The first reference to a name taken
+    through arena takes one from the pool, which the table holds for
+    every later one, so that those are counted in the table alone,
+    without the pool's lock, and Names_closeArena lets go of them all
+    at once. A name no reference through arena is left to stays in
+    the table until the table next needs room. The table, like arena,
+    may be used by one thread at a time. Returns TRUE, or FALSE if
+    allocation error occurs. arena must not already have a table.
+*/
+boolean Names_openArena(Arena_T arena);
+
+
+/*
+    Releases the references to the pool held by arena's table, and so
+    every reference to a name taken through arena, and takes the
+    table from arena, which frees it when freed itself. Meant for
+    just before arena and the nodes allocated from it are freed
+    whole. Does nothing if arena is NULL or has no table.
+*/
+void Names_closeArena(Arena_T arena);
+
+
+/*
+    As Names_intern, Names_retain and Names_release, but taking or
+    releasing a reference through arena's table (see
+    Names_openArena), or through the pool itself if arena is NULL or
+    has no table. A reference taken through an arena must be released
+    through it.
+*/
+const char* Names_internIn(Arena_T arena, const char* chars,
+size_t len);
+const char* Names_retainIn(Arena_T arena, const char* name);
+void Names_releaseIn(Arena_T arena, const char* name);
+
+
+/*
+    Fills in *pStats for the pool. Names no one refers to are not
+    counted.
+*/
+void Names_getStats(struct Names_stats* pStats);
+
+#endif
@@ -12,88 +12,267 @@
 
 #include "nodeDir.h"
 #include "dynarray.h"
+#include "names.h"
+#include "path.h"
+#include "stats.h"
+
+
+/*
+  The number of children of a kind at which a NodeDir starts keeping
+  an index of them by name, besides the array of them.
+*/
+enum { NODEDIR_INDEX_MIN = 64 };
+
+
+/* A slot of an index of children. */
+struct NodeDir_slot {
+   /* the hash of the child's name, compared before the name itself
+      so that most probes need not touch the child */
+   size_t hash;
+
+   /* the child, NULL if the slot has never been used, or
+      NodeDir_removed if its child has since been unlinked */
+   void* child;
+};
+
+
+/*
+  An index of the children of a kind of a NodeDir: a hash table on
+  their names with open addressing and linear probing, kept at most
+  half full so that probes are short and always end.
+*/
+struct NodeDir_index {
+   /* the slots, of which there are a power of two */
+   struct NodeDir_slot* slots;
+   size_t numSlots;
+
+   /* the number of slots holding a child, and of those together
+      with the ones whose child has been unlinked */
+   size_t numChildren;
+   size_t numUsed;
+
+   /* the index this one replaced, which concurrent readers may have
+      been using when it was, or NULL; it is freed with this one */
+   struct NodeDir_index* replaced;
+};
+
+
+/* The marker left in a slot whose child has been unlinked. */
+static char NodeDir_removed;
 
 
 /* A node structure representing a dir. */
 struct nodeDir {
-   /* the full path of this directory */
-   char* path;
+   /* the name of this directory: the last component of its path,
+      interned (see names.h), or the first of its chain's */
+   const char* name;
+
+   /* the label of this node (see NodeDir_getLabel), of length
+      labelLength. It is name unless this node has ever stood for a
+      chain of directories, in which case it points into chain, the
+      interned label the node was created with or split from; chain
+      is NULL otherwise. A split only shortens labelLength, so the
+      chain past it is kept for the join that undoes it */
+   const char* label;
+   size_t labelLength;
+   const char* chain;
 
    /* the parent directory of this node
       NULL for the root of the directory tree */
    NodeDir parent;
 
    /* the subdirectories of this directory
-      stored in sorted order by pathname */
+      stored in sorted order by name, each keyed by NodeDir_nameKey
+      of its name */
    DynArray_T childrenDirs;
 
    /* the subfiles of this directory
-      stored in sorted order by pathname */
+      stored in sorted order by name, keyed likewise */
    DynArray_T childrenFiles;
+
+   /* indexes of childrenDirs and childrenFiles by name, or NULL
+      until they reach NODEDIR_INDEX_MIN children */
+   struct NodeDir_index* dirIndex;
+   struct NodeDir_index* fileIndex;
+
+   /* FALSE if children have been added to the end of childrenDirs
+      or childrenFiles out of order since it was last sorted. Only
+      an indexed array is added to that way, and only by the
+      functions that do not publish their changes, so an array
+      concurrent readers can see is always sorted; the others are
+      sorted when next iterated or searched by position */
+   boolean dirsSorted;
+   boolean filesSorted;
+
+   /* the number of directories (those of this node included) and
+      NodeFiles in the hierarchy rooted at this node, and the total
+      length of the files' contents, kept up to date as nodes are
+      linked below it */
+   size_t totalDirs;
+   size_t totalFiles;
+   size_t totalBytes;
+
+   /* TRUE while this node is linked into its parent's children, so
+      that changes to its totals are passed up to its ancestors' */
+   boolean isLinked;
+
+   /* the arena this node and its children arrays are allocated
+      from, or NULL if they are malloc'd */
+   Arena_T arena;
 };
 
 
 /*
-  returns a path with contents
-  n->path/dir
-  or NULL if there is an allocation error.
+  Returns n's array of child NodeDirs as last published. Arrays that
+  concurrent readers may see are replaced whole rather than changed
+  (see NodeDir_linkChildDirShared), so a reader that loads one sees
+  it fully built.
+*/
+static DynArray_T NodeDir_dirs(NodeDir n) {
+   return __atomic_load_n(&n->childrenDirs, __ATOMIC_ACQUIRE);
+}
 
-  Allocates memory for the returned string,
-  which is then owened by the caller!
+
+/*
+  Returns n's array of child NodeFiles as last published.
 */
-static char* NodeDir_buildPath(NodeDir n, const char* dir) {
-   char* path;
+static DynArray_T NodeDir_files(NodeDir n) {
+   return __atomic_load_n(&n->childrenFiles, __ATOMIC_ACQUIRE);
+}
 
-   assert(dir != NULL);
 
-   if(n == NULL)
-      path = malloc(strlen(dir)+1);
-   else
-      path = malloc(strlen(n->path) + 1 + strlen(dir) + 1);
+/*
+  Returns the index of n's child NodeDirs as last published, or NULL.
+*/
+static struct NodeDir_index* NodeDir_dirIndex(NodeDir n) {
+   return __atomic_load_n(&n->dirIndex, __ATOMIC_ACQUIRE);
+}
+
 
-   if(path == NULL)
-      return NULL;
-   *path = '\0';
+/*
+  Returns the index of n's child NodeFiles as last published, or NULL.
+*/
+static struct NodeDir_index* NodeDir_fileIndex(NodeDir n) {
+   return __atomic_load_n(&n->fileIndex, __ATOMIC_ACQUIRE);
+}
 
-   if(n != NULL) {
-      strcpy(path, n->path);
-      strcat(path, "/");
-   }
-   strcat(path, dir);
 
-   return path;
+/*
+  Gives index, and the indexes it replaced, back to arena. Does
+  nothing if index is NULL.
+*/
+static void NodeDir_freeIndex(struct NodeDir_index* index,
+Arena_T arena) {
+   struct NodeDir_index* replaced;
+
+   while (index != NULL) {
+      replaced = index->replaced;
+      Arena_release(arena, index->slots,
+                    index->numSlots * sizeof(struct NodeDir_slot));
+      Arena_release(arena, index, sizeof(struct NodeDir_index));
+      index = replaced;
+   }
 }
 
+
 /* see nodeDir.h for specification */
 NodeDir NodeDir_create(const char* name, NodeDir parent) {
+   return NodeDir_createIn(name, parent, NULL);
+}
 
-   NodeDir new;
 
+/*
+  Returns the number of components of the length chars starting at
+  label, which are separated by single slashes.
+*/
+static size_t NodeDir_countComponents(const char* label,
+size_t length) {
+   const char* slash;
+   size_t count = 1;
+
+   assert(label != NULL);
+
+   while ((slash = memchr(label, '/', length)) != NULL) {
+      count++;
+      length -= (size_t) (slash + 1 - label);
+      label = slash + 1;
+   }
+   return count;
+}
+
+
+/* see nodeDir.h for specification */
+NodeDir NodeDir_createIn(const char* name, NodeDir parent,
+Arena_T arena) {
    assert(name != NULL);
 
-   new = malloc(sizeof(struct nodeDir));
+   return NodeDir_createChainIn(name, strlen(name), parent, arena);
+}
+
+
+/* see nodeDir.h for specification */
+NodeDir NodeDir_createChainIn(const char* label, size_t length,
+NodeDir parent, Arena_T arena) {
+
+   NodeDir new;
+   const char* slash;
+   size_t nameLength = length;
+
+   assert(label != NULL);
+
+   new = Arena_alloc(arena, sizeof(struct nodeDir));
    if(new == NULL)
       return NULL;
 
-   new->path = NodeDir_buildPath(parent, name);
+   slash = memchr(label, '/', length);
+   if (slash != NULL)
+      nameLength = (size_t) (slash - label);
 
-   if(new->path == NULL) {
-      free(new);
+   new->arena = arena;
+   new->name = Names_internIn(arena, label, nameLength);
+   if(new->name == NULL) {
+      Arena_release(arena, new, sizeof(struct nodeDir));
       return NULL;
    }
 
-   new->parent = parent;
+   new->label = new->name;
+   new->labelLength = nameLength;
+   new->chain = NULL;
+   if (slash != NULL) {
+      new->chain = Names_internIn(arena, label, length);
+      if (new->chain == NULL) {
+         Names_releaseIn(arena, new->name);
+         Arena_release(arena, new, sizeof(struct nodeDir));
+         return NULL;
+      }
+      new->label = new->chain;
+      new->labelLength = length;
+   }
 
-   new->childrenDirs = DynArray_new(0);
+   new->parent = parent;
+   new->dirIndex = NULL;
+   new->fileIndex = NULL;
+   new->dirsSorted = TRUE;
+   new->filesSorted = TRUE;
+   new->totalDirs = slash == NULL ? 1 :
+      NodeDir_countComponents(label, length);
+   new->totalFiles = 0;
+   new->totalBytes = 0;
+   new->isLinked = FALSE;
+
+   new->childrenDirs = DynArray_newKeyedIn(0, arena);
    if(new->childrenDirs == NULL) {
-      free(new->path);
-      free(new);
+      Names_releaseIn(arena, new->chain);
+      Names_releaseIn(arena, new->name);
+      Arena_release(arena, new, sizeof(struct nodeDir));
       return NULL;
    }
-   new->childrenFiles = DynArray_new(0);
+   new->childrenFiles = DynArray_newKeyedIn(0, arena);
    if(new->childrenFiles == NULL) {
-      free(new->path);
-      free(new);
+      DynArray_free(new->childrenDirs);
+      Names_releaseIn(arena, new->chain);
+      Names_releaseIn(arena, new->name);
+      Arena_release(arena, new, sizeof(struct nodeDir));
       return NULL;
    }
 
@@ -101,241 +280,1533 @@ NodeDir NodeDir_create(const char* name, NodeDir parent) {
 }
 
 
+/*
+  Frees NodeDir n, which has no children left, together with its
+  arrays of children, indexes, name and label.
+*/
+static void NodeDir_free(NodeDir n) {
+   assert(n != NULL);
+
+   DynArray_free(n->childrenFiles);
+   DynArray_free(n->childrenDirs);
+
+   NodeDir_freeIndex(n->dirIndex, n->arena);
+   NodeDir_freeIndex(n->fileIndex, n->arena);
+
+   Names_releaseIn(n->arena, n->chain);
+   Names_releaseIn(n->arena, n->name);
+   Arena_release(n->arena, n, sizeof(struct nodeDir));
+}
+
+
+/*
+  Does the work of NodeDir_destroySome, and adds the number of
+  NodeDirs destroyed to *pDirs. Each node is emptied from the end of
+  its arrays, so nothing shifts, and destroyed once it has no
+  children left; the walk goes back up by parent links, so it needs
+  no stack, and the nodes above *pCurr are untouched, so it can stop
+  anywhere.
+*/
+static boolean NodeDir_destroyFrom(NodeDir root, NodeDir* pCurr,
+size_t* pBudget, size_t* pDirs) {
+   NodeDir curr;
+   NodeDir parent;
+   size_t num;
+
+   assert(root != NULL);
+   assert(pCurr != NULL);
+   assert(*pCurr != NULL);
+   assert(pBudget != NULL);
+   assert(pDirs != NULL);
+
+   curr = *pCurr;
+   while (*pBudget > 0) {
+      num = DynArray_getLength(curr->childrenFiles);
+      if (num > 0) {
+         (void) NodeFile_destroy(
+            DynArray_removeAt(curr->childrenFiles, num - 1));
+         (*pBudget)--;
+         continue;
+      }
+
+      num = DynArray_getLength(curr->childrenDirs);
+      if (num > 0) {
+         curr = DynArray_get(curr->childrenDirs, num - 1);
+         continue;
+      }
+
+      parent = curr == root ? NULL : curr->parent;
+      if (curr->label == curr->name)
+         (*pDirs)++;
+      else
+         *pDirs += NodeDir_countComponents(curr->label,
+                                           curr->labelLength);
+      NodeDir_free(curr);
+      (*pBudget)--;
+      if (parent == NULL)
+         return TRUE;
+      (void) DynArray_removeAt(parent->childrenDirs,
+                  DynArray_getLength(parent->childrenDirs) - 1);
+      curr = parent;
+   }
+
+   *pCurr = curr;
+   return FALSE;
+}
+
+
 /* see nodeDir.h for specification */
 size_t NodeDir_destroy(NodeDir n) {
-    size_t i;
+    NodeDir curr = n;
+    size_t budget = (size_t) -1;
     size_t count = 0;
-    NodeDir c;
 
     assert(n != NULL);
 
-    /* free all children files of n */
-    for (i = 0; i < DynArray_getLength(n->childrenFiles); i++) {
-        (void) NodeFile_destroy(DynArray_get(n->childrenFiles, i));
-    }
-    DynArray_free(n->childrenFiles);
+    (void) NodeDir_destroyFrom(n, &curr, &budget, &count);
+    return count;
+}
 
-    /* recursively call destroy on each child dir */
-    for (i = 0; i < DynArray_getLength(n->childrenDirs); i++) {
-        c = DynArray_get(n->childrenDirs, i);
-        count += NodeDir_destroy(c);
-    }
-    DynArray_free(n->childrenDirs);
 
-    free(n->path);
-    free(n);
-    count++;
+/* see nodeDir.h for specification */
+boolean NodeDir_destroySome(NodeDir root, NodeDir* pCurr,
+size_t* pBudget) {
+    size_t count = 0;
 
-    return count;
+    return NodeDir_destroyFrom(root, pCurr, pBudget, &count);
+}
+
+
+/* see nodeDir.h for specification */
+const char* NodeDir_getName(NodeDir n) {
+    assert(n != NULL);
+    return n->name;
 }
 
 
 /* see nodeDir.h for specification */
-int NodeDir_compare(NodeDir node1, NodeDir node2) {
-    assert(node1 != NULL);
-    assert(node2 != NULL);
+const char* NodeDir_getLabel(NodeDir n, size_t* pLength) {
+    assert(n != NULL);
+    assert(pLength != NULL);
+
+    *pLength = n->labelLength;
+    return n->label;
+}
+
+
+/* see nodeDir.h for specification */
+size_t NodeDir_getPathLength(NodeDir n) {
+    size_t length;
+
+    assert(n != NULL);
 
-    return strcmp(node1->path, node2->path);
+    length = n->labelLength;
+    for (n = n->parent; n != NULL; n = n->parent)
+        length += n->labelLength + 1;
+
+    return length;
 }
 
 
 /* see nodeDir.h for specification */
-const char* NodeDir_getPath(NodeDir n) {
+char* NodeDir_writePath(NodeDir n, char* buf) {
+    char* end;
+    char* p;
+    size_t len;
+
     assert(n != NULL);
-    return n->path;
+    assert(buf != NULL);
+
+    end = buf + NodeDir_getPathLength(n);
+    *end = '\0';
+
+    /* fill in labels from the end, walking up towards the root */
+    p = end;
+    for (;;) {
+        len = n->labelLength;
+        p -= len;
+        memcpy(p, n->label, len);
+        n = n->parent;
+        if (n == NULL)
+            break;
+        *--p = '/';
+    }
+
+    return end;
 }
 
 
 /* see nodeDir.h for specification */
 size_t NodeDir_getNumChildDirs(NodeDir n) {
     assert(n != NULL);
-    return DynArray_getLength(n->childrenDirs);
+    return DynArray_getLength(NodeDir_dirs(n));
 }
 
 
 /* see nodeDir.h for specification */
 size_t NodeDir_getNumChildFiles(NodeDir n) {
     assert(n != NULL);
-    return DynArray_getLength(n->childrenFiles);
+    return DynArray_getLength(NodeDir_files(n));
 }
 
 
-/* see nodeDir.h for specification */
-int NodeDir_hasChildDir(NodeDir n, const char* path, size_t* 
-childIndex) {
-    size_t index;
-    int result;
-    NodeDir checker;
+/*
+  Compares interned name against the len bytes starting at key, which
+  hold no '\0'. Returns <0, 0, or >0 if name is less than, equal to,
+  or greater than key, respectively.
+*/
+static int NodeDir_compareName(const char* name, const char* key,
+size_t len) {
+    assert(name != NULL);
+    assert(key != NULL);
+
+    /* a key that is itself the interned name needs no comparing */
+    if (key == name && len == Names_getLength(name))
+        return 0;
+    return Path_compare(name, Names_getLength(name), key, len);
+}
 
-    assert(n != NULL);
-    assert(path != NULL);
 
-    checker = NodeDir_create(path, NULL);
-    if(checker == NULL)
-        return -1;
-    result = DynArray_bsearch(n->childrenDirs, checker, &index,
-                (int (*)(const void*, const void*)) NodeDir_compare);
-    (void) NodeDir_destroy(checker);
+/*
+  Returns the first bytes of the len bytes starting at name, as many
+  as fit in a size_t, packed most significant first and padded with
+  zeros. Keys compare as numbers the way the names they come from
+  compare as strings, as far as the keys go, and a name shorter than
+  a key is wholly in it.
+*/
+static size_t NodeDir_nameKey(const char* name, size_t len) {
+    size_t key = 0;
+    size_t i;
+
+    assert(name != NULL);
 
-    if(childIndex != NULL)
-        *childIndex = index;
-    return result;
+    for (i = 0; i < sizeof(size_t); i++) {
+        key <<= 8;
+        if (i < len)
+            key |= (unsigned char) name[i];
+    }
+    return key;
 }
 
 
-/* see nodeDir.h for specification */
-int NodeDir_hasChildFile(NodeDir n, const char* path, 
-size_t* childIndex) {
-    size_t index;
+/*
+  Binary searches children, sorted by the names that getName returns
+  for them, for the child named by the len bytes starting at key.
+  Most probes are settled by the children's keys (see
+  NodeDir_nameKey), which lie next to one another, without touching
+  the children themselves.
+  Returns 1 if found and 0 if not, assigning the index where it is
+  or would belong to *pIndex if pIndex is not NULL.
+*/
+static int NodeDir_bsearchName(DynArray_T children,
+const char* (*getName)(void*), const char* key, size_t len,
+size_t* pIndex) {
+    size_t low = 0;
+    size_t high;
+    size_t mid;
+    size_t nameKey;
+    size_t childKey;
     int result;
-    NodeFile checker;
 
-    assert(n != NULL);
-    assert(path != NULL);
+    assert(children != NULL);
+    assert(getName != NULL);
+    assert(key != NULL);
+
+    STATS_COUNT(STATS_NODES_VISITED, 1);
+    nameKey = NodeDir_nameKey(key, len);
+    high = DynArray_getLength(children);
+    while (low < high) {
+        STATS_COUNT(STATS_COMPARES, 1);
+        mid = low + (high - low) / 2;
+        childKey = DynArray_getKey(children, mid);
+        if (childKey != nameKey)
+            result = childKey < nameKey ? -1 : 1;
+        else if (len < sizeof(size_t))
+            result = 0;
+        else
+            result = NodeDir_compareName(
+                getName(DynArray_get(children, mid)), key, len);
+        if (result == 0) {
+            low = mid;
+            break;
+        }
+        if (result < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
 
-    checker = NodeFile_create(path, NULL, NULL, (size_t)0);
-    if(checker == NULL)
-        return -1;
-    result = DynArray_bsearch(n->childrenFiles, checker, &index,
-                (int (*)(const void*, const void*)) NodeFile_compare);
-    (void) NodeFile_destroy(checker);
+    if (pIndex != NULL)
+        *pIndex = low;
+    return low < high;
+}
 
-    if(childIndex != NULL)
-        *childIndex = index;
-    return result;
+
+/*
+  Returns the child in index, whose children's names getName returns,
+  named by the len bytes starting at key, or NULL if there is none.
+  May run while a writer changes index.
+*/
+static void* NodeDir_probe(struct NodeDir_index* index,
+const char* (*getName)(void*), const char* key, size_t len) {
+    size_t hash;
+    size_t mask;
+    size_t i;
+    void* child;
+
+    assert(index != NULL);
+    assert(getName != NULL);
+    assert(key != NULL);
+
+    STATS_COUNT(STATS_NODES_VISITED, 1);
+    hash = Names_hash(key, len);
+    mask = index->numSlots - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        child = __atomic_load_n(&index->slots[i].child,
+                                __ATOMIC_ACQUIRE);
+        if (child == NULL)
+            return NULL;
+        STATS_COUNT(STATS_COMPARES, 1);
+        if (child != &NodeDir_removed &&
+            __atomic_load_n(&index->slots[i].hash, __ATOMIC_RELAXED)
+            == hash &&
+            NodeDir_compareName(getName(child), key, len) == 0)
+            return child;
+    }
 }
 
 
-/* see nodeDir.h for specification */
-NodeDir NodeDir_getChildDir(NodeDir n, size_t childIndex) {
+/*
+  Adds child, whose name has hash hash, to index, which must have
+  room for it and not already hold a child of that name.
+*/
+static void NodeDir_indexPut(struct NodeDir_index* index, void* child,
+size_t hash) {
+    size_t mask;
+    size_t i;
+    void* old;
+
+    assert(index != NULL);
+    assert(child != NULL);
+
+    mask = index->numSlots - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        old = index->slots[i].child;
+        if (old == &NodeDir_removed)
+            break;
+        if (old == NULL) {
+            index->numUsed++;
+            break;
+        }
+    }
+
+    /* a reader that sees the child sees its hash too */
+    __atomic_store_n(&index->slots[i].hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&index->slots[i].child, child, __ATOMIC_RELEASE);
+    index->numChildren++;
+}
+
+
+/*
+  Removes child, whose name has hash hash, from index, if it is there.
+*/
+static void NodeDir_indexRemove(struct NodeDir_index* index,
+void* child, size_t hash) {
+    size_t mask;
+    size_t i;
+
+    assert(index != NULL);
+    assert(child != NULL);
+
+    mask = index->numSlots - 1;
+    for (i = hash & mask; index->slots[i].child != NULL;
+         i = (i + 1) & mask)
+        if (index->slots[i].child == child) {
+            __atomic_store_n(&index->slots[i].child,
+                             (void*) &NodeDir_removed,
+                             __ATOMIC_RELEASE);
+            index->numChildren--;
+            return;
+        }
+}
+
+
+/*
+  Makes sure *pIndex, the index of children, whose names getName
+  returns, has room for one more child, replacing it with a bigger
+  one if not, or creating it if children is about to reach
+  NODEDIR_INDEX_MIN. If isShared is TRUE, readers may be using the
+  index being replaced, so it is kept until n is destroyed rather
+  than freed. Returns TRUE, or FALSE if allocation error occurs, in
+  which case *pIndex is unchanged.
+*/
+static boolean NodeDir_reserveIndex(NodeDir n,
+struct NodeDir_index** pIndex, DynArray_T children,
+const char* (*getName)(void*), boolean isShared) {
+    struct NodeDir_index* old;
+    struct NodeDir_index* new;
+    size_t numChildren;
+    size_t i;
+    void* child;
+
     assert(n != NULL);
+    assert(pIndex != NULL);
+    assert(children != NULL);
+    assert(getName != NULL);
+
+    old = *pIndex;
+    numChildren = DynArray_getLength(children);
+    if (old == NULL && numChildren + 1 < NODEDIR_INDEX_MIN)
+        return TRUE;
+    if (old != NULL && 2 * (old->numUsed + 1) <= old->numSlots)
+        return TRUE;
+
+    new = Arena_alloc(n->arena, sizeof(struct NodeDir_index));
+    if (new == NULL)
+        return FALSE;
+
+    /* the new index starts a quarter full, less any unlinked slots */
+    new->numSlots = NODEDIR_INDEX_MIN;
+    while (new->numSlots < 4 * (numChildren + 1))
+        new->numSlots *= 2;
+    new->slots = Arena_alloc(n->arena,
+                    new->numSlots * sizeof(struct NodeDir_slot));
+    if (new->slots == NULL) {
+        Arena_release(n->arena, new, sizeof(struct NodeDir_index));
+        return FALSE;
+    }
+    for (i = 0; i < new->numSlots; i++) {
+        new->slots[i].hash = 0;
+        new->slots[i].child = NULL;
+    }
+    new->numChildren = 0;
+    new->numUsed = 0;
+    new->replaced = NULL;
+
+    for (i = 0; i < numChildren; i++) {
+        child = DynArray_get(children, i);
+        NodeDir_indexPut(new, child,
+            Names_getHash(getName(child)));
+    }
 
-    if (DynArray_getLength(n->childrenDirs) > childIndex)
-        return DynArray_get(n->childrenDirs, childIndex);
+    if (isShared)
+        new->replaced = old;
     else
-        return NULL;
+        NodeDir_freeIndex(old, n->arena);
+    __atomic_store_n(pIndex, new, __ATOMIC_RELEASE);
+    return TRUE;
 }
 
 
-/* see nodeDir.h for specification */
-NodeFile NodeDir_getChildFile(NodeDir n, size_t childIndex) {
+/*
+  Compares the names of the NodeDirs pv1 and pv2, for DynArray_sort.
+*/
+static int NodeDir_compareDirNames(const void* pv1, const void* pv2) {
+    STATS_COUNT(STATS_COMPARES, 1);
+    return strcmp(((const struct nodeDir*) pv1)->name,
+                  ((const struct nodeDir*) pv2)->name);
+}
+
+
+/*
+  Compares the names of the NodeFiles pv1 and pv2, for DynArray_sort.
+*/
+static int NodeDir_compareFileNames(const void* pv1, const void* pv2) {
+    STATS_COUNT(STATS_COMPARES, 1);
+    return strcmp(NodeFile_getName((NodeFile) pv1),
+                  NodeFile_getName((NodeFile) pv2));
+}
+
+
+/*
+  Sorts n's child NodeDirs by name if they are out of order.
+*/
+static void NodeDir_sortDirs(NodeDir n) {
     assert(n != NULL);
 
-    if (DynArray_getLength(n->childrenFiles) > childIndex)
-        return DynArray_get(n->childrenFiles, childIndex);
-    else
-        return NULL;
+    if (!n->dirsSorted) {
+        DynArray_sort(n->childrenDirs, NodeDir_compareDirNames);
+        n->dirsSorted = TRUE;
+    }
 }
 
 
-/* see nodeDir.h for specification */
-NodeDir NodeDir_getParent(NodeDir n) {
+/*
+  Sorts n's child NodeFiles by name if they are out of order.
+*/
+static void NodeDir_sortFiles(NodeDir n) {
     assert(n != NULL);
-    return n->parent;
+
+    if (!n->filesSorted) {
+        DynArray_sort(n->childrenFiles, NodeDir_compareFileNames);
+        n->filesSorted = TRUE;
+    }
 }
 
 
-/* see nodeDir.h for specification */
-int NodeDir_linkChildDir(NodeDir parent, NodeDir child) {
+/*
+  Adds child, called name, to children, the array of parent's
+  children of its kind, whose index is *pIndex and whose sortedness
+  is *pIsSorted, in place. An indexed array is added to at the end,
+  leaving it unsorted unless name comes last; otherwise child goes
+  where it belongs. parent must have no child called name. If
+  isReserved, children and its index are known to have room for
+  child already, and nothing is allocated.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int NodeDir_addChild(NodeDir parent, DynArray_T children,
+struct NodeDir_index** pIndex, boolean* pIsSorted,
+const char* (*getName)(void*), void* child, const char* name,
+boolean isReserved) {
+    size_t len;
+    size_t num;
     size_t i;
-    char* rest;
 
     assert(parent != NULL);
-    assert(child != NULL);
-
-    /* checks for different kinds of errors */
-    if (NodeDir_hasChildDir(parent, child->path, NULL))
-        return ALREADY_IN_TREE;
-    if (NodeDir_hasChildFile(parent, child->path, NULL))
-        return ALREADY_IN_TREE;
+    assert(children != NULL);
+    assert(pIndex != NULL);
+    assert(pIsSorted != NULL);
+
+    if (!isReserved &&
+        !NodeDir_reserveIndex(parent, pIndex, children, getName,
+                              FALSE))
+        return MEMORY_ERROR;
+
+    len = Names_getLength(name);
+    if (*pIndex == NULL) {
+        (void) NodeDir_bsearchName(children, getName, name, len, &i);
+        if (DynArray_addAt(children, i, child) != TRUE)
+            return MEMORY_ERROR;
+        DynArray_setKey(children, i, NodeDir_nameKey(name, len));
+        return SUCCESS;
+    }
 
-    i = strlen(parent->path);
-    if (strncmp(child->path, parent->path, i))
-        return PARENT_CHILD_ERROR;
-    rest = child->path + i;
-    if (strlen(child->path) >= i && rest[0] != '/')
-        return PARENT_CHILD_ERROR;
-    rest++;
-    if (strstr(rest, "/") != NULL)
-        return PARENT_CHILD_ERROR;
+    num = DynArray_getLength(children);
+    if (DynArray_add(children, child) != TRUE)
+        return MEMORY_ERROR;
+    DynArray_setKey(children, num, NodeDir_nameKey(name, len));
+    if (num > 0 &&
+        strcmp(getName(DynArray_get(children, num - 1)), name) > 0)
+        *pIsSorted = FALSE;
+    NodeDir_indexPut(*pIndex, child, Names_getHash(name));
+    return SUCCESS;
+}
 
-    child->parent = parent;
 
-    /* checks if parent already has a child with child's path */
-    if (DynArray_bsearch(parent->childrenDirs, child, &i,
-            (int (*)(const void*, const void*)) NodeDir_compare) == 1)
-        return ALREADY_IN_TREE;
+/* see nodeDir.h for specification */
+int NodeDir_findChildDir(NodeDir n, const char* name, size_t len,
+size_t* childIndex) {
+    struct NodeDir_index* index;
 
-    if (DynArray_addAt(parent->childrenDirs, i, child) == TRUE)
-        return SUCCESS;
-    else
-        return PARENT_CHILD_ERROR;
+    assert(n != NULL);
+    assert(name != NULL);
+
+    index = NodeDir_dirIndex(n);
+    if (childIndex == NULL && index != NULL)
+        return NodeDir_probe(index,
+                   (const char* (*)(void*)) NodeDir_getName,
+                   name, len) != NULL;
+
+    NodeDir_sortDirs(n);
+    return NodeDir_bsearchName(NodeDir_dirs(n),
+                (const char* (*)(void*)) NodeDir_getName,
+                name, len, childIndex);
 }
 
 
 /* see nodeDir.h for specification */
-int NodeDir_linkChildFile(NodeDir parent, NodeFile child) {
-    size_t i;
-    char* rest;
+int NodeDir_findChildFile(NodeDir n, const char* name, size_t len,
+size_t* childIndex) {
+    struct NodeDir_index* index;
 
-    assert(parent != NULL);
-    assert(child != NULL);
+    assert(n != NULL);
+    assert(name != NULL);
+
+    index = NodeDir_fileIndex(n);
+    if (childIndex == NULL && index != NULL)
+        return NodeDir_probe(index,
+                   (const char* (*)(void*)) NodeFile_getName,
+                   name, len) != NULL;
+
+    NodeDir_sortFiles(n);
+    return NodeDir_bsearchName(NodeDir_files(n),
+                (const char* (*)(void*)) NodeFile_getName,
+                name, len, childIndex);
+}
 
-    /* checks for different kinds of errors */
-    if (NodeDir_hasChildDir(parent, NodeFile_getPath(child), NULL))
-        return ALREADY_IN_TREE;
-    if (NodeDir_hasChildFile(parent, NodeFile_getPath(child), NULL))
-        return ALREADY_IN_TREE;
 
-    i = strlen(parent->path);
-    if (strncmp(NodeFile_getPath(child), parent->path, i))
-        return PARENT_CHILD_ERROR;
-    rest = (char*) NodeFile_getPath(child) + i;
-    if (strlen(NodeFile_getPath(child)) >= i && rest[0] != '/')
-        return PARENT_CHILD_ERROR;
-    rest++;
-    if (strstr(rest, "/") != NULL)
-        return PARENT_CHILD_ERROR;
+/* see nodeDir.h for specification */
+NodeDir NodeDir_lookupChildDir(NodeDir n, const char* name,
+size_t len) {
+    struct NodeDir_index* index;
+    DynArray_T children;
+    size_t i;
 
-    /* checks if parent already has a child with child's path */
-    if (DynArray_bsearch(parent->childrenFiles, child, &i,
-            (int (*)(const void*, const void*)) NodeFile_compare) == 1)
-        return ALREADY_IN_TREE;
+    assert(n != NULL);
+    assert(name != NULL);
 
-    if (DynArray_addAt(parent->childrenFiles, i, child) == TRUE)
-        return SUCCESS;
-    else
-        return PARENT_CHILD_ERROR;
+    /* an array without an index is always sorted */
+    index = NodeDir_dirIndex(n);
+    if (index != NULL)
+        return NodeDir_probe(index,
+                   (const char* (*)(void*)) NodeDir_getName, name, len);
+
+    children = NodeDir_dirs(n);
+    if (!NodeDir_bsearchName(children,
+            (const char* (*)(void*)) NodeDir_getName, name, len, &i))
+        return NULL;
+    return DynArray_get(children, i);
 }
 
 
 /* see nodeDir.h for specification */
-int NodeDir_unlinkChildDir(NodeDir parent, NodeDir child) {
+NodeFile NodeDir_lookupChildFile(NodeDir n, const char* name,
+size_t len) {
+    struct NodeDir_index* index;
+    DynArray_T children;
     size_t i;
 
-    assert(parent != NULL);
-    assert(child != NULL);
+    assert(n != NULL);
+    assert(name != NULL);
 
-    if(DynArray_bsearch(parent->childrenDirs, child, &i,
-            (int (*)(const void*, const void*)) NodeDir_compare) == 0)
-        return PARENT_CHILD_ERROR;
+    index = NodeDir_fileIndex(n);
+    if (index != NULL)
+        return NodeDir_probe(index,
+                   (const char* (*)(void*)) NodeFile_getName,
+                   name, len);
 
-    (void) DynArray_removeAt(parent->childrenDirs, i);
-    return SUCCESS;
+    children = NodeDir_files(n);
+    if (!NodeDir_bsearchName(children,
+            (const char* (*)(void*)) NodeFile_getName, name, len, &i))
+        return NULL;
+    return DynArray_get(children, i);
 }
 
 
 /* see nodeDir.h for specification */
-int NodeDir_unlinkChildFile(NodeDir parent, NodeFile child) {
-    size_t i;
+NodeDir NodeDir_getChildDir(NodeDir n, size_t childIndex) {
+    DynArray_T children;
 
-    assert(parent != NULL);
-    assert(child != NULL);
+    assert(n != NULL);
 
-    if(DynArray_bsearch(parent->childrenFiles, child, &i,
-            (int (*)(const void*, const void*)) NodeFile_compare) == 0)
-        return PARENT_CHILD_ERROR;
+    NodeDir_sortDirs(n);
+    children = NodeDir_dirs(n);
+    if (DynArray_getLength(children) > childIndex)
+        return DynArray_get(children, childIndex);
+    else
+        return NULL;
+}
 
-    (void) DynArray_removeAt(parent->childrenFiles, i);
-    return SUCCESS;
-}
\ No newline at end of file
+
+/* see nodeDir.h for specification */
+NodeFile NodeDir_getChildFile(NodeDir n, size_t childIndex) {
+    DynArray_T children;
+
+    assert(n != NULL);
+
+    NodeDir_sortFiles(n);
+    children = NodeDir_files(n);
+    if (DynArray_getLength(children) > childIndex)
+        return DynArray_get(children, childIndex);
+    else
+        return NULL;
+}
+
+
+/* see nodeDir.h for specification */
+NodeDir NodeDir_getParent(NodeDir n) {
+    assert(n != NULL);
+    return n->parent;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_setParent(NodeDir n, NodeDir parent) {
+    assert(n != NULL);
+    assert(!n->isLinked);
+
+    n->parent = parent;
+}
+
+
+/* see nodeDir.h for specification */
+const char* NodeDir_rename(NodeDir n, const char* name) {
+    const char* oldName;
+
+    assert(n != NULL);
+    assert(name != NULL);
+    assert(!n->isLinked);
+    assert(n->labelLength == Names_getLength(n->name));
+
+    /* n no longer stands for part of its chain, if it ever did */
+    oldName = n->name;
+    Names_releaseIn(n->arena, n->chain);
+    n->chain = NULL;
+    n->name = name;
+    n->label = name;
+    n->labelLength = Names_getLength(name);
+    return oldName;
+}
+
+
+/*
+  Makes parent the parent of each of its children, which it has just
+  been handed whole by another NodeDir with the same path.
+*/
+static void NodeDir_adoptChildren(NodeDir parent) {
+    NodeDir child;
+    size_t i;
+
+    assert(parent != NULL);
+
+    for (i = 0; i < DynArray_getLength(parent->childrenDirs); i++) {
+        child = DynArray_get(parent->childrenDirs, i);
+        child->parent = parent;
+    }
+    for (i = 0; i < DynArray_getLength(parent->childrenFiles); i++)
+        NodeFile_setParent(DynArray_get(parent->childrenFiles, i),
+                           parent);
+}
+
+
+/*
+  Hands the children of from, their arrays, indexes and sortedness,
+  over to to, which has none, leaving from with none.
+*/
+static void NodeDir_handOver(NodeDir from, NodeDir to) {
+    assert(from != NULL);
+    assert(to != NULL);
+
+    to->childrenDirs = from->childrenDirs;
+    to->childrenFiles = from->childrenFiles;
+    to->dirIndex = from->dirIndex;
+    to->fileIndex = from->fileIndex;
+    to->dirsSorted = from->dirsSorted;
+    to->filesSorted = from->filesSorted;
+    NodeDir_adoptChildren(to);
+}
+
+
+/* see nodeDir.h for specification */
+NodeDir NodeDir_splitChain(NodeDir n, size_t count) {
+    NodeDir new;
+    DynArray_T dirs;
+    DynArray_T files;
+    const char* rest;
+    const char* slash;
+    size_t restLength;
+    size_t nameLength;
+    size_t i;
+
+    assert(n != NULL);
+    assert(count > 0);
+
+    /* the rest starts after the count'th '/' of n's label */
+    rest = n->label;
+    restLength = n->labelLength;
+    for (i = 0; i < count; i++) {
+        slash = memchr(rest, '/', restLength);
+        assert(slash != NULL);
+        restLength -= (size_t) (slash + 1 - rest);
+        rest = slash + 1;
+    }
+    slash = memchr(rest, '/', restLength);
+    nameLength = slash == NULL ? restLength : (size_t) (slash - rest);
+
+    new = Arena_alloc(n->arena, sizeof(struct nodeDir));
+    if (new == NULL)
+        return NULL;
+    new->name = Names_internIn(n->arena, rest, nameLength);
+    dirs = DynArray_newKeyedIn(1, n->arena);
+    files = DynArray_newKeyedIn(0, n->arena);
+    if (new->name == NULL || dirs == NULL || files == NULL) {
+        if (files != NULL)
+            DynArray_free(files);
+        if (dirs != NULL)
+            DynArray_free(dirs);
+        Names_releaseIn(n->arena, new->name);
+        Arena_release(n->arena, new, sizeof(struct nodeDir));
+        return NULL;
+    }
+
+    new->arena = n->arena;
+    new->label = new->name;
+    new->labelLength = nameLength;
+    new->chain = NULL;
+    if (slash != NULL) {
+        new->label = rest;
+        new->labelLength = restLength;
+        new->chain = Names_retainIn(n->arena, n->chain);
+    }
+    new->parent = n;
+    NodeDir_handOver(n, new);
+
+    /* the hierarchy below is the same, less the dirs n keeps */
+    new->totalDirs = n->totalDirs - count;
+    new->totalFiles = n->totalFiles;
+    new->totalBytes = n->totalBytes;
+    new->isLinked = TRUE;
+
+    (void) DynArray_set(dirs, 0, new);
+    DynArray_setKey(dirs, 0, NodeDir_nameKey(new->name, nameLength));
+    n->childrenDirs = dirs;
+    n->childrenFiles = files;
+    n->dirIndex = NULL;
+    n->fileIndex = NULL;
+    n->dirsSorted = TRUE;
+    n->filesSorted = TRUE;
+    n->labelLength -= restLength + 1;
+    return new;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_joinChain(NodeDir n) {
+    NodeDir child;
+
+    assert(n != NULL);
+    assert(DynArray_getLength(n->childrenDirs) == 1);
+    assert(DynArray_getLength(n->childrenFiles) == 0);
+
+    child = DynArray_get(n->childrenDirs, 0);
+    DynArray_free(n->childrenDirs);
+    DynArray_free(n->childrenFiles);
+    NodeDir_freeIndex(n->dirIndex, n->arena);
+    NodeDir_freeIndex(n->fileIndex, n->arena);
+
+    /* the chars of child's label still follow n's in n's chain */
+    n->labelLength += 1 + child->labelLength;
+    NodeDir_handOver(child, n);
+
+    Names_releaseIn(child->arena, child->chain);
+    Names_releaseIn(child->arena, child->name);
+    Arena_release(child->arena, child, sizeof(struct nodeDir));
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_walkInit(struct NodeDir_walk* w) {
+    assert(w != NULL);
+
+    w->levels = w->fixed;
+    w->depth = 0;
+    w->maxDepth = NODEDIR_WALK_LEVELS;
+    w->isStarted = TRUE;
+    w->canSkip = FALSE;
+}
+
+
+/*
+  Pushes a level for dir onto w's stack, growing it if it is full.
+  Returns TRUE if successful, or FALSE if allocation error.
+*/
+static boolean NodeDir_walkPush(struct NodeDir_walk* w, NodeDir dir) {
+   struct NodeDir_level* newLevels;
+   struct NodeDir_level* level;
+   size_t newMax;
+
+   assert(w != NULL);
+   assert(dir != NULL);
+
+   if (w->depth == w->maxDepth) {
+      newMax = 2 * w->maxDepth;
+      if (w->levels == w->fixed) {
+         newLevels = malloc(newMax * sizeof(struct NodeDir_level));
+         if (newLevels != NULL)
+            memcpy(newLevels, w->fixed, sizeof w->fixed);
+      }
+      else
+         newLevels = realloc(w->levels,
+                             newMax * sizeof(struct NodeDir_level));
+      if (newLevels == NULL)
+         return FALSE;
+      w->levels = newLevels;
+      w->maxDepth = newMax;
+   }
+
+   level = &w->levels[w->depth++];
+   level->dir = dir;
+   level->nextDir = 0;
+   level->start = 0;
+   level->length = 0;
+   return TRUE;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_walkBegin(struct NodeDir_walk* w, NodeDir root) {
+    assert(w != NULL);
+    assert(root != NULL);
+
+    w->depth = 0;
+    (void) NodeDir_walkPush(w, root);
+    w->isStarted = FALSE;
+    w->canSkip = FALSE;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_walkNext(struct NodeDir_walk* w,
+struct NodeDir_level** pLevel) {
+    struct NodeDir_level* top;
+    NodeDir child;
+
+    assert(w != NULL);
+    assert(pLevel != NULL);
+
+    if (!w->isStarted) {
+        w->isStarted = TRUE;
+        w->canSkip = TRUE;
+        *pLevel = &w->levels[0];
+        return 1;
+    }
+
+    w->canSkip = FALSE;
+    while (w->depth > 0) {
+        top = &w->levels[w->depth - 1];
+        child = NodeDir_getChildDir(top->dir, top->nextDir);
+        if (child != NULL) {
+            if (!NodeDir_walkPush(w, child))
+                return -1;
+            /* the push may have moved the stack */
+            w->levels[w->depth - 2].nextDir++;
+            w->canSkip = TRUE;
+            *pLevel = &w->levels[w->depth - 1];
+            return 1;
+        }
+        w->depth--;
+    }
+    return 0;
+}
+
+
+/* see nodeDir.h for specification */
+struct NodeDir_level* NodeDir_walkParent(struct NodeDir_walk* w) {
+    assert(w != NULL);
+    assert(w->depth > 0);
+
+    if (w->depth == 1)
+        return NULL;
+    return &w->levels[w->depth - 2];
+}
+
+
+/* see nodeDir.h for specification */
+boolean NodeDir_walkSkip(struct NodeDir_walk* w) {
+    assert(w != NULL);
+
+    if (!w->canSkip)
+        return FALSE;
+
+    w->depth--;
+    w->canSkip = FALSE;
+    return TRUE;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_walkFree(struct NodeDir_walk* w) {
+    assert(w != NULL);
+
+    if (w->levels != w->fixed)
+        free(w->levels);
+    NodeDir_walkInit(w);
+}
+
+
+/*
+  Returns TRUE if interned name is a valid single path component:
+  non-empty and free of '/' characters. Returns FALSE otherwise.
+*/
+static boolean NodeDir_isValidName(const char* name) {
+    size_t len;
+
+    assert(name != NULL);
+
+    /* its length is known, so it need not be scanned for its end */
+    len = Names_getLength(name);
+    return len != 0 && memchr(name, '/', len) == NULL;
+}
+
+
+/*
+  Adds dirs, files and bytes to the totals of n and of each ancestor
+  it is linked to through its parent. They are added modulo
+  SIZE_MAX + 1, so totals are taken away by adding their negations.
+  Concurrent readers see each total change at once.
+*/
+static void NodeDir_addTotals(NodeDir n, size_t dirs, size_t files,
+size_t bytes) {
+    for (;;) {
+        (void) __atomic_add_fetch(&n->totalDirs, dirs,
+                                  __ATOMIC_RELAXED);
+        (void) __atomic_add_fetch(&n->totalFiles, files,
+                                  __ATOMIC_RELAXED);
+        (void) __atomic_add_fetch(&n->totalBytes, bytes,
+                                  __ATOMIC_RELAXED);
+        if (!n->isLinked)
+            return;
+        n = n->parent;
+    }
+}
+
+
+/*
+  Counts the hierarchy rooted at child, which has just been linked
+  into parent if isLinked is TRUE or unlinked from it if not, in or
+  out of the totals of parent and its ancestors.
+*/
+static void NodeDir_countChildDir(NodeDir parent, NodeDir child,
+boolean isLinked) {
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    child->isLinked = isLinked;
+    if (isLinked)
+        NodeDir_addTotals(parent, child->totalDirs, child->totalFiles,
+                          child->totalBytes);
+    else
+        NodeDir_addTotals(parent, 0 - child->totalDirs,
+                          0 - child->totalFiles, 0 - child->totalBytes);
+}
+
+
+/*
+  Counts NodeFile child, which has just been linked into parent if
+  isLinked is TRUE or unlinked from it if not, in or out of the
+  totals of parent and its ancestors.
+*/
+static void NodeDir_countChildFile(NodeDir parent, NodeFile child,
+boolean isLinked) {
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    if (isLinked)
+        NodeDir_addTotals(parent, 0, 1, NodeFile_getLength(child));
+    else
+        NodeDir_addTotals(parent, 0, 0 - (size_t) 1,
+                          0 - NodeFile_getLength(child));
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_getTotals(NodeDir n, size_t* pDirs, size_t* pFiles,
+size_t* pBytes) {
+    assert(n != NULL);
+    assert(pDirs != NULL);
+    assert(pFiles != NULL);
+    assert(pBytes != NULL);
+
+    *pDirs = __atomic_load_n(&n->totalDirs, __ATOMIC_RELAXED);
+    *pFiles = __atomic_load_n(&n->totalFiles, __ATOMIC_RELAXED);
+    *pBytes = __atomic_load_n(&n->totalBytes, __ATOMIC_RELAXED);
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_changeBytes(NodeDir n, size_t oldBytes, size_t newBytes) {
+    assert(n != NULL);
+
+    if (newBytes != oldBytes)
+        NodeDir_addTotals(n, 0, 0, newBytes - oldBytes);
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_linkChildDir(NodeDir parent, NodeDir child) {
+    size_t len;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    if (child->parent != parent || !NodeDir_isValidName(child->name))
+        return PARENT_CHILD_ERROR;
+
+    /* checks if parent already has a child with child's name */
+    len = Names_getLength(child->name);
+    if (NodeDir_findChildFile(parent, child->name, len, NULL))
+        return ALREADY_IN_TREE;
+    if (NodeDir_findChildDir(parent, child->name, len, NULL))
+        return ALREADY_IN_TREE;
+
+    result = NodeDir_addChild(parent, parent->childrenDirs,
+                              &parent->dirIndex, &parent->dirsSorted,
+                              (const char* (*)(void*)) NodeDir_getName,
+                              child, child->name, FALSE);
+    if (result == SUCCESS)
+        NodeDir_countChildDir(parent, child, TRUE);
+    return result;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_linkChildFile(NodeDir parent, NodeFile child) {
+    const char* name;
+    size_t len;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    name = NodeFile_getName(child);
+    if (NodeFile_getParent(child) != parent ||
+        !NodeDir_isValidName(name))
+        return PARENT_CHILD_ERROR;
+
+    /* checks if parent already has a child with child's name */
+    len = Names_getLength(name);
+    if (NodeDir_findChildDir(parent, name, len, NULL))
+        return ALREADY_IN_TREE;
+    if (NodeDir_findChildFile(parent, name, len, NULL))
+        return ALREADY_IN_TREE;
+
+    result = NodeDir_addChild(parent, parent->childrenFiles,
+                              &parent->fileIndex, &parent->filesSorted,
+                              (const char* (*)(void*)) NodeFile_getName,
+                              child, name, FALSE);
+    if (result == SUCCESS)
+        NodeDir_countChildFile(parent, child, TRUE);
+    return result;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_appendChildDir(NodeDir parent, NodeDir child) {
+    size_t num;
+    NodeDir last;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    if (child->parent != parent)
+        return PARENT_CHILD_ERROR;
+
+    NodeDir_sortDirs(parent);
+    num = DynArray_getLength(parent->childrenDirs);
+    if (num > 0) {
+        last = DynArray_get(parent->childrenDirs, num - 1);
+        if (strcmp(last->name, child->name) >= 0)
+            return PARENT_CHILD_ERROR;
+    }
+
+    if (!NodeDir_reserveIndex(parent, &parent->dirIndex,
+                              parent->childrenDirs,
+                              (const char* (*)(void*)) NodeDir_getName,
+                              FALSE) ||
+        DynArray_add(parent->childrenDirs, child) != TRUE)
+        return MEMORY_ERROR;
+    DynArray_setKey(parent->childrenDirs, num,
+                    NodeDir_nameKey(child->name,
+                                    Names_getLength(child->name)));
+
+    if (parent->dirIndex != NULL)
+        NodeDir_indexPut(parent->dirIndex, child,
+                         Names_getHash(child->name));
+    NodeDir_countChildDir(parent, child, TRUE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_appendChildFile(NodeDir parent, NodeFile child) {
+    const char* name;
+    size_t num;
+    NodeFile last;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    if (NodeFile_getParent(child) != parent)
+        return PARENT_CHILD_ERROR;
+
+    name = NodeFile_getName(child);
+    NodeDir_sortFiles(parent);
+    num = DynArray_getLength(parent->childrenFiles);
+    if (num > 0) {
+        last = DynArray_get(parent->childrenFiles, num - 1);
+        if (strcmp(NodeFile_getName(last), name) >= 0)
+            return PARENT_CHILD_ERROR;
+    }
+
+    if (!NodeDir_reserveIndex(parent, &parent->fileIndex,
+                              parent->childrenFiles,
+                              (const char* (*)(void*)) NodeFile_getName,
+                              FALSE) ||
+        DynArray_add(parent->childrenFiles, child) != TRUE)
+        return MEMORY_ERROR;
+    DynArray_setKey(parent->childrenFiles, num,
+                    NodeDir_nameKey(name, Names_getLength(name)));
+
+    if (parent->fileIndex != NULL)
+        NodeDir_indexPut(parent->fileIndex, child,
+                         Names_getHash(name));
+    NodeDir_countChildFile(parent, child, TRUE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_unlinkChildDir(NodeDir parent, NodeDir child) {
+    size_t i;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    if (child->parent != parent ||
+        !NodeDir_findChildDir(parent, child->name,
+                              Names_getLength(child->name), &i) ||
+        DynArray_get(parent->childrenDirs, i) != child)
+        return PARENT_CHILD_ERROR;
+
+    (void) DynArray_removeAt(parent->childrenDirs, i);
+    if (parent->dirIndex != NULL)
+        NodeDir_indexRemove(parent->dirIndex, child,
+                            Names_getHash(child->name));
+    NodeDir_countChildDir(parent, child, FALSE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_unlinkChildFile(NodeDir parent, NodeFile child) {
+    const char* name;
+    size_t i;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    name = NodeFile_getName(child);
+    if (NodeFile_getParent(child) != parent ||
+        !NodeDir_findChildFile(parent, name, Names_getLength(name),
+                               &i) ||
+        DynArray_get(parent->childrenFiles, i) != child)
+        return PARENT_CHILD_ERROR;
+
+    (void) DynArray_removeAt(parent->childrenFiles, i);
+    if (parent->fileIndex != NULL)
+        NodeDir_indexRemove(parent->fileIndex, child,
+                            Names_getHash(name));
+    NodeDir_countChildFile(parent, child, FALSE);
+    return SUCCESS;
+}
+
+
+/*
+  Returns a new DynArray holding the elements of old and their keys,
+  with pvElement inserted at index under key if pvElement is not
+  NULL, or with the element at index left out if pvElement is NULL.
+  Returns NULL if allocation error occurs.
+*/
+static DynArray_T NodeDir_copyChildren(DynArray_T old, size_t index,
+const void* pvElement, size_t key, Arena_T arena) {
+    DynArray_T new;
+    size_t oldLength;
+    size_t newLength;
+    size_t i;
+    size_t j = 0;
+
+    assert(old != NULL);
+
+    oldLength = DynArray_getLength(old);
+    newLength = pvElement != NULL ? oldLength + 1 : oldLength - 1;
+
+    new = DynArray_newKeyedIn(newLength, arena);
+    if (new == NULL)
+        return NULL;
+
+    for (i = 0; i < oldLength; i++) {
+        if (i == index) {
+            if (pvElement == NULL)
+                continue;
+            (void) DynArray_set(new, j, pvElement);
+            DynArray_setKey(new, j++, key);
+        }
+        (void) DynArray_set(new, j, DynArray_get(old, i));
+        DynArray_setKey(new, j++, DynArray_getKey(old, i));
+    }
+    if (index == oldLength && pvElement != NULL) {
+        (void) DynArray_set(new, j, pvElement);
+        DynArray_setKey(new, j, key);
+    }
+
+    return new;
+}
+
+
+/*
+  Replaces *pChildren with a copy changed as NodeDir_copyChildren
+  describes, publishing the copy for concurrent readers, and passes
+  the old array back in *pOld. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int NodeDir_publishChildren(DynArray_T* pChildren, size_t index,
+const void* pvElement, size_t key, Arena_T arena, DynArray_T* pOld) {
+    DynArray_T new;
+
+    assert(pChildren != NULL);
+    assert(pOld != NULL);
+
+    new = NodeDir_copyChildren(*pChildren, index, pvElement, key,
+                               arena);
+    if (new == NULL)
+        return MEMORY_ERROR;
+
+    *pOld = *pChildren;
+    __atomic_store_n(pChildren, new, __ATOMIC_RELEASE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_linkChildDirShared(NodeDir parent, NodeDir child,
+DynArray_T* pOldChildren) {
+    size_t len;
+    size_t i;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(pOldChildren != NULL);
+
+    *pOldChildren = NULL;
+
+    if (child->parent != parent || !NodeDir_isValidName(child->name))
+        return PARENT_CHILD_ERROR;
+
+    len = Names_getLength(child->name);
+    if (NodeDir_findChildFile(parent, child->name, len, NULL))
+        return ALREADY_IN_TREE;
+    if (NodeDir_findChildDir(parent, child->name, len, &i))
+        return ALREADY_IN_TREE;
+
+    /* room in the index is made first, so once the array is
+       published nothing can fail */
+    if (!NodeDir_reserveIndex(parent, &parent->dirIndex,
+                              parent->childrenDirs,
+                              (const char* (*)(void*)) NodeDir_getName,
+                              TRUE))
+        return MEMORY_ERROR;
+
+    result = NodeDir_publishChildren(&parent->childrenDirs, i, child,
+                                     NodeDir_nameKey(child->name, len),
+                                     parent->arena, pOldChildren);
+    if (result != SUCCESS)
+        return result;
+    if (parent->dirIndex != NULL)
+        NodeDir_indexPut(parent->dirIndex, child,
+                         Names_getHash(child->name));
+    NodeDir_countChildDir(parent, child, TRUE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_linkChildFileShared(NodeDir parent, NodeFile child,
+DynArray_T* pOldChildren) {
+    const char* name;
+    size_t len;
+    size_t i;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(pOldChildren != NULL);
+
+    *pOldChildren = NULL;
+
+    name = NodeFile_getName(child);
+    if (NodeFile_getParent(child) != parent ||
+        !NodeDir_isValidName(name))
+        return PARENT_CHILD_ERROR;
+
+    len = Names_getLength(name);
+    if (NodeDir_findChildDir(parent, name, len, NULL))
+        return ALREADY_IN_TREE;
+    if (NodeDir_findChildFile(parent, name, len, &i))
+        return ALREADY_IN_TREE;
+
+    if (!NodeDir_reserveIndex(parent, &parent->fileIndex,
+                              parent->childrenFiles,
+                              (const char* (*)(void*)) NodeFile_getName,
+                              TRUE))
+        return MEMORY_ERROR;
+
+    result = NodeDir_publishChildren(&parent->childrenFiles, i, child,
+                                     NodeDir_nameKey(name, len),
+                                     parent->arena, pOldChildren);
+    if (result != SUCCESS)
+        return result;
+    if (parent->fileIndex != NULL)
+        NodeDir_indexPut(parent->fileIndex, child,
+                         Names_getHash(name));
+    NodeDir_countChildFile(parent, child, TRUE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_unlinkChildDirShared(NodeDir parent, NodeDir child,
+DynArray_T* pOldChildren) {
+    size_t i;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(pOldChildren != NULL);
+
+    *pOldChildren = NULL;
+
+    if (child->parent != parent ||
+        !NodeDir_findChildDir(parent, child->name,
+                              Names_getLength(child->name), &i) ||
+        DynArray_get(parent->childrenDirs, i) != child)
+        return PARENT_CHILD_ERROR;
+
+    result = NodeDir_publishChildren(&parent->childrenDirs, i, NULL, 0,
+                                     parent->arena, pOldChildren);
+    if (result != SUCCESS)
+        return result;
+    if (parent->dirIndex != NULL)
+        NodeDir_indexRemove(parent->dirIndex, child,
+                            Names_getHash(child->name));
+    NodeDir_countChildDir(parent, child, FALSE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+int NodeDir_unlinkChildFileShared(NodeDir parent, NodeFile child,
+DynArray_T* pOldChildren) {
+    const char* name;
+    size_t i;
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(pOldChildren != NULL);
+
+    *pOldChildren = NULL;
+
+    name = NodeFile_getName(child);
+    if (NodeFile_getParent(child) != parent ||
+        !NodeDir_findChildFile(parent, name, Names_getLength(name),
+                               &i) ||
+        DynArray_get(parent->childrenFiles, i) != child)
+        return PARENT_CHILD_ERROR;
+
+    result = NodeDir_publishChildren(&parent->childrenFiles, i, NULL,
+                                     0, parent->arena, pOldChildren);
+    if (result != SUCCESS)
+        return result;
+    if (parent->fileIndex != NULL)
+        NodeDir_indexRemove(parent->fileIndex, child,
+                            Names_getHash(name));
+    NodeDir_countChildFile(parent, child, FALSE);
+    return SUCCESS;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_relinkChildDir(NodeDir parent, NodeDir child) {
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(child->parent == parent);
+
+    /* the unlink left the array's capacity, and the index slot it
+       emptied, behind */
+    result = NodeDir_addChild(parent, parent->childrenDirs,
+                              &parent->dirIndex, &parent->dirsSorted,
+                              (const char* (*)(void*)) NodeDir_getName,
+                              child, child->name, TRUE);
+    assert(result == SUCCESS);
+    (void) result;
+    NodeDir_countChildDir(parent, child, TRUE);
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_relinkChildFile(NodeDir parent, NodeFile child) {
+    int result;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(NodeFile_getParent(child) == parent);
+
+    result = NodeDir_addChild(parent, parent->childrenFiles,
+                              &parent->fileIndex, &parent->filesSorted,
+                              (const char* (*)(void*)) NodeFile_getName,
+                              child, NodeFile_getName(child), TRUE);
+    assert(result == SUCCESS);
+    (void) result;
+    NodeDir_countChildFile(parent, child, TRUE);
+}
+
+
+/*
+  Publishes oldChildren again as *pChildren, the array of children
+  indexed by index, undoing the Shared link or unlink of child, whose
+  name is name, that replaced it. Passes the array replaced now back
+  in *pOldChildren. Returns TRUE if child is linked again, and FALSE
+  if it is unlinked.
+*/
+static boolean NodeDir_restoreChildren(DynArray_T* pChildren,
+struct NodeDir_index* index, void* child, const char* name,
+DynArray_T oldChildren, DynArray_T* pOldChildren) {
+    size_t hash;
+    boolean isLinked;
+
+    assert(pChildren != NULL);
+    assert(child != NULL);
+    assert(oldChildren != NULL);
+    assert(pOldChildren != NULL);
+
+    *pOldChildren = *pChildren;
+    __atomic_store_n(pChildren, oldChildren, __ATOMIC_RELEASE);
+    isLinked = DynArray_getLength(oldChildren) >
+        DynArray_getLength(*pOldChildren);
+    if (index == NULL)
+        return isLinked;
+
+    /* an index that grew since was built without child if it had
+       been unlinked, and is at most half full */
+    hash = Names_getHash(name);
+    if (isLinked)
+        NodeDir_indexPut(index, child, hash);
+    else
+        NodeDir_indexRemove(index, child, hash);
+    return isLinked;
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_restoreChildDirsShared(NodeDir parent, NodeDir child,
+DynArray_T oldChildren, DynArray_T* pOldChildren) {
+    boolean isLinked;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    isLinked = NodeDir_restoreChildren(&parent->childrenDirs,
+                                       parent->dirIndex, child,
+                                       child->name, oldChildren,
+                                       pOldChildren);
+    NodeDir_countChildDir(parent, child, isLinked);
+}
+
+
+/* see nodeDir.h for specification */
+void NodeDir_restoreChildFilesShared(NodeDir parent, NodeFile child,
+DynArray_T oldChildren, DynArray_T* pOldChildren) {
+    boolean isLinked;
+
+    assert(parent != NULL);
+    assert(child != NULL);
+
+    isLinked = NodeDir_restoreChildren(&parent->childrenFiles,
+                                       parent->fileIndex, child,
+                                       NodeFile_getName(child),
+                                       oldChildren, pOldChildren);
+    NodeDir_countChildFile(parent, child, isLinked);
+}
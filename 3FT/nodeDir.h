@@ -10,11 +10,20 @@
 
 #include <stddef.h>
 #include "a4def.h"
+#include "arena.h"
+#include "dynarray.h"
 
 
 /*
-    a NodeDir is a node that contains its path, a referenec to its
+    a NodeDir is a node that contains its name, a referenec to its
     parent node, and children nodes (both NodeDirs and NodeFiles).
+    Its full path is not stored but rebuilt from its ancestors' names.
+    A NodeDir may also stand for a chain of directories, each but the
+    last having only the next as its child (see NodeDir_getLabel).
+    Once it has many children of a kind, it also indexes them in a
+    hash table on their names, so that they are found and added in
+    constant time however many there are; they are then put back in
+    order only when next listed.
 */
 typedef struct nodeDir* NodeDir;
 
@@ -24,14 +33,36 @@ typedef struct nodeDir* NodeDir;
 
 /*
     Creates and returns a new NodeDir or NULL if allocation error
-    occurs. NodeDir's path is parent's path (if it exists) prefixed
-    to "name" separated by a slash. It points to its parent.
+    occurs. NodeDir's name is "name", interned, so its path is
+    parent's path (if it exists) prefixed to "name" separated by a
+    slash. It points to its parent.
 
     Note: the parent is not linked to this new NodeDir.
 */
 NodeDir NodeDir_create(const char* name, NodeDir parent); 
 
 
+/*
+    Creates a NodeDir as NodeDir_create does, but allocates it and
+    its arrays of children from arena, to which NodeDir_destroy gives
+    them back.
+*/
+NodeDir NodeDir_createIn(const char* name, NodeDir parent,
+Arena_T arena);
+
+
+/*
+    Creates a NodeDir as NodeDir_createIn does, standing for the
+    chain of directories named by the components of the length chars
+    starting at label, which must be non-empty and separated by
+    single slashes: its label is a copy of them, interned, and its
+    name the first of them. If there is only one, the NodeDir is an
+    ordinary one called that.
+*/
+NodeDir NodeDir_createChainIn(const char* label, size_t length,
+NodeDir parent, Arena_T arena);
+
+
 /*
     Destroys the entire hierarchy of Nodes rooted at NodeDir n,
     including n itself. Returns the number of NodeDirs destroyed.
@@ -40,17 +71,74 @@ size_t NodeDir_destroy(NodeDir n);
 
 
 /*
-    Compares node1 and node2 based on their paths.
-    Returns <0, 0, or >0 if node1 is less than,
-    equal to, or greater than node2, respectively.
+    Destroys nodes of the hierarchy rooted at NodeDir root, which no
+    other hierarchy or reader may reach any more, deepest first,
+    until *pBudget of them have been destroyed or root has been.
+    *pCurr is where the last call on root left off, and must be root
+    itself for the first; it is set to where this call leaves off,
+    and *pBudget is lowered by the number of nodes destroyed. Returns
+    TRUE if root has been destroyed, and FALSE otherwise.
+*/
+boolean NodeDir_destroySome(NodeDir root, NodeDir* pCurr,
+size_t* pBudget);
+
+
+/*
+    Returns NodeDir n's name: the last component of its path, or if n
+    stands for a chain of directories, the name of the first of them,
+    by which n is found among its parent's children.
+*/
+const char* NodeDir_getName(NodeDir n);
+
+
+/*
+    Returns NodeDir n's label, which is not '\0'-terminated, and
+    assigns its length to *pLength. If n stands for a chain of
+    directories, each of which but the last has only the next as its
+    child and no files, the label is their names joined by '/'s, n's
+    path is the path of the last of them, and n's children are that
+    one's; n's totals count every one of them. Otherwise the label is
+    n's name, and its length the name's.
+*/
+const char* NodeDir_getLabel(NodeDir n, size_t* pLength);
+
+
+/*
+    Splits the chain of directories NodeDir n stands for after its
+    first count directories, of which n goes on standing for the
+    chain, and returns a new NodeDir standing for the rest, which
+    becomes n's only child and takes over n's children. count must be
+    at least 1 and less than the number of directories in the chain.
+    The paths of n's former children stay as they were, and n's
+    totals are unchanged. Returns NULL, leaving n unchanged, if
+    allocation error occurs. Not for a hierarchy that concurrent
+    readers may see.
+*/
+NodeDir NodeDir_splitChain(NodeDir n, size_t count);
+
+
+/*
+    Undoes the NodeDir_splitChain that made n's only child, once
+    every change to n and that child since has been undone, giving
+    the child's children back to n and destroying the child.
+    Allocates no memory, so it cannot fail.
+*/
+void NodeDir_joinChain(NodeDir n);
+
+
+/*
+    Returns the length of NodeDir n's path, computed from the labels
+    of n and its ancestors.
 */
-int NodeDir_compare(NodeDir node1, NodeDir node2);
+size_t NodeDir_getPathLength(NodeDir n);
 
 
 /*
-    Returns NodeDir n's path.
+    Writes NodeDir n's path, '\0'-terminated, into buf, which must
+    have room for NodeDir_getPathLength(n) + 1 chars. Returns a
+    pointer to the terminating '\0' in buf. Allocates no memory.
 */
-const char* NodeDir_getPath(NodeDir n);
+char* NodeDir_writePath(NodeDir n, char* buf);
 
 
 /*
@@ -66,21 +154,42 @@ size_t NodeDir_getNumChildFiles(NodeDir n);
 
 
 /*
-    Returns 1 if NodeDir n has a child NodeDir with path,
-    0 if not, and -1 if allocation error. Passes index of child 
-    back with childIndex.
+    Returns 1 if NodeDir n has a child NodeDir whose name (the last
+    component of its path) is the len bytes starting at name, and 0
+    if not. name need not be '\0'-terminated. Passes index of child
+    (or the index where it would be inserted) back with childIndex,
+    which is faster if childIndex is NULL. Allocates no memory.
 */
-int NodeDir_hasChildDir(NodeDir n, const char* path, size_t* 
-childIndex);
+int NodeDir_findChildDir(NodeDir n, const char* name, size_t len,
+size_t* childIndex);
 
 
 /*
-    Returns 1 if n has a child NodeFile with path,
-    0 if not, and -1 if allocation error. Passes index of child 
-    back with childIndex.
+    Returns 1 if NodeDir n has a child NodeFile whose name (the last
+    component of its path) is the len bytes starting at name, and 0
+    if not. name need not be '\0'-terminated. Passes index of child
+    (or the index where it would be inserted) back with childIndex,
+    which is faster if childIndex is NULL. Allocates no memory.
 */
-int NodeDir_hasChildFile(NodeDir n, const char* path, size_t* 
-childIndex);
+int NodeDir_findChildFile(NodeDir n, const char* name, size_t len,
+size_t* childIndex);
+
+
+/*
+    Returns the child NodeDir of n named by the len bytes starting at
+    name, or NULL if there is none. Safe to call while another thread
+    changes n's children through the *Shared functions below.
+*/
+NodeDir NodeDir_lookupChildDir(NodeDir n, const char* name, size_t len);
+
+
+/*
+    Returns the child NodeFile of n named by the len bytes starting at
+    name, or NULL if there is none. Safe to call while another thread
+    changes n's children through the *Shared functions below.
+*/
+NodeFile NodeDir_lookupChildFile(NodeDir n, const char* name,
+size_t len);
 
 
 /*
@@ -103,12 +212,56 @@ NodeFile NodeDir_getChildFile(NodeDir n, size_t childIndex);
 NodeDir NodeDir_getParent(NodeDir n);
 
 
+/*
+    Makes parent, or no NodeDir if it is NULL, the parent of NodeDir
+    n, which must not be linked to its parent, so that n's path, and
+    those of the nodes below it, are parent's path followed by '/'
+    and n's label, as they are built from the labels of their
+    ancestors. parent is not linked to n.
+*/
+void NodeDir_setParent(NodeDir n, NodeDir parent);
+
+
+/*
+    Gives NodeDir n, which must not be linked to its parent and must
+    stand for a single directory, interned name as its name and
+    label, along with the reference to it the caller took through
+    n's arena (see Names_internIn), and returns n's old name, with
+    the reference n held to it, for the caller to release or give
+    back likewise. n no longer stands for part of
+    the chain it was split from, if any, so it is not to be joined
+    with its child again.
+*/
+const char* NodeDir_rename(NodeDir n, const char* name);
+
+
+/*
+    Passes back in *pDirs, *pFiles and *pBytes the number of NodeDirs
+    (n included) and NodeFiles in the hierarchy rooted at n and the
+    total length of the files' contents. These are kept up to date as
+    children are linked and unlinked below n, so nothing is walked.
+    While another thread changes the hierarchy, each count is one it
+    had at some moment, though not necessarily the same moment.
+*/
+void NodeDir_getTotals(NodeDir n, size_t* pDirs, size_t* pFiles,
+size_t* pBytes);
+
+
+/*
+    Records that the contents of a NodeFile linked below n changed
+    length from oldBytes to newBytes, in the totals of n and its
+    ancestors.
+*/
+void NodeDir_changeBytes(NodeDir n, size_t oldBytes, size_t newBytes);
+
+
 /*
     Makes NodeDir child a child of parent and returns SUCCESS.
     This is not possible in the following cases:
-    * child's path is not parent's path + / + directory,
+    * child was not created with parent as its parent, or its
+      name is empty or contains a slash,
       in which case returns PARENT_CHILD_ERROR
-    * parent already has a child with child's path,
+    * parent already has a child with child's name,
       in which case returns ALREADY_IN_TREE
     * parent is unable to allocate memory to store new child link,
       in which case returns MEMORY_ERROR
@@ -119,9 +272,10 @@ int NodeDir_linkChildDir(NodeDir parent, NodeDir child);
 /*
     Makes NodeFile child a child of parent and returns SUCCESS.
     This is not possible in the following cases:
-    * child's path is not parent's path + / + directory,
+    * child was not created with parent as its parent, or its
+      name is empty or contains a slash,
       in which case returns PARENT_CHILD_ERROR
-    * parent already has a child with child's path,
+    * parent already has a child with child's name,
       in which case returns ALREADY_IN_TREE
     * parent is unable to allocate memory to store new child link,
       in which case returns MEMORY_ERROR
@@ -129,6 +283,19 @@ int NodeDir_linkChildDir(NodeDir parent, NodeDir child);
 int NodeDir_linkChildFile(NodeDir parent, NodeFile child);
 
 
+/*
+    Behave as NodeDir_linkChildDir and NodeDir_linkChildFile, for a
+    child whose name comes after the names of all of parent's children
+    of its kind, without searching: the child is added at the end of
+    parent's children. The caller guarantees that no child of the
+    other kind has the same name.
+    Returns SUCCESS, PARENT_CHILD_ERROR if child was not created with
+    parent as its parent or does not come last, or MEMORY_ERROR.
+*/
+int NodeDir_appendChildDir(NodeDir parent, NodeDir child);
+int NodeDir_appendChildFile(NodeDir parent, NodeFile child);
+
+
 /*
     Unlinks NodeDir parent from its NodeDir child, leaving
     child unchanged.
@@ -148,4 +315,138 @@ int NodeDir_unlinkChildDir(NodeDir parent, NodeDir child);
 */
 int NodeDir_unlinkChildFile(NodeDir parent, NodeFile child);
 
-#endif
\ No newline at end of file
+/*
+    The following behave as NodeDir_linkChildDir,
+    NodeDir_linkChildFile, NodeDir_unlinkChildDir and
+    NodeDir_unlinkChildFile, except that they never change parent's
+    array of children in place, so that other threads can keep
+    looking children up meanwhile. Instead they publish a changed copy
+    and pass the old array back in *pOldChildren (NULL if nothing
+    changed), which the caller must DynArray_free once no reader can
+    still be using it. They return MEMORY_ERROR if the copy cannot be
+    allocated. An index of parent's children is changed in place in
+    a way readers can follow, and when it must grow, the one it
+    replaces is kept until parent is destroyed.
+*/
+int NodeDir_linkChildDirShared(NodeDir parent, NodeDir child,
+DynArray_T* pOldChildren);
+int NodeDir_linkChildFileShared(NodeDir parent, NodeFile child,
+DynArray_T* pOldChildren);
+int NodeDir_unlinkChildDirShared(NodeDir parent, NodeDir child,
+DynArray_T* pOldChildren);
+int NodeDir_unlinkChildFileShared(NodeDir parent, NodeFile child,
+DynArray_T* pOldChildren);
+
+
+/*
+    Link child back into parent, undoing the unlink of child by
+    NodeDir_unlinkChildDir or NodeDir_unlinkChildFile, which must be
+    the last change to parent's children of child's kind, or have
+    had every later change undone. The room child took up is still
+    there, so nothing is allocated and nothing can fail.
+*/
+void NodeDir_relinkChildDir(NodeDir parent, NodeDir child);
+void NodeDir_relinkChildFile(NodeDir parent, NodeFile child);
+
+
+/*
+    Undo a Shared link or unlink of child, which must be the last
+    change to parent's children of child's kind, or have had every
+    later change undone, by publishing again oldChildren, the array
+    that change passed back. The array it published in its place is
+    passed back in *pOldChildren, for the caller to free as after any
+    Shared change. Nothing is allocated and nothing can fail.
+*/
+void NodeDir_restoreChildDirsShared(NodeDir parent, NodeDir child,
+DynArray_T oldChildren, DynArray_T* pOldChildren);
+void NodeDir_restoreChildFilesShared(NodeDir parent, NodeFile child,
+DynArray_T oldChildren, DynArray_T* pOldChildren);
+
+
+/* The number of levels a walk holds before it allocates any. */
+enum { NODEDIR_WALK_LEVELS = 32 };
+
+
+/* A NodeDir a walk has entered and not yet left. */
+struct NodeDir_level {
+    /* the NodeDir, and the index of its next child NodeDir to enter */
+    NodeDir dir;
+    size_t nextDir;
+
+    /* kept for the walk's user, such as where the NodeDir's path was
+       written and its length; 0 when the NodeDir is entered */
+    size_t start;
+    size_t length;
+};
+
+
+/*
+    A preorder walk over the NodeDirs of a hierarchy, which keeps the
+    NodeDirs it is inside of on a stack of its own rather than on the
+    C stack, so that hierarchies of any depth can be walked. Its
+    fields are for the functions below only. The stack is held in
+    fixed until the walk goes deeper than NODEDIR_WALK_LEVELS, and
+    is kept from one walk to the next until the walk is freed.
+*/
+struct NodeDir_walk {
+    /* the NodeDirs entered and not left, from the root of the walk
+       down; only the first depth of maxDepth levels are in use */
+    struct NodeDir_level* levels;
+    size_t depth;
+    size_t maxDepth;
+
+    /* TRUE once the root of the walk has been entered */
+    boolean isStarted;
+
+    /* TRUE if the NodeDir last entered has not had a child entered */
+    boolean canSkip;
+
+    struct NodeDir_level fixed[NODEDIR_WALK_LEVELS];
+};
+
+
+/*
+    Initializes *w, which holds no stack until it is first begun.
+*/
+void NodeDir_walkInit(struct NodeDir_walk* w);
+
+
+/*
+    Starts *w over from root, which its next step enters first.
+*/
+void NodeDir_walkBegin(struct NodeDir_walk* w, NodeDir root);
+
+
+/*
+    Takes the next step of *w: enters the next NodeDir in preorder,
+    each one's children in order after it, and passes back its level
+    in *pLevel. A child is fetched only when it is entered, so the
+    walk keeps going if children are linked or unlinked meanwhile.
+    Returns 1 if a NodeDir was entered, 0 if the walk is over, or -1
+    if allocation error.
+*/
+int NodeDir_walkNext(struct NodeDir_walk* w,
+struct NodeDir_level** pLevel);
+
+
+/*
+    Returns the level of the parent of the NodeDir *w last entered,
+    or NULL if that is the root of the walk.
+*/
+struct NodeDir_level* NodeDir_walkParent(struct NodeDir_walk* w);
+
+
+/*
+    Makes *w not enter the children of the NodeDir it last entered.
+    Returns TRUE if it has entered none of them yet, and FALSE
+    otherwise, in which case it does nothing.
+*/
+boolean NodeDir_walkSkip(struct NodeDir_walk* w);
+
+
+/*
+    Frees the stack *w allocated, if any.
+*/
+void NodeDir_walkFree(struct NodeDir_walk* w);
+
+#endif
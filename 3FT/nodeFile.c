@@ -12,12 +12,15 @@
 
 #include "nodeFile.h"
 #include "dynarray.h"
+#include "names.h"
+#include "stats.h"
 
 
 /* A node structure representing a file. */
 struct nodeFile {
-   /* the full path of this directory */
-   char* path;
+   /* the name of this file: the last component of its path,
+      interned (see names.h) */
+   const char* name;
 
    /* the parent directory of this node
       NULL for the root of the directory tree */
@@ -28,62 +31,48 @@ struct nodeFile {
 
    /* size_t length of contents */
    size_t length;
-};
-
-
-/*
-  returns a path with contents
-  n->path/dir
-  or NULL if there is an allocation error.
 
-  Allocates memory for the returned string,
-  which is then owened by the caller.
-*/
-static char* NodeFile_buildPath(NodeDir n, const char* dir) {
-   char* path;
+   /* the Blob_T holding contents, to which this node holds a
+      reference, or NULL if contents are borrowed from the client */
+   Blob_T blob;
 
-   assert(dir != NULL);
-
-   if(n == NULL)
-      path = malloc(strlen(dir)+1);
-   else
-      path = malloc(strlen(NodeDir_getPath(n)) + 1 + strlen(dir) + 1);
-
-   if(path == NULL)
-      return NULL;
-   *path = '\0';
+   /* the arena this node is allocated from, or NULL if it is
+      malloc'd */
+   Arena_T arena;
+};
 
-   if(n != NULL) {
-      strcpy(path, NodeDir_getPath(n));
-      strcat(path, "/");
-   }
-   strcat(path, dir);
 
-   return path;
+/* See nodeFile.h for specification. */
+NodeFile NodeFile_create(const char* name, NodeDir parent, 
+void* contents, size_t length) {
+   return NodeFile_createIn(name, parent, contents, length, NULL,
+                            NULL);
 }
 
 
 /* See nodeFile.h for specification. */
-NodeFile NodeFile_create(const char* name, NodeDir parent, 
-void* contents, size_t length) {
+NodeFile NodeFile_createIn(const char* name, NodeDir parent,
+void* contents, size_t length, Blob_T blob, Arena_T arena) {
    NodeFile new;
 
    assert(name != NULL);
+   assert(blob == NULL || contents == Blob_getBytes(blob));
 
-   new = malloc(sizeof(struct nodeFile));
+   new = Arena_alloc(arena, sizeof(struct nodeFile));
    if(new == NULL)
       return NULL;
 
-   new->path = NodeFile_buildPath(parent, name);
-
-   if(new->path == NULL) {
-      free(new);
+   new->arena = arena;
+   new->name = Names_internIn(arena, name, strlen(name));
+   if(new->name == NULL) {
+      Arena_release(arena, new, sizeof(struct nodeFile));
       return NULL;
    }
 
    new->parent = parent;
    new->contents = contents;
    new->length = length;
+   new->blob = blob == NULL ? NULL : Blob_retain(blob);
 
    return new;
 }
@@ -93,26 +82,48 @@ void* contents, size_t length) {
 size_t NodeFile_destroy(NodeFile n) {
     assert(n != NULL);
     
-    free(n->path);
-    free(n);
+    Names_releaseIn(n->arena, n->name);
+    Blob_release(n->blob);
+    Arena_release(n->arena, n, sizeof(struct nodeFile));
 
     return 1;
 }
 
 
 /* See nodeFile.h for specification. */
-int NodeFile_compare(NodeFile node1, NodeFile node2) {
-    assert(node1 != NULL);
-    assert(node2 != NULL);
+const char* NodeFile_getName(NodeFile n) {
+    assert(n != NULL);
+    return n->name;
+}
+
 
-    return strcmp(node1->path, node2->path);
+/* See nodeFile.h for specification. */
+size_t NodeFile_getPathLength(NodeFile n) {
+    assert(n != NULL);
+
+    if (n->parent == NULL)
+        return Names_getLength(n->name);
+    return NodeDir_getPathLength(n->parent) + 1 +
+        Names_getLength(n->name);
 }
 
 
 /* See nodeFile.h for specification. */
-const char* NodeFile_getPath(NodeFile n) {
+char* NodeFile_writePath(NodeFile n, char* buf) {
+    char* end = buf;
+    size_t len;
+
     assert(n != NULL);
-    return n->path;
+    assert(buf != NULL);
+
+    if (n->parent != NULL) {
+        end = NodeDir_writePath(n->parent, buf);
+        *end++ = '/';
+    }
+    len = Names_getLength(n->name);
+    memcpy(end, n->name, len + 1);
+
+    return end + len;
 }
 
 
@@ -123,23 +134,66 @@ NodeDir NodeFile_getParent(NodeFile n) {
 }
 
 
+/* See nodeFile.h for specification. */
+void NodeFile_setParent(NodeFile n, NodeDir parent) {
+    assert(n != NULL);
+    assert(parent != NULL);
+
+    n->parent = parent;
+}
+
+
+/* See nodeFile.h for specification. */
+const char* NodeFile_rename(NodeFile n, const char* name) {
+    const char* oldName;
+
+    assert(n != NULL);
+    assert(name != NULL);
+
+    oldName = n->name;
+    n->name = name;
+    return oldName;
+}
+
+
 /* See nodeFile.h for specification. */
 void *NodeFile_getContents(NodeFile n) {
     assert(n != NULL);
-    return n->contents;
+    return __atomic_load_n(&n->contents, __ATOMIC_ACQUIRE);
+}
+
+
+/* See nodeFile.h for specification. */
+Blob_T NodeFile_getBlob(NodeFile n) {
+    assert(n != NULL);
+    return __atomic_load_n(&n->blob, __ATOMIC_ACQUIRE);
 }
 
 
 /* See nodeFile.h for specification. */
-void *NodeFile_replaceContents(NodeFile n, void *newContents, 
-size_t newLength) {
+void *NodeFile_replaceContents(NodeFile n, void *newContents,
+size_t newLength, Blob_T newBlob, Blob_T *pOldBlob) {
     void *oldContents;
+    size_t oldLength;
 
     assert(n != NULL);
+    assert(newBlob == NULL || newContents == Blob_getBytes(newBlob));
+    assert(pOldBlob != NULL);
+
+    if (newBlob != NULL)
+        (void) Blob_retain(newBlob);
+
+    /* each field is swapped atomically, so concurrent readers see
+       either its old or its new value */
+    oldLength = __atomic_exchange_n(&n->length, newLength,
+                                    __ATOMIC_ACQ_REL);
+    oldContents = __atomic_exchange_n(&n->contents, newContents,
+                                      __ATOMIC_ACQ_REL);
+    *pOldBlob = __atomic_exchange_n(&n->blob, newBlob,
+                                    __ATOMIC_ACQ_REL);
 
-    oldContents = n->contents;
-    n->contents = newContents;
-    n->length = newLength;
+    if (n->parent != NULL)
+        NodeDir_changeBytes(n->parent, oldLength, newLength);
 
     return oldContents;
 }
@@ -148,5 +202,5 @@ size_t newLength) {
 /* See nodeFile.h for specification. */
 size_t NodeFile_getLength(NodeFile n) {
     assert(n != NULL);
-    return n->length;
+    return __atomic_load_n(&n->length, __ATOMIC_ACQUIRE);
 }
\ No newline at end of file
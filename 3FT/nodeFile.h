@@ -10,11 +10,16 @@
 
 #include <stddef.h>
 #include "a4def.h"
+#include "arena.h"
+#include "blob.h"
 
 
 /*
-    a NodeFile is a node that contains its path, a referenec to its
+    a NodeFile is a node that contains its name, a referenec to its
     parent node, a pointer to its contents, and its contents' length.
+    Its contents are either borrowed from the client, or those of a
+    Blob_T it holds a reference to.
+    Its full path is not stored but rebuilt from its ancestors' names.
 */
 typedef struct nodeFile* NodeFile;
 
@@ -24,8 +29,9 @@ typedef struct nodeFile* NodeFile;
 
 /*
     Creates and returns a new NodeFile or NULL if allocation error
-    occurs. NodeFile's path is parent's path (if it exists) prefixed
-    to "name" separated by a slash. It points to its parent. Also
+    occurs. NodeFile's name is "name", interned, so its path is
+    parent's path (if it exists) prefixed to "name" separated by a
+    slash. It points to its parent. Also
     adds contents and length to NodeFile. Note that client still owns
     contents.
 
@@ -35,6 +41,17 @@ NodeFile NodeFile_create(const char* name, NodeDir parent,
 void* contents, size_t length); 
 
 
+/*
+    Creates a NodeFile as NodeFile_create does, but allocates it from
+    arena, to which NodeFile_destroy gives it back.
+    If blob is not NULL, contents and length must be its bytes and
+    length, and the NodeFile takes a reference to it, which
+    NodeFile_destroy releases.
+*/
+NodeFile NodeFile_createIn(const char* name, NodeDir parent,
+void* contents, size_t length, Blob_T blob, Arena_T arena);
+
+
 /*
     Destroys NodeFile n. Returns the number of NodeDir's destroyed,
     which is always 0.
@@ -43,17 +60,24 @@ size_t NodeFile_destroy(NodeFile n);
 
 
 /*
-    Compares node1 and node2 based on their paths.
-    Returns <0, 0, or >0 if node1 is less than,
-    equal to, or greater than node2, respectively.
+    Returns NodeFile n's name: the last component of its path.
+*/
+const char* NodeFile_getName(NodeFile n);
+
+
+/*
+    Returns the length of NodeFile n's path, computed from the names
+    of n and its ancestors.
 */
-int NodeFile_compare(NodeFile node1, NodeFile node2);
+size_t NodeFile_getPathLength(NodeFile n);
 
 
 /*
-    Returns NodeFile n's path.
+    Writes NodeFile n's path, '\0'-terminated, into buf, which must
+    have room for NodeFile_getPathLength(n) + 1 chars. Returns a
+    pointer to the terminating '\0' in buf. Allocates no memory.
 */
-const char* NodeFile_getPath(NodeFile n);
+char* NodeFile_writePath(NodeFile n, char* buf);
 
 
 /*
@@ -62,18 +86,50 @@ const char* NodeFile_getPath(NodeFile n);
 NodeDir NodeFile_getParent(NodeFile n);
 
 
+/*
+    Makes parent the parent of NodeFile n, which must not be linked
+    to its parent unless parent is being handed it along with the
+    rest of its former parent's children and has the path that
+    parent had. parent is not linked to n.
+*/
+void NodeFile_setParent(NodeFile n, NodeDir parent);
+
+
+/*
+    Gives NodeFile n, which must not be linked to its parent,
+    interned name as its name, along with the reference to it the
+    caller took through n's arena (see Names_internIn), and returns
+    n's old name, with the reference n held to it, for the caller to
+    release or give back likewise.
+*/
+const char* NodeFile_rename(NodeFile n, const char* name);
+
+
 /*
     Returns the contents of NodeFile n.
 */
 void* NodeFile_getContents(NodeFile n);
 
 
+/*
+    Returns the Blob_T holding NodeFile n's contents, or NULL if they
+    are borrowed.
+*/
+Blob_T NodeFile_getBlob(NodeFile n);
+
+
 /*
     Replaces NodeFile n's contents and length with newContents and
-    newLength and returns the old contents.
+    newLength and returns the old contents. If newBlob is not NULL,
+    newContents and newLength must be its bytes and length, and n
+    takes a reference to it. The reference n held to the Blob_T of
+    the old contents, or NULL if they were borrowed, is passed back
+    in *pOldBlob, to be released by the caller. If n has a parent, n
+    must be linked to it, and the change in length is recorded in the
+    totals of n's ancestors (see NodeDir_getTotals).
 */
-void *NodeFile_replaceContents(NodeFile n, void *newContents, 
-size_t newLength);
+void *NodeFile_replaceContents(NodeFile n, void *newContents,
+size_t newLength, Blob_T newBlob, Blob_T *pOldBlob);
 
 
 /*
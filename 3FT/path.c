@@ -0,0 +1,366 @@
+/*--------------------------------------------------------------------*/
+/* path.c                                                             */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <string.h>
+
+
+#include "path.h"
+
+
+/* The vector kernels are built for x86 CPUs with SSE2, on which the
+   wider AVX2 one is only run if the CPU turns out to have it. */
+#if defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define PATH_VECTOR
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+
+/*
+   The vector kernels read whole aligned blocks, which may run past
+   the '\0' of the string being scanned, though never into a page the
+   string does not reach; address checking must not mistake that for
+   reading out of bounds.
+*/
+#if defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define PATH_WHOLE_BLOCKS __attribute__((no_sanitize_address))
+#else
+#define PATH_WHOLE_BLOCKS
+#endif
+
+
+/* The kernel in use, or PATH_AUTO until one is picked. */
+static int Path_kernel = PATH_AUTO;
+
+
+/*
+   Returns the widest kernel the CPU supports.
+*/
+static int Path_detectKernel(void) {
+#ifdef PATH_VECTOR
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return PATH_AVX2;
+   return PATH_SSE2;
+#else
+   return PATH_SCALAR;
+#endif
+}
+
+
+/*
+   Returns the kernel in use, picking it if none has been yet. Threads
+   racing to pick it all pick the same one.
+*/
+static int Path_getKernel(void) {
+   int kernel;
+
+   kernel = __atomic_load_n(&Path_kernel, __ATOMIC_RELAXED);
+   if (kernel == PATH_AUTO) {
+      kernel = Path_detectKernel();
+      __atomic_store_n(&Path_kernel, kernel, __ATOMIC_RELAXED);
+   }
+   return kernel;
+}
+
+
+/* see path.h for specification */
+boolean Path_useKernel(int kernel) {
+   int best;
+
+   best = Path_detectKernel();
+   if (kernel == PATH_AUTO)
+      kernel = best;
+   else if (kernel < PATH_SCALAR || kernel > best)
+      return FALSE;
+
+   __atomic_store_n(&Path_kernel, kernel, __ATOMIC_RELAXED);
+   return TRUE;
+}
+
+
+/*
+   Path_scan, one byte at a time.
+*/
+static size_t Path_scanScalar(const char* path, size_t start,
+size_t* slashes, size_t maxSlashes, size_t* pEnd) {
+   size_t count = 0;
+   size_t i;
+
+   for (i = start; path[i] != '\0'; i++)
+      if (path[i] == '/') {
+         slashes[count++] = i;
+         if (count == maxSlashes) {
+            *pEnd = i + 1;
+            return count;
+         }
+      }
+
+   *pEnd = i;
+   return count;
+}
+
+
+#ifdef PATH_VECTOR
+
+/*
+   Records the offsets in path of the bytes of the block starting at
+   block whose bits are set in mask, lowest first, in
+   slashes[*pCount...], counting them in *pCount, until maxSlashes are
+   recorded. Returns TRUE if that happens, having set *pEnd just past
+   the last one, and FALSE if every bit was recorded first.
+*/
+static boolean Path_recordMask(unsigned long mask, const char* block,
+const char* path, size_t* slashes, size_t maxSlashes, size_t* pCount,
+size_t* pEnd) {
+   size_t offset;
+
+   while (mask != 0) {
+      offset = (size_t) (block + __builtin_ctzl(mask) - path);
+      slashes[(*pCount)++] = offset;
+      if (*pCount == maxSlashes) {
+         *pEnd = offset + 1;
+         return TRUE;
+      }
+      mask &= mask - 1;
+   }
+   return FALSE;
+}
+
+
+/*
+   Finishes a vector scan of the block starting at block, of which
+   slashMask and nulMask have a bit set for each '/' and '\0' at or
+   past path + start. Returns TRUE if the scan is over, having set
+   *pEnd, and FALSE if it goes on to the next block.
+*/
+static boolean Path_finishBlock(unsigned long slashMask,
+unsigned long nulMask, const char* block, const char* path,
+size_t* slashes, size_t maxSlashes, size_t* pCount, size_t* pEnd) {
+   /* only the '/'s before the '\0' belong to the string */
+   if (nulMask != 0)
+      slashMask &= (nulMask & -nulMask) - 1;
+
+   if (Path_recordMask(slashMask, block, path, slashes, maxSlashes,
+                       pCount, pEnd))
+      return TRUE;
+
+   if (nulMask != 0) {
+      *pEnd = (size_t) (block + __builtin_ctzl(nulMask) - path);
+      return TRUE;
+   }
+   return FALSE;
+}
+
+
+/*
+   Path_scan, 16 bytes at a time.
+*/
+PATH_WHOLE_BLOCKS
+static size_t Path_scanSSE2(const char* path, size_t start,
+size_t* slashes, size_t maxSlashes, size_t* pEnd) {
+   const __m128i slash = _mm_set1_epi8('/');
+   const __m128i nul = _mm_setzero_si128();
+   const char* block;
+   unsigned long skip;
+   unsigned long slashMask;
+   unsigned long nulMask;
+   size_t count = 0;
+   __m128i bytes;
+
+   /* aligned blocks never straddle a page boundary */
+   block = (const char*) ((size_t) (path + start) & ~(size_t) 15);
+   skip = (unsigned long) (path + start - block);
+   for (;;) {
+      bytes = _mm_load_si128((const __m128i*) (const void*) block);
+      slashMask = (unsigned long) (unsigned)
+         _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, slash));
+      nulMask = (unsigned long) (unsigned)
+         _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nul));
+      slashMask = slashMask >> skip << skip;
+      nulMask = nulMask >> skip << skip;
+      skip = 0;
+
+      if (Path_finishBlock(slashMask, nulMask, block, path, slashes,
+                           maxSlashes, &count, pEnd))
+         return count;
+      block += 16;
+   }
+}
+
+
+/*
+   Path_scan, 32 bytes at a time.
+*/
+PATH_WHOLE_BLOCKS __attribute__((target("avx2")))
+static size_t Path_scanAVX2(const char* path, size_t start,
+size_t* slashes, size_t maxSlashes, size_t* pEnd) {
+   const __m256i slash = _mm256_set1_epi8('/');
+   const __m256i nul = _mm256_setzero_si256();
+   const char* block;
+   unsigned long skip;
+   unsigned long slashMask;
+   unsigned long nulMask;
+   size_t count = 0;
+   __m256i bytes;
+
+   block = (const char*) ((size_t) (path + start) & ~(size_t) 31);
+   skip = (unsigned long) (path + start - block);
+   for (;;) {
+      bytes = _mm256_load_si256((const __m256i*) (const void*) block);
+      slashMask = (unsigned long) (unsigned)
+         _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, slash));
+      nulMask = (unsigned long) (unsigned)
+         _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, nul));
+      slashMask = slashMask >> skip << skip;
+      nulMask = nulMask >> skip << skip;
+      skip = 0;
+
+      if (Path_finishBlock(slashMask, nulMask, block, path, slashes,
+                           maxSlashes, &count, pEnd))
+         return count;
+      block += 32;
+   }
+}
+
+#endif
+
+
+/* see path.h for specification */
+size_t Path_scan(const char* path, size_t start, size_t* slashes,
+size_t maxSlashes, size_t* pEnd) {
+   assert(path != NULL);
+   assert(slashes != NULL);
+   assert(maxSlashes > 0);
+   assert(pEnd != NULL);
+
+   switch (Path_getKernel()) {
+#ifdef PATH_VECTOR
+   case PATH_AVX2:
+      return Path_scanAVX2(path, start, slashes, maxSlashes, pEnd);
+   case PATH_SSE2:
+      return Path_scanSSE2(path, start, slashes, maxSlashes, pEnd);
+#endif
+   default:
+      return Path_scanScalar(path, start, slashes, maxSlashes, pEnd);
+   }
+}
+
+
+/* see path.h for specification */
+int Path_compare(const char* s1, size_t len1, const char* s2,
+size_t len2) {
+   size_t len;
+   size_t i = 0;
+#ifdef PATH_VECTOR
+   unsigned long differ;
+   __m128i block1;
+   __m128i block2;
+#endif
+
+   assert(s1 != NULL);
+   assert(s2 != NULL);
+
+   len = len1 < len2 ? len1 : len2;
+
+#ifdef PATH_VECTOR
+   /* both vector kernels compare 16 bytes at a time: names are
+      rarely long enough for wider blocks to pay */
+   if (Path_getKernel() != PATH_SCALAR)
+      for (; i + 16 <= len; i += 16) {
+         block1 = _mm_loadu_si128((const __m128i*) (const void*)
+                                  (s1 + i));
+         block2 = _mm_loadu_si128((const __m128i*) (const void*)
+                                  (s2 + i));
+         differ = 0xFFFFUL ^ (unsigned long) (unsigned)
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block1, block2));
+         if (differ != 0) {
+            i += (size_t) __builtin_ctzl(differ);
+            return (int) (unsigned char) s1[i] -
+               (int) (unsigned char) s2[i];
+         }
+      }
+#endif
+
+   for (; i < len; i++)
+      if (s1[i] != s2[i])
+         return (int) (unsigned char) s1[i] -
+            (int) (unsigned char) s2[i];
+
+   if (len1 == len2)
+      return 0;
+   return len1 < len2 ? -1 : 1;
+}
+
+
+/* see path.h for specification */
+void Path_startTokens(struct Path_tokens* pTokens, const char* path) {
+   Path_startTokensAt(pTokens, path, 0);
+}
+
+
+/* see path.h for specification */
+void Path_startTokensAt(struct Path_tokens* pTokens, const char* path,
+size_t start) {
+   assert(pTokens != NULL);
+   assert(path != NULL);
+   assert(start == 0 || path[start - 1] == '/');
+
+   pTokens->path = path;
+   pTokens->numSlashes = 0;
+   pTokens->nextSlash = 0;
+   pTokens->scanEnd = start;
+   pTokens->isScanned = FALSE;
+   pTokens->start = start;
+   pTokens->isDone = FALSE;
+}
+
+
+/* see path.h for specification */
+boolean Path_nextToken(struct Path_tokens* pTokens, size_t* pStart,
+size_t* pLength) {
+   size_t slash;
+
+   assert(pTokens != NULL);
+   assert(pStart != NULL);
+   assert(pLength != NULL);
+
+   if (pTokens->isDone)
+      return FALSE;
+
+   if (pTokens->nextSlash == pTokens->numSlashes &&
+       !pTokens->isScanned) {
+      pTokens->numSlashes = Path_scan(pTokens->path, pTokens->scanEnd,
+                                      pTokens->slashes, PATH_CHUNK,
+                                      &pTokens->scanEnd);
+      pTokens->nextSlash = 0;
+      pTokens->isScanned = pTokens->numSlashes < PATH_CHUNK;
+   }
+
+   *pStart = pTokens->start;
+   if (pTokens->nextSlash < pTokens->numSlashes) {
+      slash = pTokens->slashes[pTokens->nextSlash++];
+      *pLength = slash - pTokens->start;
+      pTokens->start = slash + 1;
+   }
+   else {
+      /* the last component ends at the '\0' */
+      *pLength = pTokens->scanEnd - pTokens->start;
+      pTokens->isDone = TRUE;
+   }
+   return TRUE;
+}
+
+
+/* see path.h for specification */
+boolean Path_isLastToken(struct Path_tokens* pTokens) {
+   assert(pTokens != NULL);
+
+   return pTokens->isDone;
+}
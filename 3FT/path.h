@@ -0,0 +1,115 @@
+/*--------------------------------------------------------------------*/
+/* path.h                                                             */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef PATH_INCLUDED
+#define PATH_INCLUDED
+
+
+#include <stddef.h>
+#include "a4def.h"
+
+
+/*
+    Kernels the path functions can run on. Vector kernels handle 16
+    (SSE2) or 32 (AVX2) bytes at a time; by default the widest one the
+    CPU supports is picked on first use.
+*/
+enum { PATH_AUTO, PATH_SCALAR, PATH_SSE2, PATH_AVX2 };
+
+
+/*
+    Makes the path functions run on kernel, or on the one picked by
+    default if kernel is PATH_AUTO. Returns TRUE, or FALSE (changing
+    nothing) if this build or CPU cannot run kernel. Not meant to be
+    called while other threads use the path functions.
+*/
+boolean Path_useKernel(int kernel);
+
+
+/*
+    Finds the '/'s of the string path from offset start on, in one
+    pass, recording their offsets in path, in order, in slashes, until
+    maxSlashes (which must be positive) have been recorded. Returns
+    the number recorded. If it is maxSlashes, the scan stopped just
+    after the last one and *pEnd is set to where it stopped;
+    otherwise the string has no more '/'s and *pEnd is set to the
+    offset of its '\0'.
+*/
+size_t Path_scan(const char* path, size_t start, size_t* slashes,
+size_t maxSlashes, size_t* pEnd);
+
+
+/*
+    Compares the len1 bytes starting at s1 with the len2 bytes
+    starting at s2, neither of which need be '\0'-terminated. Returns
+    <0, 0, or >0 as strcmp would for strings holding those bytes.
+*/
+int Path_compare(const char* s1, size_t len1, const char* s2,
+size_t len2);
+
+
+/* The number of '/'s a Path_tokens finds per scan. */
+enum { PATH_CHUNK = 32 };
+
+
+/*
+    A Path_tokens splits a path into its components, which are the
+    runs of bytes between '/'s (and may be empty), finding the '/'s by
+    Path_scan a chunk at a time. It lives wherever its client puts it
+    and allocates no memory.
+*/
+struct Path_tokens {
+   /* the path being split */
+   const char* path;
+
+   /* the offsets of the '/'s found by the last scan, of which there
+      are numSlashes, and the next one not yet passed back */
+   size_t slashes[PATH_CHUNK];
+   size_t numSlashes;
+   size_t nextSlash;
+
+   /* where the last scan stopped, and whether it reached the '\0' */
+   size_t scanEnd;
+   boolean isScanned;
+
+   /* the offset of the next component, and whether the last one has
+      been passed back */
+   size_t start;
+   boolean isDone;
+};
+
+
+/*
+    Starts splitting path with *pTokens.
+*/
+void Path_startTokens(struct Path_tokens* pTokens, const char* path);
+
+
+/*
+    Starts splitting path with *pTokens from offset start, which must
+    be 0 or just past a '/', as if the components before it had
+    already been passed back.
+*/
+void Path_startTokensAt(struct Path_tokens* pTokens, const char* path,
+size_t start);
+
+
+/*
+    Passes back the offset in the path of its next component in
+    *pStart and the component's length in *pLength, and returns TRUE,
+    or returns FALSE if every component has been passed back.
+*/
+boolean Path_nextToken(struct Path_tokens* pTokens, size_t* pStart,
+size_t* pLength);
+
+
+/*
+    Returns TRUE if the component Path_nextToken last passed back is
+    the path's last one, and FALSE otherwise.
+*/
+boolean Path_isLastToken(struct Path_tokens* pTokens);
+
+#endif
@@ -0,0 +1,863 @@
+/*--------------------------------------------------------------------*/
+/* snapshot.c                                                         */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#include "dynarray.h"
+#include "snapshot.h"
+
+
+/* The first bytes of every snapshot. */
+static const char SNAPSHOT_MAGIC[8] = "FTSNAP01";
+
+/* A value whose bytes tell apart machines of different byte order
+   or word size. */
+static const size_t SNAPSHOT_ORDER = (size_t) 0x01020304;
+
+/* The version of the image layout below. */
+enum { SNAPSHOT_VERSION = 1 };
+
+/* What the root of a saved hierarchy is. */
+enum { SNAPSHOT_EMPTY, SNAPSHOT_ROOT_DIR, SNAPSHOT_ROOT_FILE };
+
+/* The contents offset of a file whose contents are NULL. */
+static const size_t SNAPSHOT_NO_CONTENTS = (size_t) -1;
+
+
+/* The header at the start of a snapshot. Offsets are in bytes from
+   the start of the image. */
+struct SnapshotHeader {
+   /* SNAPSHOT_MAGIC, SNAPSHOT_ORDER and SNAPSHOT_VERSION as written
+      by the machine that saved the image */
+   char magic[8];
+   size_t order;
+   size_t version;
+
+   /* SNAPSHOT_EMPTY, SNAPSHOT_ROOT_DIR (directory 0 is the root) or
+      SNAPSHOT_ROOT_FILE (file 0 is the root) */
+   size_t root;
+
+   /* the number of directory and file records, and where they are */
+   size_t numDirs;
+   size_t numFiles;
+   size_t dirs;
+   size_t files;
+
+   /* where the name pool and the contents blob are, and their sizes */
+   size_t names;
+   size_t namesSize;
+   size_t contents;
+   size_t contentsSize;
+};
+
+
+/* A saved directory. */
+struct SnapshotDir {
+   /* the offset of its '\0'-terminated name in the name pool, and
+      the name's length */
+   size_t name;
+   size_t nameLength;
+
+   /* the indices of its first child directory and first child file,
+      and their numbers; children are sorted by name */
+   size_t firstDir;
+   size_t numDirs;
+   size_t firstFile;
+   size_t numFiles;
+};
+
+
+/* A saved file. */
+struct SnapshotFile {
+   /* the offset of its name in the name pool, and its length */
+   size_t name;
+   size_t nameLength;
+
+   /* the offset of its contents in the contents blob, or
+      SNAPSHOT_NO_CONTENTS, and their length */
+   size_t contents;
+   size_t length;
+};
+
+
+/* A mapped snapshot. */
+struct Snapshot {
+   /* the mapping, and its size */
+   void* image;
+   size_t size;
+
+   /* the parts of the image */
+   const struct SnapshotHeader* header;
+   const struct SnapshotDir* dirs;
+   const struct SnapshotFile* files;
+   const char* names;
+   const char* contents;
+};
+
+
+/**********************************************************************/
+/* Saving */
+/**********************************************************************/
+
+
+/*
+   Returns the name of the i'th directory of dirs, passing back its
+   length in *pLength. The directory is the NodeDir there or, if
+   that stands for a chain of directories (see NodeDir_getLabel), the
+   one of them whose name starts where the i'th key says in its
+   label; *pIsLast is set to whether it is the last of them, which
+   has the NodeDir's children.
+*/
+static const char* Snapshot_dirName(DynArray_T dirs, size_t i,
+size_t* pLength, boolean* pIsLast) {
+   const char* label;
+   const char* slash;
+   size_t labelLen;
+   size_t at;
+
+   assert(dirs != NULL);
+   assert(pLength != NULL);
+   assert(pIsLast != NULL);
+
+   label = NodeDir_getLabel(DynArray_get(dirs, i), &labelLen);
+   at = DynArray_getKey(dirs, i);
+   slash = memchr(label + at, '/', labelLen - at);
+   *pIsLast = slash == NULL;
+   *pLength = *pIsLast ? labelLen - at : (size_t) (slash - label) - at;
+   return label + at;
+}
+
+
+/*
+   Appends the directories of the hierarchy rooted at rootDir to
+   dirs in breadth-first order, as Snapshot_dirName describes them,
+   and the NodeFiles to files in the same order as their parents.
+   Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Snapshot_collect(NodeDir rootDir, DynArray_T dirs,
+DynArray_T files) {
+   NodeDir n;
+   size_t length;
+   boolean isLast;
+   size_t i;
+   size_t j;
+
+   assert(rootDir != NULL);
+   assert(dirs != NULL);
+   assert(files != NULL);
+
+   if (!DynArray_add(dirs, rootDir))
+      return MEMORY_ERROR;
+
+   for (i = 0; i < DynArray_getLength(dirs); i++) {
+      n = DynArray_get(dirs, i);
+
+      /* the next directory of a chain is its only child */
+      (void) Snapshot_dirName(dirs, i, &length, &isLast);
+      if (!isLast) {
+         if (!DynArray_add(dirs, n))
+            return MEMORY_ERROR;
+         DynArray_setKey(dirs, DynArray_getLength(dirs) - 1,
+                         DynArray_getKey(dirs, i) + length + 1);
+         continue;
+      }
+
+      for (j = 0; j < NodeDir_getNumChildDirs(n); j++)
+         if (!DynArray_add(dirs, NodeDir_getChildDir(n, j)))
+            return MEMORY_ERROR;
+      for (j = 0; j < NodeDir_getNumChildFiles(n); j++)
+         if (!DynArray_add(files, NodeDir_getChildFile(n, j)))
+            return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+
+/*
+   Fills in *pHeader for an image of the directories in dirs and the
+   NodeFiles in files.
+*/
+static void Snapshot_layOut(DynArray_T dirs, DynArray_T files,
+struct SnapshotHeader* pHeader) {
+   NodeFile file;
+   size_t length;
+   boolean isLast;
+   size_t i;
+
+   assert(dirs != NULL);
+   assert(files != NULL);
+   assert(pHeader != NULL);
+
+   memcpy(pHeader->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+   pHeader->order = SNAPSHOT_ORDER;
+   pHeader->version = SNAPSHOT_VERSION;
+
+   pHeader->numDirs = DynArray_getLength(dirs);
+   pHeader->numFiles = DynArray_getLength(files);
+   if (pHeader->numDirs > 0)
+      pHeader->root = SNAPSHOT_ROOT_DIR;
+   else if (pHeader->numFiles > 0)
+      pHeader->root = SNAPSHOT_ROOT_FILE;
+   else
+      pHeader->root = SNAPSHOT_EMPTY;
+
+   pHeader->namesSize = 0;
+   for (i = 0; i < pHeader->numDirs; i++) {
+      (void) Snapshot_dirName(dirs, i, &length, &isLast);
+      pHeader->namesSize += length + 1;
+   }
+
+   pHeader->contentsSize = 0;
+   for (i = 0; i < pHeader->numFiles; i++) {
+      file = DynArray_get(files, i);
+      pHeader->namesSize += strlen(NodeFile_getName(file)) + 1;
+      if (NodeFile_getContents(file) != NULL)
+         pHeader->contentsSize += NodeFile_getLength(file);
+   }
+
+   pHeader->dirs = sizeof(struct SnapshotHeader);
+   pHeader->files = pHeader->dirs +
+      pHeader->numDirs * sizeof(struct SnapshotDir);
+   pHeader->names = pHeader->files +
+      pHeader->numFiles * sizeof(struct SnapshotFile);
+   pHeader->contents = pHeader->names + pHeader->namesSize;
+}
+
+
+/*
+   Writes the image of the directories in dirs and the NodeFiles in
+   files, laid out as header describes, to stream. Returns TRUE if
+   every write succeeded, and FALSE otherwise.
+*/
+static boolean Snapshot_write(FILE* stream, DynArray_T dirs,
+DynArray_T files, const struct SnapshotHeader* header) {
+   struct SnapshotDir dirRecord;
+   struct SnapshotFile fileRecord;
+   NodeDir dir;
+   NodeFile file;
+   const char* name;
+   size_t length;
+   boolean isLast;
+   size_t nextName = 0;
+   size_t nextDir = 1;
+   size_t nextFile = 0;
+   size_t nextContents = 0;
+   size_t i;
+   boolean ok;
+
+   assert(stream != NULL);
+   assert(header != NULL);
+
+   ok = fwrite(header, sizeof(*header), 1, stream) == 1;
+
+   /* children of each directory follow those of the ones before it,
+      in the order Snapshot_collect put them in */
+   for (i = 0; i < header->numDirs; i++) {
+      dir = DynArray_get(dirs, i);
+      (void) Snapshot_dirName(dirs, i, &length, &isLast);
+      dirRecord.name = nextName;
+      dirRecord.nameLength = length;
+      dirRecord.firstDir = nextDir;
+      dirRecord.numDirs = isLast ? NodeDir_getNumChildDirs(dir) : 1;
+      dirRecord.firstFile = nextFile;
+      dirRecord.numFiles = isLast ? NodeDir_getNumChildFiles(dir) : 0;
+      nextName += dirRecord.nameLength + 1;
+      nextDir += dirRecord.numDirs;
+      nextFile += dirRecord.numFiles;
+      ok = ok &&
+         fwrite(&dirRecord, sizeof(dirRecord), 1, stream) == 1;
+   }
+
+   for (i = 0; i < header->numFiles; i++) {
+      file = DynArray_get(files, i);
+      fileRecord.name = nextName;
+      fileRecord.nameLength = strlen(NodeFile_getName(file));
+      fileRecord.length = NodeFile_getLength(file);
+      if (NodeFile_getContents(file) == NULL)
+         fileRecord.contents = SNAPSHOT_NO_CONTENTS;
+      else {
+         fileRecord.contents = nextContents;
+         nextContents += fileRecord.length;
+      }
+      nextName += fileRecord.nameLength + 1;
+      ok = ok &&
+         fwrite(&fileRecord, sizeof(fileRecord), 1, stream) == 1;
+   }
+
+   for (i = 0; i < header->numDirs; i++) {
+      name = Snapshot_dirName(dirs, i, &length, &isLast);
+      ok = ok && fwrite(name, length, 1, stream) == 1 &&
+         putc('\0', stream) != EOF;
+   }
+   for (i = 0; i < header->numFiles; i++) {
+      name = NodeFile_getName(DynArray_get(files, i));
+      ok = ok && fwrite(name, strlen(name) + 1, 1, stream) == 1;
+   }
+
+   for (i = 0; i < header->numFiles; i++) {
+      file = DynArray_get(files, i);
+      if (NodeFile_getContents(file) != NULL &&
+          NodeFile_getLength(file) > 0)
+         ok = ok && fwrite(NodeFile_getContents(file),
+                           NodeFile_getLength(file), 1, stream) == 1;
+   }
+
+   return ok;
+}
+
+
+/*
+   Writes the image of the NodeDirs in dirs and the NodeFiles in
+   files to filename, by way of a temporary file next to it.
+   Returns SUCCESS, MEMORY_ERROR or FILE_ERROR.
+*/
+static int Snapshot_writeFile(const char* filename, DynArray_T dirs,
+DynArray_T files) {
+   struct SnapshotHeader header;
+   FILE* stream;
+   char* tempname;
+   boolean ok;
+
+   assert(filename != NULL);
+
+   tempname = malloc(strlen(filename) + sizeof(".tmp"));
+   if (tempname == NULL)
+      return MEMORY_ERROR;
+   strcpy(tempname, filename);
+   strcat(tempname, ".tmp");
+
+   stream = fopen(tempname, "wb");
+   if (stream == NULL) {
+      free(tempname);
+      return FILE_ERROR;
+   }
+
+   Snapshot_layOut(dirs, files, &header);
+   ok = Snapshot_write(stream, dirs, files, &header);
+   if (fclose(stream) != 0)
+      ok = FALSE;
+
+   if (!ok || rename(tempname, filename) != 0) {
+      (void) remove(tempname);
+      free(tempname);
+      return FILE_ERROR;
+   }
+
+   free(tempname);
+   return SUCCESS;
+}
+
+
+/* see snapshot.h for specification */
+int Snapshot_save(const char* filename, NodeDir rootDir,
+NodeFile rootFile) {
+   DynArray_T dirs;
+   DynArray_T files;
+   int result = SUCCESS;
+
+   assert(filename != NULL);
+   assert(rootDir == NULL || rootFile == NULL);
+
+   dirs = DynArray_newKeyedIn(0, NULL);
+   files = DynArray_new(0);
+   if (dirs == NULL || files == NULL)
+      result = MEMORY_ERROR;
+   else if (rootDir != NULL)
+      result = Snapshot_collect(rootDir, dirs, files);
+   else if (rootFile != NULL && !DynArray_add(files, rootFile))
+      result = MEMORY_ERROR;
+
+   if (result == SUCCESS)
+      result = Snapshot_writeFile(filename, dirs, files);
+
+   if (dirs != NULL)
+      DynArray_free(dirs);
+   if (files != NULL)
+      DynArray_free(files);
+   return result;
+}
+
+
+/**********************************************************************/
+/* Opening */
+/**********************************************************************/
+
+
+/*
+   Returns TRUE if count records of size bytes starting at offset fit
+   in total bytes, and FALSE otherwise.
+*/
+static boolean Snapshot_fits(size_t offset, size_t count, size_t size,
+size_t total) {
+   assert(size > 0);
+
+   return offset <= total && count <= (total - offset) / size;
+}
+
+
+/*
+   Returns TRUE if s's header is that of a snapshot this machine can
+   read, and every part it describes lies within the image, and FALSE
+   otherwise.
+*/
+static boolean Snapshot_checkHeader(Snapshot_T s) {
+   const struct SnapshotHeader* h;
+
+   assert(s != NULL);
+
+   if (s->size < sizeof(struct SnapshotHeader))
+      return FALSE;
+   h = s->header;
+
+   if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+       h->order != SNAPSHOT_ORDER || h->version != SNAPSHOT_VERSION)
+      return FALSE;
+
+   if ((h->root == SNAPSHOT_ROOT_DIR && h->numDirs == 0) ||
+       (h->root == SNAPSHOT_ROOT_FILE &&
+        (h->numDirs != 0 || h->numFiles != 1)) ||
+       h->root > SNAPSHOT_ROOT_FILE)
+      return FALSE;
+
+   /* the records are read in place, so must be aligned */
+   if (h->dirs % sizeof(size_t) != 0 || h->files % sizeof(size_t) != 0)
+      return FALSE;
+
+   return Snapshot_fits(h->dirs, h->numDirs, sizeof(struct SnapshotDir),
+                        s->size) &&
+      Snapshot_fits(h->files, h->numFiles, sizeof(struct SnapshotFile),
+                    s->size) &&
+      Snapshot_fits(h->names, h->namesSize, 1, s->size) &&
+      Snapshot_fits(h->contents, h->contentsSize, 1, s->size);
+}
+
+
+/* see snapshot.h for specification */
+int Snapshot_open(const char* filename, Snapshot_T* pS) {
+   Snapshot_T s;
+   struct stat st;
+   void* image;
+   int fd;
+
+   assert(filename != NULL);
+   assert(pS != NULL);
+
+   fd = open(filename, O_RDONLY);
+   if (fd < 0)
+      return FILE_ERROR;
+   if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      (void) close(fd);
+      return FILE_ERROR;
+   }
+
+   /* the mapping outlives the descriptor */
+   image = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                0);
+   (void) close(fd);
+   if (image == MAP_FAILED)
+      return FILE_ERROR;
+
+   s = malloc(sizeof(struct Snapshot));
+   if (s == NULL) {
+      (void) munmap(image, (size_t) st.st_size);
+      return MEMORY_ERROR;
+   }
+   s->image = image;
+   s->size = (size_t) st.st_size;
+   s->header = image;
+
+   if (!Snapshot_checkHeader(s)) {
+      Snapshot_close(s);
+      return FILE_ERROR;
+   }
+
+   s->dirs = (const void*) ((const char*) image + s->header->dirs);
+   s->files = (const void*) ((const char*) image + s->header->files);
+   s->names = (const char*) image + s->header->names;
+   s->contents = (const char*) image + s->header->contents;
+
+   *pS = s;
+   return SUCCESS;
+}
+
+
+/* see snapshot.h for specification */
+void Snapshot_close(Snapshot_T s) {
+   if (s == NULL)
+      return;
+
+   (void) munmap(s->image, s->size);
+   free(s);
+}
+
+
+/**********************************************************************/
+/* Reading */
+/**********************************************************************/
+
+
+/*
+   Returns the name at offset name, of length length, in s's name
+   pool, or NULL if it does not lie within the pool.
+*/
+static const char* Snapshot_name(Snapshot_T s, size_t name,
+size_t length) {
+   assert(s != NULL);
+
+   if (name >= s->header->namesSize ||
+       length >= s->header->namesSize - name ||
+       s->names[name + length] != '\0')
+      return NULL;
+   return s->names + name;
+}
+
+
+/*
+   Passes back in *pContents the contents of file record f of s, or
+   NULL if it has none. Returns TRUE if successful, or FALSE if they
+   do not lie within the contents blob.
+*/
+static boolean Snapshot_contents(Snapshot_T s,
+const struct SnapshotFile* f, void** pContents) {
+   assert(s != NULL);
+   assert(f != NULL);
+   assert(pContents != NULL);
+
+   if (f->contents == SNAPSHOT_NO_CONTENTS) {
+      *pContents = NULL;
+      return TRUE;
+   }
+   if (!Snapshot_fits(f->contents, f->length, 1,
+                      s->header->contentsSize))
+      return FALSE;
+
+   /* the mapping is read-only; the cast only lets the contents be
+      handed out as FT_getFileContents hands out any others */
+   *pContents = (void*) (s->contents + f->contents);
+   return TRUE;
+}
+
+
+/*
+   Returns TRUE if directory record d, at index dirIndex, of s has
+   children that lie within the tables and come after it, and FALSE
+   otherwise. Children coming later guarantees that following them
+   never loops.
+*/
+static boolean Snapshot_checkDir(Snapshot_T s,
+const struct SnapshotDir* d, size_t dirIndex) {
+   assert(s != NULL);
+   assert(d != NULL);
+
+   return (d->numDirs == 0 || d->firstDir > dirIndex) &&
+      Snapshot_fits(d->firstDir, d->numDirs, 1, s->header->numDirs) &&
+      Snapshot_fits(d->firstFile, d->numFiles, 1, s->header->numFiles);
+}
+
+
+/*
+   Compares name against the len chars starting at comp, as
+   NodeDir_compareName does.
+*/
+static int Snapshot_compareName(const char* name, const char* comp,
+size_t len) {
+   int result;
+
+   assert(name != NULL);
+   assert(comp != NULL);
+
+   result = strncmp(name, comp, len);
+   if (result == 0 && name[len] != '\0')
+      return 1;
+   return result;
+}
+
+
+/*
+   Binary searches the count consecutive records starting at index
+   first of records, each size bytes long and starting with a name
+   offset and length, for the one named by the len chars at comp.
+   Returns TRUE and passes its index back in *pIndex if there is one,
+   and returns FALSE otherwise.
+*/
+static boolean Snapshot_search(Snapshot_T s, const void* records,
+size_t size, size_t first, size_t count, const char* comp,
+size_t len, size_t* pIndex) {
+   const size_t* record;
+   const char* name;
+   size_t lo = first;
+   size_t hi = first + count;
+   size_t mid;
+   int result;
+
+   assert(s != NULL);
+   assert(records != NULL);
+   assert(comp != NULL);
+   assert(pIndex != NULL);
+
+   while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      record = (const void*) ((const char*) records + mid * size);
+      name = Snapshot_name(s, record[0], record[1]);
+      if (name == NULL)
+         return FALSE;
+
+      result = Snapshot_compareName(name, comp, len);
+      if (result == 0) {
+         *pIndex = mid;
+         return TRUE;
+      }
+      if (result < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return FALSE;
+}
+
+
+/* see snapshot.h for specification */
+int Snapshot_lookup(Snapshot_T s, const char* path, boolean* pIsFile,
+void** pContents, size_t* pLength) {
+   const struct SnapshotDir* d;
+   const struct SnapshotFile* f = NULL;
+   const char* comp = path;
+   const char* end;
+   const char* name;
+   size_t dirIndex = 0;
+   size_t index;
+
+   assert(s != NULL);
+   assert(path != NULL);
+   assert(pIsFile != NULL);
+   assert(pContents != NULL);
+   assert(pLength != NULL);
+
+   end = strchr(comp, '/');
+   if (end == NULL)
+      end = comp + strlen(comp);
+
+   if (s->header->root == SNAPSHOT_EMPTY)
+      return NO_SUCH_PATH;
+
+   if (s->header->root == SNAPSHOT_ROOT_FILE) {
+      f = &s->files[0];
+      name = Snapshot_name(s, f->name, f->nameLength);
+   }
+   else
+      name = Snapshot_name(s, s->dirs[0].name, s->dirs[0].nameLength);
+   if (name == NULL ||
+       Snapshot_compareName(name, comp, (size_t) (end - comp)) != 0)
+      return NO_SUCH_PATH;
+
+   while (f == NULL && *end != '\0') {
+      d = &s->dirs[dirIndex];
+      if (!Snapshot_checkDir(s, d, dirIndex))
+         return NO_SUCH_PATH;
+
+      comp = end + 1;
+      end = strchr(comp, '/');
+      if (end == NULL)
+         end = comp + strlen(comp);
+
+      if (Snapshot_search(s, s->dirs, sizeof(struct SnapshotDir),
+                          d->firstDir, d->numDirs, comp,
+                          (size_t) (end - comp), &index)) {
+         dirIndex = index;
+         continue;
+      }
+
+      if (!Snapshot_search(s, s->files, sizeof(struct SnapshotFile),
+                           d->firstFile, d->numFiles, comp,
+                           (size_t) (end - comp), &index))
+         return NO_SUCH_PATH;
+      f = &s->files[index];
+   }
+
+   if (f == NULL) {
+      *pIsFile = FALSE;
+      return SUCCESS;
+   }
+   if (*end != '\0' || !Snapshot_contents(s, f, pContents))
+      return NO_SUCH_PATH;
+   *pIsFile = TRUE;
+   *pLength = f->length;
+   return SUCCESS;
+}
+
+
+/**********************************************************************/
+/* Building */
+/**********************************************************************/
+
+
+/*
+   Creates a NodeFile from file record f of s below parent (which may
+   be NULL), allocated from arena, and passes it back in *pNew.
+   Returns SUCCESS, MEMORY_ERROR or FILE_ERROR.
+*/
+static int Snapshot_buildFile(Snapshot_T s,
+const struct SnapshotFile* f, NodeDir parent, Arena_T arena,
+NodeFile* pNew) {
+   const char* name;
+   void* contents;
+
+   assert(s != NULL);
+   assert(f != NULL);
+   assert(pNew != NULL);
+
+   name = Snapshot_name(s, f->name, f->nameLength);
+   if (name == NULL || f->nameLength == 0 ||
+       !Snapshot_contents(s, f, &contents))
+      return FILE_ERROR;
+
+   *pNew = NodeFile_createIn(name, parent, contents, f->length, NULL,
+                             arena);
+   if (*pNew == NULL)
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+
+/*
+   Creates a NodeDir from directory record dirIndex of s below parent
+   (which may be NULL), without its children, allocated from arena,
+   and passes it back in *pNew. Returns SUCCESS, MEMORY_ERROR or
+   FILE_ERROR.
+*/
+static int Snapshot_createDir(Snapshot_T s, size_t dirIndex,
+NodeDir parent, Arena_T arena, NodeDir* pNew) {
+   const struct SnapshotDir* d;
+   const char* name;
+
+   assert(s != NULL);
+   assert(dirIndex < s->header->numDirs);
+   assert(pNew != NULL);
+
+   d = &s->dirs[dirIndex];
+   name = Snapshot_name(s, d->name, d->nameLength);
+   if (name == NULL || d->nameLength == 0 ||
+       !Snapshot_checkDir(s, d, dirIndex))
+      return FILE_ERROR;
+
+   *pNew = NodeDir_createIn(name, parent, arena);
+   if (*pNew == NULL)
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+
+/*
+   Creates the hierarchy of directories saved in s, allocated from
+   arena, and passes its root back in *pNew and its number of
+   NodeDirs in *pCount. The children of every directory record come
+   after it, so the records are built in order, each below the
+   NodeDir already built for its parent, and no stack is needed
+   however deep the hierarchy is. Returns SUCCESS, MEMORY_ERROR or
+   FILE_ERROR, in which case nothing is left allocated.
+*/
+static int Snapshot_buildDirs(Snapshot_T s, Arena_T arena,
+NodeDir* pNew, size_t* pCount) {
+   const struct SnapshotDir* d;
+   NodeDir* built;
+   NodeDir childDir;
+   NodeFile childFile;
+   size_t count = 0;
+   size_t dirIndex;
+   size_t child;
+   size_t i;
+   int result;
+
+   assert(s != NULL);
+   assert(pNew != NULL);
+   assert(pCount != NULL);
+
+   /* the NodeDir built for each record, NULL until it is */
+   built = calloc(s->header->numDirs, sizeof(NodeDir));
+   if (built == NULL)
+      return MEMORY_ERROR;
+
+   result = Snapshot_createDir(s, 0, NULL, arena, &built[0]);
+   for (dirIndex = 0; result == SUCCESS &&
+                      dirIndex < s->header->numDirs; dirIndex++) {
+      /* records no directory names as a child are left out */
+      if (built[dirIndex] == NULL)
+         continue;
+      d = &s->dirs[dirIndex];
+      count++;
+
+      for (i = 0; result == SUCCESS && i < d->numFiles; i++) {
+         result = Snapshot_buildFile(s, &s->files[d->firstFile + i],
+                                     built[dirIndex], arena,
+                                     &childFile);
+         if (result == SUCCESS &&
+             NodeDir_linkChildFile(built[dirIndex], childFile) !=
+             SUCCESS) {
+            (void) NodeFile_destroy(childFile);
+            result = FILE_ERROR;
+         }
+      }
+
+      for (i = 0; result == SUCCESS && i < d->numDirs; i++) {
+         /* a record named as the child of two directories would
+            make a hierarchy that is not a tree */
+         child = d->firstDir + i;
+         if (built[child] != NULL) {
+            result = FILE_ERROR;
+            break;
+         }
+         result = Snapshot_createDir(s, child, built[dirIndex], arena,
+                                     &childDir);
+         if (result == SUCCESS &&
+             NodeDir_linkChildDir(built[dirIndex], childDir) !=
+             SUCCESS) {
+            (void) NodeDir_destroy(childDir);
+            result = FILE_ERROR;
+         }
+         if (result == SUCCESS)
+            built[child] = childDir;
+      }
+   }
+
+   if (result == SUCCESS) {
+      *pNew = built[0];
+      *pCount = count;
+   }
+   else if (built[0] != NULL)
+      (void) NodeDir_destroy(built[0]);
+   free(built);
+   return result;
+}
+
+
+/* see snapshot.h for specification */
+int Snapshot_build(Snapshot_T s, Arena_T arena, NodeDir* pRootDir,
+NodeFile* pRootFile, size_t* pCountDirs) {
+   assert(s != NULL);
+   assert(pRootDir != NULL);
+   assert(pRootFile != NULL);
+   assert(pCountDirs != NULL);
+
+   *pRootDir = NULL;
+   *pRootFile = NULL;
+   *pCountDirs = 0;
+
+   if (s->header->root == SNAPSHOT_ROOT_FILE)
+      return Snapshot_buildFile(s, &s->files[0], NULL, arena,
+                                pRootFile);
+   if (s->header->root == SNAPSHOT_ROOT_DIR)
+      return Snapshot_buildDirs(s, arena, pRootDir, pCountDirs);
+   return SUCCESS;
+}
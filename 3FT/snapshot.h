@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------*/
+/* snapshot.h                                                         */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef SNAPSHOT_INCLUDED
+#define SNAPSHOT_INCLUDED
+
+
+#include <stddef.h>
+#include "a4def.h"
+#include "arena.h"
+#include "nodeDir.h" /* this includes nodeFile.h too */
+
+
+/*
+    a Snapshot_T is a File Tree hierarchy saved to a file and mapped
+    read-only back into memory. The file holds a table of directories,
+    in breadth-first order so that each directory's children are
+    consecutive, a table of files, a pool of names and a blob of
+    contents, all referring to one another by offset, so the image can
+    be used wherever it is mapped without being converted first.
+
+    Images are only readable on machines with the same byte order
+    and word size as the one that saved them.
+*/
+typedef struct Snapshot* Snapshot_T;
+
+
+/*
+    Saves the hierarchy rooted at rootDir or rootFile (at most one of
+    which is non-NULL; if both are, the hierarchy is empty) to the
+    file filename, replacing it if it exists. The file is written in
+    full under a temporary name and then renamed, so an existing
+    snapshot is never left half overwritten.
+    Returns SUCCESS, MEMORY_ERROR, or FILE_ERROR if the file cannot be
+    written.
+*/
+int Snapshot_save(const char* filename, NodeDir rootDir,
+NodeFile rootFile);
+
+
+/*
+    Maps the snapshot in file filename and passes it back in *pS.
+    Only the header is checked; the rest of the image is checked as
+    it is used.
+    Returns SUCCESS, MEMORY_ERROR, or FILE_ERROR if the file cannot be
+    read or is not a snapshot.
+*/
+int Snapshot_open(const char* filename, Snapshot_T* pS);
+
+
+/*
+    Unmaps s and frees it. Contents looked up in s are no longer valid
+    afterwards. Does nothing if s is NULL.
+*/
+void Snapshot_close(Snapshot_T s);
+
+
+/*
+    Looks up path in s. If it names a file, sets *pIsFile to TRUE,
+    *pContents to the file's contents, which are read-only and live as
+    long as s, and *pLength to their length. If it names a directory,
+    sets *pIsFile to FALSE and leaves the rest unchanged.
+    Returns SUCCESS, or NO_SUCH_PATH if path names nothing in s.
+*/
+int Snapshot_lookup(Snapshot_T s, const char* path, boolean* pIsFile,
+void** pContents, size_t* pLength);
+
+
+/*
+    Builds the hierarchy saved in s out of nodes allocated from arena,
+    and passes back its root in *pRootDir or *pRootFile (the other is
+    set to NULL; both are if the hierarchy is empty) and its number of
+    NodeDirs in *pCountDirs. The files' contents are those in s.
+    Returns SUCCESS, MEMORY_ERROR, or FILE_ERROR if the image is
+    damaged, in which case nothing is built.
+*/
+int Snapshot_build(Snapshot_T s, Arena_T arena, NodeDir* pRootDir,
+NodeFile* pRootFile, size_t* pCountDirs);
+
+#endif
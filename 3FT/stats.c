@@ -0,0 +1,132 @@
+/*--------------------------------------------------------------------*/
+/* stats.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+
+#include "stats.h"
+
+
+/* see stats.h for specification */
+__thread size_t Stats_counts[STATS_NUM_COUNTERS];
+
+
+/* The number of operations the calling thread is inside of. */
+static __thread size_t depth;
+
+
+/* The calling thread's counts and time when its outermost operation
+   began. */
+static __thread size_t startCounts[STATS_NUM_COUNTERS];
+static __thread struct timespec startTime;
+
+
+/* The totals of every operation. */
+static struct Stats_report report;
+
+
+/* The hook called after each operation, and its extra argument. */
+static Stats_hook hook;
+static void* hookExtra;
+
+
+/*
+    Returns the latency bucket of a call that took ns nanoseconds.
+*/
+static size_t Stats_bucket(size_t ns) {
+   size_t bucket = 0;
+
+   for (; ns > 0 && bucket < STATS_NUM_BUCKETS - 1; ns >>= 1)
+      bucket++;
+   return bucket;
+}
+
+
+/* see stats.h for specification */
+void Stats_begin(void) {
+   if (depth++ > 0)
+      return;
+
+   memcpy(startCounts, Stats_counts, sizeof startCounts);
+   clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+
+/* see stats.h for specification */
+int Stats_end(enum Stats_op op, const char* path, int status) {
+   struct timespec endTime;
+   struct Stats_call call;
+   struct Stats_totals* totals;
+   size_t i;
+
+   assert((size_t) op < STATS_NUM_OPS);
+   assert(depth > 0);
+
+   if (--depth > 0)
+      return status;
+
+   clock_gettime(CLOCK_MONOTONIC, &endTime);
+   call.op = op;
+   call.path = path;
+   call.status = status;
+   call.ns = (size_t) ((endTime.tv_sec - startTime.tv_sec) *
+                       1000000000L +
+                       (endTime.tv_nsec - startTime.tv_nsec));
+   for (i = 0; i < STATS_NUM_COUNTERS; i++)
+      call.counts[i] = Stats_counts[i] - startCounts[i];
+
+   /* each field is added on its own, so a report taken meanwhile
+      may see part of a call */
+   totals = &report.ops[op];
+   (void) __atomic_add_fetch(&totals->calls, 1, __ATOMIC_RELAXED);
+   (void) __atomic_add_fetch(&totals->ns, call.ns, __ATOMIC_RELAXED);
+   for (i = 0; i < STATS_NUM_COUNTERS; i++)
+      (void) __atomic_add_fetch(&totals->counts[i], call.counts[i],
+                                __ATOMIC_RELAXED);
+   (void) __atomic_add_fetch(&totals->latency[Stats_bucket(call.ns)],
+                             1, __ATOMIC_RELAXED);
+
+   if (hook != NULL)
+      hook(&call, hookExtra);
+   return status;
+}
+
+
+/* see stats.h for specification */
+void Stats_getReport(struct Stats_report* pReport) {
+   size_t* from = (size_t*) &report;
+   size_t* to = (size_t*) pReport;
+   size_t i;
+
+   assert(pReport != NULL);
+
+   /* the report is nothing but size_ts */
+   for (i = 0; i < sizeof report / sizeof(size_t); i++)
+      to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+}
+
+
+/* see stats.h for specification */
+void Stats_reset(void) {
+   size_t* fields = (size_t*) &report;
+   size_t i;
+
+   for (i = 0; i < sizeof report / sizeof(size_t); i++)
+      __atomic_store_n(&fields[i], 0, __ATOMIC_RELAXED);
+}
+
+
+/* see stats.h for specification */
+void Stats_setHook(Stats_hook newHook, void* pvExtra) {
+   hook = newHook;
+   hookExtra = pvExtra;
+}
@@ -0,0 +1,163 @@
+/*--------------------------------------------------------------------*/
+/* stats.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+
+#include <stddef.h>
+
+
+/*
+    Counts and latencies of the FT's operations, kept only in builds
+    with FT_STATS defined. Every module counts its work with
+    STATS_COUNT, and each FT operation is bracketed by STATS_BEGIN and
+    STATS_END, which add the counts made in between to that
+    operation's totals. Without FT_STATS, the macros compile to
+    nothing and the totals stay at zero.
+
+    Counts are kept per thread and added to the totals atomically, so
+    operations may run in many threads at once. An operation run
+    inside another is counted as part of the outer one.
+*/
+
+
+/* The operations whose totals are kept. */
+enum Stats_op {
+   STATS_INSERT_DIR, STATS_INSERT_FILE, STATS_RM_DIR, STATS_RM_FILE,
+   STATS_CONTAINS, STATS_GET_CONTENTS, STATS_REPLACE_CONTENTS,
+   STATS_STAT, STATS_TO_STRING, STATS_BATCH, STATS_MOVE,
+   STATS_NUM_OPS
+};
+
+
+/* The kinds of work counted. */
+enum Stats_counter {
+   /* directories searched for a child, and nodes passed over by
+      traversals */
+   STATS_NODES_VISITED,
+
+   /* comparisons of names */
+   STATS_COMPARES,
+
+   /* allocations, whether from malloc or an arena */
+   STATS_ALLOCS,
+
+   /* elements moved to open or close a gap in a DynArray */
+   STATS_SHIFTS,
+
+   STATS_NUM_COUNTERS
+};
+
+
+/*
+    The number of latency buckets: bucket i counts calls that took
+    from 2^(i-1) up to 2^i - 1 nanoseconds, except that the last also
+    counts all slower calls.
+*/
+enum { STATS_NUM_BUCKETS = 32 };
+
+
+/* The totals of one operation. */
+struct Stats_totals {
+   /* the number of calls, and the nanoseconds they took in all */
+   size_t calls;
+   size_t ns;
+
+   /* the work they did, indexed by enum Stats_counter */
+   size_t counts[STATS_NUM_COUNTERS];
+
+   /* how long they took, bucketed as above */
+   size_t latency[STATS_NUM_BUCKETS];
+};
+
+
+/* The totals of every operation, indexed by enum Stats_op. */
+struct Stats_report {
+   struct Stats_totals ops[STATS_NUM_OPS];
+};
+
+
+/* One call to an operation, as passed to a Stats_hook. */
+struct Stats_call {
+   /* the operation, and the path it was given, or NULL if none */
+   enum Stats_op op;
+   const char* path;
+
+   /* what it returned: a status, a boolean, or, for those returning
+      a pointer, whether it was not NULL */
+   int status;
+
+   /* the nanoseconds it took, and the work it did, indexed by enum
+      Stats_counter */
+   size_t ns;
+   size_t counts[STATS_NUM_COUNTERS];
+};
+
+
+/*
+    A function to be called after each operation, in the thread that
+    ran it, with the call and the pvExtra it was set with.
+*/
+typedef void (*Stats_hook)(const struct Stats_call* pCall,
+                           void* pvExtra);
+
+
+#ifdef FT_STATS
+
+/* The running counts of the calling thread, for STATS_COUNT. */
+extern __thread size_t Stats_counts[STATS_NUM_COUNTERS];
+
+#define STATS_COUNT(counter, n) \
+   ((void) (Stats_counts[counter] += (size_t) (n)))
+#define STATS_BEGIN() Stats_begin()
+#define STATS_END(op, path, status) Stats_end(op, path, status)
+
+#else
+
+#define STATS_COUNT(counter, n) ((void) 0)
+#define STATS_BEGIN() ((void) 0)
+#define STATS_END(op, path, status) (status)
+
+#endif
+
+
+/*
+    Starts an operation in the calling thread. Use STATS_BEGIN.
+*/
+void Stats_begin(void);
+
+
+/*
+    Ends the operation the calling thread started last, as op on path
+    returning status, and returns status. Adds its counts to the
+    totals, and passes it to the hook, unless it ran inside another
+    operation. Use STATS_END.
+*/
+int Stats_end(enum Stats_op op, const char* path, int status);
+
+
+/*
+    Fills in *pReport with the totals so far. Operations still running
+    may be partly counted.
+*/
+void Stats_getReport(struct Stats_report* pReport);
+
+
+/*
+    Sets the totals back to zero.
+*/
+void Stats_reset(void);
+
+
+/*
+    Makes hook, if not NULL, be called with pvExtra after each
+    operation from then on. Must not run at the same time as any
+    operation.
+*/
+void Stats_setHook(Stats_hook hook, void* pvExtra);
+
+#endif
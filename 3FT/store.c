@@ -0,0 +1,268 @@
+/*--------------------------------------------------------------------*/
+/* store.c                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "store.h"
+
+
+/* The number of slots a store starts with, a power of two. */
+enum { STORE_MIN_SLOTS = 64 };
+
+
+/* A slot of a store. */
+struct Store_slot {
+   /* the hash of the blob's bytes, compared before the bytes
+      themselves so that most probes need not touch the blob */
+   size_t hash;
+
+   /* the blob, or NULL if the slot is free */
+   Blob_T blob;
+};
+
+
+/*
+   A store is a hash table of blobs with open addressing and linear
+   probing, kept at most half full so that probes are short and
+   always end. Blobs only leave it when it is rebuilt, so it needs no
+   markers for removed ones.
+*/
+struct Store {
+   /* the slots, of which there are a power of two, and the number
+      holding a blob */
+   struct Store_slot* slots;
+   size_t numSlots;
+   size_t numBlobs;
+
+   /* the lookups that found their bytes, and that did not */
+   size_t numHits;
+   size_t numMisses;
+};
+
+
+/*
+   Returns the hash of the length bytes at bytes, taken a word at a
+   time: each word is folded in by a multiply, whose high half is
+   then folded back into the low half, which picks the slot.
+*/
+static size_t Store_hash(const void* bytes, size_t length) {
+   const unsigned char* p = bytes;
+   size_t hash = length;
+   size_t word;
+   size_t i = 0;
+   size_t half = sizeof(size_t) * 4;
+
+   for (; i + sizeof word <= length; i += sizeof word) {
+      memcpy(&word, p + i, sizeof word);
+      hash = (hash ^ word) * 0x9E3779B1U;
+      hash ^= hash >> half;
+   }
+   if (i < length) {
+      word = 0;
+      memcpy(&word, p + i, length - i);
+      hash = (hash ^ word) * 0x9E3779B1U;
+      hash ^= hash >> half;
+   }
+
+   hash *= 0x85EBCA6BU;
+   return hash ^ (hash >> half);
+}
+
+
+/*
+   Puts blob, whose bytes have hash hash, in the first free slot of
+   the numSlots slots it probes in slots.
+*/
+static void Store_put(struct Store_slot* slots, size_t numSlots,
+Blob_T blob, size_t hash) {
+   size_t mask = numSlots - 1;
+   size_t i;
+
+   for (i = hash & mask; slots[i].blob != NULL; i = (i + 1) & mask)
+      ;
+   slots[i].hash = hash;
+   slots[i].blob = blob;
+}
+
+
+/*
+   Moves the blobs in s into a new array of numSlots slots, which
+   must have room for them. If isPruning is TRUE, lets go of the
+   blobs no one else refers to instead. Returns SUCCESS, or
+   MEMORY_ERROR, in which case s is unchanged.
+*/
+static int Store_rebuild(Store_T s, size_t numSlots,
+boolean isPruning) {
+   struct Store_slot* slots;
+   Blob_T blob;
+   size_t i;
+
+   assert(s != NULL);
+
+   slots = calloc(numSlots, sizeof(struct Store_slot));
+   if (slots == NULL)
+      return MEMORY_ERROR;
+
+   for (i = 0; i < s->numSlots; i++) {
+      blob = s->slots[i].blob;
+      if (blob == NULL)
+         continue;
+      /* with only the store's reference, no one else can take one */
+      if (isPruning && Blob_countRefs(blob) == 1) {
+         Blob_release(blob);
+         s->numBlobs--;
+      }
+      else
+         Store_put(slots, numSlots, blob, s->slots[i].hash);
+   }
+
+   free(s->slots);
+   s->slots = slots;
+   s->numSlots = numSlots;
+   return SUCCESS;
+}
+
+
+/* see store.h for specification */
+Store_T Store_new(void) {
+   Store_T s;
+
+   s = malloc(sizeof(struct Store));
+   if (s == NULL)
+      return NULL;
+
+   s->slots = calloc(STORE_MIN_SLOTS, sizeof(struct Store_slot));
+   if (s->slots == NULL) {
+      free(s);
+      return NULL;
+   }
+   s->numSlots = STORE_MIN_SLOTS;
+   s->numBlobs = 0;
+   s->numHits = 0;
+   s->numMisses = 0;
+   return s;
+}
+
+
+/* see store.h for specification */
+void Store_free(Store_T s) {
+   size_t i;
+
+   if (s == NULL)
+      return;
+
+   for (i = 0; i < s->numSlots; i++)
+      Blob_release(s->slots[i].blob);
+   free(s->slots);
+   free(s);
+}
+
+
+/* see store.h for specification */
+Blob_T Store_lookup(Store_T s, const void* bytes, size_t length,
+size_t* pHash) {
+   Blob_T blob;
+   size_t hash;
+   size_t mask;
+   size_t i;
+
+   assert(s != NULL);
+   assert(bytes != NULL || length == 0);
+   assert(pHash != NULL);
+
+   hash = Store_hash(bytes, length);
+   *pHash = hash;
+
+   mask = s->numSlots - 1;
+   for (i = hash & mask; s->slots[i].blob != NULL;
+        i = (i + 1) & mask) {
+      blob = s->slots[i].blob;
+      if (s->slots[i].hash == hash &&
+          Blob_getLength(blob) == length &&
+          (length == 0 ||
+           memcmp(Blob_getBytes(blob), bytes, length) == 0)) {
+         s->numHits++;
+         return blob;
+      }
+   }
+
+   s->numMisses++;
+   return NULL;
+}
+
+
+/* see store.h for specification */
+int Store_insert(Store_T s, Blob_T blob, size_t hash) {
+   assert(s != NULL);
+   assert(blob != NULL);
+
+   /* a full table is first rid of the blobs no one refers to, and
+      grows if that does not leave it at most a quarter full, so
+      that it fills up again only after as many insertions as it
+      has blobs */
+   if (2 * (s->numBlobs + 1) > s->numSlots) {
+      if (Store_rebuild(s, s->numSlots, TRUE) != SUCCESS)
+         return MEMORY_ERROR;
+      if (4 * (s->numBlobs + 1) > s->numSlots &&
+          Store_rebuild(s, 2 * s->numSlots, FALSE) != SUCCESS &&
+          2 * (s->numBlobs + 1) > s->numSlots)
+         return MEMORY_ERROR;
+   }
+
+   Store_put(s->slots, s->numSlots, Blob_retain(blob), hash);
+   s->numBlobs++;
+   return SUCCESS;
+}
+
+
+/* see store.h for specification */
+void Store_prune(Store_T s) {
+   size_t i;
+
+   assert(s != NULL);
+
+   for (i = 0; i < s->numSlots; i++)
+      if (s->slots[i].blob != NULL &&
+          Blob_countRefs(s->slots[i].blob) == 1)
+         break;
+   if (i == s->numSlots)
+      return;
+
+   /* only rebuilding keeps every probe sequence unbroken, and if
+      there is no memory for it, the blobs are let go of later */
+   (void) Store_rebuild(s, s->numSlots, TRUE);
+}
+
+
+/* see store.h for specification */
+void Store_getStats(Store_T s, struct Store_stats* pStats) {
+   size_t refs;
+   size_t length;
+   size_t i;
+
+   assert(s != NULL);
+   assert(pStats != NULL);
+
+   pStats->numBlobs = s->numBlobs;
+   pStats->numBytes = 0;
+   pStats->numRefs = 0;
+   pStats->numRefBytes = 0;
+   pStats->numHits = s->numHits;
+   pStats->numMisses = s->numMisses;
+
+   for (i = 0; i < s->numSlots; i++) {
+      if (s->slots[i].blob == NULL)
+         continue;
+      refs = Blob_countRefs(s->slots[i].blob) - 1;
+      length = Blob_getLength(s->slots[i].blob);
+      pStats->numBytes += length;
+      pStats->numRefs += refs;
+      pStats->numRefBytes += refs * length;
+   }
+}
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------*/
+/* store.h                                                            */
+/* Author: Anton Stengel and Jake Intrater                            */
+/*--------------------------------------------------------------------*/
+
+
+#ifndef STORE_INCLUDED
+#define STORE_INCLUDED
+
+
+#include <stddef.h>
+#include "a4def.h"
+#include "blob.h"
+
+
+/*
+    a Store_T is a content-addressed set of Blob_Ts, at most one per
+    distinct run of bytes, so that equal contents can be found and
+    shared rather than kept twice. Blobs are found by a hash of their
+    bytes and then compared byte by byte, so two blobs are only taken
+    to be equal if they are. The store holds a reference to each of
+    its blobs, and lets go of those no one else refers to any more
+    from time to time.
+
+    A Store_T is not safe for use by many threads at once, though the
+    blobs in it are.
+*/
+typedef struct Store* Store_T;
+
+
+/* Counts describing a Store_T, as Store_getStats fills them in. */
+struct Store_stats {
+   /* the number of blobs in the store, and their total length */
+   size_t numBlobs;
+   size_t numBytes;
+
+   /* the number of references to them besides the store's, and
+      the total length of the contents those refer to */
+   size_t numRefs;
+   size_t numRefBytes;
+
+   /* the number of lookups that found their bytes in the store,
+      and the number that did not */
+   size_t numHits;
+   size_t numMisses;
+};
+
+
+/*
+    Creates and returns a new, empty Store_T, or NULL if allocation
+    error occurs.
+*/
+Store_T Store_new(void);
+
+
+/*
+    Releases the references s holds and frees s. Does nothing if s is
+    NULL.
+*/
+void Store_free(Store_T s);
+
+
+/*
+    Returns the blob in s holding the same length bytes as bytes
+    (which may be NULL if length is 0), or NULL if there is none, and
+    sets *pHash to the hash of bytes, for Store_insert. The blob
+    returned is only certain to live while s holds it, so the caller
+    must take a reference to keep it.
+*/
+Blob_T Store_lookup(Store_T s, const void* bytes, size_t length,
+size_t* pHash);
+
+
+/*
+    Adds blob, whose bytes have hash hash and are in no blob in s
+    yet, to s, which takes a reference to it. Returns SUCCESS, or
+    MEMORY_ERROR, in which case s is unchanged.
+*/
+int Store_insert(Store_T s, Blob_T blob, size_t hash);
+
+
+/*
+    Lets go of the blobs in s no one else refers to.
+*/
+void Store_prune(Store_T s);
+
+
+/*
+    Fills in *pStats for s.
+*/
+void Store_getStats(Store_T s, struct Store_stats* pStats);
+
+#endif